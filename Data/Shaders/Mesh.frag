@@ -7,6 +7,7 @@ layout(location = 1) in vec2 inFragTexCoord;
 layout(location = 2) in vec3 inPos;
 layout(location = 3) in vec3 inEyePos;
 layout(location = 4) in vec4 inShadowCoord;
+layout(location = 5) flat in uint inMaterialIndex;
 layout(location = 5) out vec4 test;
 
 layout(location = 0) out vec4 outColor;
@@ -31,13 +32,22 @@ layout(binding = 0) uniform UniformBufferObject
 	mat4 depthVP;
 } ubo;
 
-layout(binding = 2) uniform UniformMaterialBuffer
+struct Material
 {	
 	vec4	color;
 	float	reflectance;
 	float	perceptual_roughness;
 	float	metallic;							// Slider but value other than 0.0 & 1.0 has no real meaning in physics
-} material;
+	uint	maskChannels;						// Channels of the mask map coming from an image
+};
+
+// Materials of every node, indexed per instance
+layout(std430, binding = 2) readonly buffer MaterialBuffer
+{
+	Material materials[];
+};
+
+Material material;
 
 layout(binding = 3) uniform LightUniformBufferObject 
 {	
@@ -50,6 +60,7 @@ layout(binding = 4) uniform Ambient
 	vec4	equatorColor;
 	vec4	groundColor;
 	vec4	ambientCube[6];
+	vec4	irradiance[9];			// L2 spherical harmonics of the irradiance of the skybox, divided by pi
 	float	ka;
 	int		mode;
 } ambient;
@@ -63,21 +74,32 @@ layout(binding = 5) uniform Params
 
 layout(binding = 6) uniform sampler2D texSampler;
 layout(binding = 7) uniform sampler2D normalMapSampler;
-layout(binding = 8) uniform sampler2D specularMapSampler;
-layout(binding = 9) uniform sampler2D metallicMapSampler;
-layout(binding = 10) uniform sampler2D roughnessMapSampler;
+// Occlusion, roughness, metallic and specular packed in RGBA, white where no image
+layout(binding = 8) uniform sampler2D maskMapSampler;
+
+layout(binding = 9) uniform sampler2D shadowMapSampler;
 
-layout(binding = 11) uniform sampler2D shadowMapSampler;
+layout (binding = 10) uniform samplerCube samplerCubeMap;
 
-layout (binding = 12) uniform samplerCube samplerCubeMap;
+// GGX prefiltered skybox, the perceptual roughness over the levels
+layout(binding = 11) uniform samplerCube specularMapSampler;
+// Scale and bias of f0 over NdotV and the perceptual roughness, 16 bits stored as high and low bytes
+layout(binding = 12) uniform sampler2D brdfLutSampler;
 
 // "Enums"
 const int AmbientTrilight = 1;
 const int AmbientCubeMap = 2;
+const int AmbientImageBased = 3;
 
 const int GGX_Karis = 1;
 const int Blinn_Phong = 2;
 
+// Bits of material.maskChannels
+const uint MaskMetallic = 4u;
+
+// Fetched once per fragment
+vec4 mask;
+
 struct SurfaceOutput
 {
 	vec3	albedo;
@@ -85,6 +107,7 @@ struct SurfaceOutput
 	vec3	specular;
 	float	metallic;
 	float	roughness;
+	float	occlusion;
 };
 
 //	-------------------------
@@ -146,9 +169,8 @@ vec3 ComputeAlbedo()
 	
 	if(texSize.x > 2)
 	{
-		vec4 tex_color = texture(texSampler, inFragTexCoord);
-
-		albedo *= pow(tex_color.rgb, vec3(params.gamma));
+		// Albedo images are sRGB, the sampler returns linear values
+		albedo *= texture(texSampler, inFragTexCoord).rgb;
 	}
 
 	return albedo;
@@ -169,7 +191,9 @@ vec3 ComputeNormal()
 		vec3 T = normalize(q1 * st2.t - q2 * st1.t);
 		vec3 B = -normalize(cross(N, T));
 		mat3 TBN = mat3(T, B, N);
-		vec3 normal = normalize(2.0 * texture(normalMapSampler, inFragTexCoord).rgb - 1.0);
+		// Only x and y are stored (BC5), z is rebuilt from the unit length
+		vec2 normalXY = 2.0 * texture(normalMapSampler, inFragTexCoord).rg - 1.0;
+		vec3 normal = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
 		return normalize(TBN * normal);
 	}
 	else
@@ -178,25 +202,13 @@ vec3 ComputeNormal()
 
 vec3 ComputeSpecular()
 {
-	ivec2 texSize = textureSize(specularMapSampler, 0);
-	
-	if(texSize.x > 2)
-	{
-		vec4 tex_color = texture(specularMapSampler, inFragTexCoord);
-		return GammaToLinear(tex_color.rgb);
-	}
-
-	return vec3(1.0);
+	return GammaToLinear(vec3(mask.a));
 }
 
 float ComputeMetallic()
 {
-	ivec2 texSize = textureSize(metallicMapSampler, 0);
-	
-	if(texSize.x > 2)
-	{
-		return texture(metallicMapSampler, inFragTexCoord).r;
-	}
+	if((material.maskChannels & MaskMetallic) != 0u)
+		return mask.b;
 
 	return material.metallic;
 }
@@ -204,14 +216,8 @@ float ComputeMetallic()
 float ComputeRoughness()
 {
 	float roughness = material.perceptual_roughness * material.perceptual_roughness;;
-	ivec2 texSize = textureSize(roughnessMapSampler, 0);
-	
-	if(texSize.x > 2)
-	{
-		float r = texture(roughnessMapSampler, inFragTexCoord).r;
-		r = r * r;
-		roughness *= r;
-	}
+	float r = mask.g;
+	roughness *= r * r;
 
 	return roughness;
 }
@@ -468,13 +474,58 @@ vec3 ComputeLight(LeLight light, SurfaceOutput o, vec3 V)
 	return (diffuse + specular) * NdotL * light.intensity * attenuation;
 }
 
-vec3 CalculateAmbientLight(SurfaceOutput o)
+// View space direction to the direction the skybox is sampled with
+vec3 CubeMapDirection(vec3 direction)
+{
+	vec3 d = transpose(mat3(ubo.view)) * direction;
+	d.z *= -1;
+	return d;
+}
+
+vec3 EvaluateIrradiance(vec3 n)
+{
+	return max(ambient.irradiance[0].rgb * 0.282095
+		+ ambient.irradiance[1].rgb * (0.488603 * n.y)
+		+ ambient.irradiance[2].rgb * (0.488603 * n.z)
+		+ ambient.irradiance[3].rgb * (0.488603 * n.x)
+		+ ambient.irradiance[4].rgb * (1.092548 * n.x * n.y)
+		+ ambient.irradiance[5].rgb * (1.092548 * n.y * n.z)
+		+ ambient.irradiance[6].rgb * (0.315392 * (3.0 * n.z * n.z - 1.0))
+		+ ambient.irradiance[7].rgb * (1.092548 * n.x * n.z)
+		+ ambient.irradiance[8].rgb * (0.546274 * (n.x * n.x - n.y * n.y)), vec3(0.0));
+}
+
+// Split sum : prefiltered radiance times the integrated BRDF of the LUT
+vec3 CalculateImageBasedLight(SurfaceOutput o, vec3 V)
+{
+	float NdotV = max(dot(o.normal, V), 0.001);
+	float perceptualRoughness = sqrt(o.roughness);
+	vec3 R = CubeMapDirection(reflect(-V, o.normal));
+
+	float lod = perceptualRoughness * float(textureQueryLevels(specularMapSampler) - 1);
+	vec3 radiance = textureLod(specularMapSampler, R, lod).rgb;
+
+	vec4 lut = texture(brdfLutSampler, vec2(NdotV, perceptualRoughness));
+	vec2 scaleBias = vec2(dot(lut.rg, vec2(65280.0, 255.0) / 65535.0), dot(lut.ba, vec2(65280.0, 255.0) / 65535.0));
+
+	vec3 f0 = RemapReflectance(material.reflectance, o.albedo, o.metallic);
+	vec3 diffuse = EvaluateIrradiance(CubeMapDirection(o.normal)) * ComputeDiffuseColor(o.albedo, o.metallic);
+	vec3 specular = radiance * (f0 * scaleBias.x + scaleBias.y) * o.specular;
+
+	return diffuse + specular;
+}
+
+vec3 CalculateAmbientLight(SurfaceOutput o, vec3 V)
 {
 	vec3 ambientSky = GammaToLinear(ambient.skyColor.rgb);	
 	vec3 ambientEquator = GammaToLinear(ambient.equatorColor.rgb);	
 	vec3 ambientGround = GammaToLinear(ambient.groundColor.rgb);	
 
-	if (ambient.mode == AmbientCubeMap)
+	if (ambient.mode == AmbientImageBased)
+	{
+		return CalculateImageBasedLight(o, V);
+	}
+	else if (ambient.mode == AmbientCubeMap)
 	{
 		vec3 sqrNormal = o.normal * o.normal;
 		ivec3 isNegative = ivec3(o.normal.x < 0.0,
@@ -528,6 +579,15 @@ vec3 Reflect(vec3 normal, vec3 V)
     return texture(samplerCubeMap, R).rgb;
 }
 
+// The image based ambient already reflects the skybox
+vec3 CalculateReflection(SurfaceOutput o, vec3 V)
+{
+	if (ambient.mode == AmbientImageBased || o.metallic <= 0.0)
+		return vec3(0.0);
+
+	return Reflect(o.normal, V) * o.metallic;
+}
+
 
 
 //	-------------
@@ -536,17 +596,21 @@ vec3 Reflect(vec3 normal, vec3 V)
 
 void main() 
 {
+	material = materials[inMaterialIndex];
+	mask = texture(maskMapSampler, inFragTexCoord);
+
 	SurfaceOutput o;
 	o.albedo = ComputeAlbedo();
 	o.normal = ComputeNormal();
 	o.specular = ComputeSpecular();
 	o.metallic = ComputeMetallic();
 	o.roughness = ComputeRoughness();
+	o.occlusion = mask.r;
 
 	// Cause eye pos = vec3(0.0) in camera space
 	vec3 V = normalize(-inPos);
 
-	vec3 finalColor = CalculateAmbientLight(o);
+	vec3 finalColor = CalculateAmbientLight(o, V) * o.occlusion;
 	
 	for	(int i = 0; i < 9; ++i)
 	{
@@ -555,10 +619,7 @@ void main()
 			finalColor += ComputeLight(light, o, V);
 	}
 
-	if(o.metallic > 0.f)
-	{
-		finalColor += Reflect(o.normal, V) * o.metallic;
-	}
+	finalColor += CalculateReflection(o, V);
 
 	finalColor = LinearToGamma(finalColor);
 
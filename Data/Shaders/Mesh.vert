@@ -8,11 +8,6 @@ layout(binding = 0) uniform UniformBufferObject
 	mat4 depthVP;
 } ubo;
 
-layout(binding = 1) uniform UniformNodeVertexBuffer 
-{
-    mat4 model;
-} nvo;
-
 layout(binding = 5) uniform Params
 {
 	int		brdf;
@@ -25,11 +20,16 @@ layout(location = 1) in vec2 inTexCoord;
 layout(location = 2) in vec3 inColor;
 layout(location = 3) in vec3 inNormal;
 
+// Per instance
+layout(location = 4) in mat4 inModel;
+layout(location = 8) in uint inMaterialIndex;
+
 layout(location = 0) out vec3 outNormal;
 layout(location = 1) out vec2 outFragTexCoord;
 layout(location = 2) out vec3 outPos;
 layout(location = 3) out vec3 outEyePos;
 layout(location = 4) out vec4 outShadowCoord;
+layout(location = 5) flat out uint outMaterialIndex;
 
 const mat4 biasMat = mat4( 
 	0.5, 0.0, 0.0, 0.0,
@@ -45,16 +45,18 @@ out gl_PerVertex
 
 void main()
 {
-	outPos = (ubo.view * nvo.model * vec4(inPosition, 1.0)).xyz;
+	outPos = (ubo.view * inModel * vec4(inPosition, 1.0)).xyz;
 
 	outFragTexCoord = vec2(inTexCoord.x, 1.0 - inTexCoord.y);
 	
-	mat3 normalMatrix = mat3(ubo.view) * mat3(transpose(inverse(nvo.model)));
+	mat3 normalMatrix = mat3(ubo.view) * mat3(transpose(inverse(inModel)));
 	outNormal = normalMatrix * inNormal;
 
 	outEyePos = vec3(0.0);
 
-	gl_Position = ubo.proj * ubo.view * nvo.model * vec4(inPosition, 1.0);
+	outMaterialIndex = inMaterialIndex;
+
+	gl_Position = ubo.proj * ubo.view * inModel * vec4(inPosition, 1.0);
 	
-	outShadowCoord = ( biasMat * ubo.depthVP * nvo.model ) * vec4(inPosition, 1.0);	
+	outShadowCoord = ( biasMat * ubo.depthVP * inModel ) * vec4(inPosition, 1.0);	
 }
\ No newline at end of file
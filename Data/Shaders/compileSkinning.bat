@@ -0,0 +1,3 @@
+C:\VulkanSDK\1.1.114.0\Bin32\glslc.exe skinning.comp -o skinning.comp.spv
+C:\VulkanSDK\1.1.114.0\Bin32\glslc.exe skinning.comp -o ../../x64/Data/Shaders/skinning.comp.spv
+pause
@@ -8,6 +8,7 @@ layout(location = 2) in vec3 inPos;
 layout(location = 3) in vec3 inEyePos;
 layout(location = 4) in vec4 inShadowCoord;
 layout(location = 5) in mat4 inCameraSpace;
+layout(location = 9) flat in uint inMaterialIndex;
 
 layout(location = 0) out vec4 outColor;
 
@@ -40,13 +41,18 @@ layout(binding = 2) uniform Params
 	bool	useCameraSpace;
 } params;
 
-layout(binding = 3) uniform UniformMaterialBuffer
+struct Material
 {	
 	vec4	color;
 	float	reflectance;
 	float	perceptual_roughness;
 	float	metallic;							// Slider but value other than 0.0 & 1.0 has no real meaning in physics
-} material;
+};
+
+layout(std430, binding = 3) readonly buffer MaterialBuffer
+{
+	Material materials[];
+};
 
 //	-------------------------
 //	|	Gamma Correction	|
@@ -71,7 +77,7 @@ void main()
 
 	vec3 finalColor = vec3(0.f, 0.f, 0.f);
 
-	finalColor = material.color.xyz;
+	finalColor = materials[inMaterialIndex].color.xyz;
 	
 	finalColor = LinearToGamma(finalColor);
 		
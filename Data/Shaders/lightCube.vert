@@ -8,11 +8,6 @@ layout(binding = 0) uniform UniformBufferObject
 	mat4 depthVP;
 } ubo;
 
-layout(binding = 1) uniform UniformNodeVertexBuffer 
-{
-    mat4 model;
-} nvo;
-
 layout(binding = 2) uniform Params
 {
 	int		brdf;
@@ -25,7 +20,10 @@ layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec2 inTexCoord;
 layout(location = 2) in vec3 inColor;
 layout(location = 3) in vec3 inNormal;
-layout(location = 4) in vec3 inTangent;
+
+// Per instance
+layout(location = 4) in mat4 inModel;
+layout(location = 8) in uint inMaterialIndex;
 
 layout(location = 0) out vec3 outNormal;
 layout(location = 1) out vec2 outFragTexCoord;
@@ -33,6 +31,7 @@ layout(location = 2) out vec3 outPos;
 layout(location = 3) out vec3 outEyePos;
 layout(location = 4) out vec4 outShadowCoord;
 layout(location = 5) out mat4 outCameraSpace;
+layout(location = 9) flat out uint outMaterialIndex;
 
 out gl_PerVertex 
 {
@@ -42,22 +41,23 @@ out gl_PerVertex
 void main()
 {
 	outCameraSpace = ubo.view;
+	outMaterialIndex = inMaterialIndex;
 
 	if (params.useCameraSpace)
-		outPos = (ubo.view * nvo.model * vec4(inPosition, 1.0)).xyz;
+		outPos = (ubo.view * inModel * vec4(inPosition, 1.0)).xyz;
 	else
-		outPos = (nvo.model * vec4(inPosition, 1.0)).xyz;
+		outPos = (inModel * vec4(inPosition, 1.0)).xyz;
 
 	outFragTexCoord = vec2(inTexCoord.x, 1.0 - inTexCoord.y);
 	
 	if (params.useCameraSpace)
 	{
-		mat3 normalMatrix = mat3(transpose(inverse(ubo.view * nvo.model)));
+		mat3 normalMatrix = mat3(transpose(inverse(ubo.view * inModel)));
 		outNormal = normalMatrix * inNormal;
 	}
 	else
 	{
-		mat3 normalMatrix = mat3(transpose(inverse(nvo.model)));
+		mat3 normalMatrix = mat3(transpose(inverse(inModel)));
 		outNormal = normalMatrix * inNormal;
 	}
 
@@ -66,7 +66,7 @@ void main()
 	else
 		outEyePos = -vec3(ubo.view[3]);
 
-	gl_Position = ubo.proj * ubo.view * nvo.model * vec4(inPosition, 1.0);
+	gl_Position = ubo.proj * ubo.view * inModel * vec4(inPosition, 1.0);
 	
-	outShadowCoord = ( ubo.depthVP * nvo.model ) * vec4(inPosition, 1.0);	
+	outShadowCoord = ( ubo.depthVP * inModel ) * vec4(inPosition, 1.0);	
 }
\ No newline at end of file
@@ -2,17 +2,15 @@
 
 layout(location = 0) in vec3 inPosition;
 
+// Per instance
+layout(location = 4) in mat4 inModel;
+
 layout (set = 0, binding = 0) uniform UBO 
 {
 	mat4 depthVP;
 	int lightType;
 } ubo;
 
-layout(set = 1, binding = 1) uniform UniformNodeVertexBuffer 
-{
-    mat4 model;
-} nvo;
-
 out gl_PerVertex 
 {
     vec4 gl_Position;
@@ -23,11 +21,11 @@ void main()
 {
 	if(ubo.lightType == 1) // SPOT LIGHT
 	{
-		gl_Position = ubo.depthVP * nvo.model * vec4(inPosition, 1.f);
+		gl_Position = ubo.depthVP * inModel * vec4(inPosition, 1.f);
 	}
 	else if	(ubo.lightType == 2) // DIRECTIONAL LIGHT
 	{
-		gl_Position = ubo.depthVP * nvo.model * vec4(inPosition, 1.0);
+		gl_Position = ubo.depthVP * inModel * vec4(inPosition, 1.0);
 	}
 	else
 	{
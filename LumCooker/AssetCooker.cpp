@@ -0,0 +1,516 @@
+#include "AssetCooker.h"
+#include "MeshLoader.h"
+#include "MeshFile.h"
+#include "KtxFile.h"
+#include "TextureCache.h"
+#include "IblBaker.h"
+#include "ThreadPool.h"
+#include "PackFile.h"
+#include "VirtualFileSystem.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+	const char* const jobTypeNames[] = { "mesh", "model", "texture", "mask", "cubemap" };
+	const char* const semanticNames[] = { "color", "albedo", "normal", "scalar", "mask", "height" };
+	const char* const cubeFaceNames[] = { "posx.jpg", "negx.jpg", "posy.jpg", "negy.jpg", "posz.jpg", "negz.jpg" };
+	const char* const cookListName = "CookList.txt";
+
+	std::string GetExtension(const std::string& path)
+	{
+		size_t dot = path.rfind('.');
+		if (dot == std::string::npos || path.find_first_of("/\\", dot) != std::string::npos)
+			return "";
+
+		std::string extension = path.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return extension;
+	}
+
+	bool ParseSemantic(const std::string& name, TextureSemantic& semantic)
+	{
+		for (int i = 0; i <= static_cast<int>(TextureSemantic::Height); ++i)
+		{
+			if (name == semanticNames[i])
+			{
+				semantic = static_cast<TextureSemantic>(i);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	std::vector<std::string> SplitKey(const std::string& key)
+	{
+		// Empty fields are kept, they are the empty channels of a mask map
+		std::vector<std::string> fields;
+		size_t start = 0;
+		for (size_t end = key.find('|'); end != std::string::npos; end = key.find('|', start))
+		{
+			fields.push_back(key.substr(start, end - start));
+			start = end + 1;
+		}
+
+		fields.push_back(key.substr(start));
+		return fields;
+	}
+}
+
+std::string CookJob::GetKey() const
+{
+	std::string key = jobTypeNames[static_cast<int>(type)];
+	if (type == CookJobType::Texture)
+		key += std::string("|") + semanticNames[static_cast<int>(semantic)];
+
+	for (const std::string& source : sources)
+		key += "|" + source;
+
+	return key;
+}
+
+AssetCooker::AssetCooker(const std::string& dataDirectory, const std::string& manifestPath) : dataDirectory(dataDirectory), manifestPath(manifestPath)
+{
+	for (std::atomic<size_t>& result : results)
+		result = 0;
+}
+
+CookJob AssetCooker::MakeMeshJob(const std::string& path, bool hierarchy)
+{
+	CookJob job;
+	job.type = hierarchy ? CookJobType::Model : CookJobType::Mesh;
+	job.sources = { path };
+	job.output = MeshFile::GetCachePath(path, hierarchy);
+	return job;
+}
+
+CookJob AssetCooker::MakeTextureJob(const std::string& path, TextureSemantic semantic)
+{
+	CookJob job;
+	job.type = CookJobType::Texture;
+	job.semantic = semantic;
+	job.sources = { path };
+	job.output = KtxFile::GetCachePath(path);
+	return job;
+}
+
+CookJob AssetCooker::MakeMaskJob(const std::vector<std::string>& channelPaths)
+{
+	CookJob job;
+	job.type = CookJobType::Mask;
+	job.semantic = TextureSemantic::Mask;
+	job.sources = channelPaths;
+
+	// Named after the first source as in TextureCache::LoadMaskChain
+	auto first = std::find_if(channelPaths.begin(), channelPaths.end(), [](const std::string& path) { return !path.empty(); });
+	if (first != channelPaths.end())
+		job.output = KtxFile::GetCachePath(*first + ".mask");
+
+	return job;
+}
+
+CookJob AssetCooker::MakeCubeMapJob(const std::vector<std::string>& facePaths)
+{
+	CookJob job;
+	job.type = CookJobType::CubeMap;
+	job.sources = facePaths;
+	job.output = TextureCache::GetCubeCachePath(facePaths);
+	return job;
+}
+
+bool AssetCooker::ParseJob(const std::string& key, CookJob& job)
+{
+	std::vector<std::string> fields = SplitKey(key);
+
+	TextureSemantic semantic;
+	if (fields.size() == 3 && fields[0] == jobTypeNames[static_cast<int>(CookJobType::Texture)] && ParseSemantic(fields[1], semantic))
+	{
+		job = MakeTextureJob(fields[2], semantic);
+		return true;
+	}
+	else if (fields.size() == 1 + static_cast<size_t>(MaskChannel::Count) && fields[0] == jobTypeNames[static_cast<int>(CookJobType::Mask)])
+	{
+		job = MakeMaskJob(std::vector<std::string>(fields.begin() + 1, fields.end()));
+		return !job.output.empty();
+	}
+
+	return false;
+}
+
+bool AssetCooker::IsModelFile(const std::string& path)
+{
+	std::string extension = GetExtension(path);
+	return extension == "fbx" || extension == "obj" || extension == "dae" || extension == "3ds" || extension == "gltf" || extension == "glb";
+}
+
+bool AssetCooker::IsImageFile(const std::string& path)
+{
+	std::string extension = GetExtension(path);
+	return extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga" || extension == "bmp";
+}
+
+void AssetCooker::AddMaterialReferences(const MeshData* data, std::vector<std::string>& references)
+{
+	std::vector<std::string> keys;
+
+	if (!data->texturePath.empty())
+		keys.push_back(MakeTextureJob(data->texturePath, TextureSemantic::Albedo).GetKey());
+
+	if (!data->normalMapPath.empty())
+		keys.push_back(MakeTextureJob(data->normalMapPath, TextureSemantic::Normal).GetKey());
+
+	// Packed in the alpha of the mask map
+	if (!data->specularMapPath.empty())
+		keys.push_back(MakeMaskJob({ "", "", "", data->specularMapPath }).GetKey());
+
+	for (const std::string& key : keys)
+	{
+		if (std::find(references.begin(), references.end(), key) == references.end())
+			references.push_back(key);
+	}
+}
+
+void AssetCooker::ReadCookList(std::vector<CookJob>& jobs)
+{
+	std::ifstream file(dataDirectory + "/" + cookListName);
+
+	std::string line;
+	for (int lineNumber = 1; std::getline(file, line); ++lineNumber)
+	{
+		std::stringstream stream(line);
+		std::string type;
+		if (!(stream >> type) || type[0] == '#')
+			continue;
+
+		std::vector<std::string> arguments;
+		std::string argument;
+		while (stream >> argument)
+			arguments.push_back(argument);
+
+		auto toPath = [this](const std::string& argument) { return argument == "-" ? std::string() : dataDirectory + "/" + argument; };
+
+		CookJob job;
+		bool valid = false;
+		TextureSemantic semantic;
+
+		if (type == jobTypeNames[static_cast<int>(CookJobType::Texture)] && arguments.size() == 2 && ParseSemantic(arguments[0], semantic))
+		{
+			job = MakeTextureJob(toPath(arguments[1]), semantic);
+			valid = !job.sources[0].empty();
+		}
+		else if (type == jobTypeNames[static_cast<int>(CookJobType::Mask)] && arguments.size() == static_cast<size_t>(MaskChannel::Count))
+		{
+			std::vector<std::string> channelPaths;
+			for (const std::string& channel : arguments)
+				channelPaths.push_back(toPath(channel));
+
+			job = MakeMaskJob(channelPaths);
+			valid = !job.output.empty();
+		}
+		else if (type == jobTypeNames[static_cast<int>(CookJobType::CubeMap)] && arguments.size() == 1)
+		{
+			std::vector<std::string> facePaths;
+			for (const char* face : cubeFaceNames)
+				facePaths.push_back(toPath(arguments[0]) + "/" + face);
+
+			job = MakeCubeMapJob(facePaths);
+			valid = true;
+		}
+
+		if (valid)
+			jobs.push_back(job);
+		else
+			std::cout << cookListName << "(" << lineNumber << ") : can't read \"" << line << "\"" << std::endl;
+	}
+}
+
+uint64_t AssetCooker::GetSettings(const CookJob& job) const
+{
+	// Everything the output depends on besides the content of its sources
+	std::string settings = job.GetKey() + "|" + std::to_string(cookVersion);
+
+	switch (job.type)
+	{
+	case CookJobType::Mesh:		settings += "|" + std::to_string(MeshLoader::meshImportFlags) + "|" + std::to_string(MeshFile::version); break;
+	case CookJobType::Model:	settings += "|" + std::to_string(MeshLoader::modelImportFlags) + "|" + std::to_string(MeshFile::version); break;
+	case CookJobType::Texture:
+	case CookJobType::Mask:
+		settings += "|" + std::to_string(TextureCache::ChooseFormat(job.semantic, false)) + "|" + std::to_string(TextureCache::ChooseFormat(job.semantic, true));
+		break;
+	case CookJobType::CubeMap:	settings += "|" + std::to_string(IblBaker::version); break;
+	default: break;
+	}
+
+	return CookManifest::Hash(settings.data(), settings.size());
+}
+
+void AssetCooker::Log(const std::string& message)
+{
+	std::lock_guard<std::mutex> lock(logMutex);
+	std::cout << message << std::endl;
+}
+
+bool AssetCooker::Run()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (!rebuildAll && !manifest.Load(manifestPath))
+		std::cout << "No manifest in " << manifestPath << ", every output is cooked" << std::endl;
+
+	std::vector<std::string> files;
+	PackFile::ListFiles(dataDirectory, "", files);
+	std::sort(files.begin(), files.end());
+
+	// Models first, their materials name the textures to cook and their semantic
+	std::vector<CookJob> meshJobs;
+	std::vector<std::string> images;
+	for (const std::string& file : files)
+	{
+		std::string path = dataDirectory + "/" + file;
+		if (IsModelFile(path))
+		{
+			meshJobs.push_back(MakeMeshJob(path, false));
+			meshJobs.push_back(MakeMeshJob(path, true));
+		}
+		else if (IsImageFile(path))
+		{
+			images.push_back(path);
+		}
+	}
+
+	std::vector<std::vector<std::string>> meshReferences;
+	RunJobs(meshJobs, meshReferences);
+
+	std::vector<CookJob> textureJobs;
+	ReadCookList(textureJobs);
+
+	for (const std::vector<std::string>& references : meshReferences)
+	{
+		for (const std::string& reference : references)
+		{
+			CookJob job;
+			if (ParseJob(reference, job))
+				textureJobs.push_back(job);
+		}
+	}
+
+	// One job per output, the cache of an image holds a single semantic
+	std::unordered_map<std::string, std::string> outputKeys;
+	std::unordered_set<std::string> claimedImages;
+	std::vector<CookJob> uniqueJobs;
+	for (const CookJob& job : textureJobs)
+	{
+		std::string key = job.GetKey();
+		auto existing = outputKeys.emplace(PackFile::NormalizePath(job.output), key);
+		if (!existing.second)
+		{
+			if (existing.first->second != key)
+				std::cout << job.output << " is wanted as " << existing.first->second << " and " << key << ", kept the first" << std::endl;
+			continue;
+		}
+
+		for (const std::string& source : job.sources)
+			claimedImages.insert(PackFile::NormalizePath(source));
+
+		uniqueJobs.push_back(job);
+	}
+
+	for (const std::string& image : images)
+	{
+		if (claimedImages.count(PackFile::NormalizePath(image)) == 0 && outputKeys.count(PackFile::NormalizePath(KtxFile::GetCachePath(image))) == 0)
+			uniqueJobs.push_back(MakeTextureJob(image, TextureSemantic::Color));
+	}
+
+	std::vector<std::vector<std::string>> textureReferences;
+	RunJobs(uniqueJobs, textureReferences);
+
+	std::unordered_set<std::string> outputs;
+	for (const std::vector<CookJob>* jobs : { &meshJobs, &uniqueJobs })
+	{
+		for (const CookJob& job : *jobs)
+			outputs.insert(job.output);
+	}
+
+	size_t pruned = manifest.Prune(outputs);
+	if (!manifest.Save(manifestPath))
+		std::cout << "Can't write " << manifestPath << std::endl;
+
+	size_t failed = results[static_cast<int>(JobResult::Failed)];
+	std::cout << "Cooked " << results[static_cast<int>(JobResult::Cooked)] << ", restamped " << results[static_cast<int>(JobResult::Restamped)]
+		<< ", up to date " << results[static_cast<int>(JobResult::UpToDate)] << ", failed " << failed << ", forgotten " << pruned << " outputs in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms on "
+		<< ThreadPool::Get().GetWorkerCount() + 1 << " threads" << std::endl;
+
+	return failed == 0;
+}
+
+void AssetCooker::RunJobs(const std::vector<CookJob>& jobs, std::vector<std::vector<std::string>>& references)
+{
+	references.resize(jobs.size());
+
+	ThreadPool::Get().ParallelFor(jobs.size(), [this, &jobs, &references](size_t i)
+	{
+		JobResult result = RunJob(jobs[i], references[i]);
+		++results[static_cast<int>(result)];
+
+		if (result == JobResult::Cooked)
+			Log("Cooked " + jobs[i].output);
+		else if (result == JobResult::Restamped)
+			Log("Restamped " + jobs[i].output);
+	});
+}
+
+AssetCooker::JobResult AssetCooker::RunJob(const CookJob& job, std::vector<std::string>& references)
+{
+	CookManifest::Entry previous;
+	bool known = !rebuildAll && manifest.Find(job.output, previous);
+
+	CookManifest::Entry entry;
+	entry.settings = GetSettings(job);
+
+	bool upToDate = known && previous.settings == entry.settings && VirtualFileSystem::Exists(job.output);
+	bool touched = false;
+
+	for (const std::string& source : job.sources)
+	{
+		if (source.empty())
+			continue;
+
+		CookManifest::Input input;
+		input.path = source;
+		if (!VirtualFileSystem::GetStamp(source, input.size, input.time))
+		{
+			Log("Missing source " + source + " of " + job.output);
+			return JobResult::Failed;
+		}
+
+		// The content of a source with the same stamp is trusted, the others are hashed
+		size_t index = entry.inputs.size();
+		const CookManifest::Input* last = index < previous.inputs.size() && previous.inputs[index].path == source ? &previous.inputs[index] : nullptr;
+		if (last && last->size == input.size && last->time == input.time)
+		{
+			input.hash = last->hash;
+		}
+		else
+		{
+			if (!CookManifest::HashFile(source, input.hash))
+			{
+				Log("Can't read " + source);
+				return JobResult::Failed;
+			}
+
+			touched = true;
+		}
+
+		upToDate = upToDate && last && last->size == input.size && last->hash == input.hash;
+		entry.inputs.push_back(input);
+	}
+
+	upToDate = upToDate && entry.inputs.size() == previous.inputs.size();
+
+	if (upToDate)
+	{
+		references = previous.references;
+		entry.references = previous.references;
+
+		if (!touched)
+			return JobResult::UpToDate;
+
+		// Same content under a new date, the runtime checks the dates
+		if (RestampOutput(job))
+		{
+			manifest.Set(job.output, entry);
+			return JobResult::Restamped;
+		}
+
+		references.clear();
+	}
+
+	if (!CookOutput(job, references))
+	{
+		// Cooked again by the next run whatever its sources
+		manifest.Set(job.output, CookManifest::Entry());
+		return JobResult::Failed;
+	}
+
+	entry.references = references;
+	manifest.Set(job.output, entry);
+	return JobResult::Cooked;
+}
+
+bool AssetCooker::CookOutput(const CookJob& job, std::vector<std::string>& references)
+{
+	switch (job.type)
+	{
+	case CookJobType::Mesh:
+	case CookJobType::Model:
+	{
+		std::vector<MeshData*> parts;
+		bool cooked = MeshLoader::CookMeshFile(job.sources[0], job.type == CookJobType::Model, parts);
+		for (MeshData* part : parts)
+		{
+			AddMaterialReferences(part, references);
+			delete part;
+		}
+
+		if (!cooked)
+			Log("Can't cook " + job.sources[0]);
+
+		return cooked;
+	}
+	case CookJobType::Texture:
+		return TextureCache::Cook(job.sources[0], job.semantic);
+	case CookJobType::Mask:
+	{
+		MaskSources sources;
+		sources.occlusion = job.sources[0];
+		sources.roughness = job.sources[1];
+		sources.metallic = job.sources[2];
+		sources.specular = job.sources[3];
+		return TextureCache::CookMask(sources);
+	}
+	case CookJobType::CubeMap:
+	{
+		Texture faces[6];
+		bool cooked = TextureCache::LoadCubeFaces(job.sources, faces, true);
+
+		// The image based lighting the driver bakes from the skybox
+		ImageBasedLight light;
+		cooked = cooked && IblBaker::Load(job.sources, faces, light, true);
+		light.Clear();
+
+		for (Texture& face : faces)
+			face.Clear();
+
+		return cooked;
+	}
+	default:
+		return false;
+	}
+}
+
+bool AssetCooker::RestampOutput(const CookJob& job)
+{
+	if (job.type == CookJobType::Mesh || job.type == CookJobType::Model)
+		return MeshFile::Restamp(job.output, job.sources[0]);
+
+	std::vector<std::string> sourcePaths;
+	for (const std::string& source : job.sources)
+	{
+		if (!source.empty())
+			sourcePaths.push_back(source);
+	}
+
+	if (job.type == CookJobType::CubeMap && !IblBaker::Restamp(sourcePaths))
+		return false;
+
+	return KtxFile::Restamp(job.output, sourcePaths);
+}
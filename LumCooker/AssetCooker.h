@@ -0,0 +1,98 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+#include "CookManifest.h"
+#include "Texture.h"
+
+struct MeshData;
+
+enum class CookJobType : int
+{
+	Mesh = 0,	// .lmesh of AssetManager::LoadMesh
+	Model,		// .model.lmesh of MeshLoader::LoadModel, with the hierarchy
+	Texture,
+	Mask,
+	CubeMap,
+	Count
+};
+
+// One output of the cook and the sources it is built from
+struct CookJob
+{
+	CookJobType					type = CookJobType::Texture;
+	TextureSemantic				semantic = TextureSemantic::Color;
+	std::vector<std::string>	sources;	// A mask map keeps an empty path per empty channel, a cube map its six faces
+	std::string					output;
+
+	// "type|semantic|sources", the identity of the job and its reference in the manifest
+	std::string GetKey() const;
+};
+
+// Converts the source assets of a data directory into the engine formats ahead of the launch, on the ThreadPool :
+// both .lmesh files of every model, the .ktx2 chains of their material textures, the textures, mask maps and cube maps
+// (with the image based lighting of IblBaker) of the CookList.txt of the directory, and every other image in the Color semantic of TextureCache::Load.
+// Outputs are written where the runtime loaders look for them, through the same code. An output is cooked again
+// only when the content of one of its inputs or its settings changed, a source touched without change only stamps it again.
+class AssetCooker
+{
+public:
+	// Bumped when a cook step changes its output without any setting changing
+	static const uint32_t cookVersion = 2;
+
+	AssetCooker(const std::string& dataDirectory, const std::string& manifestPath);
+
+	// Ignores the manifest, every output is cooked
+	void SetRebuildAll(bool rebuild) { rebuildAll = rebuild; }
+
+	// False when an output can't be cooked
+	bool Run();
+
+private:
+	enum class JobResult : int
+	{
+		UpToDate = 0,
+		Restamped,
+		Cooked,
+		Failed,
+		Count
+	};
+
+	static CookJob MakeMeshJob(const std::string& path, bool hierarchy);
+	static CookJob MakeTextureJob(const std::string& path, TextureSemantic semantic);
+	static CookJob MakeMaskJob(const std::vector<std::string>& channelPaths);
+	static CookJob MakeCubeMapJob(const std::vector<std::string>& facePaths);
+
+	// Inverse of CookJob::GetKey, false for a key of an older cooker
+	static bool ParseJob(const std::string& key, CookJob& job);
+
+	static bool IsModelFile(const std::string& path);
+	static bool IsImageFile(const std::string& path);
+
+	// The textures MeshLoader::CreateMaterialTextures loads for the material of data
+	static void AddMaterialReferences(const MeshData* data, std::vector<std::string>& references);
+
+	// Lines "texture <semantic> <path>", "mask <occlusion> <roughness> <metallic> <specular>" with '-' for an empty channel
+	// and "cubemap <directory>", paths relative to the data directory
+	void ReadCookList(std::vector<CookJob>& jobs);
+
+	uint64_t GetSettings(const CookJob& job) const;
+
+	void RunJobs(const std::vector<CookJob>& jobs, std::vector<std::vector<std::string>>& references);
+	JobResult RunJob(const CookJob& job, std::vector<std::string>& references);
+	bool CookOutput(const CookJob& job, std::vector<std::string>& references);
+	bool RestampOutput(const CookJob& job);
+
+	void Log(const std::string& message);
+
+	std::string dataDirectory;
+	std::string manifestPath;
+	bool rebuildAll = false;
+
+	CookManifest manifest;
+	std::atomic<size_t> results[static_cast<int>(JobResult::Count)];
+	std::mutex logMutex;
+};
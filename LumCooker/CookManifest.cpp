@@ -0,0 +1,178 @@
+#include "CookManifest.h"
+#include "VirtualFileSystem.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+namespace
+{
+	const char* const header = "LumCooker manifest";
+
+	std::vector<std::string> SplitFields(const std::string& line)
+	{
+		std::vector<std::string> fields;
+		std::stringstream stream(line);
+		std::string field;
+		while (std::getline(stream, field, '\t'))
+			fields.push_back(field);
+
+		return fields;
+	}
+
+	std::string ToHex(uint64_t value)
+	{
+		char text[17];
+		snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+		return text;
+	}
+
+	uint64_t FromHex(const std::string& text)
+	{
+		return std::strtoull(text.c_str(), nullptr, 16);
+	}
+}
+
+bool CookManifest::Load(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.clear();
+
+	std::ifstream file(path);
+	std::string line;
+	if (!file.is_open() || !std::getline(file, line) || line != header + std::string(" ") + std::to_string(version))
+		return false;
+
+	Entry* entry = nullptr;
+	while (std::getline(file, line))
+	{
+		std::vector<std::string> fields = SplitFields(line);
+
+		if (fields.size() == 3 && fields[0] == "output")
+		{
+			entry = &entries[fields[1]];
+			entry->settings = FromHex(fields[2]);
+		}
+		else if (fields.size() == 5 && fields[0] == "input" && entry)
+		{
+			Input input;
+			input.path = fields[1];
+			input.size = std::strtoull(fields[2].c_str(), nullptr, 10);
+			input.time = std::strtoll(fields[3].c_str(), nullptr, 10);
+			input.hash = FromHex(fields[4]);
+			entry->inputs.push_back(input);
+		}
+		else if (fields.size() == 2 && fields[0] == "reference" && entry)
+		{
+			entry->references.push_back(fields[1]);
+		}
+		else
+		{
+			// Unreadable, nothing is trusted
+			entries.clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool CookManifest::Save(const std::string& path) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	file << header << " " << version << "\n";
+	for (const auto& entry : entries)
+	{
+		file << "output\t" << entry.first << "\t" << ToHex(entry.second.settings) << "\n";
+
+		for (const Input& input : entry.second.inputs)
+			file << "input\t" << input.path << "\t" << input.size << "\t" << input.time << "\t" << ToHex(input.hash) << "\n";
+
+		for (const std::string& reference : entry.second.references)
+			file << "reference\t" << reference << "\n";
+	}
+
+	return file.good();
+}
+
+bool CookManifest::Find(const std::string& output, Entry& entry) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto it = entries.find(output);
+	if (it == entries.end())
+		return false;
+
+	entry = it->second;
+	return true;
+}
+
+void CookManifest::Set(const std::string& output, const Entry& entry)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	entries[output] = entry;
+}
+
+size_t CookManifest::Prune(const std::unordered_set<std::string>& outputs)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	size_t pruned = 0;
+	for (auto it = entries.begin(); it != entries.end();)
+	{
+		if (outputs.count(it->first) == 0)
+		{
+			it = entries.erase(it);
+			++pruned;
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	return pruned;
+}
+
+size_t CookManifest::GetEntryCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.size();
+}
+
+uint64_t CookManifest::Hash(const void* data, size_t size, uint64_t hash)
+{
+	// Over 8 bytes words, the tail is hashed byte by byte
+	const uint64_t prime = 0x100000001B3ull;
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	size_t wordCount = size / sizeof(uint64_t);
+
+	for (size_t i = 0; i < wordCount; ++i)
+	{
+		uint64_t word;
+		memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+		hash = (hash ^ word) * prime;
+	}
+
+	for (size_t i = wordCount * sizeof(uint64_t); i < size; ++i)
+		hash = (hash ^ bytes[i]) * prime;
+
+	return hash;
+}
+
+bool CookManifest::HashFile(const std::string& path, uint64_t& hash)
+{
+	std::shared_ptr<const FileData> file = VirtualFileSystem::Open(path);
+	if (!file)
+		return false;
+
+	hash = Hash(file->GetData(), file->GetSize());
+	return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_set>
+#include <mutex>
+#include <cstdint>
+
+// What the last cook built : for every output, the settings hash it was built with and the stamp and content hash of its inputs.
+// Saved as text, one "output" line followed by its "input" and "reference" lines. Thread safe
+class CookManifest
+{
+public:
+	static const uint32_t version = 1;
+
+	struct Input
+	{
+		std::string	path;
+		uint64_t	size = 0;
+		int64_t		time = 0;
+		uint64_t	hash = 0;
+	};
+
+	struct Entry
+	{
+		uint64_t					settings = 0;
+		std::vector<Input>			inputs;
+		std::vector<std::string>	references;		// Jobs found by the import, the material textures of a model
+	};
+
+	// A missing or older file leaves the manifest empty, everything is cooked again
+	bool Load(const std::string& path);
+	bool Save(const std::string& path) const;
+
+	bool Find(const std::string& output, Entry& entry) const;
+	void Set(const std::string& output, const Entry& entry);
+
+	// Drops the entries of outputs no job produces anymore, returns how many
+	size_t Prune(const std::unordered_set<std::string>& outputs);
+
+	size_t GetEntryCount() const;
+
+	// FNV-1a 64 bits
+	static uint64_t Hash(const void* data, size_t size, uint64_t hash = 0xCBF29CE484222325ull);
+	static bool HashFile(const std::string& path, uint64_t& hash);
+
+private:
+	// Sorted, the saved file only changes with its content
+	std::map<std::string, Entry> entries;
+	mutable std::mutex mutex;
+};
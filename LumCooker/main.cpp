@@ -0,0 +1,55 @@
+#include "AssetCooker.h"
+#include "TextureCache.h"
+#include "PackFile.h"
+
+#include <iostream>
+#include <string>
+
+// LumCooker [--data <directory>] [--rebuild] [--no-block-compression] [--pack]
+//   --rebuild : ignores the manifest of the last cook
+//   --no-block-compression : textures in the formats of a device without BC support
+//   --pack : packs the cooked directory in the .lpak archive the engine mounts
+const char* const defaultDataDirectory = "../Data";
+
+int main(int argc, char** argv)
+{
+	std::string dataDirectory = defaultDataDirectory;
+	bool rebuild = false;
+	bool blockCompression = true;
+	bool pack = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string argument = argv[i];
+		if (argument == "--data" && i + 1 < argc)
+			dataDirectory = argv[++i];
+		else if (argument == "--rebuild")
+			rebuild = true;
+		else if (argument == "--no-block-compression")
+			blockCompression = false;
+		else if (argument == "--pack")
+			pack = true;
+		else
+		{
+			std::cout << "Usage : LumCooker [--data <directory>] [--rebuild] [--no-block-compression] [--pack]" << std::endl;
+			return 1;
+		}
+	}
+
+	// The engine chooses the same formats on a device supporting them, it converts the textures again on the others
+	TextureCache::SetBlockCompression(blockCompression);
+
+	AssetCooker cooker(dataDirectory, dataDirectory + ".cookmanifest");
+	cooker.SetRebuildAll(rebuild);
+	bool cooked = cooker.Run();
+
+	if (pack)
+	{
+		std::string archivePath = dataDirectory + ".lpak";
+		int fileCount = PackFile::Build(dataDirectory, archivePath);
+		std::cout << (fileCount < 0 ? "Can't write " : "Packed " + std::to_string(fileCount) + " files in ") << archivePath << std::endl;
+		cooked = cooked && fileCount >= 0;
+	}
+
+	return cooked ? 0 : 1;
+}
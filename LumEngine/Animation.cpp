@@ -0,0 +1,489 @@
+#include "Animation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <xmmintrin.h>
+
+namespace
+{
+	size_t PadJointCount(size_t count)
+	{
+		return (count + 3) & ~size_t(3);
+	}
+
+	struct BlobWriter
+	{
+		std::vector<uint8_t>& data;
+
+		void Write(const void* value, size_t size)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(value);
+			data.insert(data.end(), bytes, bytes + size);
+		}
+
+		void WriteUint(uint32_t value) { Write(&value, sizeof(value)); }
+		void WriteFloat(float value) { Write(&value, sizeof(value)); }
+
+		void WriteString(const std::string& value)
+		{
+			WriteUint(static_cast<uint32_t>(value.size()));
+			Write(value.data(), value.size());
+		}
+
+		template<typename T>
+		void WriteArray(const std::vector<T>& values)
+		{
+			WriteUint(static_cast<uint32_t>(values.size()));
+			Write(values.data(), sizeof(T) * values.size());
+		}
+	};
+
+	struct BlobReader
+	{
+		const uint8_t* data;
+		size_t size;
+		size_t offset = 0;
+		bool valid = true;
+
+		void Read(void* value, size_t valueSize)
+		{
+			if (!valid || valueSize > size - offset)
+			{
+				valid = false;
+				memset(value, 0, valueSize);
+				return;
+			}
+
+			memcpy(value, data + offset, valueSize);
+			offset += valueSize;
+		}
+
+		uint32_t ReadUint() { uint32_t value; Read(&value, sizeof(value)); return value; }
+		float ReadFloat() { float value; Read(&value, sizeof(value)); return value; }
+
+		std::string ReadString()
+		{
+			uint32_t length = ReadUint();
+			if (!valid || length > size - offset)
+			{
+				valid = false;
+				return "";
+			}
+
+			std::string value(reinterpret_cast<const char*>(data + offset), length);
+			offset += length;
+			return value;
+		}
+
+		template<typename T>
+		void ReadArray(std::vector<T>& values)
+		{
+			uint32_t count = ReadUint();
+			if (!valid || count > (size - offset) / sizeof(T))
+			{
+				valid = false;
+				return;
+			}
+
+			values.resize(count);
+			Read(values.data(), sizeof(T) * count);
+		}
+	};
+}
+
+void SkeletonPose::Resize(size_t count)
+{
+	jointCount = count;
+	size_t padded = PadJointCount(count);
+
+	for (std::vector<float>* component : { &tx, &ty, &tz, &rx, &ry, &rz })
+		component->assign(padded, 0.f);
+
+	// Identity for every joint, padding joints keep a valid rotation for the normalization
+	for (std::vector<float>* component : { &rw, &sx, &sy, &sz })
+		component->assign(padded, 1.f);
+}
+
+void SkeletonPose::SetJoint(size_t joint, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+	tx[joint] = translation.x;
+	ty[joint] = translation.y;
+	tz[joint] = translation.z;
+	rx[joint] = rotation.x;
+	ry[joint] = rotation.y;
+	rz[joint] = rotation.z;
+	rw[joint] = rotation.w;
+	sx[joint] = scale.x;
+	sy[joint] = scale.y;
+	sz[joint] = scale.z;
+}
+
+int32_t Skeleton::FindJoint(const std::string& name) const
+{
+	auto it = std::find(names.begin(), names.end(), name);
+	return it != names.end() ? static_cast<int32_t>(it - names.begin()) : -1;
+}
+
+void AnimationSet::Serialize(std::vector<uint8_t>& data) const
+{
+	BlobWriter writer = { data };
+
+	writer.WriteUint(static_cast<uint32_t>(skeleton.GetJointCount()));
+	for (size_t i = 0; i < skeleton.GetJointCount(); ++i)
+	{
+		const SkeletonPose& bind = skeleton.bindPose;
+
+		writer.WriteString(skeleton.names[i]);
+		writer.WriteUint(static_cast<uint32_t>(skeleton.parents[i]));
+		writer.Write(&skeleton.inverseBindMatrices[i], sizeof(glm::mat4));
+
+		for (float value : { bind.tx[i], bind.ty[i], bind.tz[i], bind.rx[i], bind.ry[i], bind.rz[i], bind.rw[i], bind.sx[i], bind.sy[i], bind.sz[i] })
+			writer.WriteFloat(value);
+	}
+
+	writer.WriteUint(static_cast<uint32_t>(clips.size()));
+	for (const AnimationClip& clip : clips)
+	{
+		writer.WriteString(clip.name);
+		writer.WriteFloat(clip.duration);
+		writer.WriteUint(static_cast<uint32_t>(clip.tracks.size()));
+
+		for (const AnimationTrack& track : clip.tracks)
+		{
+			writer.WriteUint(static_cast<uint32_t>(track.joint));
+			writer.WriteArray(track.positionTimes);
+			writer.WriteArray(track.positions);
+			writer.WriteArray(track.rotationTimes);
+			writer.WriteArray(track.rotations);
+			writer.WriteArray(track.scaleTimes);
+			writer.WriteArray(track.scales);
+		}
+	}
+}
+
+bool AnimationSet::Deserialize(const uint8_t* data, size_t size)
+{
+	BlobReader reader = { data, size };
+
+	uint32_t jointCount = reader.ReadUint();
+	if (!reader.valid || jointCount > size)
+		return false;
+
+	skeleton.names.resize(jointCount);
+	skeleton.parents.resize(jointCount);
+	skeleton.inverseBindMatrices.resize(jointCount);
+	skeleton.bindPose.Resize(jointCount);
+
+	for (uint32_t i = 0; i < jointCount; ++i)
+	{
+		SkeletonPose& bind = skeleton.bindPose;
+
+		skeleton.names[i] = reader.ReadString();
+		skeleton.parents[i] = static_cast<int32_t>(reader.ReadUint());
+		reader.Read(&skeleton.inverseBindMatrices[i], sizeof(glm::mat4));
+
+		for (std::vector<float>* component : { &bind.tx, &bind.ty, &bind.tz, &bind.rx, &bind.ry, &bind.rz, &bind.rw, &bind.sx, &bind.sy, &bind.sz })
+			(*component)[i] = reader.ReadFloat();
+
+		if (skeleton.parents[i] >= static_cast<int32_t>(i))
+			return false;
+	}
+
+	uint32_t clipCount = reader.ReadUint();
+	if (!reader.valid || clipCount > size)
+		return false;
+
+	clips.resize(clipCount);
+	for (AnimationClip& clip : clips)
+	{
+		clip.name = reader.ReadString();
+		clip.duration = reader.ReadFloat();
+
+		uint32_t trackCount = reader.ReadUint();
+		if (!reader.valid || trackCount > size)
+			return false;
+
+		clip.tracks.resize(trackCount);
+		for (AnimationTrack& track : clip.tracks)
+		{
+			track.joint = static_cast<int32_t>(reader.ReadUint());
+			reader.ReadArray(track.positionTimes);
+			reader.ReadArray(track.positions);
+			reader.ReadArray(track.rotationTimes);
+			reader.ReadArray(track.rotations);
+			reader.ReadArray(track.scaleTimes);
+			reader.ReadArray(track.scales);
+
+			if (track.joint < 0 || track.joint >= static_cast<int32_t>(jointCount)
+				|| track.positionTimes.size() != track.positions.size()
+				|| track.rotationTimes.size() != track.rotations.size()
+				|| track.scaleTimes.size() != track.scales.size())
+				return false;
+		}
+	}
+
+	return reader.valid;
+}
+
+void AnimationSampler::FindKeys(const std::vector<float>& times, float time, size_t& first, size_t& second, float& factor)
+{
+	auto it = std::upper_bound(times.begin(), times.end(), time);
+
+	second = std::min(static_cast<size_t>(it - times.begin()), times.size() - 1);
+	first = second > 0 ? second - 1 : 0;
+
+	float span = times[second] - times[first];
+	factor = span > 0.f ? glm::clamp((time - times[first]) / span, 0.f, 1.f) : 0.f;
+}
+
+void AnimationSampler::Sample(const AnimationClip& clip, const Skeleton& skeleton, float time, Scratch& scratch, SkeletonPose& pose)
+{
+	const SkeletonPose& bind = skeleton.bindPose;
+	size_t padded = bind.GetPaddedCount();
+
+	scratch.from = bind;
+	scratch.to = bind;
+	scratch.translationFactors.assign(padded, 0.f);
+	scratch.rotationFactors.assign(padded, 0.f);
+	scratch.scaleFactors.assign(padded, 0.f);
+
+	if (pose.GetPaddedCount() != padded)
+		pose.Resize(skeleton.GetJointCount());
+
+	// Key lookup is scalar, the interpolation below runs on 4 joints at a time
+	for (const AnimationTrack& track : clip.tracks)
+	{
+		size_t joint = static_cast<size_t>(track.joint);
+		size_t first, second;
+
+		if (!track.positions.empty())
+		{
+			FindKeys(track.positionTimes, time, first, second, scratch.translationFactors[joint]);
+			scratch.from.tx[joint] = track.positions[first].x;
+			scratch.from.ty[joint] = track.positions[first].y;
+			scratch.from.tz[joint] = track.positions[first].z;
+			scratch.to.tx[joint] = track.positions[second].x;
+			scratch.to.ty[joint] = track.positions[second].y;
+			scratch.to.tz[joint] = track.positions[second].z;
+		}
+
+		if (!track.rotations.empty())
+		{
+			FindKeys(track.rotationTimes, time, first, second, scratch.rotationFactors[joint]);
+			scratch.from.rx[joint] = track.rotations[first].x;
+			scratch.from.ry[joint] = track.rotations[first].y;
+			scratch.from.rz[joint] = track.rotations[first].z;
+			scratch.from.rw[joint] = track.rotations[first].w;
+			scratch.to.rx[joint] = track.rotations[second].x;
+			scratch.to.ry[joint] = track.rotations[second].y;
+			scratch.to.rz[joint] = track.rotations[second].z;
+			scratch.to.rw[joint] = track.rotations[second].w;
+		}
+
+		if (!track.scales.empty())
+		{
+			FindKeys(track.scaleTimes, time, first, second, scratch.scaleFactors[joint]);
+			scratch.from.sx[joint] = track.scales[first].x;
+			scratch.from.sy[joint] = track.scales[first].y;
+			scratch.from.sz[joint] = track.scales[first].z;
+			scratch.to.sx[joint] = track.scales[second].x;
+			scratch.to.sy[joint] = track.scales[second].y;
+			scratch.to.sz[joint] = track.scales[second].z;
+		}
+	}
+
+	const SkeletonPose& from = scratch.from;
+	const SkeletonPose& to = scratch.to;
+
+	Lerp(from.tx.data(), to.tx.data(), scratch.translationFactors.data(), pose.tx.data(), padded);
+	Lerp(from.ty.data(), to.ty.data(), scratch.translationFactors.data(), pose.ty.data(), padded);
+	Lerp(from.tz.data(), to.tz.data(), scratch.translationFactors.data(), pose.tz.data(), padded);
+	Lerp(from.sx.data(), to.sx.data(), scratch.scaleFactors.data(), pose.sx.data(), padded);
+	Lerp(from.sy.data(), to.sy.data(), scratch.scaleFactors.data(), pose.sy.data(), padded);
+	Lerp(from.sz.data(), to.sz.data(), scratch.scaleFactors.data(), pose.sz.data(), padded);
+	Nlerp(from, to, scratch.rotationFactors.data(), pose);
+}
+
+void AnimationSampler::Blend(const SkeletonPose& a, const SkeletonPose& b, float weight, SkeletonPose& pose)
+{
+	size_t padded = a.GetPaddedCount();
+
+	if (pose.GetPaddedCount() != padded)
+		pose.Resize(a.jointCount);
+
+	std::vector<float> weights(padded, weight);
+
+	Lerp(a.tx.data(), b.tx.data(), weights.data(), pose.tx.data(), padded);
+	Lerp(a.ty.data(), b.ty.data(), weights.data(), pose.ty.data(), padded);
+	Lerp(a.tz.data(), b.tz.data(), weights.data(), pose.tz.data(), padded);
+	Lerp(a.sx.data(), b.sx.data(), weights.data(), pose.sx.data(), padded);
+	Lerp(a.sy.data(), b.sy.data(), weights.data(), pose.sy.data(), padded);
+	Lerp(a.sz.data(), b.sz.data(), weights.data(), pose.sz.data(), padded);
+	Nlerp(a, b, weights.data(), pose);
+}
+
+void AnimationSampler::Lerp(const float* a, const float* b, const float* factors, float* out, size_t count)
+{
+	for (size_t i = 0; i < count; i += 4)
+	{
+		__m128 va = _mm_loadu_ps(a + i);
+		__m128 vb = _mm_loadu_ps(b + i);
+		__m128 vf = _mm_loadu_ps(factors + i);
+		_mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), vf)));
+	}
+}
+
+void AnimationSampler::Nlerp(const SkeletonPose& a, const SkeletonPose& b, const float* factors, SkeletonPose& out)
+{
+	const __m128 signMask = _mm_set1_ps(-0.f);
+
+	for (size_t i = 0; i < a.GetPaddedCount(); i += 4)
+	{
+		__m128 ax = _mm_loadu_ps(&a.rx[i]), ay = _mm_loadu_ps(&a.ry[i]), az = _mm_loadu_ps(&a.rz[i]), aw = _mm_loadu_ps(&a.rw[i]);
+		__m128 bx = _mm_loadu_ps(&b.rx[i]), by = _mm_loadu_ps(&b.ry[i]), bz = _mm_loadu_ps(&b.rz[i]), bw = _mm_loadu_ps(&b.rw[i]);
+		__m128 f = _mm_loadu_ps(factors + i);
+
+		// Shortest path, b is negated where the dot product is negative
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+		__m128 sign = _mm_and_ps(dot, signMask);
+		bx = _mm_xor_ps(bx, sign);
+		by = _mm_xor_ps(by, sign);
+		bz = _mm_xor_ps(bz, sign);
+		bw = _mm_xor_ps(bw, sign);
+
+		__m128 x = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), f));
+		__m128 y = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), f));
+		__m128 z = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), f));
+		__m128 w = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw, aw), f));
+
+		__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+		__m128 inverseLength = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(_mm_max_ps(lengthSquared, _mm_set1_ps(1e-12f))));
+
+		_mm_storeu_ps(&out.rx[i], _mm_mul_ps(x, inverseLength));
+		_mm_storeu_ps(&out.ry[i], _mm_mul_ps(y, inverseLength));
+		_mm_storeu_ps(&out.rz[i], _mm_mul_ps(z, inverseLength));
+		_mm_storeu_ps(&out.rw[i], _mm_mul_ps(w, inverseLength));
+	}
+}
+
+void AnimationSampler::ComputeGlobalTransforms(const Skeleton& skeleton, const SkeletonPose& pose, Scratch& scratch, std::vector<glm::mat4>& globals)
+{
+	size_t jointCount = skeleton.GetJointCount();
+	scratch.locals.resize(pose.GetPaddedCount());
+	globals.resize(jointCount);
+
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 two = _mm_set1_ps(2.f);
+
+	// Local TRS matrices of 4 joints at a time
+	for (size_t i = 0; i < pose.GetPaddedCount(); i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&pose.rx[i]), y = _mm_loadu_ps(&pose.ry[i]), z = _mm_loadu_ps(&pose.rz[i]), w = _mm_loadu_ps(&pose.rw[i]);
+		__m128 sx = _mm_loadu_ps(&pose.sx[i]), sy = _mm_loadu_ps(&pose.sy[i]), sz = _mm_loadu_ps(&pose.sz[i]);
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		alignas(16) float m[9][4];
+		_mm_store_ps(m[0], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx));
+		_mm_store_ps(m[1], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx));
+		_mm_store_ps(m[2], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx));
+		_mm_store_ps(m[3], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy));
+		_mm_store_ps(m[4], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy));
+		_mm_store_ps(m[5], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy));
+		_mm_store_ps(m[6], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz));
+		_mm_store_ps(m[7], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz));
+		_mm_store_ps(m[8], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz));
+
+		for (size_t lane = 0; lane < 4; ++lane)
+		{
+			glm::mat4& local = scratch.locals[i + lane];
+			local[0] = glm::vec4(m[0][lane], m[1][lane], m[2][lane], 0.f);
+			local[1] = glm::vec4(m[3][lane], m[4][lane], m[5][lane], 0.f);
+			local[2] = glm::vec4(m[6][lane], m[7][lane], m[8][lane], 0.f);
+			local[3] = glm::vec4(pose.tx[i + lane], pose.ty[i + lane], pose.tz[i + lane], 1.f);
+		}
+	}
+
+	// Parents are sorted first
+	for (size_t i = 0; i < jointCount; ++i)
+	{
+		int32_t parent = skeleton.parents[i];
+		globals[i] = parent < 0 ? scratch.locals[i] : globals[parent] * scratch.locals[i];
+	}
+}
+
+void AnimationSampler::ComputeSkinningMatrices(const Skeleton& skeleton, const std::vector<glm::mat4>& globals, std::vector<glm::mat4>& matrices)
+{
+	matrices.resize(skeleton.GetJointCount());
+
+	for (size_t i = 0; i < skeleton.GetJointCount(); ++i)
+		matrices[i] = globals[i] * skeleton.inverseBindMatrices[i];
+}
+
+AnimationInstance::AnimationInstance(std::shared_ptr<const AnimationSet> animationSet)
+	:animationSet(animationSet)
+{
+	pose = animationSet->skeleton.bindPose;
+	Update(0.f);
+}
+
+void AnimationInstance::Play(size_t clipIndex, float blendDuration)
+{
+	if (clipIndex >= animationSet->clips.size())
+		return;
+
+	previousClip = blendDuration > 0.f ? clip : -1;
+	previousTime = time;
+	this->blendDuration = blendDuration;
+	blendTime = 0.f;
+
+	clip = static_cast<int32_t>(clipIndex);
+	time = 0.f;
+}
+
+float AnimationInstance::AdvanceTime(int32_t clipIndex, float clipTime, float deltaTime) const
+{
+	float duration = animationSet->clips[clipIndex].duration;
+	clipTime += deltaTime * speed;
+
+	if (duration <= 0.f)
+		return 0.f;
+
+	clipTime = std::fmod(clipTime, duration);
+	return clipTime < 0.f ? clipTime + duration : clipTime;
+}
+
+void AnimationInstance::Update(float deltaTime)
+{
+	const Skeleton& skeleton = animationSet->skeleton;
+	const SkeletonPose* finalPose = &pose;
+
+	if (clip >= 0)
+	{
+		time = AdvanceTime(clip, time, deltaTime);
+		AnimationSampler::Sample(animationSet->clips[clip], skeleton, time, scratch, pose);
+
+		if (previousClip >= 0)
+		{
+			blendTime += deltaTime;
+
+			if (blendTime >= blendDuration)
+			{
+				previousClip = -1;
+			}
+			else
+			{
+				previousTime = AdvanceTime(previousClip, previousTime, deltaTime);
+				AnimationSampler::Sample(animationSet->clips[previousClip], skeleton, previousTime, scratch, previousPose);
+				AnimationSampler::Blend(previousPose, pose, blendTime / blendDuration, blendedPose);
+				finalPose = &blendedPose;
+			}
+		}
+	}
+
+	AnimationSampler::ComputeGlobalTransforms(skeleton, *finalPose, scratch, globals);
+	AnimationSampler::ComputeSkinningMatrices(skeleton, globals, skinningMatrices);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Local joint transforms in SoA form, arrays are padded to a multiple of 4 joints for SIMD
+struct SkeletonPose
+{
+	size_t jointCount = 0;
+
+	std::vector<float> tx, ty, tz;
+	std::vector<float> rx, ry, rz, rw;
+	std::vector<float> sx, sy, sz;
+
+	void Resize(size_t count);
+	void SetJoint(size_t joint, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+	size_t GetPaddedCount() const { return tx.size(); }
+};
+
+struct Skeleton
+{
+	// Joints are sorted parents first, a root has a parent of -1
+	std::vector<std::string> names;
+	std::vector<int32_t> parents;
+	std::vector<glm::mat4> inverseBindMatrices;
+	SkeletonPose bindPose;
+
+	size_t GetJointCount() const { return parents.size(); }
+	int32_t FindJoint(const std::string& name) const;
+};
+
+// Keys of one joint, times are in seconds
+struct AnimationTrack
+{
+	int32_t joint = -1;
+
+	std::vector<float> positionTimes;
+	std::vector<glm::vec3> positions;
+	std::vector<float> rotationTimes;
+	std::vector<glm::quat> rotations;
+	std::vector<float> scaleTimes;
+	std::vector<glm::vec3> scales;
+};
+
+struct AnimationClip
+{
+	std::string name;
+	float duration = 0.f;
+	std::vector<AnimationTrack> tracks;
+};
+
+// Skeleton and clips of a model, shared by all its instances
+struct AnimationSet
+{
+	Skeleton skeleton;
+	std::vector<AnimationClip> clips;
+
+	void Serialize(std::vector<uint8_t>& data) const;
+	bool Deserialize(const uint8_t* data, size_t size);
+};
+
+class AnimationSampler
+{
+public:
+	AnimationSampler() = delete;
+	~AnimationSampler() = delete;
+
+	// Keys surrounding the sampled time, interpolated afterwards 4 joints at a time
+	struct Scratch
+	{
+		SkeletonPose from;
+		SkeletonPose to;
+		std::vector<float> translationFactors;
+		std::vector<float> rotationFactors;
+		std::vector<float> scaleFactors;
+		std::vector<glm::mat4> locals;
+	};
+
+	// Joints without track keep their bind pose
+	static void Sample(const AnimationClip& clip, const Skeleton& skeleton, float time, Scratch& scratch, SkeletonPose& pose);
+
+	// Linear blend of translations and scales, normalized lerp of rotations
+	static void Blend(const SkeletonPose& a, const SkeletonPose& b, float weight, SkeletonPose& pose);
+
+	static void ComputeGlobalTransforms(const Skeleton& skeleton, const SkeletonPose& pose, Scratch& scratch, std::vector<glm::mat4>& globals);
+	static void ComputeSkinningMatrices(const Skeleton& skeleton, const std::vector<glm::mat4>& globals, std::vector<glm::mat4>& matrices);
+
+private:
+	static void Lerp(const float* a, const float* b, const float* factors, float* out, size_t count);
+	static void Nlerp(const SkeletonPose& a, const SkeletonPose& b, const float* factors, SkeletonPose& out);
+	static void FindKeys(const std::vector<float>& times, float time, size_t& first, size_t& second, float& factor);
+};
+
+// Playback state of one animated model instance
+class AnimationInstance
+{
+public:
+	AnimationInstance(std::shared_ptr<const AnimationSet> animationSet);
+	~AnimationInstance() = default;
+
+	float speed = 1.f;
+
+	// Cross fades from the current clip over blendDuration seconds
+	void Play(size_t clipIndex, float blendDuration = 0.f);
+	void Update(float deltaTime);
+
+	const Skeleton& GetSkeleton() const { return animationSet->skeleton; }
+	const std::vector<glm::mat4>& GetGlobalTransforms() const { return globals; }
+	const std::vector<glm::mat4>& GetSkinningMatrices() const { return skinningMatrices; }
+
+private:
+	std::shared_ptr<const AnimationSet> animationSet;
+
+	int32_t clip = -1;
+	float time = 0.f;
+
+	int32_t previousClip = -1;
+	float previousTime = 0.f;
+	float blendDuration = 0.f;
+	float blendTime = 0.f;
+
+	AnimationSampler::Scratch scratch;
+	SkeletonPose pose;
+	SkeletonPose previousPose;
+	SkeletonPose blendedPose;
+
+	std::vector<glm::mat4> globals;
+	std::vector<glm::mat4> skinningMatrices;
+
+	float AdvanceTime(int32_t clipIndex, float clipTime, float deltaTime) const;
+};
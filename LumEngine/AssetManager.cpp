@@ -0,0 +1,429 @@
+#include "AssetManager.h"
+#include "MeshLoader.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <iostream>
+
+AssetManager::Pool AssetManager::textures;
+AssetManager::Pool AssetManager::meshes;
+std::deque<std::pair<bool, uint32_t>> AssetManager::uploads;
+std::unordered_map<Mesh*, std::vector<AssetManager::Binding>> AssetManager::pendingBindings;
+std::unordered_map<Mesh*, uint32_t> AssetManager::boundSlots;
+bool AssetManager::bindingsChanged = false;
+size_t AssetManager::pendingCount = 0;
+std::mutex AssetManager::mutex;
+
+uint32_t AssetManager::Allocate(Pool& pool)
+{
+	uint32_t index;
+	if (!pool.freeSlots.empty())
+	{
+		index = pool.freeSlots.back();
+		pool.freeSlots.pop_back();
+	}
+	else
+	{
+		index = static_cast<uint32_t>(pool.slots.size());
+		pool.slots.emplace_back();
+	}
+
+	Slot& slot = pool.slots[index];
+	slot.refCount = 1;
+	slot.state = AssetState::Queued;
+	++pendingCount;
+
+	return index;
+}
+
+AssetManager::Slot* AssetManager::Find(Pool& pool, uint32_t index, uint32_t generation)
+{
+	if (index == 0 || index >= pool.slots.size() || pool.slots[index].generation != generation || pool.slots[index].refCount <= 0)
+		return nullptr;
+
+	return &pool.slots[index];
+}
+
+void AssetManager::FreeIfUnused(Pool& pool, uint32_t index)
+{
+	Slot& slot = pool.slots[index];
+	if (slot.refCount > 0 || !IsFinal(slot.state))
+		return;
+
+	TextureCache::Release(slot.texture);
+	MeshCache::Release(slot.data);
+
+	if (slot.mesh)
+	{
+		auto bindings = pendingBindings.find(slot.mesh);
+		if (bindings != pendingBindings.end())
+		{
+			std::vector<Binding> released = std::move(bindings->second);
+			pendingBindings.erase(bindings);
+
+			for (const Binding& binding : released)
+				ReleaseLocked(binding.texture);
+		}
+
+		boundSlots.erase(slot.mesh);
+		delete slot.mesh;
+	}
+
+	// Stale handles no longer match the slot
+	uint32_t generation = slot.generation + 1;
+	slot = Slot();
+	slot.generation = generation;
+	pool.freeSlots.push_back(index);
+}
+
+void AssetManager::ReleaseLocked(TextureHandle handle)
+{
+	if (Find(textures, handle.index, handle.generation) == nullptr)
+		return;
+
+	--textures.slots[handle.index].refCount;
+	FreeIfUnused(textures, handle.index);
+}
+
+void AssetManager::FinishDecode(Pool& pool, uint32_t index, bool isMesh, bool decoded)
+{
+	Slot& slot = pool.slots[index];
+
+	// Released while decoding, nothing left to upload
+	if (decoded && slot.refCount > 0)
+	{
+		slot.state = AssetState::Uploading;
+		uploads.emplace_back(isMesh, index);
+		return;
+	}
+
+	slot.state = AssetState::Failed;
+	--pendingCount;
+	bindingsChanged = true;
+	FreeIfUnused(pool, index);
+}
+
+uint32_t AssetManager::GetSlotBit(Texture* LeMaterial::* slot)
+{
+	if (slot == &LeMaterial::texture)
+		return 1;
+
+	return slot == &LeMaterial::normalMap ? 2 : 4;
+}
+
+TextureHandle AssetManager::QueueTexture(const std::function<Texture*()>& load)
+{
+	TextureHandle handle;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		handle.index = Allocate(textures);
+		handle.generation = textures.slots[handle.index].generation;
+	}
+
+	// The slot can't be freed before its decode is final
+	ThreadPool::Get().Submit([handle, load]()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			textures.slots[handle.index].state = AssetState::Decoding;
+		}
+
+		Texture* texture = load();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		textures.slots[handle.index].texture = texture;
+		FinishDecode(textures, handle.index, false, texture != nullptr);
+	});
+
+	return handle;
+}
+
+TextureHandle AssetManager::LoadTexture(const std::string& path, TextureSemantic semantic)
+{
+	return QueueTexture([path, semantic]() { return TextureCache::Load(path, semantic); });
+}
+
+TextureHandle AssetManager::LoadMask(const MaskSources& sources)
+{
+	return QueueTexture([sources]() { return TextureCache::LoadMask(sources); });
+}
+
+MeshHandle AssetManager::LoadMesh(const std::string& path)
+{
+	// Placeholder textures, the material can be edited while the geometry loads
+	Mesh* mesh = new Mesh(nullptr);
+	mesh->CreateMaterial();
+	mesh->name = path.substr(path.find_last_of("/\\") + 1);
+	MeshLoader::CreateDefaultMaterialTextures(mesh);
+
+	MeshHandle handle;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		handle.index = Allocate(meshes);
+		handle.generation = meshes.slots[handle.index].generation;
+		meshes.slots[handle.index].mesh = mesh;
+	}
+
+	ThreadPool::Get().Submit([handle, path]() { DecodeMesh(handle.index, path); });
+
+	return handle;
+}
+
+void AssetManager::DecodeMesh(uint32_t index, const std::string& path)
+{
+	Mesh* mesh;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		meshes.slots[index].state = AssetState::Decoding;
+		mesh = meshes.slots[index].mesh;
+	}
+
+	MeshData* data = nullptr;
+	try
+	{
+		data = MeshCache::Load(path, [&path]() { return MeshLoader::LoadMeshData(path); });
+	}
+	catch (const std::exception&)
+	{
+		data = nullptr;
+	}
+
+	if (data)
+		BindFileTextures(mesh, data);
+	else
+		std::cout << "Can't load mesh " << path << std::endl;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	meshes.slots[index].data = data;
+	FinishDecode(meshes, index, true, data != nullptr);
+}
+
+void AssetManager::BindFileTextures(Mesh* mesh, const MeshData* data)
+{
+	std::vector<Binding> fileBindings;
+
+	if (!data->texturePath.empty())
+		fileBindings.push_back({ &LeMaterial::texture, LoadTexture(data->texturePath, TextureSemantic::Albedo) });
+
+	if (!data->normalMapPath.empty())
+		fileBindings.push_back({ &LeMaterial::normalMap, LoadTexture(data->normalMapPath, TextureSemantic::Normal) });
+
+	// Packed in the alpha of the mask map
+	if (!data->specularMapPath.empty())
+	{
+		MaskSources sources;
+		sources.specular = data->specularMapPath;
+		fileBindings.push_back({ &LeMaterial::maskMap, LoadMask(sources) });
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	uint32_t callerSlots = boundSlots.count(mesh) > 0 ? boundSlots[mesh] : 0;
+	for (const Binding& binding : fileBindings)
+	{
+		if (callerSlots & GetSlotBit(binding.slot))
+			ReleaseLocked(binding.texture);
+		else
+			pendingBindings[mesh].push_back(binding);
+	}
+
+	bindingsChanged = true;
+}
+
+void AssetManager::BindTexture(Mesh* mesh, Texture* LeMaterial::* slot, TextureHandle texture)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	boundSlots[mesh] |= GetSlotBit(slot);
+
+	// The last binding of a slot wins
+	std::vector<Binding>& bindings = pendingBindings[mesh];
+	for (auto it = bindings.begin(); it != bindings.end();)
+	{
+		if (it->slot != slot)
+		{
+			++it;
+			continue;
+		}
+
+		TextureHandle replaced = it->texture;
+		it = bindings.erase(it);
+		ReleaseLocked(replaced);
+	}
+
+	bindings.push_back({ slot, texture });
+	bindingsChanged = true;
+}
+
+void AssetManager::AddReference(TextureHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (Slot* slot = Find(textures, handle.index, handle.generation))
+		++slot->refCount;
+}
+
+void AssetManager::AddReference(MeshHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (Slot* slot = Find(meshes, handle.index, handle.generation))
+		++slot->refCount;
+}
+
+void AssetManager::Release(TextureHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	ReleaseLocked(handle);
+}
+
+void AssetManager::Release(MeshHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (Find(meshes, handle.index, handle.generation) == nullptr)
+		return;
+
+	--meshes.slots[handle.index].refCount;
+	FreeIfUnused(meshes, handle.index);
+}
+
+AssetState AssetManager::GetState(TextureHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Slot* slot = Find(textures, handle.index, handle.generation);
+	return slot ? slot->state : AssetState::Failed;
+}
+
+AssetState AssetManager::GetState(MeshHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Slot* slot = Find(meshes, handle.index, handle.generation);
+	return slot ? slot->state : AssetState::Failed;
+}
+
+Texture* AssetManager::Get(TextureHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Slot* slot = Find(textures, handle.index, handle.generation);
+	return slot && slot->state == AssetState::Ready ? slot->texture : nullptr;
+}
+
+Mesh* AssetManager::Get(MeshHandle handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Slot* slot = Find(meshes, handle.index, handle.generation);
+	return slot ? slot->mesh : nullptr;
+}
+
+size_t AssetManager::GetPendingCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return pendingCount;
+}
+
+bool AssetManager::PopUpload(Upload& upload)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	while (!uploads.empty())
+	{
+		bool isMesh = uploads.front().first;
+		uint32_t index = uploads.front().second;
+		uploads.pop_front();
+
+		Pool& pool = isMesh ? meshes : textures;
+		Slot& slot = pool.slots[index];
+
+		// Released since decoded
+		if (slot.refCount <= 0)
+		{
+			slot.state = AssetState::Failed;
+			--pendingCount;
+			FreeIfUnused(pool, index);
+			continue;
+		}
+
+		upload.texture = isMesh ? nullptr : slot.texture;
+		upload.mesh = slot.mesh;
+		upload.data = slot.data;
+		upload.index = index;
+		upload.generation = slot.generation;
+		return true;
+	}
+
+	return false;
+}
+
+void AssetManager::FinishUpload(const Upload& upload)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Pool& pool = upload.mesh ? meshes : textures;
+	Slot& slot = pool.slots[upload.index];
+
+	// The mesh owns the geometry reference from now on
+	if (slot.mesh)
+	{
+		slot.mesh->SetMeshData(slot.data);
+		slot.data = nullptr;
+	}
+
+	slot.state = AssetState::Ready;
+	--pendingCount;
+	bindingsChanged = true;
+}
+
+void AssetManager::ApplyTextureBindings(std::vector<Mesh*>& changedMeshes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!bindingsChanged)
+		return;
+
+	bindingsChanged = false;
+
+	for (auto it = pendingBindings.begin(); it != pendingBindings.end();)
+	{
+		std::vector<Binding>& bindings = it->second;
+		bool final = std::all_of(bindings.begin(), bindings.end(), [](const Binding& binding)
+		{
+			Slot* slot = Find(textures, binding.texture.index, binding.texture.generation);
+			return slot == nullptr || IsFinal(slot->state);
+		});
+
+		if (!final)
+		{
+			++it;
+			continue;
+		}
+
+		Mesh* mesh = it->first;
+		bool changed = false;
+
+		for (const Binding& binding : bindings)
+		{
+			Slot* slot = Find(textures, binding.texture.index, binding.texture.generation);
+			if (slot && slot->state == AssetState::Ready)
+			{
+				// The material holds its own reference, the handle is released below
+				TextureCache::AddReference(slot->texture);
+				TextureCache::Assign(mesh->GetMaterial()->*binding.slot, slot->texture);
+				changed = true;
+			}
+		}
+
+		std::vector<Binding> applied = std::move(bindings);
+		it = pendingBindings.erase(it);
+
+		for (const Binding& binding : applied)
+			ReleaseLocked(binding.texture);
+
+		if (changed)
+			changedMeshes.push_back(mesh);
+	}
+}
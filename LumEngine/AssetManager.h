@@ -0,0 +1,149 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+#include "TextureCache.h"
+#include "Mesh.h"
+
+// Progress of an asset, Ready and Failed are final
+enum class AssetState : int
+{
+	Queued = 0,		// Waiting for a ThreadPool worker
+	Decoding,		// Read from disk and converted on a worker
+	Uploading,		// Decoded, waiting for the driver to create its GPU resources
+	Ready,
+	Failed
+};
+
+// Reference to an asset of the AssetManager, it goes stale once the asset is destroyed and its slot reused
+template<typename T>
+struct AssetHandle
+{
+	uint32_t index = 0;			// 0 for the null handle
+	uint32_t generation = 0;
+
+	bool IsNull() const { return index == 0; }
+};
+
+using TextureHandle = AssetHandle<Texture>;
+using MeshHandle = AssetHandle<Mesh>;
+
+// Asynchronous loads of the scene assets, thread safe.
+// Loads return at once, decoding runs on the ThreadPool and the driver uploads the decoded assets
+// between frames within its budget, so a scene is drawn from the first frame while it fills in.
+// A mesh exists from its load with placeholder textures and no geometry until it is ready.
+// Textures bound to a mesh material replace its placeholders together once they are all ready.
+// Every handle holds one reference, the asset is destroyed with the last one.
+class AssetManager
+{
+public:
+	AssetManager() = delete;
+	~AssetManager() = delete;
+
+	// Decoded asset handed to the driver, a texture or a mesh with its geometry
+	struct Upload
+	{
+		Texture*	texture = nullptr;
+		Mesh*		mesh = nullptr;
+		MeshData*	data = nullptr;
+		uint32_t	index = 0;
+		uint32_t	generation = 0;
+	};
+
+	static TextureHandle LoadTexture(const std::string& path, TextureSemantic semantic = TextureSemantic::Color);
+	static TextureHandle LoadMask(const MaskSources& sources);
+
+	// The textures named by the file are bound to the mesh material, unless the caller bound the same slot
+	static MeshHandle LoadMesh(const std::string& path);
+
+	// Takes over the reference of texture, the slot keeps its placeholder when the texture fails
+	static void BindTexture(Mesh* mesh, Texture* LeMaterial::* slot, TextureHandle texture);
+
+	static void AddReference(TextureHandle handle);
+	static void AddReference(MeshHandle handle);
+	static void Release(TextureHandle handle);
+
+	// No node may still draw the mesh
+	static void Release(MeshHandle handle);
+
+	// Failed for a stale handle
+	static AssetState GetState(TextureHandle handle);
+	static AssetState GetState(MeshHandle handle);
+
+	// Null until ready or for a stale handle
+	static Texture* Get(TextureHandle handle);
+
+	// The mesh exists from its load, null for a stale handle
+	static Mesh* Get(MeshHandle handle);
+
+	// Assets loaded and not ready yet
+	static size_t GetPendingCount();
+
+	// Driver side, between two frames. Pops the oldest decoded asset
+	static bool PopUpload(Upload& upload);
+
+	// Once the GPU resources of the upload exist, the mesh gets its geometry
+	static void FinishUpload(const Upload& upload);
+
+	// Assigns the bound textures of the meshes whose textures all reached a final state, fills the meshes changed
+	static void ApplyTextureBindings(std::vector<Mesh*>& changedMeshes);
+
+private:
+	struct Slot
+	{
+		uint32_t	generation = 1;
+		int			refCount = 0;
+		AssetState	state = AssetState::Failed;
+		Texture*	texture = nullptr;
+		Mesh*		mesh = nullptr;
+		MeshData*	data = nullptr;		// Decoded geometry until uploaded
+	};
+
+	// Slot 0 stays unused so a null handle never matches
+	struct Pool
+	{
+		std::vector<Slot>		slots = std::vector<Slot>(1);
+		std::vector<uint32_t>	freeSlots;
+	};
+
+	struct Binding
+	{
+		Texture* LeMaterial::*	slot;
+		TextureHandle			texture;
+	};
+
+	static uint32_t Allocate(Pool& pool);
+	static Slot* Find(Pool& pool, uint32_t index, uint32_t generation);
+	static bool IsFinal(AssetState state) { return state == AssetState::Ready || state == AssetState::Failed; }
+
+	// Destroys the asset once released and final, the slot goes back to the pool
+	static void FreeIfUnused(Pool& pool, uint32_t index);
+	static void ReleaseLocked(TextureHandle handle);
+
+	// Marks the decoded asset of slot for upload, or failed
+	static void FinishDecode(Pool& pool, uint32_t index, bool isMesh, bool decoded);
+
+	static uint32_t GetSlotBit(Texture* LeMaterial::* slot);
+
+	// Queues load on the ThreadPool for a new texture slot
+	static TextureHandle QueueTexture(const std::function<Texture*()>& load);
+
+	// Runs on the ThreadPool
+	static void DecodeMesh(uint32_t index, const std::string& path);
+	static void BindFileTextures(Mesh* mesh, const MeshData* data);
+
+	static Pool textures;
+	static Pool meshes;
+	static std::deque<std::pair<bool, uint32_t>> uploads;	// Is a mesh, slot index
+	static std::unordered_map<Mesh*, std::vector<Binding>> pendingBindings;
+	static std::unordered_map<Mesh*, uint32_t> boundSlots;	// Slots bound by the caller, see GetSlotBit
+	static bool bindingsChanged;
+	static size_t pendingCount;
+	static std::mutex mutex;
+};
@@ -0,0 +1,149 @@
+#include "AssetReloader.h"
+#include "TextureCache.h"
+#include "MeshLoader.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <unordered_set>
+
+namespace
+{
+	template<typename Future>
+	bool IsReady(const Future& future)
+	{
+		return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+}
+
+AssetReloader::~AssetReloader()
+{
+	Stop();
+}
+
+bool AssetReloader::Start(const std::string& directory)
+{
+	return watcher.Start(directory);
+}
+
+void AssetReloader::Stop()
+{
+	watcher.Stop();
+
+	for (PendingTexture& pending : pendingTextures)
+	{
+		ThreadPool::Get().Wait(pending.reloaded);
+		delete pending.reloaded.get();
+		TextureCache::Release(pending.texture);
+	}
+	pendingTextures.clear();
+
+	for (PendingMesh& pending : pendingMeshes)
+	{
+		ThreadPool::Get().Wait(pending.parts);
+		for (MeshData* part : pending.parts.get())
+			delete part;
+
+		for (MeshData* target : pending.targets)
+			MeshCache::Release(target);
+	}
+	pendingMeshes.clear();
+}
+
+void AssetReloader::StartReloads(const std::string& path)
+{
+	for (auto& reload : TextureCache::ReloadAsync(path))
+		pendingTextures.push_back({ reload.first, std::move(reload.second) });
+
+	// A file loaded both as a single mesh and as a model is imported once for each
+	PendingMesh meshReload, modelReload;
+	for (MeshData* data : MeshCache::AcquireFromSource(path))
+		(MeshCache::GetPartIndex(data) < 0 ? meshReload : modelReload).targets.push_back(data);
+
+	for (PendingMesh* pending : { &meshReload, &modelReload })
+	{
+		if (pending->targets.empty())
+			continue;
+
+		pending->path = path;
+		pending->parts = MeshLoader::ReimportAsync(path, pending == &modelReload);
+		pendingMeshes.push_back(std::move(*pending));
+	}
+}
+
+void AssetReloader::CollectMeshes(PendingMesh& pending, std::vector<MeshReload>& meshes)
+{
+	std::vector<MeshData*> parts = pending.parts.get();
+
+	std::cout << (parts.empty() ? "Can't reload mesh " : "Reloaded mesh ") << pending.path << std::endl;
+
+	for (MeshData* target : pending.targets)
+	{
+		int part = std::max(MeshCache::GetPartIndex(target), 0);
+		if (part < static_cast<int>(parts.size()) && parts[part])
+		{
+			meshes.push_back({ target, parts[part] });
+			parts[part] = nullptr;
+		}
+		else
+		{
+			MeshCache::Release(target);
+		}
+	}
+
+	// Parts no longer referenced by the scene
+	for (MeshData* part : parts)
+		delete part;
+}
+
+void AssetReloader::Update(std::vector<TextureReload>& textures, std::vector<MeshReload>& meshes)
+{
+	std::vector<std::string> changedPaths;
+	watcher.Poll(changedPaths);
+
+	for (const std::string& path : changedPaths)
+		StartReloads(path);
+
+	// A target saved twice in a row waits for its first import, the last one always wins
+	std::unordered_set<const void*> waitingTargets;
+
+	for (size_t i = 0; i < pendingTextures.size();)
+	{
+		PendingTexture& pending = pendingTextures[i];
+		if (!IsReady(pending.reloaded) || waitingTargets.count(pending.texture) > 0)
+		{
+			waitingTargets.insert(pending.texture);
+			++i;
+			continue;
+		}
+
+		Texture* reloaded = pending.reloaded.get();
+		if (reloaded)
+		{
+			std::cout << "Reloaded texture " << reloaded->path << std::endl;
+			textures.push_back({ pending.texture, reloaded });
+		}
+		else
+		{
+			TextureCache::Release(pending.texture);
+		}
+
+		pendingTextures.erase(pendingTextures.begin() + i);
+	}
+
+	for (size_t i = 0; i < pendingMeshes.size();)
+	{
+		PendingMesh& pending = pendingMeshes[i];
+		bool waiting = std::any_of(pending.targets.begin(), pending.targets.end(), [&waitingTargets](MeshData* target) { return waitingTargets.count(target) > 0; });
+
+		if (!IsReady(pending.parts) || waiting)
+		{
+			waitingTargets.insert(pending.targets.begin(), pending.targets.end());
+			++i;
+			continue;
+		}
+
+		CollectMeshes(pending, meshes);
+		pendingMeshes.erase(pendingMeshes.begin() + i);
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <future>
+
+#include "FileWatcher.h"
+#include "Texture.h"
+#include "MeshCache.h"
+
+// Imports again the assets of a directory changed on disk while the engine runs, the driver swaps them in between two frames.
+// Only the files already loaded by the TextureCache or the MeshCache are imported, each on the ThreadPool,
+// so saving one texture rebuilds that texture and the mask maps using it, nothing else.
+class AssetReloader
+{
+public:
+	// The target keeps its address, the driver moves the reloaded data into it
+	struct TextureReload
+	{
+		Texture*	texture;
+		Texture*	reloaded;
+	};
+
+	struct MeshReload
+	{
+		MeshData*	data;
+		MeshData*	reloaded;
+	};
+
+	AssetReloader() = default;
+	~AssetReloader();
+
+	AssetReloader(const AssetReloader&) = delete;
+	AssetReloader& operator=(const AssetReloader&) = delete;
+
+	bool Start(const std::string& directory);
+
+	// Waits for the imports in progress and drops their results
+	void Stop();
+
+	// Starts the imports of the files changed since the last call and hands over the finished ones in order.
+	// Every target comes with one reference, released by the caller once replaced
+	void Update(std::vector<TextureReload>& textures, std::vector<MeshReload>& meshes);
+
+private:
+	struct PendingTexture
+	{
+		Texture*				texture;
+		std::future<Texture*>	reloaded;
+	};
+
+	struct PendingMesh
+	{
+		std::string							path;
+		std::vector<MeshData*>				targets;
+		std::future<std::vector<MeshData*>>	parts;
+	};
+
+	void StartReloads(const std::string& path);
+
+	// Gives the parts of a finished import to their targets, the others are released
+	void CollectMeshes(PendingMesh& pending, std::vector<MeshReload>& meshes);
+
+	FileWatcher watcher;
+	std::vector<PendingTexture> pendingTextures;
+	std::vector<PendingMesh> pendingMeshes;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <assimp/IOSystem.hpp>
+#include <assimp/IOStream.hpp>
+#include <cstring>
+#include <algorithm>
+
+#include "VirtualFileSystem.h"
+
+// Read only stream over a file of the VirtualFileSystem
+class AssimpFileStream : public Assimp::IOStream
+{
+public:
+	explicit AssimpFileStream(const std::shared_ptr<const FileData>& file) : file(file) {}
+
+	size_t Read(void* buffer, size_t size, size_t count) override
+	{
+		if (size == 0)
+			return 0;
+
+		// Whole elements only
+		count = std::min(count, (file->GetSize() - position) / size);
+		memcpy(buffer, file->GetData() + position, size * count);
+		position += size * count;
+		return count;
+	}
+
+	size_t Write(const void* buffer, size_t size, size_t count) override { return 0; }
+
+	aiReturn Seek(size_t offset, aiOrigin origin) override
+	{
+		// Backwards from the end, as in Assimp::MemoryIOStream
+		if (origin == aiOrigin_END)
+		{
+			if (offset > file->GetSize())
+				return aiReturn_FAILURE;
+
+			position = file->GetSize() - offset;
+			return aiReturn_SUCCESS;
+		}
+
+		size_t base = origin == aiOrigin_SET ? 0 : position;
+		if (offset > file->GetSize() - base)
+			return aiReturn_FAILURE;
+
+		position = base + offset;
+		return aiReturn_SUCCESS;
+	}
+
+	size_t Tell() const override { return position; }
+	size_t FileSize() const override { return file->GetSize(); }
+	void Flush() override {}
+
+private:
+	std::shared_ptr<const FileData> file;
+	size_t position = 0;
+};
+
+// Assimp opens the models and the files they reference (materials, external buffers) through the VirtualFileSystem.
+// Set on each Importer, which deletes it
+class AssimpFileSystem : public Assimp::IOSystem
+{
+public:
+	bool Exists(const char* path) const override { return VirtualFileSystem::Exists(path); }
+
+	char getOsSeparator() const override { return '/'; }
+
+	Assimp::IOStream* Open(const char* path, const char* mode = "rb") override
+	{
+		// Importers never write
+		if (strchr(mode, 'w') || strchr(mode, 'a'))
+			return nullptr;
+
+		std::shared_ptr<const FileData> file = VirtualFileSystem::Open(path);
+		return file ? new AssimpFileStream(file) : nullptr;
+	}
+
+	void Close(Assimp::IOStream* stream) override { delete stream; }
+};
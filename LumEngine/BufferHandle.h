@@ -73,6 +73,6 @@ public:
 	}
 
 private:
-	VkDevice device;
+	VkDevice device = VK_NULL_HANDLE;
 
 };
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace
+{
+	// eax, ebx, ecx, edx of the leaf
+	void GetCpuid(int leaf, int subLeaf, int registers[4])
+	{
+#if defined(_MSC_VER)
+		__cpuidex(registers, leaf, subLeaf);
+#else
+		unsigned int eax, ebx, ecx, edx;
+		__cpuid_count(leaf, subLeaf, eax, ebx, ecx, edx);
+		registers[0] = static_cast<int>(eax);
+		registers[1] = static_cast<int>(ebx);
+		registers[2] = static_cast<int>(ecx);
+		registers[3] = static_cast<int>(edx);
+#endif
+	}
+
+	// Register states the OS saves on a context switch, XCR0
+	unsigned long long GetEnabledStates()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		unsigned int low, high;
+		__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		return (static_cast<unsigned long long>(high) << 32) | low;
+#endif
+	}
+
+	bool DetectAvx2()
+	{
+		int registers[4];
+		GetCpuid(0, 0, registers);
+		if (registers[0] < 7)
+			return false;
+
+		const int fma = 1 << 12, osxsave = 1 << 27, avx = 1 << 28;
+		GetCpuid(1, 0, registers);
+		if ((registers[2] & (fma | osxsave | avx)) != (fma | osxsave | avx))
+			return false;
+
+		// XMM and YMM states, without them the upper halves would be lost on a context switch
+		if ((GetEnabledStates() & 0x6) != 0x6)
+			return false;
+
+		const int avx2 = 1 << 5;
+		GetCpuid(7, 0, registers);
+		return (registers[1] & avx2) != 0;
+	}
+}
+
+bool CpuFeatures::HasAvx2()
+{
+	static const bool avx2 = DetectAvx2();
+	return avx2;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// Instruction sets of the running CPU. The project builds for the default instruction set of its platform,
+// the kernels of the *Avx2.cpp files are built with /arch:AVX2 and only called when HasAvx2 is true.
+class CpuFeatures
+{
+public:
+	CpuFeatures() = delete;
+	~CpuFeatures() = delete;
+
+	// AVX, AVX2 and FMA, with the OS saving the YMM registers. Detected on the first call
+	static bool HasAvx2();
+};
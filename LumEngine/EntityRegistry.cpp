@@ -0,0 +1,44 @@
+#include "EntityRegistry.h"
+
+#include <stdexcept>
+
+Entity EntityRegistry::Create()
+{
+	uint32_t index;
+	if (!freeIndices.empty())
+	{
+		index = freeIndices.back();
+		freeIndices.pop_back();
+	}
+	else
+	{
+		if (generations.size() > entityIndexMask)
+			throw std::runtime_error("Too many entities!");
+
+		index = static_cast<uint32_t>(generations.size());
+		generations.push_back(0);
+	}
+
+	return (static_cast<uint32_t>(generations[index]) << entityIndexBits) | index;
+}
+
+void EntityRegistry::Destroy(Entity entity)
+{
+	if (!IsAlive(entity))
+		return;
+
+	transforms.Remove(entity);
+	renders.Remove(entity);
+	materials.Remove(entity);
+	visibilities.Remove(entity);
+
+	uint32_t index = GetEntityIndex(entity);
+	++generations[index];
+	freeIndices.push_back(index);
+}
+
+bool EntityRegistry::IsAlive(Entity entity) const
+{
+	uint32_t index = GetEntityIndex(entity);
+	return entity != invalidEntity && index < generations.size() && generations[index] == GetEntityGeneration(entity);
+}
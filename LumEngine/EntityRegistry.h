@@ -0,0 +1,176 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "ThreadPool.h"
+
+class Mesh;
+struct LeMaterial;
+class MeshSceneNode;
+
+// Index in the low 24 bits, generation of the index in the high 8 bits so a stale handle doesn't find the next entity
+typedef uint32_t Entity;
+
+const Entity invalidEntity = 0xFFFFFFFF;
+const uint32_t entityIndexBits = 24;
+const uint32_t entityIndexMask = (1u << entityIndexBits) - 1u;
+
+inline uint32_t GetEntityIndex(Entity entity) { return entity & entityIndexMask; }
+inline uint32_t GetEntityGeneration(Entity entity) { return entity >> entityIndexBits; }
+
+// World matrix of the node, copied once its hierarchy is up to date
+struct TransformComponent
+{
+	glm::mat4	world;
+	uint32_t	version;		// Transform version of the node the matrix was copied at
+};
+
+struct RenderComponent
+{
+	MeshSceneNode*	node;
+	Mesh*			mesh;
+};
+
+struct MaterialComponent
+{
+	LeMaterial*	material;
+	uint32_t	materialIndex;		// Slot in the per frame material buffer
+};
+
+struct VisibilityComponent
+{
+	bool visible;
+	bool transparent;
+};
+
+// Components of one type packed in a dense array, with a sparse array from entity index to dense index.
+// Removing a component moves the last one into its place, iteration order isn't stable
+template<typename T>
+class ComponentPool
+{
+public:
+	T& Add(Entity entity, const T& component)
+	{
+		uint32_t index = GetEntityIndex(entity);
+		if (index >= sparse.size())
+			sparse.resize(index + 1, invalidDense);
+
+		if (sparse[index] != invalidDense)
+		{
+			entities[sparse[index]] = entity;
+			return components[sparse[index]] = component;
+		}
+
+		sparse[index] = static_cast<uint32_t>(components.size());
+		entities.push_back(entity);
+		components.push_back(component);
+		return components.back();
+	}
+
+	void Remove(Entity entity)
+	{
+		if (!Has(entity))
+			return;
+
+		uint32_t dense = sparse[GetEntityIndex(entity)];
+		uint32_t last = static_cast<uint32_t>(components.size() - 1);
+
+		if (dense != last)
+		{
+			components[dense] = components[last];
+			entities[dense] = entities[last];
+			sparse[GetEntityIndex(entities[dense])] = dense;
+		}
+
+		components.pop_back();
+		entities.pop_back();
+		sparse[GetEntityIndex(entity)] = invalidDense;
+	}
+
+	bool Has(Entity entity) const
+	{
+		uint32_t index = GetEntityIndex(entity);
+		return index < sparse.size() && sparse[index] != invalidDense && entities[sparse[index]] == entity;
+	}
+
+	// The entity must have the component
+	T& Get(Entity entity) { return components[sparse[GetEntityIndex(entity)]]; }
+	const T& Get(Entity entity) const { return components[sparse[GetEntityIndex(entity)]]; }
+
+	T* Find(Entity entity) { return Has(entity) ? &Get(entity) : nullptr; }
+
+	size_t GetCount() const { return components.size(); }
+	T* GetData() { return components.data(); }
+	const Entity* GetEntities() const { return entities.data(); }
+
+private:
+	static const uint32_t invalidDense = 0xFFFFFFFF;
+
+	std::vector<uint32_t>	sparse;
+	std::vector<Entity>		entities;
+	std::vector<T>			components;
+};
+
+template<typename T>
+const uint32_t ComponentPool<T>::invalidDense;
+
+// Entities of the scene mesh nodes and their components, each type in its own dense array so the systems
+// iterating one of them don't drag the others through the cache
+class EntityRegistry
+{
+public:
+	EntityRegistry() = default;
+	~EntityRegistry() = default;
+
+	Entity Create();
+
+	// Removes every component of the entity, its index is reused by a later entity
+	void Destroy(Entity entity);
+	bool IsAlive(Entity entity) const;
+
+	size_t GetEntityCount() const { return generations.size() - freeIndices.size(); }
+
+	ComponentPool<TransformComponent>	transforms;
+	ComponentPool<RenderComponent>		renders;
+	ComponentPool<MaterialComponent>	materials;
+	ComponentPool<VisibilityComponent>	visibilities;
+
+	// Calls function(entity, component) for every component of the pool, split in chunks of at least
+	// minChunkSize components between the ThreadPool workers and the calling thread. The function may read
+	// other pools and write its own component, but not add or remove components
+	template<typename T, typename Function>
+	static void ParallelForEach(ComponentPool<T>& pool, Function function, size_t minChunkSize = 1024)
+	{
+		const size_t count = pool.GetCount();
+		T* components = pool.GetData();
+		const Entity* entities = pool.GetEntities();
+
+		ThreadPool& threadPool = ThreadPool::Get();
+		size_t chunkCount = std::min<size_t>(threadPool.GetWorkerCount() + 1, (count + minChunkSize - 1) / minChunkSize);
+
+		if (chunkCount <= 1)
+		{
+			for (size_t i = 0; i < count; ++i)
+				function(entities[i], components[i]);
+			return;
+		}
+
+		size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+		threadPool.ParallelFor(chunkCount, [&](size_t chunk)
+		{
+			size_t end = std::min(count, (chunk + 1) * chunkSize);
+			for (size_t i = chunk * chunkSize; i < end; ++i)
+				function(entities[i], components[i]);
+		});
+	}
+
+private:
+	std::vector<uint8_t>	generations;
+	std::vector<uint32_t>	freeIndices;
+};
@@ -0,0 +1,248 @@
+#include "FileWatcher.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::~FileWatcher()
+{
+	Stop();
+}
+
+void FileWatcher::AddChange(const std::string& relativePath)
+{
+	std::string path = root + "/" + relativePath;
+	std::replace(path.begin(), path.end(), '\\', '/');
+
+	std::lock_guard<std::mutex> lock(mutex);
+	changes[path] = std::chrono::steady_clock::now();
+}
+
+void FileWatcher::Poll(std::vector<std::string>& changedPaths)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto it = changes.begin(); it != changes.end();)
+	{
+		if (now - it->second < settleTime)
+		{
+			++it;
+			continue;
+		}
+
+		changedPaths.push_back(it->first);
+		it = changes.erase(it);
+	}
+}
+
+#ifdef _WIN32
+
+bool FileWatcher::Start(const std::string& directory)
+{
+	Stop();
+
+	HANDLE handle = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	root = directory;
+	directoryHandle = handle;
+	stopEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+	running = true;
+	thread = std::thread(&FileWatcher::Run, this);
+
+	return true;
+}
+
+void FileWatcher::Stop()
+{
+	if (!running)
+		return;
+
+	running = false;
+	SetEvent(stopEvent);
+	thread.join();
+
+	CloseHandle(directoryHandle);
+	CloseHandle(stopEvent);
+	directoryHandle = nullptr;
+	stopEvent = nullptr;
+}
+
+void FileWatcher::Run()
+{
+	// DWORD aligned as ReadDirectoryChangesW requires
+	std::vector<DWORD> buffer(16 * 1024);
+
+	OVERLAPPED overlapped = {};
+	overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+	HANDLE events[] = { overlapped.hEvent, stopEvent };
+
+	while (running)
+	{
+		ResetEvent(overlapped.hEvent);
+		if (!ReadDirectoryChangesW(directoryHandle, buffer.data(), static_cast<DWORD>(buffer.size() * sizeof(DWORD)), TRUE,
+			FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE, nullptr, &overlapped, nullptr))
+			break;
+
+		if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0)
+		{
+			CancelIo(directoryHandle);
+			GetOverlappedResult(directoryHandle, &overlapped, nullptr, TRUE);
+			break;
+		}
+
+		DWORD size = 0;
+		if (!GetOverlappedResult(directoryHandle, &overlapped, &size, FALSE) || size == 0)
+			continue;	// Overflow, the changes of this interval are lost
+
+		const uint8_t* entry = reinterpret_cast<const uint8_t*>(buffer.data());
+		for (;;)
+		{
+			const FILE_NOTIFY_INFORMATION* notification = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(entry);
+
+			if (notification->Action == FILE_ACTION_ADDED || notification->Action == FILE_ACTION_MODIFIED || notification->Action == FILE_ACTION_RENAMED_NEW_NAME)
+			{
+				int nameLength = static_cast<int>(notification->FileNameLength / sizeof(WCHAR));
+				int utf8Length = WideCharToMultiByte(CP_UTF8, 0, notification->FileName, nameLength, nullptr, 0, nullptr, nullptr);
+
+				std::string relativePath(static_cast<size_t>(utf8Length), '\0');
+				WideCharToMultiByte(CP_UTF8, 0, notification->FileName, nameLength, &relativePath[0], utf8Length, nullptr, nullptr);
+				AddChange(relativePath);
+			}
+
+			if (notification->NextEntryOffset == 0)
+				break;
+
+			entry += notification->NextEntryOffset;
+		}
+	}
+
+	CloseHandle(overlapped.hEvent);
+}
+
+#else
+
+bool FileWatcher::Start(const std::string& directory)
+{
+	Stop();
+
+	inotifyHandle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotifyHandle < 0)
+		return false;
+
+	root = directory;
+	AddWatches("", false);
+
+	if (watchedDirectories.empty())
+	{
+		close(inotifyHandle);
+		inotifyHandle = -1;
+		return false;
+	}
+
+	running = true;
+	thread = std::thread(&FileWatcher::Run, this);
+
+	return true;
+}
+
+void FileWatcher::Stop()
+{
+	if (!running)
+		return;
+
+	running = false;
+	thread.join();
+
+	// Closing the descriptor removes every watch
+	close(inotifyHandle);
+	inotifyHandle = -1;
+	watchedDirectories.clear();
+}
+
+void FileWatcher::AddWatches(const std::string& relativeDirectory, bool reportFiles)
+{
+	std::string directory = relativeDirectory.empty() ? root : root + "/" + relativeDirectory;
+
+	// Files closed after a write or moved in, editors often save through a temporary file
+	int watch = inotify_add_watch(inotifyHandle, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+	if (watch < 0)
+		return;
+
+	watchedDirectories[watch] = relativeDirectory;
+
+	DIR* handle = opendir(directory.c_str());
+	if (handle == nullptr)
+		return;
+
+	while (dirent* entry = readdir(handle))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+
+		std::string relativePath = relativeDirectory.empty() ? name : relativeDirectory + "/" + name;
+
+		struct stat entryStat;
+		if (stat((root + "/" + relativePath).c_str(), &entryStat) != 0)
+			continue;
+
+		if (S_ISDIR(entryStat.st_mode))
+			AddWatches(relativePath, reportFiles);
+		else if (reportFiles)
+			AddChange(relativePath);
+	}
+
+	closedir(handle);
+}
+
+void FileWatcher::Run()
+{
+	// Room for many events, each one is followed by its name
+	alignas(inotify_event) char buffer[16 * 1024];
+
+	while (running)
+	{
+		pollfd descriptor = { inotifyHandle, POLLIN, 0 };
+		if (poll(&descriptor, 1, 100) <= 0)
+			continue;
+
+		ssize_t size = read(inotifyHandle, buffer, sizeof(buffer));
+		for (ssize_t offset = 0; offset < size;)
+		{
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+
+			auto directory = watchedDirectories.find(event->wd);
+			if (event->len == 0 || directory == watchedDirectories.end())
+				continue;
+
+			std::string relativePath = directory->second.empty() ? std::string(event->name) : directory->second + "/" + event->name;
+
+			if (event->mask & IN_ISDIR)
+			{
+				if (event->mask & (IN_CREATE | IN_MOVED_TO))
+					AddWatches(relativePath, true);
+			}
+			else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+			{
+				AddChange(relativePath);
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+// Collects the files written under a directory tree from a background thread,
+// with ReadDirectoryChangesW on Windows and inotify on Linux.
+// Editors save in several writes, a file is only reported once it stopped changing for settleTime.
+class FileWatcher
+{
+public:
+	FileWatcher() = default;
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	std::chrono::milliseconds settleTime = std::chrono::milliseconds(250);
+
+	// Watches directory and all its subdirectories, false when it can't be watched
+	bool Start(const std::string& directory);
+	void Stop();
+
+	// Appends the files settled since the last call, as directory + "/" + their '/' separated relative path
+	void Poll(std::vector<std::string>& changedPaths);
+
+private:
+	void Run();
+	void AddChange(const std::string& relativePath);
+
+	std::string root;
+	std::thread thread;
+	std::atomic<bool> running{ false };
+
+	std::mutex mutex;
+	std::unordered_map<std::string, std::chrono::steady_clock::time_point> changes;
+
+#ifdef _WIN32
+	void* directoryHandle = nullptr;
+	void* stopEvent = nullptr;
+#else
+	// New subdirectories get their own watch, the files written in them before it are reported
+	void AddWatches(const std::string& relativeDirectory, bool reportFiles);
+
+	int inotifyHandle = -1;
+	std::unordered_map<int, std::string> watchedDirectories;
+#endif
+};
@@ -0,0 +1,205 @@
+#include "FrustumCulling.h"
+#include "CpuFeatures.h"
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <glm/gtc/matrix_transform.hpp>
+#include <xmmintrin.h>
+
+namespace
+{
+	// Mask of the lanes of the last group holding a box
+	uint8_t GetGroupMask(size_t count, size_t group)
+	{
+		size_t remaining = count - group * BoxCuller::groupSize;
+		return remaining >= BoxCuller::groupSize ? uint8_t(0xFF) : static_cast<uint8_t>((1u << remaining) - 1u);
+	}
+
+	size_t CountBits(uint8_t bits)
+	{
+		size_t count = 0;
+		for (; bits != 0; bits &= bits - 1)
+			++count;
+		return count;
+	}
+}
+
+void BoxCuller::Clear()
+{
+	for (std::vector<float>* component : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+		component->clear();
+
+	count = 0;
+}
+
+void BoxCuller::Reserve(size_t boxCount)
+{
+	size_t paddedCount = (boxCount + groupSize - 1) / groupSize * groupSize;
+	for (std::vector<float>* component : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+		component->reserve(paddedCount);
+}
+
+uint32_t BoxCuller::Add(const LeAabb& box)
+{
+	// A new group of zero boxes, masked until filled
+	if (count % groupSize == 0)
+	{
+		for (std::vector<float>* component : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+			component->resize(count + groupSize, 0.f);
+	}
+
+	minX[count] = box.min.x;
+	minY[count] = box.min.y;
+	minZ[count] = box.min.z;
+	maxX[count] = box.max.x;
+	maxY[count] = box.max.y;
+	maxZ[count] = box.max.z;
+
+	return static_cast<uint32_t>(count++);
+}
+
+size_t BoxCuller::Cull(const LeFrustum& frustum, std::vector<uint8_t>& visibility) const
+{
+	const size_t groupCount = (count + groupSize - 1) / groupSize;
+	visibility.resize(groupCount);
+
+	PlaneLanes planes[6];
+	for (int i = 0; i < 6; ++i)
+	{
+		const glm::vec4& plane = frustum.planes[i];
+		planes[i] = { { plane.x, plane.y, plane.z }, plane.w,
+			{ plane.x >= 0.f ? maxX.data() : minX.data(), plane.y >= 0.f ? maxY.data() : minY.data(), plane.z >= 0.f ? maxZ.data() : minZ.data() } };
+	}
+
+	if (CpuFeatures::HasAvx2())
+		CullGroupsAvx2(planes, groupCount, visibility.data());
+	else
+		CullGroupsSse(planes, groupCount, visibility.data());
+
+	size_t visibleCount = 0;
+	for (size_t group = 0; group < groupCount; ++group)
+	{
+		visibility[group] &= GetGroupMask(count, group);
+		visibleCount += CountBits(visibility[group]);
+	}
+
+	return visibleCount;
+}
+
+void BoxCuller::CullGroupsSse(const PlaneLanes planes[6], size_t groupCount, uint8_t* visibility)
+{
+	__m128 normalX[6], normalY[6], normalZ[6], distance[6];
+	for (int i = 0; i < 6; ++i)
+	{
+		normalX[i] = _mm_set1_ps(planes[i].normal[0]);
+		normalY[i] = _mm_set1_ps(planes[i].normal[1]);
+		normalZ[i] = _mm_set1_ps(planes[i].normal[2]);
+		distance[i] = _mm_set1_ps(planes[i].distance);
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	for (size_t group = 0; group < groupCount; ++group)
+	{
+		const size_t first = group * groupSize;
+		__m128 outsideLow = zero;
+		__m128 outsideHigh = zero;
+
+		for (int i = 0; i < 6; ++i)
+		{
+			const float* x = planes[i].positive[0] + first;
+			const float* y = planes[i].positive[1] + first;
+			const float* z = planes[i].positive[2] + first;
+
+			__m128 low = _mm_add_ps(_mm_mul_ps(normalX[i], _mm_loadu_ps(x)), distance[i]);
+			low = _mm_add_ps(low, _mm_mul_ps(normalY[i], _mm_loadu_ps(y)));
+			low = _mm_add_ps(low, _mm_mul_ps(normalZ[i], _mm_loadu_ps(z)));
+			outsideLow = _mm_or_ps(outsideLow, _mm_cmplt_ps(low, zero));
+
+			__m128 high = _mm_add_ps(_mm_mul_ps(normalX[i], _mm_loadu_ps(x + 4)), distance[i]);
+			high = _mm_add_ps(high, _mm_mul_ps(normalY[i], _mm_loadu_ps(y + 4)));
+			high = _mm_add_ps(high, _mm_mul_ps(normalZ[i], _mm_loadu_ps(z + 4)));
+			outsideHigh = _mm_or_ps(outsideHigh, _mm_cmplt_ps(high, zero));
+		}
+
+		int outside = _mm_movemask_ps(outsideLow) | (_mm_movemask_ps(outsideHigh) << 4);
+		visibility[group] = static_cast<uint8_t>(~outside);
+	}
+}
+
+size_t BoxCuller::CullScalar(const LeFrustum& frustum, std::vector<uint8_t>& visibility) const
+{
+	visibility.assign((count + groupSize - 1) / groupSize, 0);
+
+	size_t visibleCount = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		LeAabb box;
+		box.min = glm::vec3(minX[i], minY[i], minZ[i]);
+		box.max = glm::vec3(maxX[i], maxY[i], maxZ[i]);
+
+		if (frustum.IsBoxVisible(box))
+		{
+			visibility[i / groupSize] |= static_cast<uint8_t>(1u << (i % groupSize));
+			++visibleCount;
+		}
+	}
+
+	return visibleCount;
+}
+
+void CullingBenchmark::Run(size_t boxCount, size_t iterationCount)
+{
+	// Boxes of 0.5 to 10 units scattered in a 1000 units cube around a camera looking down -Z
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> position(-500.f, 500.f);
+	std::uniform_real_distribution<float> size(0.5f, 10.f);
+
+	BoxCuller culler;
+	culler.Reserve(boxCount);
+	for (size_t i = 0; i < boxCount; ++i)
+	{
+		LeAabb box;
+		box.min = glm::vec3(position(random), position(random), position(random));
+		box.max = box.min + glm::vec3(size(random), size(random), size(random));
+		culler.Add(box);
+	}
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+	glm::mat4 proj = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 1000.f);
+	proj[1][1] *= -1;
+
+	LeFrustum frustum;
+	frustum.ExtractPlanes(proj * view);
+
+	std::vector<uint8_t> scalarVisibility;
+	std::vector<uint8_t> simdVisibility;
+	size_t visibleCount = culler.CullScalar(frustum, scalarVisibility);
+	bool identical = culler.Cull(frustum, simdVisibility) == visibleCount && simdVisibility == scalarVisibility;
+
+	const char* simdName = CpuFeatures::HasAvx2() ? "AVX2" : "SSE";
+
+	std::cout << "Culling benchmark : " << boxCount << " boxes, " << visibleCount << " visible, " << iterationCount << " iterations, "
+		<< simdName << (identical ? " matches" : " DIFFERS FROM") << " the scalar path" << std::endl;
+
+	auto measure = [&](const std::string& name, const std::function<size_t(std::vector<uint8_t>&)>& cull)
+	{
+		std::vector<uint8_t> visibility;
+		size_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+
+		for (size_t iteration = 0; iteration < iterationCount; ++iteration)
+			checksum += cull(visibility);
+
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		double boxesPerSecond = double(boxCount) * iterationCount / seconds;
+
+		std::cout << "  " << name << " : " << seconds * 1000.0 / iterationCount << " ms/cull, " << boxesPerSecond / 1e6 << " M boxes/s"
+			<< (checksum == visibleCount * iterationCount ? "" : " (inconsistent)") << std::endl;
+	};
+
+	measure("Scalar", [&](std::vector<uint8_t>& visibility) { return culler.CullScalar(frustum, visibility); });
+	measure(std::string(simdName) + " 8 boxes per iteration", [&](std::vector<uint8_t>& visibility) { return culler.Cull(frustum, visibility); });
+}
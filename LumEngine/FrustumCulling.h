@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "LeFrustum.h"
+
+// World boxes stored as structure of arrays and tested against the 6 frustum planes 8 boxes per iteration,
+// with AVX2 when the CPU has it and two SSE halves otherwise. Each plane picks its positive vertex
+// per axis once for all boxes, so the loop is only multiply adds and one compare per plane.
+class BoxCuller
+{
+public:
+	static const size_t groupSize = 8;
+
+	BoxCuller() = default;
+	~BoxCuller() = default;
+
+	void Clear();
+	void Reserve(size_t boxCount);
+
+	// Returns the index of the box, its bit in the visibility masks
+	uint32_t Add(const LeAabb& box);
+
+	size_t GetCount() const { return count; }
+
+	// One byte per group of 8 boxes, bit i set when box 8 * group + i intersects the frustum. Returns the visible count
+	size_t Cull(const LeFrustum& frustum, std::vector<uint8_t>& visibility) const;
+
+	// Same result one box at a time, the reference of the benchmark
+	size_t CullScalar(const LeFrustum& frustum, std::vector<uint8_t>& visibility) const;
+
+	static bool IsVisible(const std::vector<uint8_t>& visibility, uint32_t index) { return (visibility[index / groupSize] >> (index % groupSize)) & 1; }
+
+private:
+	// Plane broadcast once per cull, with the box arrays holding its positive vertex
+	struct PlaneLanes
+	{
+		float			normal[3];
+		float			distance;
+		const float*	positive[3];
+	};
+
+	// Bit i of visibility[group] set when box 8 * group + i is inside the 6 planes, padding lanes included
+	static void CullGroupsSse(const PlaneLanes planes[6], size_t groupCount, uint8_t* visibility);
+
+	// FrustumCullingAvx2.cpp, built with /arch:AVX2 and only called when CpuFeatures::HasAvx2
+	static void CullGroupsAvx2(const PlaneLanes planes[6], size_t groupCount, uint8_t* visibility);
+
+	// Padded to a whole group, the padding lanes are masked out
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+	size_t count = 0;
+};
+
+class CullingBenchmark
+{
+public:
+	CullingBenchmark() = delete;
+	~CullingBenchmark() = delete;
+
+	// Prints the boxes culled per second of the scalar and SIMD paths for boxCount random boxes around a camera
+	static void Run(size_t boxCount, size_t iterationCount);
+};
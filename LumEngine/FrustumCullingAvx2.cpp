@@ -0,0 +1,35 @@
+#include "FrustumCulling.h"
+
+#include <immintrin.h>
+
+// Built with /arch:AVX2, only called when CpuFeatures::HasAvx2. Nothing but intrinsics and raw arrays is used here:
+// an inline function of a shared header compiled in this file could be the copy the linker keeps for every caller.
+
+void BoxCuller::CullGroupsAvx2(const PlaneLanes planes[6], size_t groupCount, uint8_t* visibility)
+{
+	__m256 normalX[6], normalY[6], normalZ[6], distance[6];
+	for (int i = 0; i < 6; ++i)
+	{
+		normalX[i] = _mm256_set1_ps(planes[i].normal[0]);
+		normalY[i] = _mm256_set1_ps(planes[i].normal[1]);
+		normalZ[i] = _mm256_set1_ps(planes[i].normal[2]);
+		distance[i] = _mm256_set1_ps(planes[i].distance);
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+	for (size_t group = 0; group < groupCount; ++group)
+	{
+		const size_t first = group * groupSize;
+		__m256 outside = zero;
+
+		for (int i = 0; i < 6; ++i)
+		{
+			__m256 d = _mm256_add_ps(_mm256_mul_ps(normalX[i], _mm256_loadu_ps(planes[i].positive[0] + first)), distance[i]);
+			d = _mm256_add_ps(d, _mm256_mul_ps(normalY[i], _mm256_loadu_ps(planes[i].positive[1] + first)));
+			d = _mm256_add_ps(d, _mm256_mul_ps(normalZ[i], _mm256_loadu_ps(planes[i].positive[2] + first)));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, zero, _CMP_LT_OQ));
+		}
+
+		visibility[group] = static_cast<uint8_t>(~_mm256_movemask_ps(outside));
+	}
+}
@@ -0,0 +1,604 @@
+#include "IblBaker.h"
+#include "KtxFile.h"
+#include "ThreadPool.h"
+#include "VirtualFileSystem.h"
+
+#include <glm/geometric.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const float pi = 3.14159265358979f;
+
+	float SrgbToLinear(float value)
+	{
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	uint8_t LinearToSrgb(float value)
+	{
+		value = std::min(std::max(value, 0.f), 1.f);
+		float encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+		return static_cast<uint8_t>(encoded * 255.f + 0.5f);
+	}
+
+	// Van der Corput sequence in x, the low discrepancy points of the importance sampling
+	glm::vec2 Hammersley(uint32_t i, uint32_t count)
+	{
+		uint32_t bits = i;
+		bits = (bits << 16u) | (bits >> 16u);
+		bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+		bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+		bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+		bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+		return glm::vec2(float(i) / float(count), float(bits) * 2.3283064365386963e-10f);
+	}
+
+	// Half vector around +Z distributed as the GGX normal distribution of alpha
+	glm::vec3 ImportanceSampleGgx(const glm::vec2& xi, float alpha)
+	{
+		float phi = 2.f * pi * xi.x;
+		float cosTheta = std::sqrt((1.f - xi.y) / (1.f + (alpha * alpha - 1.f) * xi.y));
+		float sinTheta = std::sqrt(1.f - cosTheta * cosTheta);
+		return glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+	}
+
+	float DistributionGgx(float NdotH, float alpha)
+	{
+		float alpha2 = alpha * alpha;
+		float d = NdotH * NdotH * (alpha2 - 1.f) + 1.f;
+		return alpha2 / (pi * d * d);
+	}
+
+	// Schlick-Smith with k = alpha / 2, the remapping of image based lighting
+	float GeometrySmithGgx(float NdotV, float NdotL, float alpha)
+	{
+		float k = alpha * 0.5f;
+		return (NdotV / (NdotV * (1.f - k) + k)) * (NdotL / (NdotL * (1.f - k) + k));
+	}
+
+	// Real spherical harmonics up to the band 2
+	void EvaluateBasis(const glm::vec3& d, float basis[ImageBasedLight::irradianceCoefficientCount])
+	{
+		basis[0] = 0.282095f;
+		basis[1] = 0.488603f * d.y;
+		basis[2] = 0.488603f * d.z;
+		basis[3] = 0.488603f * d.x;
+		basis[4] = 1.092548f * d.x * d.y;
+		basis[5] = 1.092548f * d.y * d.z;
+		basis[6] = 0.315392f * (3.f * d.z * d.z - 1.f);
+		basis[7] = 1.092548f * d.x * d.z;
+		basis[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+	}
+
+	// Calls function(row) for every row in [0, rowCount) on the ThreadPool
+	template<typename Function>
+	void ForEachRow(uint32_t rowCount, const Function& function)
+	{
+		ThreadPool& pool = ThreadPool::Get();
+		size_t taskCount = std::min<size_t>(rowCount, pool.GetWorkerCount() + 1);
+
+		pool.ParallelFor(taskCount, [&](size_t task)
+		{
+			for (uint32_t row = static_cast<uint32_t>(task); row < rowCount; row += static_cast<uint32_t>(taskCount))
+				function(row);
+		});
+	}
+
+	// Linear radiance of the source faces with their box filtered mip chain, from maxSize texels at most
+	class LinearCube
+	{
+	public:
+		LinearCube(Texture faces[6], uint32_t maxSize)
+		{
+			const uint32_t sourceSize = static_cast<uint32_t>(faces[0].GetDimensions().x);
+			uint32_t shift = 0;
+			while ((sourceSize >> shift) > maxSize)
+				++shift;
+
+			size = std::max(sourceSize >> shift, 1u);
+			levelCount = static_cast<uint32_t>(std::floor(std::log2(std::max(size, 1u)))) + 1;
+			levels.resize(levelCount * 6);
+
+			float decode[256];
+			for (int i = 0; i < 256; ++i)
+				decode[i] = SrgbToLinear(i / 255.f);
+
+			// Each top texel averages a block of the source, the remaining rows and columns are dropped
+			const uint32_t blockSize = 1u << shift;
+			const float blockWeight = 1.f / (blockSize * blockSize);
+
+			for (uint32_t face = 0; face < 6; ++face)
+			{
+				const uint8_t* pixels = static_cast<const uint8_t*>(faces[face].GetData());
+				std::vector<glm::vec3>& top = levels[face];
+				top.resize(size_t(size) * size);
+				for (uint32_t y = 0; y < size; ++y)
+				{
+					for (uint32_t x = 0; x < size; ++x)
+					{
+						glm::vec3 sum(0.f);
+						for (uint32_t by = 0; by < blockSize; ++by)
+						{
+							const uint8_t* texel = pixels + (size_t(y * blockSize + by) * sourceSize + x * blockSize) * 4;
+							for (uint32_t bx = 0; bx < blockSize; ++bx, texel += 4)
+								sum += glm::vec3(decode[texel[0]], decode[texel[1]], decode[texel[2]]);
+						}
+
+						top[size_t(y) * size + x] = sum * blockWeight;
+					}
+				}
+
+				for (uint32_t level = 1; level < levelCount; ++level)
+				{
+					const std::vector<glm::vec3>& previous = levels[(level - 1) * 6 + face];
+					const uint32_t previousSize = GetLevelSize(level - 1);
+					const uint32_t levelSize = GetLevelSize(level);
+					std::vector<glm::vec3>& destination = levels[level * 6 + face];
+					destination.resize(size_t(levelSize) * levelSize);
+
+					for (uint32_t y = 0; y < levelSize; ++y)
+					{
+						for (uint32_t x = 0; x < levelSize; ++x)
+						{
+							const glm::vec3* row0 = &previous[size_t(y * 2) * previousSize + x * 2];
+							const glm::vec3* row1 = row0 + previousSize;
+							destination[size_t(y) * levelSize + x] = (row0[0] + row0[1] + row1[0] + row1[1]) * 0.25f;
+						}
+					}
+				}
+			}
+		}
+
+		uint32_t GetSize() const { return size; }
+		uint32_t GetLevelCount() const { return levelCount; }
+		uint32_t GetLevelSize(uint32_t level) const { return std::max(size >> level, 1u); }
+
+		const std::vector<glm::vec3>& GetTexels(uint32_t face, uint32_t level) const { return levels[level * 6 + face]; }
+
+		// Trilinear fetch, without filtering across the face edges
+		glm::vec3 Sample(const glm::vec3& direction, float lod) const
+		{
+			uint32_t face;
+			glm::vec2 uv;
+			GetFaceCoordinates(direction, face, uv);
+
+			lod = std::min(std::max(lod, 0.f), float(levelCount - 1));
+			uint32_t level = static_cast<uint32_t>(lod);
+			float blend = lod - level;
+
+			glm::vec3 color = SampleLevel(face, level, uv);
+			if (blend > 0.f && level + 1 < levelCount)
+				color = color * (1.f - blend) + SampleLevel(face, level + 1, uv) * blend;
+
+			return color;
+		}
+
+	private:
+		glm::vec3 SampleLevel(uint32_t face, uint32_t level, const glm::vec2& uv) const
+		{
+			const uint32_t levelSize = GetLevelSize(level);
+			const std::vector<glm::vec3>& texels = levels[level * 6 + face];
+
+			float x = uv.x * levelSize - 0.5f;
+			float y = uv.y * levelSize - 0.5f;
+			float fx = std::floor(x);
+			float fy = std::floor(y);
+			float wx = x - fx;
+			float wy = y - fy;
+
+			// Clamped to the edge of the face
+			const int last = static_cast<int>(levelSize) - 1;
+			int x0 = std::min(std::max(static_cast<int>(fx), 0), last);
+			int y0 = std::min(std::max(static_cast<int>(fy), 0), last);
+			int x1 = std::min(std::max(static_cast<int>(fx) + 1, 0), last);
+			int y1 = std::min(std::max(static_cast<int>(fy) + 1, 0), last);
+
+			glm::vec3 top = texels[size_t(y0) * levelSize + x0] * (1.f - wx) + texels[size_t(y0) * levelSize + x1] * wx;
+			glm::vec3 bottom = texels[size_t(y1) * levelSize + x0] * (1.f - wx) + texels[size_t(y1) * levelSize + x1] * wx;
+			return top * (1.f - wy) + bottom * wy;
+		}
+
+		// Face and texture coordinates of a direction, as the GPU selects them
+		static void GetFaceCoordinates(const glm::vec3& d, uint32_t& face, glm::vec2& uv)
+		{
+			glm::vec3 a = glm::abs(d);
+			float sc, tc, ma;
+			if (a.x >= a.y && a.x >= a.z)
+			{
+				face = d.x >= 0.f ? 0 : 1;
+				sc = d.x >= 0.f ? -d.z : d.z;
+				tc = -d.y;
+				ma = a.x;
+			}
+			else if (a.y >= a.z)
+			{
+				face = d.y >= 0.f ? 2 : 3;
+				sc = d.x;
+				tc = d.y >= 0.f ? d.z : -d.z;
+				ma = a.y;
+			}
+			else
+			{
+				face = d.z >= 0.f ? 4 : 5;
+				sc = d.z >= 0.f ? d.x : -d.x;
+				tc = -d.y;
+				ma = a.z;
+			}
+
+			uv = glm::vec2(sc / ma + 1.f, tc / ma + 1.f) * 0.5f;
+		}
+
+		uint32_t size;
+		uint32_t levelCount;
+		std::vector<std::vector<glm::vec3>> levels;	// Level major, six faces per level
+	};
+
+	// Sample of a prefiltered lobe around +Z
+	struct LobeSample
+	{
+		glm::vec3	direction;
+		float		weight;
+		float		lod;
+	};
+
+	void BuildLobeSamples(float alpha, uint32_t sourceSize, uint32_t sourceLevelCount, std::vector<LobeSample>& samples)
+	{
+		// The view and the normal are the reflected direction, a source level is chosen per sample
+		// from the solid angle it covers (filtered importance sampling), few samples are then enough
+		const float texelSolidAngle = 4.f * pi / (6.f * sourceSize * sourceSize);
+
+		samples.clear();
+		for (uint32_t i = 0; i < IblBaker::specularSampleCount; ++i)
+		{
+			glm::vec3 H = ImportanceSampleGgx(Hammersley(i, IblBaker::specularSampleCount), alpha);
+			glm::vec3 L = 2.f * H.z * H - glm::vec3(0.f, 0.f, 1.f);
+			if (L.z <= 0.f)
+				continue;
+
+			float pdf = DistributionGgx(H.z, alpha) * 0.25f;
+			float sampleSolidAngle = 1.f / (IblBaker::specularSampleCount * pdf + 1e-6f);
+			float lod = std::min(std::max(0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.f, 0.f), float(sourceLevelCount - 1));
+
+			LobeSample sample;
+			sample.direction = L;
+			sample.weight = L.z;
+			sample.lod = lod;
+			samples.push_back(sample);
+		}
+	}
+}
+
+std::mutex IblBaker::fileMutex;
+
+void ImageBasedLight::Clear()
+{
+	for (Texture& face : specular)
+		face.Clear();
+
+	brdfLut.Clear();
+}
+
+std::string IblBaker::GetSpecularCachePath(const std::vector<std::string>& facePaths)
+{
+	return KtxFile::GetCachePath(facePaths[0] + ".specular");
+}
+
+std::string IblBaker::GetBrdfLutCachePath(const std::vector<std::string>& facePaths)
+{
+	return KtxFile::GetCachePath(facePaths[0] + ".brdf");
+}
+
+std::string IblBaker::GetIrradianceCachePath(const std::vector<std::string>& facePaths)
+{
+	return facePaths[0] + ".irradiance";
+}
+
+glm::vec3 IblBaker::GetTexelDirection(uint32_t face, uint32_t x, uint32_t y, uint32_t size)
+{
+	float s = 2.f * (x + 0.5f) / size - 1.f;
+	float t = 2.f * (y + 0.5f) / size - 1.f;
+
+	glm::vec3 direction;
+	switch (face)
+	{
+	case 0:		direction = glm::vec3(1.f, -t, -s); break;
+	case 1:		direction = glm::vec3(-1.f, -t, s); break;
+	case 2:		direction = glm::vec3(s, 1.f, t); break;
+	case 3:		direction = glm::vec3(s, -1.f, -t); break;
+	case 4:		direction = glm::vec3(s, -t, 1.f); break;
+	default:	direction = glm::vec3(-s, -t, -1.f); break;
+	}
+
+	return glm::normalize(direction);
+}
+
+bool IblBaker::Load(const std::vector<std::string>& facePaths, Texture faces[6], ImageBasedLight& light, bool rebuild)
+{
+	if (facePaths.size() != 6)
+		return false;
+
+	if (!rebuild && KtxFile::ReadCube(GetSpecularCachePath(facePaths), facePaths, light.specular)
+		&& KtxFile::Read(GetBrdfLutCachePath(facePaths), facePaths, &light.brdfLut)
+		&& ReadIrradiance(GetIrradianceCachePath(facePaths), facePaths, light))
+		return true;
+
+	// A partial read is baked again as a whole
+	light.Clear();
+
+	glm::ivec2 dimensions = faces[0].GetDimensions();
+	for (uint32_t face = 0; face < 6; ++face)
+	{
+		if (faces[face].GetDimensions() != dimensions || dimensions.x != dimensions.y
+			|| (faces[face].format != VK_FORMAT_R8G8B8A8_UNORM && faces[face].format != VK_FORMAT_R8G8B8A8_SRGB))
+			return false;
+	}
+
+	Bake(faces, light);
+
+	if (!KtxFile::WriteCube(GetSpecularCachePath(facePaths), facePaths, light.specular)
+		|| !KtxFile::Write(GetBrdfLutCachePath(facePaths), facePaths, &light.brdfLut)
+		|| !WriteIrradiance(GetIrradianceCachePath(facePaths), facePaths, light))
+	{
+		std::cout << "Can't write image based lighting cache of " << facePaths[0] << std::endl;
+		return !rebuild;
+	}
+
+	return true;
+}
+
+void IblBaker::Bake(Texture faces[6], ImageBasedLight& light)
+{
+	const LinearCube cube(faces, maxSpecularSize);
+
+	// Irradiance : projection of a small level, each texel weighted by the solid angle it covers
+	{
+		uint32_t level = 0;
+		while (cube.GetLevelSize(level) > irradianceSize)
+			++level;
+
+		const uint32_t size = cube.GetLevelSize(level);
+		glm::vec3 faceSums[6][ImageBasedLight::irradianceCoefficientCount];
+		float faceWeights[6];
+
+		ThreadPool::Get().ParallelFor(6, [&](size_t face)
+		{
+			const std::vector<glm::vec3>& texels = cube.GetTexels(static_cast<uint32_t>(face), level);
+			std::fill(faceSums[face], faceSums[face] + ImageBasedLight::irradianceCoefficientCount, glm::vec3(0.f));
+			faceWeights[face] = 0.f;
+
+			float basis[ImageBasedLight::irradianceCoefficientCount];
+			for (uint32_t y = 0; y < size; ++y)
+			{
+				for (uint32_t x = 0; x < size; ++x)
+				{
+					float s = 2.f * (x + 0.5f) / size - 1.f;
+					float t = 2.f * (y + 0.5f) / size - 1.f;
+					float solidAngle = 4.f / (size * size * std::pow(1.f + s * s + t * t, 1.5f));
+
+					EvaluateBasis(GetTexelDirection(static_cast<uint32_t>(face), x, y, size), basis);
+					const glm::vec3& radiance = texels[size_t(y) * size + x];
+					for (uint32_t i = 0; i < ImageBasedLight::irradianceCoefficientCount; ++i)
+						faceSums[face][i] += radiance * (basis[i] * solidAngle);
+
+					faceWeights[face] += solidAngle;
+				}
+			}
+		});
+
+		float totalWeight = 0.f;
+		for (float weight : faceWeights)
+			totalWeight += weight;
+
+		// Cosine lobe convolution per band (pi, 2pi / 3, pi / 4), divided by pi for a lambertian surface
+		const float bandFactors[3] = { 1.f, 2.f / 3.f, 0.25f };
+		for (uint32_t i = 0; i < ImageBasedLight::irradianceCoefficientCount; ++i)
+		{
+			glm::vec3 sum(0.f);
+			for (uint32_t face = 0; face < 6; ++face)
+				sum += faceSums[face][i];
+
+			const uint32_t band = i == 0 ? 0 : (i < 4 ? 1 : 2);
+			light.irradiance[i] = glm::vec4(sum * (4.f * pi / totalWeight) * bandFactors[band], 0.f);
+		}
+	}
+
+	// Specular : the top level is the source at the baked size, the others one GGX lobe per texel
+	{
+		const uint32_t size = cube.GetSize();
+		const uint32_t levelCount = std::min<uint32_t>(uint32_t(maxSpecularLevels), cube.GetLevelCount());
+
+		std::vector<size_t> offsets(levelCount);
+		size_t chainSize = 0;
+		for (uint32_t level = 0; level < levelCount; ++level)
+		{
+			offsets[level] = chainSize;
+			chainSize += size_t(std::max(size >> level, 1u)) * std::max(size >> level, 1u) * 4;
+		}
+
+		std::vector<uint8_t> chains[6];
+		for (std::vector<uint8_t>& chain : chains)
+			chain.resize(chainSize);
+
+		std::vector<LobeSample> samples;
+		for (uint32_t level = 0; level < levelCount; ++level)
+		{
+			const uint32_t levelSize = std::max(size >> level, 1u);
+			const float perceptualRoughness = levelCount > 1 ? float(level) / float(levelCount - 1) : 0.f;
+			BuildLobeSamples(perceptualRoughness * perceptualRoughness, cube.GetSize(), cube.GetLevelCount(), samples);
+
+			ForEachRow(levelSize * 6, [&](uint32_t row)
+			{
+				const uint32_t face = row / levelSize;
+				const uint32_t y = row % levelSize;
+				uint8_t* destination = chains[face].data() + offsets[level] + size_t(y) * levelSize * 4;
+
+				for (uint32_t x = 0; x < levelSize; ++x)
+				{
+					glm::vec3 color;
+					if (level == 0)
+					{
+						color = cube.GetTexels(face, 0)[size_t(y) * levelSize + x];
+					}
+					else
+					{
+						glm::vec3 N = GetTexelDirection(face, x, y, levelSize);
+						glm::vec3 up = std::abs(N.z) < 0.999f ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(1.f, 0.f, 0.f);
+						glm::vec3 T = glm::normalize(glm::cross(up, N));
+						glm::vec3 B = glm::cross(N, T);
+
+						glm::vec3 sum(0.f);
+						float weight = 0.f;
+						for (const LobeSample& sample : samples)
+						{
+							glm::vec3 L = T * sample.direction.x + B * sample.direction.y + N * sample.direction.z;
+							sum += cube.Sample(L, sample.lod) * sample.weight;
+							weight += sample.weight;
+						}
+
+						color = weight > 0.f ? sum / weight : glm::vec3(0.f);
+					}
+
+					destination[x * 4] = LinearToSrgb(color.r);
+					destination[x * 4 + 1] = LinearToSrgb(color.g);
+					destination[x * 4 + 2] = LinearToSrgb(color.b);
+					destination[x * 4 + 3] = 255;
+				}
+			});
+		}
+
+		for (uint32_t face = 0; face < 6; ++face)
+			light.specular[face].SetLevels(VK_FORMAT_R8G8B8A8_SRGB, static_cast<int>(size), static_cast<int>(size), offsets, chains[face].data(), chains[face].size());
+	}
+
+	// BRDF LUT : the split sum integral of a white f0 over the GGX lobe, as f0 * scale + bias
+	{
+		std::vector<uint8_t> lut(size_t(brdfLutSize) * brdfLutSize * 4);
+
+		ForEachRow(brdfLutSize, [&](uint32_t y)
+		{
+			const float perceptualRoughness = (y + 0.5f) / brdfLutSize;
+			const float alpha = perceptualRoughness * perceptualRoughness;
+
+			for (uint32_t x = 0; x < brdfLutSize; ++x)
+			{
+				const float NdotV = (x + 0.5f) / brdfLutSize;
+				const glm::vec3 V(std::sqrt(1.f - NdotV * NdotV), 0.f, NdotV);
+
+				float scale = 0.f;
+				float bias = 0.f;
+				for (uint32_t i = 0; i < brdfSampleCount; ++i)
+				{
+					glm::vec3 H = ImportanceSampleGgx(Hammersley(i, brdfSampleCount), alpha);
+					float VdotH = glm::dot(V, H);
+					glm::vec3 L = 2.f * VdotH * H - V;
+
+					float NdotL = L.z;
+					if (NdotL <= 0.f)
+						continue;
+
+					float NdotH = std::max(H.z, 0.f);
+					VdotH = std::max(VdotH, 0.f);
+					float visibility = GeometrySmithGgx(NdotV, NdotL, alpha) * VdotH / (NdotH * NdotV);
+					float fresnel = std::pow(1.f - VdotH, 5.f);
+
+					scale += (1.f - fresnel) * visibility;
+					bias += fresnel * visibility;
+				}
+
+				const uint16_t values[2] = {
+					static_cast<uint16_t>(std::min(scale / brdfSampleCount, 1.f) * 65535.f + 0.5f),
+					static_cast<uint16_t>(std::min(bias / brdfSampleCount, 1.f) * 65535.f + 0.5f) };
+
+				uint8_t* texel = lut.data() + (size_t(y) * brdfLutSize + x) * 4;
+				texel[0] = static_cast<uint8_t>(values[0] >> 8);
+				texel[1] = static_cast<uint8_t>(values[0] & 0xFF);
+				texel[2] = static_cast<uint8_t>(values[1] >> 8);
+				texel[3] = static_cast<uint8_t>(values[1] & 0xFF);
+			}
+		});
+
+		light.brdfLut.SetLevels(VK_FORMAT_R8G8B8A8_UNORM, static_cast<int>(brdfLutSize), static_cast<int>(brdfLutSize), { 0 }, lut.data(), lut.size());
+	}
+}
+
+bool IblBaker::Restamp(const std::vector<std::string>& facePaths)
+{
+	if (facePaths.size() != 6
+		|| !KtxFile::Restamp(GetSpecularCachePath(facePaths), facePaths)
+		|| !KtxFile::Restamp(GetBrdfLutCachePath(facePaths), facePaths))
+		return false;
+
+	std::lock_guard<std::mutex> lock(fileMutex);
+
+	IrradianceHeader header;
+	std::fstream file(GetIrradianceCachePath(facePaths), std::ios::binary | std::ios::in | std::ios::out);
+	if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(IrradianceHeader))
+		|| header.magic != magic || header.version != version || !GetSourceStamp(facePaths, header))
+		return false;
+
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(IrradianceHeader));
+	return file.good();
+}
+
+bool IblBaker::GetSourceStamp(const std::vector<std::string>& facePaths, IrradianceHeader& header)
+{
+	for (uint32_t face = 0; face < 6; ++face)
+	{
+		if (!VirtualFileSystem::GetStamp(facePaths[face], header.sourceSizes[face], header.sourceTimes[face]))
+			return false;
+	}
+
+	return true;
+}
+
+bool IblBaker::ReadIrradiance(const std::string& path, const std::vector<std::string>& facePaths, ImageBasedLight& light)
+{
+	std::lock_guard<std::mutex> lock(fileMutex);
+
+	IrradianceHeader stamp;
+	if (!GetSourceStamp(facePaths, stamp))
+		return false;
+
+	std::shared_ptr<const FileData> file = VirtualFileSystem::Open(path);
+	if (!file || file->GetSize() != sizeof(IrradianceHeader))
+		return false;
+
+	IrradianceHeader header;
+	memcpy(&header, file->GetData(), sizeof(IrradianceHeader));
+	if (header.magic != magic || header.version != version
+		|| memcmp(header.sourceSizes, stamp.sourceSizes, sizeof(stamp.sourceSizes)) != 0
+		|| memcmp(header.sourceTimes, stamp.sourceTimes, sizeof(stamp.sourceTimes)) != 0)
+		return false;
+
+	for (uint32_t i = 0; i < ImageBasedLight::irradianceCoefficientCount; ++i)
+		light.irradiance[i] = glm::vec4(header.coefficients[i][0], header.coefficients[i][1], header.coefficients[i][2], header.coefficients[i][3]);
+
+	return true;
+}
+
+bool IblBaker::WriteIrradiance(const std::string& path, const std::vector<std::string>& facePaths, const ImageBasedLight& light)
+{
+	std::lock_guard<std::mutex> lock(fileMutex);
+
+	IrradianceHeader header = {};
+	header.magic = magic;
+	header.version = version;
+	if (!GetSourceStamp(facePaths, header))
+		return false;
+
+	for (uint32_t i = 0; i < ImageBasedLight::irradianceCoefficientCount; ++i)
+		memcpy(header.coefficients[i], &light.irradiance[i].x, sizeof(header.coefficients[i]));
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(IrradianceHeader));
+	return file.good();
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "Texture.h"
+
+// Image based lighting of an environment cube map, in the directions the shaders sample the skybox with
+struct ImageBasedLight
+{
+	static const uint32_t irradianceCoefficientCount = 9;
+
+	// L2 spherical harmonics of the irradiance divided by pi, rgb : the diffuse light of a white surface
+	glm::vec4	irradiance[irradianceCoefficientCount];
+
+	// GGX prefiltered radiance in sRGB, level l holds the perceptual roughness l / (levels - 1)
+	Texture		specular[6];
+
+	// Scale and bias of f0 in the split sum, over NdotV in u and the perceptual roughness in v.
+	// 16 bits values stored as high and low bytes, in RG and BA, so they stay linear under filtering
+	Texture		brdfLut;
+
+	// CPU data only, the driver owns the GPU copies
+	void Clear();
+};
+
+// CPU baker of the image based lighting of a skybox, on the ThreadPool : projects the radiance on L2 spherical
+// harmonics convolved by the cosine lobe, prefilters a specular mip chain with importance sampled GGX lobes
+// (fetching the source mip matching the solid angle of each sample) and integrates the BRDF LUT of the split sum.
+// Results are cached next to the first face and rebuilt when a face image changes.
+class IblBaker
+{
+public:
+	IblBaker() = delete;
+	~IblBaker() = delete;
+
+	static const uint32_t magic = 0x4C42494C; // "LIBL"
+	static const uint32_t version = 1;
+
+	static const uint32_t maxSpecularSize = 256;
+	static const uint32_t maxSpecularLevels = 6;
+	static const uint32_t specularSampleCount = 64;
+	static const uint32_t irradianceSize = 64;		// Faces are downsampled to this size before the projection
+	static const uint32_t brdfLutSize = 128;
+	static const uint32_t brdfSampleCount = 256;
+
+	// faces are the R8G8B8A8 sRGB encoded faces of TextureCache::LoadCubeFaces, in the +X -X +Y -Y +Z -Z order.
+	// Reads the caches of the face images, or bakes the light and writes them when they are missing, outdated or rebuilt.
+	// False when the faces can't be baked, or when rebuilt caches can't be written
+	static bool Load(const std::vector<std::string>& facePaths, Texture faces[6], ImageBasedLight& light, bool rebuild = false);
+
+	static void Bake(Texture faces[6], ImageBasedLight& light);
+
+	// Stamps the caches with the current size and date of the faces, for faces touched without any change
+	static bool Restamp(const std::vector<std::string>& facePaths);
+
+	static std::string GetSpecularCachePath(const std::vector<std::string>& facePaths);
+	static std::string GetBrdfLutCachePath(const std::vector<std::string>& facePaths);
+	static std::string GetIrradianceCachePath(const std::vector<std::string>& facePaths);
+
+	// Unit direction of the texel center (x, y) of a face of size texels
+	static glm::vec3 GetTexelDirection(uint32_t face, uint32_t x, uint32_t y, uint32_t size);
+
+private:
+	struct IrradianceHeader
+	{
+		uint32_t	magic;
+		uint32_t	version;
+		uint64_t	sourceSizes[6];
+		int64_t		sourceTimes[6];
+		float		coefficients[ImageBasedLight::irradianceCoefficientCount][4];
+	};
+
+	static bool GetSourceStamp(const std::vector<std::string>& facePaths, IrradianceHeader& header);
+	static bool ReadIrradiance(const std::string& path, const std::vector<std::string>& facePaths, ImageBasedLight& light);
+	static bool WriteIrradiance(const std::string& path, const std::vector<std::string>& facePaths, const ImageBasedLight& light);
+
+	static std::mutex fileMutex;
+};
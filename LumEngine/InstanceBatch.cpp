@@ -0,0 +1,65 @@
+#include "InstanceBatch.h"
+
+#include <functional>
+#include <stdexcept>
+
+size_t InstanceBatcher::BatchKeyHash::operator()(const BatchKey& key) const
+{
+	size_t hash = std::hash<const void*>()(key.buffer);
+	return hash ^ (std::hash<uint64_t>()((uint64_t)key.descriptorSet) + 0x9e3779b9 + (hash << 6) + (hash >> 2));
+}
+
+void InstanceBatcher::Clear()
+{
+	batchLookup.clear();
+	batches.clear();
+	instances.clear();
+	instanceBatches.clear();
+}
+
+void InstanceBatcher::Add(MeshBuffer* buffer, VkDescriptorSet descriptorSet, const glm::mat4& model, uint32_t materialIndex)
+{
+	uint32_t batchIndex = static_cast<uint32_t>(batches.size());
+
+	if (mergeInstances)
+	{
+		auto it = batchLookup.find({ buffer, descriptorSet });
+		if (it != batchLookup.end())
+			batchIndex = it->second;
+		else
+			batchLookup[{ buffer, descriptorSet }] = batchIndex;
+	}
+
+	if (batchIndex == batches.size())
+		batches.push_back({ buffer, descriptorSet, 0, 0, model });
+
+	++batches[batchIndex].instanceCount;
+
+	InstanceData instance = {};
+	instance.model = model;
+	instance.materialIndex = materialIndex;
+
+	instances.push_back(instance);
+	instanceBatches.push_back(batchIndex);
+}
+
+uint32_t InstanceBatcher::Write(InstanceData* instanceData, uint32_t firstInstance, uint32_t capacity)
+{
+	if (firstInstance + instances.size() > capacity)
+		throw std::runtime_error("Instance buffer is too small for the frame!");
+
+	std::vector<uint32_t> cursors(batches.size());
+
+	uint32_t offset = firstInstance;
+	for (size_t i = 0; i < batches.size(); ++i)
+	{
+		batches[i].firstInstance = offset;
+		cursors[i] = offset;
+		offset += batches[i].instanceCount;
+	}
+
+	for (size_t i = 0; i < instances.size(); ++i)
+		instanceData[cursors[instanceBatches[i]]++] = instances[i];
+
+	return offset;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#define VK_NO_PROTOTYPES
+#include <volk.h>
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+class MeshBuffer;
+
+// Per instance vertex stream (binding 1, locations 4 to 8)
+struct InstanceData
+{
+	glm::mat4	model;
+	uint32_t	materialIndex;
+	uint32_t	padding[3];
+};
+
+// One draw of instanceCount nodes sharing the same geometry and descriptor set
+struct InstanceBatch
+{
+	MeshBuffer*		buffer;
+	VkDescriptorSet descriptorSet;
+	uint32_t		firstInstance;
+	uint32_t		instanceCount;
+
+	// Model of the first instance, single instance batches keep meshlet culling
+	glm::mat4		model;
+};
+
+class InstanceBatcher
+{
+public:
+	InstanceBatcher() = default;
+	~InstanceBatcher() = default;
+
+	// When false every added node gets its own batch
+	bool mergeInstances = true;
+
+	void Clear();
+	void Add(MeshBuffer* buffer, VkDescriptorSet descriptorSet, const glm::mat4& model, uint32_t materialIndex);
+
+	// Writes the instances grouped by batch from instanceData[firstInstance], returns the next free instance
+	uint32_t Write(InstanceData* instanceData, uint32_t firstInstance, uint32_t capacity);
+
+	const std::vector<InstanceBatch>& GetBatches() const { return batches; }
+
+private:
+	struct BatchKey
+	{
+		MeshBuffer*		buffer;
+		VkDescriptorSet descriptorSet;
+
+		bool operator==(const BatchKey& other) const { return buffer == other.buffer && descriptorSet == other.descriptorSet; }
+	};
+
+	struct BatchKeyHash
+	{
+		size_t operator()(const BatchKey& key) const;
+	};
+
+	std::unordered_map<BatchKey, uint32_t, BatchKeyHash> batchLookup;
+	std::vector<InstanceBatch>	batches;
+	std::vector<InstanceData>	instances;
+	std::vector<uint32_t>		instanceBatches;
+};
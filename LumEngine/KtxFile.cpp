@@ -0,0 +1,346 @@
+#include "KtxFile.h"
+#include "VirtualFileSystem.h"
+#include "TextureCompressor.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	const uint64_t levelAlignment = 16;
+
+	uint64_t AlignOffset(uint64_t offset, uint64_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	bool IsRangeValid(uint64_t offset, uint64_t size, size_t fileSize)
+	{
+		return offset <= fileSize && size <= fileSize - offset;
+	}
+}
+
+const uint8_t KtxFile::identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+const char* const KtxFile::sourceKey = "LumEngine.source";
+
+std::mutex KtxFile::fileMutex;
+
+std::string KtxFile::GetCachePath(const std::string& sourcePath)
+{
+	return sourcePath + ".ktx2";
+}
+
+bool KtxFile::IsSupportedFormat(VkFormat format)
+{
+	return Texture::GetTexelSize(format) != 0 || TextureCompressor::IsBlockCompressed(format);
+}
+
+bool KtxFile::GetSourceStamp(const std::vector<std::string>& sourcePaths, std::string& stamp)
+{
+	// "size:time" of each source, separated by ';'
+	stamp.clear();
+	for (const std::string& sourcePath : sourcePaths)
+	{
+		uint64_t size;
+		int64_t time;
+		if (!VirtualFileSystem::GetStamp(sourcePath, size, time))
+			return false;
+
+		if (!stamp.empty())
+			stamp += ";";
+		stamp += std::to_string(size) + ":" + std::to_string(time);
+	}
+
+	return !stamp.empty();
+}
+
+void KtxFile::BuildDescriptor(VkFormat format, std::vector<uint32_t>& words)
+{
+	// Khronos Data Format basic block, one sample per 64 bits of a BC block or per channel of an uncompressed texel
+	uint32_t colorModel = 0;
+	std::vector<uint32_t> channels;
+
+	switch (format)
+	{
+	case VK_FORMAT_R8_UNORM:
+	case VK_FORMAT_R16_UNORM:			colorModel = 1; channels = { 0 }; break;
+	case VK_FORMAT_R8G8_UNORM:			colorModel = 1; channels = { 0, 1 }; break;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:		colorModel = 1; channels = { 0, 1, 2, 15 }; break;
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:	colorModel = 128; channels = { 0 }; break;
+	case VK_FORMAT_BC3_UNORM_BLOCK:		colorModel = 130; channels = { 15, 0 }; break;
+	case VK_FORMAT_BC4_UNORM_BLOCK:		colorModel = 131; channels = { 0 }; break;
+	case VK_FORMAT_BC5_UNORM_BLOCK:		colorModel = 132; channels = { 0, 1 }; break;
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:		colorModel = 134; channels = { 0 }; break;
+	default: break;
+	}
+
+	const bool srgb = format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC7_SRGB_BLOCK;
+	const bool blockCompressed = TextureCompressor::IsBlockCompressed(format);
+	const uint32_t blockSize = TextureCompressor::GetBlockSize(format);
+	const uint32_t sampleBits = blockSize * 8 / static_cast<uint32_t>(channels.size());
+	const uint32_t descriptorBlockSize = 24 + 16 * static_cast<uint32_t>(channels.size());
+
+	words.clear();
+	words.push_back(4 + descriptorBlockSize);
+	words.push_back(0);											// Khronos vendor, basic descriptor type
+	words.push_back(2 | (descriptorBlockSize << 16));			// Version 1.3
+	words.push_back(colorModel | (1 << 8) | ((srgb ? 2 : 1) << 16));	// BT.709 primaries, linear or sRGB transfer
+	words.push_back(blockCompressed ? 3 | (3 << 8) : 0);			// 4x4 or 1x1 texels
+	words.push_back(blockSize);
+	words.push_back(0);
+
+	for (size_t i = 0; i < channels.size(); ++i)
+	{
+		// The alpha of sRGB texels stays linear
+		uint32_t qualifiers = srgb && channels[i] == 15 ? 1u << 4 : 0u;
+		words.push_back(static_cast<uint32_t>(i * sampleBits) | ((sampleBits - 1) << 16) | ((channels[i] | qualifiers) << 24));
+		words.push_back(0);
+		words.push_back(0);
+		words.push_back(blockCompressed ? 0xFFFFFFFF : (1u << sampleBits) - 1);
+	}
+}
+
+bool KtxFile::Read(const std::string& path, const std::vector<std::string>& sourcePaths, Texture* texture)
+{
+	std::lock_guard<std::mutex> lock(fileMutex);
+
+	std::string stamp;
+	if (!GetSourceStamp(sourcePaths, stamp))
+		return false;
+
+	uint32_t faceCount;
+	return ReadFaces(path, &stamp, texture, 1, faceCount) && faceCount == 1;
+}
+
+bool KtxFile::ReadCube(const std::string& path, const std::vector<std::string>& sourcePaths, Texture faces[6])
+{
+	std::lock_guard<std::mutex> lock(fileMutex);
+
+	std::string stamp;
+	if (!GetSourceStamp(sourcePaths, stamp))
+		return false;
+
+	uint32_t faceCount;
+	return ReadFaces(path, &stamp, faces, 6, faceCount) && faceCount == 6;
+}
+
+bool KtxFile::ReadFaces(const std::string& path, const std::string* stamp, Texture* faces, uint32_t faceCapacity, uint32_t& faceCount)
+{
+	std::shared_ptr<const FileData> file = VirtualFileSystem::Open(path);
+	if (!file || file->GetSize() < sizeof(Header))
+		return false;
+
+	const uint8_t* data = file->GetData();
+	const size_t fileSize = file->GetSize();
+
+	Header header;
+	memcpy(&header, data, sizeof(Header));
+
+	const VkFormat format = static_cast<VkFormat>(header.vkFormat);
+	if (memcmp(header.identifier, identifier, sizeof(identifier)) != 0
+		|| !IsSupportedFormat(format) || header.supercompressionScheme != 0
+		|| header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0
+		|| header.layerCount != 0 || (header.faceCount != 1 && header.faceCount != 6) || header.faceCount > faceCapacity
+		|| (header.faceCount == 6 && header.pixelWidth != header.pixelHeight) || header.levelCount == 0
+		|| !IsRangeValid(sizeof(Header), sizeof(Level) * uint64_t(header.levelCount), fileSize)
+		|| !IsRangeValid(header.kvdByteOffset, header.kvdByteLength, fileSize))
+		return false;
+
+	// Source stamp in the key/value data
+	bool upToDate = stamp == nullptr;
+	const uint8_t* kvd = data + header.kvdByteOffset;
+	uint32_t kvdPosition = 0;
+	while (stamp && kvdPosition + sizeof(uint32_t) <= header.kvdByteLength)
+	{
+		uint32_t entryLength;
+		memcpy(&entryLength, kvd + kvdPosition, sizeof(uint32_t));
+		kvdPosition += sizeof(uint32_t);
+		if (entryLength > header.kvdByteLength - kvdPosition)
+			break;
+
+		const char* entry = reinterpret_cast<const char*>(kvd + kvdPosition);
+		size_t keyLength = strnlen(entry, entryLength);
+		if (keyLength < entryLength && strcmp(entry, sourceKey) == 0)
+		{
+			std::string value(entry + keyLength + 1, strnlen(entry + keyLength + 1, entryLength - keyLength - 1));
+			upToDate = value == *stamp;
+		}
+
+		kvdPosition = static_cast<uint32_t>(AlignOffset(kvdPosition + entryLength, 4));
+	}
+
+	if (!upToDate)
+		return false;
+
+	std::vector<Level> levels(header.levelCount);
+	memcpy(levels.data(), data + sizeof(Header), sizeof(Level) * levels.size());
+
+	// The faces of a level follow each other
+	std::vector<size_t> offsets(levels.size());
+	size_t chainSize = 0;
+	for (uint32_t level = 0; level < header.levelCount; ++level)
+	{
+		uint64_t levelSize = TextureCompressor::GetLevelSize(format, std::max(header.pixelWidth >> level, 1u), std::max(header.pixelHeight >> level, 1u));
+		if (levels[level].byteLength != levelSize * header.faceCount || !IsRangeValid(levels[level].byteOffset, levels[level].byteLength, fileSize))
+			return false;
+
+		offsets[level] = chainSize;
+		chainSize += static_cast<size_t>(levelSize);
+	}
+
+	// Levels are stored smallest first, the texture keeps the top level first
+	std::vector<uint8_t> chain(chainSize);
+	for (uint32_t face = 0; face < header.faceCount; ++face)
+	{
+		for (uint32_t level = 0; level < header.levelCount; ++level)
+		{
+			size_t levelSize = (level + 1 < header.levelCount ? offsets[level + 1] : chainSize) - offsets[level];
+			memcpy(chain.data() + offsets[level], data + levels[level].byteOffset + levelSize * face, levelSize);
+		}
+
+		faces[face].SetLevels(format, static_cast<int>(header.pixelWidth), static_cast<int>(header.pixelHeight), offsets, chain.data(), chain.size());
+	}
+
+	faceCount = header.faceCount;
+	return true;
+}
+
+bool KtxFile::Write(const std::string& path, const std::vector<std::string>& sourcePaths, Texture* texture)
+{
+	std::lock_guard<std::mutex> lock(fileMutex);
+
+	if (!texture->HasMipChain())
+		return false;
+
+	std::string stamp;
+	if (!GetSourceStamp(sourcePaths, stamp))
+		return false;
+
+	return WriteFaces(path, stamp, texture, 1);
+}
+
+bool KtxFile::WriteCube(const std::string& path, const std::vector<std::string>& sourcePaths, Texture faces[6])
+{
+	std::lock_guard<std::mutex> lock(fileMutex);
+
+	glm::ivec2 dimensions = faces[0].GetDimensions();
+	if (dimensions.x != dimensions.y)
+		return false;
+
+	for (uint32_t face = 1; face < 6; ++face)
+	{
+		if (faces[face].GetDimensions() != dimensions || faces[face].format != faces[0].format || faces[face].levelOffsets != faces[0].levelOffsets)
+			return false;
+	}
+
+	std::string stamp;
+	if (!GetSourceStamp(sourcePaths, stamp))
+		return false;
+
+	return WriteFaces(path, stamp, faces, 6);
+}
+
+bool KtxFile::Restamp(const std::string& path, const std::vector<std::string>& sourcePaths)
+{
+	std::lock_guard<std::mutex> lock(fileMutex);
+
+	std::string stamp;
+	if (!GetSourceStamp(sourcePaths, stamp))
+		return false;
+
+	Texture faces[maxFaces];
+	uint32_t faceCount = 0;
+	bool restamped = ReadFaces(path, nullptr, faces, maxFaces, faceCount) && WriteFaces(path, stamp, faces, faceCount);
+
+	for (Texture& face : faces)
+		face.Clear();
+
+	return restamped;
+}
+
+bool KtxFile::WriteFaces(const std::string& path, const std::string& stamp, Texture* faces, uint32_t faceCount)
+{
+	Texture* texture = &faces[0];
+	if (!IsSupportedFormat(texture->format))
+		return false;
+
+	// A texture without chain is written as its single level
+	const std::vector<size_t> levelOffsets = texture->HasMipChain() ? texture->levelOffsets : std::vector<size_t>{ 0 };
+	const glm::ivec2 dimensions = texture->GetDimensions();
+	const uint32_t levelCount = static_cast<uint32_t>(levelOffsets.size());
+	const size_t chainSize = static_cast<size_t>(texture->GetMemorySize());
+
+	std::vector<uint32_t> descriptor;
+	BuildDescriptor(texture->format, descriptor);
+
+	// Key and value are null terminated, the entry is padded to 4 bytes
+	std::vector<uint8_t> keyValues;
+	uint32_t entryLength = static_cast<uint32_t>(strlen(sourceKey) + 1 + stamp.size() + 1);
+	keyValues.resize(sizeof(uint32_t));
+	memcpy(keyValues.data(), &entryLength, sizeof(uint32_t));
+	keyValues.insert(keyValues.end(), sourceKey, sourceKey + strlen(sourceKey) + 1);
+	keyValues.insert(keyValues.end(), stamp.c_str(), stamp.c_str() + stamp.size() + 1);
+	keyValues.resize(static_cast<size_t>(AlignOffset(keyValues.size(), 4)), 0);
+
+	Header header = {};
+	memcpy(header.identifier, identifier, sizeof(identifier));
+	header.vkFormat = static_cast<uint32_t>(texture->format);
+	header.typeSize = 1;
+	header.pixelWidth = static_cast<uint32_t>(dimensions.x);
+	header.pixelHeight = static_cast<uint32_t>(dimensions.y);
+	header.faceCount = faceCount;
+	header.levelCount = levelCount;
+
+	// Layout : header, level index, descriptor, key/values, then the levels from the smallest, each with all of its faces
+	header.dfdByteOffset = static_cast<uint32_t>(sizeof(Header) + sizeof(Level) * levelCount);
+	header.dfdByteLength = static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t));
+	header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+	header.kvdByteLength = static_cast<uint32_t>(keyValues.size());
+
+	std::vector<Level> levels(levelCount);
+	std::vector<size_t> levelSizes(levelCount);
+	uint64_t offset = header.kvdByteOffset + header.kvdByteLength;
+	for (uint32_t level = levelCount; level-- > 0;)
+	{
+		size_t levelEnd = level + 1 < levelCount ? levelOffsets[level + 1] : chainSize;
+		levelSizes[level] = levelEnd - levelOffsets[level];
+
+		offset = AlignOffset(offset, levelAlignment);
+		levels[level].byteOffset = offset;
+		levels[level].byteLength = uint64_t(levelSizes[level]) * faceCount;
+		levels[level].uncompressedByteLength = levels[level].byteLength;
+		offset += levels[level].byteLength;
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	auto writeAt = [&file](uint64_t offset, const void* data, size_t size)
+	{
+		static const char zeros[levelAlignment] = {};
+		uint64_t position = static_cast<uint64_t>(file.tellp());
+		if (position < offset)
+			file.write(zeros, static_cast<std::streamsize>(offset - position));
+
+		if (size > 0)
+			file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+	};
+
+	writeAt(0, &header, sizeof(Header));
+	writeAt(sizeof(Header), levels.data(), sizeof(Level) * levels.size());
+	writeAt(header.dfdByteOffset, descriptor.data(), header.dfdByteLength);
+	writeAt(header.kvdByteOffset, keyValues.data(), keyValues.size());
+
+	for (uint32_t level = levelCount; level-- > 0;)
+	{
+		for (uint32_t face = 0; face < faceCount; ++face)
+			writeAt(levels[level].byteOffset + levelSizes[level] * face, static_cast<const uint8_t*>(faces[face].GetData()) + levelOffsets[level], levelSizes[level]);
+	}
+
+	return file.good();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <mutex>
+
+#include "Texture.h"
+
+// KTX 2.0 container of the mip chains (block compressed or in an uncompressed Texture format), written next to the source image on first load.
+// Only 2D textures and cube maps without supercompression are handled. The size and date of the source images are
+// stored in the key/value data so a modified image is compressed again.
+class KtxFile
+{
+public:
+	KtxFile() = delete;
+	~KtxFile() = delete;
+
+	static std::string GetCachePath(const std::string& sourcePath);
+
+	// Fails when the file is missing, in another format or older than one of the source images
+	static bool Read(const std::string& path, const std::vector<std::string>& sourcePaths, Texture* texture);
+
+	// texture must hold a full mip chain (Texture::HasMipChain)
+	static bool Write(const std::string& path, const std::vector<std::string>& sourcePaths, Texture* texture);
+
+	// Six faces in the +X -X +Y -Y +Z -Z order, of the same size, format and level count. A single level is enough
+	static bool ReadCube(const std::string& path, const std::vector<std::string>& sourcePaths, Texture faces[6]);
+	static bool WriteCube(const std::string& path, const std::vector<std::string>& sourcePaths, Texture faces[6]);
+
+	// Stamps the file with the current size and date of its sources, for sources touched without any change
+	static bool Restamp(const std::string& path, const std::vector<std::string>& sourcePaths);
+
+private:
+	struct Header
+	{
+		uint8_t		identifier[12];
+		uint32_t	vkFormat;
+		uint32_t	typeSize;
+		uint32_t	pixelWidth;
+		uint32_t	pixelHeight;
+		uint32_t	pixelDepth;
+		uint32_t	layerCount;
+		uint32_t	faceCount;
+		uint32_t	levelCount;
+		uint32_t	supercompressionScheme;
+		uint32_t	dfdByteOffset;
+		uint32_t	dfdByteLength;
+		uint32_t	kvdByteOffset;
+		uint32_t	kvdByteLength;
+		uint64_t	sgdByteOffset;
+		uint64_t	sgdByteLength;
+	};
+
+	struct Level
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	static const uint8_t identifier[12];
+	static const char* const sourceKey;
+
+	static const uint32_t maxFaces = 6;
+
+	static bool IsSupportedFormat(VkFormat format);
+	static bool GetSourceStamp(const std::vector<std::string>& sourcePaths, std::string& stamp);
+
+	// Reads faceCapacity faces at most, the stamp is not checked when null. Callers hold the fileMutex
+	static bool ReadFaces(const std::string& path, const std::string* stamp, Texture* faces, uint32_t faceCapacity, uint32_t& faceCount);
+	static bool WriteFaces(const std::string& path, const std::string& stamp, Texture* faces, uint32_t faceCount);
+
+	// Data format descriptor with a single basic block
+	static void BuildDescriptor(VkFormat format, std::vector<uint32_t>& words);
+
+	static std::mutex fileMutex;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cfloat>
+
+// Axis aligned bounding box, min > max means empty (unknown bounds)
+struct LeAabb
+{
+	// Large enough to never be culled, small enough to keep plane distances finite
+	static constexpr float unboundedExtent = 1e30f;
+
+	glm::vec3 min = glm::vec3(FLT_MAX);
+	glm::vec3 max = glm::vec3(-FLT_MAX);
+
+	bool IsEmpty() const
+	{
+		return min.x > max.x || min.y > max.y || min.z > max.z;
+	}
+
+	void Expand(const glm::vec3& point)
+	{
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	bool operator==(const LeAabb& other) const { return min == other.min && max == other.max; }
+	bool operator!=(const LeAabb& other) const { return !(*this == other); }
+
+	// Box passing every frustum test, for geometry without bounds
+	static LeAabb Unbounded()
+	{
+		LeAabb box;
+		box.min = glm::vec3(-unboundedExtent);
+		box.max = glm::vec3(unboundedExtent);
+		return box;
+	}
+
+	// Box of the transformed box : center moved by the matrix, extents by its absolute linear part.
+	// An empty box stays unbounded, the transform can't make it cullable
+	LeAabb Transform(const glm::mat4& model) const
+	{
+		if (IsEmpty())
+			return Unbounded();
+
+		glm::vec3 center = (min + max) * 0.5f;
+		glm::vec3 extents = (max - min) * 0.5f;
+
+		glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.f));
+		glm::vec3 worldExtents = glm::abs(glm::vec3(model[0])) * extents.x + glm::abs(glm::vec3(model[1])) * extents.y + glm::abs(glm::vec3(model[2])) * extents.z;
+
+		LeAabb box;
+		box.min = worldCenter - worldExtents;
+		box.max = worldCenter + worldExtents;
+		return box;
+	}
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "LeAabb.h"
+
+class LeFrustum
+{
+public:
+	enum FrustumPlane { Left = 0, Right, Bottom, Top, Near, Far };
+
+	// Planes are stored as (normal, distance), normals pointing inside
+	glm::vec4 planes[6];
+
+	LeFrustum()
+	{
+		for (int i = 0; i < 6; ++i)
+			planes[i] = glm::vec4(0.f, 0.f, 0.f, 1.f);
+	}
+
+	void ExtractPlanes(const glm::mat4& viewProj)
+	{
+		glm::vec4 row0 = glm::vec4(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+		glm::vec4 row1 = glm::vec4(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+		glm::vec4 row2 = glm::vec4(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+		glm::vec4 row3 = glm::vec4(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+		planes[Left] = row3 + row0;
+		planes[Right] = row3 - row0;
+		planes[Bottom] = row3 + row1;
+		planes[Top] = row3 - row1;
+		// Depth range is [0, 1]
+		planes[Near] = row2;
+		planes[Far] = row3 - row2;
+
+		for (int i = 0; i < 6; ++i)
+		{
+			float length = glm::length(glm::vec3(planes[i]));
+			if (length > 0.f)
+				planes[i] /= length;
+		}
+	}
+
+	bool IsSphereVisible(const glm::vec3& center, float radius) const
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+				return false;
+		}
+
+		return true;
+	}
+
+	// Positive vertex test, the corner furthest along each plane normal
+	bool IsBoxVisible(const LeAabb& box) const
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			glm::vec3 positive(planes[i].x >= 0.f ? box.max.x : box.min.x, planes[i].y >= 0.f ? box.max.y : box.min.y, planes[i].z >= 0.f ? box.max.z : box.min.z);
+			if (glm::dot(glm::vec3(planes[i]), positive) + planes[i].w < 0.f)
+				return false;
+		}
+
+		return true;
+	}
+};
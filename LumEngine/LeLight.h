@@ -27,8 +27,8 @@ enum AmbientMode
 {
 	Flat = 0,
 	Trilight,
-	CubeMap
-	//Skybox
+	CubeMap,
+	ImageBased		// Irradiance and prefiltered reflections of the skybox
 };
 
 struct AmbientUniformBufferObject
@@ -37,6 +37,7 @@ struct AmbientUniformBufferObject
 	/*alignas(16)*/ glm::vec4 equatorColor;
 	/*alignas(16)*/ glm::vec4 groundColor;
 	/*alignas(128)*/ glm::vec4 ambientCube[6];
+	/*alignas(16)*/ glm::vec4 irradiance[9];	// ImageBasedLight::irradiance of the skybox
 	/*alignas(4)*/ float ka;
 	/*alignas(4)*/ int mode;
 };
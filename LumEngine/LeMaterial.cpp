@@ -26,6 +26,7 @@ LeMaterial::LeMaterial()
 	params.roughness		= 0.5f;
 	params.metallic			= 0.f;
 	params.reflectance		= 0.5f;
+	params.maskChannels		= 0;
 };
 
 LeMaterial::LeMaterial(std::string _name, glm::vec4 color, float roughness, float metallic, float reflectance)
@@ -35,6 +36,7 @@ LeMaterial::LeMaterial(std::string _name, glm::vec4 color, float roughness, floa
 	params.roughness		= roughness;
 	params.metallic			= metallic;
 	params.reflectance		= reflectance;
+	params.maskChannels		= 0;
 };
 
 void LeMaterial::CopyMaterial(LeMaterial materialToCopy)
@@ -33,17 +33,17 @@ struct UniformMaterialBuffer
 	alignas(4) float		reflectance;
 	alignas(4) float		roughness;
 	alignas(4) float		metallic;
+	alignas(4) uint32_t		maskChannels;	// Copied from the mask map by the driver
 };
 
 struct LeMaterial
 {
 	UniformMaterialBuffer params;
 
-	Texture* texture;
-	Texture* normalMap;
-	Texture* specularMap;
-	Texture* metallicMap;
-	Texture* roughnessMap;
+	// References held on TextureCache textures
+	Texture* texture		= nullptr;
+	Texture* normalMap		= nullptr;
+	Texture* maskMap		= nullptr;	// Occlusion, roughness, metallic and specular, see MaskChannel
 
 	std::string name;
 
@@ -1,4 +1,5 @@
 #include "LeUtils.h"
+#include "VirtualFileSystem.h"
 #include <Windows.h>
 #include <iostream>
 #include <fstream>
@@ -244,19 +245,12 @@ VkBufferCreateInfo BufferCreateInfoUtils(VkBufferUsageFlags usage, VkDeviceSize
 }
 std::vector<char> ReadFile(const std::string & filename)
 {
-	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+	std::shared_ptr<const FileData> file = VirtualFileSystem::Open(filename);
 
-	if (!file.is_open())
+	if (!file)
 		throw std::runtime_error(std::string{ "chec de l'ouverture du fichier " } +filename + "!");
 
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> buffer(fileSize);
-
-	file.seekg(0);
-	file.read(buffer.data(), fileSize);
-	file.close();
-
-	return buffer;
+	return std::vector<char>(file->GetData(), file->GetData() + file->GetSize());
 }
 
 VkRenderPassBeginInfo VkRenderPassBeginInfoUtils(VkRenderPass renderPass, VkFramebuffer frameBuffer, VkExtent2D& extent)
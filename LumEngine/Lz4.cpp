@@ -0,0 +1,184 @@
+#include "Lz4.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	uint32_t Read32(const uint8_t* source)
+	{
+		uint32_t value;
+		memcpy(&value, source, sizeof(value));
+		return value;
+	}
+}
+
+size_t Lz4::GetMaxCompressedSize(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+uint8_t* Lz4::WriteLength(uint8_t* output, size_t length)
+{
+	for (; length >= 255; length -= 255)
+		*output++ = 255;
+
+	*output++ = static_cast<uint8_t>(length);
+	return output;
+}
+
+size_t Lz4::Compress(const uint8_t* source, size_t size, uint8_t* destination, size_t capacity)
+{
+	// Positions + 1, 0 for an empty entry
+	std::vector<uint32_t> table(size_t(1) << hashBits, 0);
+
+	uint8_t* output = destination;
+	const uint8_t* outputEnd = destination + capacity;
+
+	size_t anchor = 0;
+	size_t position = 0;
+	const size_t matchLimit = size > matchSafety ? size - matchSafety : 0;
+
+	while (position < matchLimit)
+	{
+		uint32_t sequence = Read32(source + position);
+		uint32_t& entry = table[Hash(sequence)];
+		size_t candidate = entry;
+		entry = static_cast<uint32_t>(position + 1);
+
+		if (candidate == 0 || position + 1 - candidate > maxOffset || Read32(source + candidate - 1) != sequence)
+		{
+			// Skips faster through data that doesn't match
+			position += 1 + ((position - anchor) >> 6);
+			continue;
+		}
+
+		size_t match = candidate - 1;
+		while (position > anchor && match > 0 && source[position - 1] == source[match - 1])
+		{
+			--position;
+			--match;
+		}
+
+		size_t matchEnd = position + minMatch;
+		for (size_t from = match + minMatch; matchEnd < size - lastLiterals && source[matchEnd] == source[from]; ++from)
+			++matchEnd;
+
+		size_t literalLength = position - anchor;
+		size_t matchLength = matchEnd - position - minMatch;
+
+		if (static_cast<size_t>(outputEnd - output) < 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1)
+			return 0;
+
+		uint8_t* token = output++;
+		*token = static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4 | (matchLength < 15 ? matchLength : 15));
+
+		if (literalLength >= 15)
+			output = WriteLength(output, literalLength - 15);
+
+		memcpy(output, source + anchor, literalLength);
+		output += literalLength;
+
+		size_t offset = position - match;
+		*output++ = static_cast<uint8_t>(offset);
+		*output++ = static_cast<uint8_t>(offset >> 8);
+
+		if (matchLength >= 15)
+			output = WriteLength(output, matchLength - 15);
+
+		position = matchEnd;
+		anchor = position;
+	}
+
+	// Last literals
+	size_t literalLength = size - anchor;
+	if (static_cast<size_t>(outputEnd - output) < 1 + literalLength / 255 + 1 + literalLength)
+		return 0;
+
+	*output++ = static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4);
+	if (literalLength >= 15)
+		output = WriteLength(output, literalLength - 15);
+
+	if (literalLength > 0)
+		memcpy(output, source + anchor, literalLength);
+	output += literalLength;
+
+	return static_cast<size_t>(output - destination);
+}
+
+bool Lz4::Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t size)
+{
+	const uint8_t* input = source;
+	const uint8_t* inputEnd = source + sourceSize;
+	uint8_t* output = destination;
+	uint8_t* outputEnd = destination + size;
+
+	// Lengths continued in bytes of 255
+	auto readLength = [&input, inputEnd](size_t& length)
+	{
+		uint8_t value;
+		do
+		{
+			if (input == inputEnd)
+				return false;
+
+			value = *input++;
+			length += value;
+		} while (value == 255);
+
+		return true;
+	};
+
+	while (input < inputEnd)
+	{
+		uint8_t token = *input++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLength(literalLength))
+			return false;
+
+		if (literalLength > static_cast<size_t>(inputEnd - input) || literalLength > static_cast<size_t>(outputEnd - output))
+			return false;
+
+		if (literalLength > 0)
+			memcpy(output, input, literalLength);
+		input += literalLength;
+		output += literalLength;
+
+		// The last sequence has no match
+		if (input == inputEnd)
+			break;
+
+		if (inputEnd - input < 2)
+			return false;
+
+		size_t offset = input[0] | size_t(input[1]) << 8;
+		input += 2;
+
+		if (offset == 0 || offset > static_cast<size_t>(output - destination))
+			return false;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLength(matchLength))
+			return false;
+
+		matchLength += minMatch;
+		if (matchLength > static_cast<size_t>(outputEnd - output))
+			return false;
+
+		// Overlapping copies repeat the last offset bytes
+		const uint8_t* match = output - offset;
+		if (offset >= matchLength)
+		{
+			memcpy(output, match, matchLength);
+			output += matchLength;
+		}
+		else
+		{
+			for (size_t i = 0; i < matchLength; ++i)
+				*output++ = *match++;
+		}
+	}
+
+	return output == outputEnd;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// LZ4 block format, greedy matching on a 64K entries hash table.
+// Decodes at memory speed, the archive stores the entries it shrinks with it
+class Lz4
+{
+public:
+	Lz4() = delete;
+	~Lz4() = delete;
+
+	// Room needed by Compress for size bytes that don't compress at all
+	static size_t GetMaxCompressedSize(size_t size);
+
+	// Returns the compressed size, 0 when it doesn't fit in capacity
+	static size_t Compress(const uint8_t* source, size_t size, uint8_t* destination, size_t capacity);
+
+	// The block must decode to exactly size bytes, false for corrupted data
+	static bool Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t size);
+
+private:
+	static const size_t minMatch = 4;
+	static const size_t lastLiterals = 5;	// The block ends with literals
+	static const size_t matchSafety = 12;	// No match starts in the last bytes
+	static const size_t maxOffset = 65535;
+	static const uint32_t hashBits = 16;
+
+	static uint32_t Hash(uint32_t sequence) { return (sequence * 2654435761u) >> (32 - hashBits); }
+
+	// Token nibble 15 continues in bytes of 255
+	static uint8_t* WriteLength(uint8_t* output, size_t length);
+};
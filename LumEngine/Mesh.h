@@ -2,38 +2,69 @@
 
 #include <glm/glm.hpp>
 #include "MeshBuffer.h"
+#include "MeshCache.h"
 #include "LeMaterial.h"
+#include "Animation.h"
 
-struct UniformNodeVertexBuffer
-{
-	glm::mat4 model;
-};
+#include <memory>
 
 class Mesh
 {
 public:
-	Mesh() = default;
-	~Mesh() = default;
+	Mesh()
+		:data(new MeshData())
+	{
+	}
+
+	// Takes ownership of one reference on the shared geometry
+	Mesh(MeshData* sharedData)
+		:data(sharedData)
+	{
+	}
+
+	~Mesh()
+	{
+		MeshCache::Release(data);
+	}
+
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
 
 	std::string name = "";
 
+	// Per mesh because it holds the material textures
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
 	MeshBuffer* AddMeshBuffer()
 	{
-		buffers.push_back(MeshBuffer());
-		return &buffers[buffers.size() - 1];
+		data->buffers.push_back(MeshBuffer());
+		return &data->buffers[data->buffers.size() - 1];
 	}
-	
+
+	// A mesh still loading has no geometry and draws nothing
 	size_t GetMeshBufferCount()
 	{
-		return buffers.size();
+		return data ? data->buffers.size() : 0;
 	}
 
 	MeshBuffer* GetMeshBuffer(unsigned i)
 	{
-		if (i >= buffers.size())
+		if (!data || i >= data->buffers.size())
 			return nullptr;
 
-		return &buffers[i];
+		return &data->buffers[i];
+	}
+
+	MeshData* GetMeshData()
+	{
+		return data;
+	}
+
+	// Takes ownership of one reference on the shared geometry, the previous one is released
+	void SetMeshData(MeshData* sharedData)
+	{
+		MeshCache::Release(data);
+		data = sharedData;
 	}
 
 	LeMaterial* GetMaterial()
@@ -47,7 +78,24 @@ public:
 	}
 
 private:
-	std::vector<MeshBuffer> buffers;
-	LeMaterial* material;
+	MeshData* data = nullptr;
+	LeMaterial* material = nullptr;
 };
 
+// One mesh reference of an imported model, transform is relative to the model root
+struct ModelNode
+{
+	Mesh*		mesh;
+	glm::mat4	transform;
+
+	// Skeleton joint of the node, rigid nodes follow it when the model is animated
+	int32_t		joint = -1;
+};
+
+struct Model
+{
+	std::vector<ModelNode> nodes;
+
+	// Null when the asset has neither bones nor animations
+	std::shared_ptr<AnimationSet> animations;
+};
@@ -4,6 +4,8 @@
 #include <volk.h>
 
 #include <vector>
+#include <cstring>
+#include <cmath>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -13,6 +15,7 @@
 
 #include "BufferHandle.h"
 #include "Texture.h"
+#include "Meshlet.h"
 
 struct Vertex
 {
@@ -22,6 +25,21 @@ struct Vertex
 	glm::vec3 normal;
 };
 
+// Vertex without its position, uploaded as a separate stream so depth only passes fetch positions alone
+struct VertexAttributes
+{
+	glm::vec2 uv;
+	glm::vec3 color;
+	glm::vec3 normal;
+};
+
+// Four joint influences of a skinned vertex, weights sum to one
+struct VertexSkin
+{
+	uint16_t joints[4];
+	float weights[4];
+};
+
 class MeshBuffer
 {
 public:
@@ -30,11 +48,86 @@ public:
 
 	std::vector<Vertex> vertices;
 	std::vector<uint16_t> indices;
+	std::vector<Meshlet> meshlets;
+	std::vector<VertexSkin> skin;
+
+	// Streams mapped from a .lmesh file, used instead of the vectors when set
+	const glm::vec3* mappedPositions = nullptr;
+	const VertexAttributes* mappedAttributes = nullptr;
+	const uint16_t* mappedIndices = nullptr;
+	const VertexSkin* mappedSkin = nullptr;
+	uint32_t mappedVertexCount = 0;
+	uint32_t mappedIndexCount = 0;
+
+	const uint16_t* GetIndexData() const { return mappedIndices ? mappedIndices : indices.data(); }
+	const VertexSkin* GetSkinData() const { return mappedSkin ? mappedSkin : (skin.empty() ? nullptr : skin.data()); }
+	bool IsSkinned() const { return GetSkinData() != nullptr; }
+	size_t GetVertexCount() const { return mappedPositions ? mappedVertexCount : vertices.size(); }
+	size_t GetIndexCount() const { return mappedIndices ? mappedIndexCount : indices.size(); }
+
+	// Splits the vertices into a packed position stream and an attribute stream
+	void WriteVertexStreams(glm::vec3* positions, VertexAttributes* attributes) const
+	{
+		if (mappedPositions)
+		{
+			memcpy(positions, mappedPositions, sizeof(glm::vec3) * mappedVertexCount);
+			memcpy(attributes, mappedAttributes, sizeof(VertexAttributes) * mappedVertexCount);
+			return;
+		}
+
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			positions[i] = vertices[i].pos;
+			attributes[i] = { vertices[i].uv, vertices[i].color, vertices[i].normal };
+		}
+	}
+
+	// Bounding sphere of the whole buffer (object space), a negative radius means unknown
+	glm::vec3 boundsCenter = glm::vec3(0.f);
+	float boundsRadius = -1.f;
+
+	// Bounding box of the vertices (object space), empty means unknown
+	LeAabb bounds;
+
+	// UV distance per object space unit, drives the mip levels the TextureStreamer keeps resident
+	float uvDensity = 0.f;
+
+	// Square root of the UV area over the surface area of the triangles
+	float ComputeUvDensity() const
+	{
+		const uint16_t* indexData = GetIndexData();
+		double surfaceArea = 0.0;
+		double uvArea = 0.0;
+
+		for (size_t i = 0; i + 2 < GetIndexCount(); i += 3)
+		{
+			glm::vec3 p[3];
+			glm::vec2 uv[3];
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				uint16_t index = indexData[i + corner];
+				p[corner] = mappedPositions ? mappedPositions[index] : vertices[index].pos;
+				uv[corner] = mappedPositions ? mappedAttributes[index].uv : vertices[index].uv;
+			}
+
+			surfaceArea += glm::length(glm::cross(p[1] - p[0], p[2] - p[0]));
+			glm::vec2 e0 = uv[1] - uv[0];
+			glm::vec2 e1 = uv[2] - uv[0];
+			uvArea += std::abs(e0.x * e1.y - e0.y * e1.x);
+		}
+
+		return surfaceArea > 0.0 ? static_cast<float>(std::sqrt(uvArea / surfaceArea)) : 0.f;
+	}
 
+	// Position stream then attribute stream, attributesOffset is where the second one starts
 	BufferHandle vertexBuffer;
+	VkDeviceSize attributesOffset = 0;
 	BufferHandle indexBuffer;
+	BufferHandle skinBuffer;
 
-	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	// Skinned copies point into a shared per frame buffer, their streams start at vertexOffset + vertexFrameStride * frame
+	VkDeviceSize vertexOffset = 0;
+	VkDeviceSize vertexFrameStride = 0;
 
 private:
 
@@ -0,0 +1,193 @@
+#include "MeshCache.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+std::unordered_map<std::string, MeshData*> MeshCache::entries;
+std::unordered_map<std::string, std::shared_future<MeshData*>> MeshCache::pendingImports;
+std::mutex MeshCache::mutex;
+
+MeshData::~MeshData()
+{
+	for (MeshBuffer& buffer : buffers)
+	{
+		buffer.vertexBuffer.Clear();
+		buffer.indexBuffer.Clear();
+		buffer.skinBuffer.Clear();
+	}
+}
+
+std::string MeshCache::MakeKey(const std::string& path)
+{
+	std::string key = path;
+	std::replace(key.begin(), key.end(), '\\', '/');
+	std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return key;
+}
+
+MeshData* MeshCache::Acquire(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto it = entries.find(MakeKey(path));
+	if (it == entries.end())
+		return nullptr;
+
+	++it->second->refCount;
+	return it->second;
+}
+
+MeshData* MeshCache::Insert(const std::string& path, MeshData* data)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	data->key = MakeKey(path);
+	data->refCount = 1;
+	entries[data->key] = data;
+	return data;
+}
+
+MeshData* MeshCache::Load(const std::string& path, const std::function<MeshData*()>& import)
+{
+	std::string key = MakeKey(path);
+	std::promise<MeshData*> importPromise;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		auto it = entries.find(key);
+		if (it != entries.end())
+		{
+			++it->second->refCount;
+			return it->second;
+		}
+
+		auto pending = pendingImports.find(key);
+		if (pending != pendingImports.end())
+		{
+			std::shared_future<MeshData*> result = pending->second;
+			lock.unlock();
+
+			ThreadPool::Get().Wait(result);
+
+			// Still missing when the import failed
+			return Acquire(path);
+		}
+
+		pendingImports[key] = importPromise.get_future().share();
+	}
+
+	MeshData* data = nullptr;
+	try
+	{
+		// A duplicate import of the key must not run on this thread while it imports
+		ThreadPool::OwnerScope owner;
+		data = import();
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingImports.erase(key);
+		importPromise.set_value(nullptr);
+		throw;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (data)
+	{
+		data->key = key;
+		data->refCount = 1;
+		entries[key] = data;
+	}
+
+	pendingImports.erase(key);
+	importPromise.set_value(data);
+
+	return data;
+}
+
+void MeshCache::Release(MeshData* data)
+{
+	if (data == nullptr)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (--data->refCount > 0)
+			return;
+
+		auto it = entries.find(data->key);
+		if (it != entries.end() && it->second == data)
+			entries.erase(it);
+	}
+
+	delete data;
+}
+
+size_t MeshCache::GetEntryCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.size();
+}
+
+std::vector<MeshData*> MeshCache::AcquireFromSource(const std::string& path)
+{
+	std::string key = MakeKey(path);
+	std::vector<MeshData*> sourceData;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (auto& entry : entries)
+	{
+		const std::string& entryKey = entry.first;
+		if (entryKey == key || (entryKey.size() > key.size() && entryKey.compare(0, key.size(), key) == 0 && entryKey[key.size()] == '#'))
+		{
+			++entry.second->refCount;
+			sourceData.push_back(entry.second);
+		}
+	}
+
+	return sourceData;
+}
+
+int MeshCache::GetPartIndex(const MeshData* data)
+{
+	size_t separator = data->key.rfind('#');
+	if (separator == std::string::npos)
+		return -1;
+
+	return std::atoi(data->key.c_str() + separator + 1);
+}
+
+void MeshCache::Replace(MeshData* data, MeshData* reloaded)
+{
+	for (MeshBuffer& buffer : data->buffers)
+	{
+		buffer.vertexBuffer.Clear();
+		buffer.indexBuffer.Clear();
+		buffer.skinBuffer.Clear();
+	}
+
+	// Same count, the MeshBuffer pointers held by the draw batches stay valid
+	if (data->buffers.size() == reloaded->buffers.size())
+	{
+		for (size_t i = 0; i < data->buffers.size(); ++i)
+			data->buffers[i] = std::move(reloaded->buffers[i]);
+	}
+	else
+	{
+		data->buffers = std::move(reloaded->buffers);
+	}
+
+	data->texturePath = reloaded->texturePath;
+	data->normalMapPath = reloaded->normalMapPath;
+	data->specularMapPath = reloaded->specularMapPath;
+	data->color = reloaded->color;
+	data->file = reloaded->file;
+
+	reloaded->buffers.clear();
+	delete reloaded;
+}
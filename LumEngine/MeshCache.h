@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <functional>
+#include <future>
+#include <mutex>
+
+#include <memory>
+
+#include "MeshBuffer.h"
+#include "VirtualFileSystem.h"
+
+// Geometry shared between every Mesh loaded from the same file
+struct MeshData
+{
+	MeshData() = default;
+	~MeshData();
+
+	MeshData(const MeshData&) = delete;
+	MeshData& operator=(const MeshData&) = delete;
+
+	std::string key = "";
+	std::vector<MeshBuffer> buffers;
+
+	// Material textures found by the importer, applied to every new Mesh
+	std::string texturePath = "";
+	std::string normalMapPath = "";
+	std::string specularMapPath = "";
+	glm::vec4 color = glm::vec4(1.f);
+
+	// Keeps the .lmesh streams referenced by the buffers alive
+	std::shared_ptr<const FileData> file;
+
+	int refCount = 1;
+};
+
+// Thread safe, meshes can be loaded from several threads at once
+class MeshCache
+{
+public:
+	MeshCache() = delete;
+	~MeshCache() = delete;
+
+	// Returns the cached geometry with one more reference, or nullptr
+	static MeshData* Acquire(const std::string& path);
+
+	// Registers freshly imported geometry, the caller owns the first reference
+	static MeshData* Insert(const std::string& path, MeshData* data);
+
+	// Returns the cached geometry with one more reference or registers the result of import.
+	// Concurrent loads of the same path wait for the first import instead of running their own.
+	static MeshData* Load(const std::string& path, const std::function<MeshData*()>& import);
+
+	// Drops a reference, geometry and GPU buffers are destroyed with the last one
+	static void Release(MeshData* data);
+
+	static size_t GetEntryCount();
+
+	// Every cached geometry imported from path, the whole file or its "path#part" model parts, each with one more reference
+	static std::vector<MeshData*> AcquireFromSource(const std::string& path);
+
+	// Part index of a "path#part" model key, -1 for a whole file
+	static int GetPartIndex(const MeshData* data);
+
+	// Moves the geometry of reloaded into data and deletes it. The GPU buffers of data are destroyed,
+	// the caller uploads the new ones once no frame uses the old ones anymore
+	static void Replace(MeshData* data, MeshData* reloaded);
+
+private:
+	static std::string MakeKey(const std::string& path);
+
+	static std::unordered_map<std::string, MeshData*> entries;
+	static std::unordered_map<std::string, std::shared_future<MeshData*>> pendingImports;
+	static std::mutex mutex;
+};
@@ -0,0 +1,327 @@
+#include "MeshFile.h"
+#include "VirtualFileSystem.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	const uint64_t streamAlignment = 16;
+
+	uint64_t AlignOffset(uint64_t offset)
+	{
+		return (offset + streamAlignment - 1) / streamAlignment * streamAlignment;
+	}
+
+	bool IsRangeValid(uint64_t offset, uint64_t size, size_t fileSize)
+	{
+		return offset <= fileSize && size <= fileSize - offset;
+	}
+}
+
+std::mutex MeshFile::fileMutex;
+
+std::string MeshFile::GetCachePath(const std::string& sourcePath, bool hierarchy)
+{
+	return sourcePath + (hierarchy ? ".model.lmesh" : ".lmesh");
+}
+
+bool MeshFile::GetSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time)
+{
+	return VirtualFileSystem::GetStamp(sourcePath, size, time);
+}
+
+void MeshFile::CopyString(char* destination, size_t destinationSize, const std::string& source)
+{
+	memset(destination, 0, destinationSize);
+	memcpy(destination, source.c_str(), std::min(source.size(), destinationSize - 1));
+}
+
+bool MeshFile::Read(const std::string& path, const std::string& sourcePath, std::vector<MeshData*>& parts, std::vector<MeshFileNode>& nodes, std::shared_ptr<AnimationSet>& animations)
+{
+	std::lock_guard<std::mutex> lock(fileMutex);
+
+	uint64_t sourceSize = 0;
+	int64_t sourceTime = 0;
+	if (!GetSourceStamp(sourcePath, sourceSize, sourceTime))
+		return false;
+
+	std::shared_ptr<const FileData> file = VirtualFileSystem::Open(path);
+	if (!file || file->GetSize() < sizeof(Header))
+		return false;
+
+	const uint8_t* data = file->GetData();
+	const size_t fileSize = file->GetSize();
+	const Header* header = reinterpret_cast<const Header*>(data);
+
+	if (header->magic != magic || header->version != version
+		|| header->attributeStride != sizeof(VertexAttributes) || header->meshletStride != sizeof(Meshlet)
+		|| header->sourceSize != sourceSize || header->sourceTime != sourceTime)
+		return false;
+
+	if (!IsRangeValid(header->partsOffset, sizeof(Part) * uint64_t(header->partCount), fileSize)
+		|| !IsRangeValid(header->buffersOffset, sizeof(Buffer) * uint64_t(header->bufferCount), fileSize)
+		|| !IsRangeValid(header->nodesOffset, sizeof(Node) * uint64_t(header->nodeCount), fileSize)
+		|| !IsRangeValid(header->animationOffset, header->animationSize, fileSize))
+		return false;
+
+	std::shared_ptr<AnimationSet> fileAnimations;
+	if (header->animationSize > 0)
+	{
+		fileAnimations = std::make_shared<AnimationSet>();
+		if (!fileAnimations->Deserialize(data + header->animationOffset, static_cast<size_t>(header->animationSize)))
+			return false;
+	}
+
+	const size_t jointCount = fileAnimations ? fileAnimations->skeleton.GetJointCount() : 0;
+
+	const Part* fileParts = reinterpret_cast<const Part*>(data + header->partsOffset);
+	const Buffer* fileBuffers = reinterpret_cast<const Buffer*>(data + header->buffersOffset);
+	const Node* fileNodes = reinterpret_cast<const Node*>(data + header->nodesOffset);
+
+	for (uint32_t i = 0; i < header->bufferCount; ++i)
+	{
+		const Buffer& fileBuffer = fileBuffers[i];
+		if (!IsRangeValid(fileBuffer.positionOffset, sizeof(glm::vec3) * uint64_t(fileBuffer.vertexCount), fileSize)
+			|| !IsRangeValid(fileBuffer.attributeOffset, sizeof(VertexAttributes) * uint64_t(fileBuffer.vertexCount), fileSize)
+			|| !IsRangeValid(fileBuffer.indexOffset, sizeof(uint16_t) * uint64_t(fileBuffer.indexCount), fileSize)
+			|| !IsRangeValid(fileBuffer.meshletOffset, sizeof(Meshlet) * uint64_t(fileBuffer.meshletCount), fileSize))
+			return false;
+
+		if (fileBuffer.skinned)
+		{
+			if (!IsRangeValid(fileBuffer.skinOffset, sizeof(VertexSkin) * uint64_t(fileBuffer.vertexCount), fileSize))
+				return false;
+
+			// Joints index the skinning palette on the GPU, they are checked once here
+			const VertexSkin* skin = reinterpret_cast<const VertexSkin*>(data + fileBuffer.skinOffset);
+			for (uint32_t j = 0; j < fileBuffer.vertexCount; ++j)
+			{
+				for (int k = 0; k < 4; ++k)
+				{
+					if (skin[j].joints[k] >= jointCount)
+						return false;
+				}
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < header->partCount; ++i)
+	{
+		if (uint64_t(fileParts[i].firstBuffer) + fileParts[i].bufferCount > header->bufferCount)
+			return false;
+	}
+
+	for (uint32_t i = 0; i < header->nodeCount; ++i)
+	{
+		if (fileNodes[i].part >= header->partCount || fileNodes[i].joint < -1 || fileNodes[i].joint >= int64_t(jointCount))
+			return false;
+	}
+
+	for (uint32_t i = 0; i < header->partCount; ++i)
+	{
+		const Part& filePart = fileParts[i];
+
+		MeshData* part = new MeshData();
+		part->file = file;
+		part->texturePath = std::string(filePart.texturePath, strnlen(filePart.texturePath, sizeof(filePart.texturePath)));
+		part->normalMapPath = std::string(filePart.normalMapPath, strnlen(filePart.normalMapPath, sizeof(filePart.normalMapPath)));
+		part->specularMapPath = std::string(filePart.specularMapPath, strnlen(filePart.specularMapPath, sizeof(filePart.specularMapPath)));
+		part->color = glm::make_vec4(filePart.color);
+		part->buffers.resize(filePart.bufferCount);
+
+		for (uint32_t j = 0; j < filePart.bufferCount; ++j)
+		{
+			const Buffer& fileBuffer = fileBuffers[filePart.firstBuffer + j];
+			MeshBuffer& buffer = part->buffers[j];
+
+			buffer.mappedPositions = reinterpret_cast<const glm::vec3*>(data + fileBuffer.positionOffset);
+			buffer.mappedAttributes = reinterpret_cast<const VertexAttributes*>(data + fileBuffer.attributeOffset);
+			buffer.mappedIndices = reinterpret_cast<const uint16_t*>(data + fileBuffer.indexOffset);
+			buffer.mappedSkin = fileBuffer.skinned ? reinterpret_cast<const VertexSkin*>(data + fileBuffer.skinOffset) : nullptr;
+			buffer.mappedVertexCount = fileBuffer.vertexCount;
+			buffer.mappedIndexCount = fileBuffer.indexCount;
+
+			// Meshlets are culled on the CPU every frame, they are small enough to be copied
+			const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(data + fileBuffer.meshletOffset);
+			buffer.meshlets.assign(meshlets, meshlets + fileBuffer.meshletCount);
+
+			buffer.boundsCenter = glm::make_vec3(fileBuffer.boundsCenter);
+			buffer.boundsRadius = fileBuffer.boundsRadius;
+			buffer.bounds.min = glm::make_vec3(fileBuffer.boundsMin);
+			buffer.bounds.max = glm::make_vec3(fileBuffer.boundsMax);
+		}
+
+		parts.push_back(part);
+	}
+
+	for (uint32_t i = 0; i < header->nodeCount; ++i)
+	{
+		const Node& fileNode = fileNodes[i];
+		nodes.push_back({ glm::make_mat4(fileNode.transform), fileNode.part, std::string(fileNode.name, strnlen(fileNode.name, sizeof(fileNode.name))), fileNode.joint });
+	}
+
+	animations = fileAnimations;
+
+	return true;
+}
+
+bool MeshFile::Write(const std::string& path, const std::string& sourcePath, const std::vector<MeshData*>& parts, const std::vector<MeshFileNode>& nodes, const AnimationSet* animations)
+{
+	std::lock_guard<std::mutex> lock(fileMutex);
+
+	Header header = {};
+	header.magic = magic;
+	header.version = version;
+	header.attributeStride = sizeof(VertexAttributes);
+	header.meshletStride = sizeof(Meshlet);
+
+	if (!GetSourceStamp(sourcePath, header.sourceSize, header.sourceTime))
+		return false;
+
+	std::vector<Part> fileParts(parts.size());
+	std::vector<Buffer> fileBuffers;
+	std::vector<Node> fileNodes(nodes.size());
+
+	for (size_t i = 0; i < parts.size(); ++i)
+	{
+		const MeshData* part = parts[i];
+		Part& filePart = fileParts[i];
+
+		memset(&filePart, 0, sizeof(Part));
+		CopyString(filePart.texturePath, sizeof(filePart.texturePath), part->texturePath);
+		CopyString(filePart.normalMapPath, sizeof(filePart.normalMapPath), part->normalMapPath);
+		CopyString(filePart.specularMapPath, sizeof(filePart.specularMapPath), part->specularMapPath);
+		memcpy(filePart.color, glm::value_ptr(part->color), sizeof(filePart.color));
+		filePart.firstBuffer = static_cast<uint32_t>(fileBuffers.size());
+		filePart.bufferCount = static_cast<uint32_t>(part->buffers.size());
+
+		for (const MeshBuffer& buffer : part->buffers)
+		{
+			Buffer fileBuffer = {};
+			fileBuffer.vertexCount = static_cast<uint32_t>(buffer.GetVertexCount());
+			fileBuffer.indexCount = static_cast<uint32_t>(buffer.GetIndexCount());
+			fileBuffer.meshletCount = static_cast<uint32_t>(buffer.meshlets.size());
+			fileBuffer.lodCount = 1;
+			fileBuffer.lods[0] = { 0, fileBuffer.indexCount };
+			memcpy(fileBuffer.boundsCenter, glm::value_ptr(buffer.boundsCenter), sizeof(fileBuffer.boundsCenter));
+			fileBuffer.boundsRadius = buffer.boundsRadius;
+			memcpy(fileBuffer.boundsMin, glm::value_ptr(buffer.bounds.min), sizeof(fileBuffer.boundsMin));
+			memcpy(fileBuffer.boundsMax, glm::value_ptr(buffer.bounds.max), sizeof(fileBuffer.boundsMax));
+			fileBuffer.skinned = buffer.IsSkinned() ? 1 : 0;
+			fileBuffers.push_back(fileBuffer);
+		}
+	}
+
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		Node& fileNode = fileNodes[i];
+		memset(&fileNode, 0, sizeof(Node));
+		memcpy(fileNode.transform, glm::value_ptr(nodes[i].transform), sizeof(fileNode.transform));
+		fileNode.part = nodes[i].part;
+		fileNode.joint = nodes[i].joint;
+		CopyString(fileNode.name, sizeof(fileNode.name), nodes[i].name);
+	}
+
+	header.partCount = static_cast<uint32_t>(fileParts.size());
+	header.bufferCount = static_cast<uint32_t>(fileBuffers.size());
+	header.nodeCount = static_cast<uint32_t>(fileNodes.size());
+
+	// Layout : header, tables, then every stream aligned
+	header.partsOffset = AlignOffset(sizeof(Header));
+	header.buffersOffset = AlignOffset(header.partsOffset + sizeof(Part) * fileParts.size());
+	header.nodesOffset = AlignOffset(header.buffersOffset + sizeof(Buffer) * fileBuffers.size());
+
+	std::vector<uint8_t> animationData;
+	if (animations)
+		animations->Serialize(animationData);
+
+	header.animationOffset = AlignOffset(header.nodesOffset + sizeof(Node) * fileNodes.size());
+	header.animationSize = animationData.size();
+
+	uint64_t offset = AlignOffset(header.animationOffset + header.animationSize);
+	for (Buffer& fileBuffer : fileBuffers)
+	{
+		fileBuffer.positionOffset = offset;
+		offset = AlignOffset(offset + sizeof(glm::vec3) * uint64_t(fileBuffer.vertexCount));
+		fileBuffer.attributeOffset = offset;
+		offset = AlignOffset(offset + sizeof(VertexAttributes) * uint64_t(fileBuffer.vertexCount));
+		fileBuffer.indexOffset = offset;
+		offset = AlignOffset(offset + sizeof(uint16_t) * uint64_t(fileBuffer.indexCount));
+		fileBuffer.meshletOffset = offset;
+		offset = AlignOffset(offset + sizeof(Meshlet) * uint64_t(fileBuffer.meshletCount));
+
+		if (fileBuffer.skinned)
+		{
+			fileBuffer.skinOffset = offset;
+			offset = AlignOffset(offset + sizeof(VertexSkin) * uint64_t(fileBuffer.vertexCount));
+		}
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	auto writeAt = [&file](uint64_t offset, const void* data, size_t size)
+	{
+		static const char zeros[streamAlignment] = {};
+		uint64_t position = static_cast<uint64_t>(file.tellp());
+		if (position < offset)
+			file.write(zeros, static_cast<std::streamsize>(offset - position));
+
+		if (size > 0)
+			file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+	};
+
+	writeAt(0, &header, sizeof(Header));
+	writeAt(header.partsOffset, fileParts.data(), sizeof(Part) * fileParts.size());
+	writeAt(header.buffersOffset, fileBuffers.data(), sizeof(Buffer) * fileBuffers.size());
+	writeAt(header.nodesOffset, fileNodes.data(), sizeof(Node) * fileNodes.size());
+	writeAt(header.animationOffset, animationData.data(), animationData.size());
+
+	std::vector<glm::vec3> positions;
+	std::vector<VertexAttributes> attributes;
+
+	size_t bufferIndex = 0;
+	for (const MeshData* part : parts)
+	{
+		for (const MeshBuffer& buffer : part->buffers)
+		{
+			const Buffer& fileBuffer = fileBuffers[bufferIndex++];
+
+			positions.resize(fileBuffer.vertexCount);
+			attributes.resize(fileBuffer.vertexCount);
+			buffer.WriteVertexStreams(positions.data(), attributes.data());
+
+			writeAt(fileBuffer.positionOffset, positions.data(), sizeof(glm::vec3) * fileBuffer.vertexCount);
+			writeAt(fileBuffer.attributeOffset, attributes.data(), sizeof(VertexAttributes) * fileBuffer.vertexCount);
+			writeAt(fileBuffer.indexOffset, buffer.GetIndexData(), sizeof(uint16_t) * fileBuffer.indexCount);
+			writeAt(fileBuffer.meshletOffset, buffer.meshlets.data(), sizeof(Meshlet) * fileBuffer.meshletCount);
+
+			if (fileBuffer.skinned)
+				writeAt(fileBuffer.skinOffset, buffer.GetSkinData(), sizeof(VertexSkin) * fileBuffer.vertexCount);
+		}
+	}
+
+	writeAt(offset, nullptr, 0);
+
+	return file.good();
+}
+
+bool MeshFile::Restamp(const std::string& path, const std::string& sourcePath)
+{
+	std::lock_guard<std::mutex> lock(fileMutex);
+
+	Header header;
+	std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+	if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(Header)) || header.magic != magic || header.version != version)
+		return false;
+
+	if (!GetSourceStamp(sourcePath, header.sourceSize, header.sourceTime))
+		return false;
+
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	return file.good();
+}
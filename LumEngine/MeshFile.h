@@ -0,0 +1,117 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <mutex>
+
+#include "MeshCache.h"
+#include "Animation.h"
+
+// Node of an imported hierarchy stored in a .lmesh file
+struct MeshFileNode
+{
+	glm::mat4	transform;
+	uint32_t	part;
+	std::string	name;
+	int32_t		joint = -1;
+};
+
+// Engine native mesh container (.lmesh), written next to the source asset on first import.
+// Streams are stored in the position / VertexAttributes / uint16_t layout used for upload,
+// 16 bytes aligned, so a loaded MeshData points straight into the mapped file.
+// Skinned models also store their VertexSkin streams and a serialized AnimationSet.
+// Reads and writes are serialized so a file being written by one import is never mapped by another.
+class MeshFile
+{
+public:
+	MeshFile() = delete;
+	~MeshFile() = delete;
+
+	static const uint32_t magic = 0x48534D4C; // "LMSH"
+	static const uint32_t version = 4;
+	static const uint32_t maxLods = 4;
+
+	// Cache file of a source asset, models keeping their hierarchy use their own file
+	static std::string GetCachePath(const std::string& sourcePath, bool hierarchy);
+
+	// Fails when the file is missing, from another version or older than the source asset
+	static bool Read(const std::string& path, const std::string& sourcePath, std::vector<MeshData*>& parts, std::vector<MeshFileNode>& nodes, std::shared_ptr<AnimationSet>& animations);
+
+	static bool Write(const std::string& path, const std::string& sourcePath, const std::vector<MeshData*>& parts, const std::vector<MeshFileNode>& nodes, const AnimationSet* animations);
+
+	// Stamps the file with the current size and date of its source, for a source touched without any change
+	static bool Restamp(const std::string& path, const std::string& sourcePath);
+
+private:
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t attributeStride;
+		uint32_t meshletStride;
+		uint64_t sourceSize;
+		int64_t	 sourceTime;
+		uint32_t partCount;
+		uint32_t bufferCount;
+		uint32_t nodeCount;
+		uint32_t padding;
+		uint64_t partsOffset;
+		uint64_t buffersOffset;
+		uint64_t nodesOffset;
+		uint64_t animationOffset;
+		uint64_t animationSize;
+	};
+
+	struct Part
+	{
+		char		texturePath[256];
+		char		normalMapPath[256];
+		char		specularMapPath[256];
+		float		color[4];
+		uint32_t	firstBuffer;
+		uint32_t	bufferCount;
+		uint32_t	padding[2];
+	};
+
+	// Index range of one level of detail, LOD 0 is the whole index stream
+	struct Lod
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	struct Buffer
+	{
+		uint64_t	positionOffset;
+		uint64_t	attributeOffset;
+		uint64_t	indexOffset;
+		uint64_t	meshletOffset;
+		uint64_t	skinOffset;
+		uint32_t	vertexCount;
+		uint32_t	indexCount;
+		uint32_t	meshletCount;
+		uint32_t	lodCount;
+		Lod			lods[maxLods];
+		float		boundsCenter[3];
+		float		boundsRadius;
+		float		boundsMin[3];
+		float		boundsMax[3];
+		uint32_t	skinned;
+		uint32_t	padding;
+	};
+
+	struct Node
+	{
+		float		transform[16];
+		uint32_t	part;
+		int32_t		joint;
+		uint32_t	padding[2];
+		char		name[64];
+	};
+
+	static bool GetSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time);
+	static void CopyString(char* destination, size_t destinationSize, const std::string& source);
+
+	static std::mutex fileMutex;
+};
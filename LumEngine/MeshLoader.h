@@ -6,7 +6,18 @@
 #include "Mesh.h"
 #include <iostream>
 #include "MeshBuffer.h"
+#include "MeshCache.h"
+#include "MeshFile.h"
+#include "Animation.h"
+#include "ThreadPool.h"
+#include "TextureCache.h"
+#include "AssimpFileSystem.h"
 #include <regex>
+#include <future>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
 
 const std::vector<Vertex> cubeVertex =
 {
@@ -57,6 +68,10 @@ public:
 	MeshLoader() = delete;
 	~MeshLoader() = delete;
 
+	// Assimp post processes of the meshes and of the models keeping their hierarchy, the cooker rebuilds their .lmesh files when they change
+	static const unsigned int meshImportFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals /*| aiProcess_FlipUVs*/ | aiProcess_PreTransformVertices;
+	static const unsigned int modelImportFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_LimitBoneWeights;
+
 	static std::vector<std::string> split(const std::string& input, const std::string& regex) 
 	{
 		// passing -1 as the submatch index parameter performs splitting
@@ -67,157 +82,692 @@ public:
 	}
 
 	static Mesh* LoadMesh(std::string filename)
+	{
+		MeshData* data = MeshCache::Load(filename, [&filename]() { return LoadMeshData(filename); });
+
+		if (!data)
+			return nullptr;
+
+		Mesh* mesh = new Mesh(data);
+		mesh->CreateMaterial();
+		std::vector<std::string> splitFileName = split(filename, "/");
+		mesh->name = splitFileName[splitFileName.size()-1];
+
+		CreateMaterialTextures(mesh);
+
+		return mesh;
+	}
+
+	// Parsing and texture decoding run on the ThreadPool, GPU resources are still created by the driver on the render thread
+	static std::future<Mesh*> LoadMeshAsync(std::string filename)
+	{
+		return ThreadPool::Get().Submit([filename]() { return LoadMesh(filename); });
+	}
+
+	static std::future<Model> LoadModelAsync(std::string filename)
+	{
+		return ThreadPool::Get().Submit([filename]() { return LoadModel(filename); });
+	}
+
+	// Imports the source again for a hot reload, a single MeshData or one per part of a model in their "filename#part" order.
+	// The .lmesh file is left as is while the cached geometry still maps it, the next launch writes it again
+	static std::future<std::vector<MeshData*>> ReimportAsync(std::string filename, bool model)
+	{
+		return ThreadPool::Get().Submit([filename, model]()
+		{
+			std::vector<MeshData*> parts;
+			if (!model)
+			{
+				if (MeshData* data = ImportMeshData(filename))
+					parts.push_back(data);
+				return parts;
+			}
+
+			std::vector<MeshFileNode> nodes;
+			std::shared_ptr<AnimationSet> animations;
+			ImportModelData(filename, parts, nodes, animations);
+			return parts;
+		});
+	}
+
+	static MeshData* ImportMeshData(const std::string& filename)
 	{
 		Assimp::Importer importer;
-		const aiScene* assimpScene = importer.ReadFile(filename.c_str(), aiProcess_Triangulate | aiProcess_GenSmoothNormals /*| aiProcess_FlipUVs*/ | aiProcess_PreTransformVertices);
+		importer.SetIOHandler(new AssimpFileSystem());
+		const aiScene* assimpScene = importer.ReadFile(filename.c_str(), meshImportFlags);
 
 		if (!assimpScene)
 			return nullptr;
 
-		size_t pos = filename.find_last_of("/\\");
-		std::string folderPath = "";
-		if (pos != std::string::npos)
-			folderPath = filename.substr(0, pos);
+		std::string folderPath = GetFolderPath(filename);
 
-		if (folderPath.size() > 0)
+		MeshData* data = new MeshData();
+		data->buffers.resize(assimpScene->mNumMeshes);
+
+		for (unsigned int i = 0; i < assimpScene->mNumMeshes; ++i)
 		{
-			char lastChar = folderPath[folderPath.size() - 1];
-			if (lastChar != '/' && lastChar != '\\')
-				folderPath.push_back('/');
+			aiMesh* assimpMesh = assimpScene->mMeshes[i];
+
+			if (!ConvertMeshBuffer(assimpMesh, &data->buffers[i]))
+			{
+				delete data;
+				return nullptr;
+			}
+
+			// The mesh keeps a single material, the last assimp mesh wins
+			ReadMaterial(assimpScene->mMaterials[assimpMesh->mMaterialIndex], folderPath, data);
+		}
+
+		return data;
+	}
+
+	// Maps the .lmesh file of the asset, the source is only imported (and the file written) when it is missing or outdated
+	static MeshData* LoadMeshData(const std::string& filename)
+	{
+		std::string cachePath = MeshFile::GetCachePath(filename, false);
+
+		std::vector<MeshData*> parts;
+		std::vector<MeshFileNode> nodes;
+		std::shared_ptr<AnimationSet> animations;
+		if (MeshFile::Read(cachePath, filename, parts, nodes, animations) && parts.size() == 1)
+			return parts[0];
+
+		for (MeshData* part : parts)
+			delete part;
+
+		MeshData* data = ImportMeshData(filename);
+
+		if (data && !MeshFile::Write(cachePath, filename, { data }, {}, nullptr))
+			std::cout << "Can't write mesh file " << cachePath << std::endl;
+
+		return data;
+	}
+
+	// Imports the source and writes its .lmesh file whatever the state of the current one, for the offline cooker.
+	// The imported parts are returned with their materials, the caller deletes them
+	static bool CookMeshFile(const std::string& filename, bool hierarchy, std::vector<MeshData*>& parts)
+	{
+		std::vector<MeshFileNode> nodes;
+		std::shared_ptr<AnimationSet> animations;
+
+		if (!hierarchy)
+		{
+			if (MeshData* data = ImportMeshData(filename))
+				parts.push_back(data);
+		}
+		else if (!ImportModelData(filename, parts, nodes, animations))
+			return false;
+
+		return !parts.empty() && MeshFile::Write(MeshFile::GetCachePath(filename, hierarchy), filename, parts, nodes, animations.get());
+	}
+
+	// Keeps the assimp node hierarchy, one Mesh per referenced aiMesh with its own material.
+	// Every reference to the same aiMesh shares its geometry through the MeshCache.
+	// Bones and animations are imported into the model AnimationSet.
+	static Model LoadModel(std::string filename)
+	{
+		Model model;
+
+		std::string cachePath = MeshFile::GetCachePath(filename, true);
+
+		std::vector<MeshData*> parts;
+		std::vector<MeshFileNode> nodes;
+		if (!MeshFile::Read(cachePath, filename, parts, nodes, model.animations))
+		{
+			for (MeshData* part : parts)
+				delete part;
+
+			parts.clear();
+			nodes.clear();
+
+			if (!ImportModelData(filename, parts, nodes, model.animations))
+				return model;
+
+			if (!MeshFile::Write(cachePath, filename, parts, nodes, model.animations.get()))
+				std::cout << "Can't write mesh file " << cachePath << std::endl;
 		}
 
-		Mesh* mesh = new Mesh();
-		mesh->CreateMaterial();
 		std::vector<std::string> splitFileName = split(filename, "/");
-		mesh->name = splitFileName[splitFileName.size()-1];
+
+		for (const MeshFileNode& node : nodes)
+		{
+			std::string meshKey = filename + "#" + std::to_string(node.part);
+
+			MeshData* data = MeshCache::Load(meshKey, [&parts, &node]()
+			{
+				MeshData* part = parts[node.part];
+				parts[node.part] = nullptr;
+				return part;
+			});
+
+			Mesh* mesh = new Mesh(data);
+			mesh->CreateMaterial();
+			mesh->GetMaterial()->params.color = data->color;
+			mesh->name = splitFileName[splitFileName.size() - 1] + "/" + node.name;
+
+			CreateMaterialTextures(mesh);
+
+			model.nodes.push_back({ mesh, node.transform, node.joint });
+		}
+
+		// Parts already in the cache or never referenced by a node
+		for (MeshData* part : parts)
+			delete part;
+
+		return model;
+	}
+
+	static bool ImportModelData(const std::string& filename, std::vector<MeshData*>& parts, std::vector<MeshFileNode>& nodes, std::shared_ptr<AnimationSet>& animations)
+	{
+		Assimp::Importer importer;
+		importer.SetIOHandler(new AssimpFileSystem());
+		const aiScene* assimpScene = importer.ReadFile(filename.c_str(), modelImportFlags);
+
+		if (!assimpScene || !assimpScene->mRootNode)
+			return false;
+
+		std::string folderPath = GetFolderPath(filename);
+
+		bool hasBones = false;
+		for (unsigned int i = 0; i < assimpScene->mNumMeshes; ++i)
+			hasBones |= assimpScene->mMeshes[i]->HasBones();
+
+		// Every node becomes a joint, so rigid parts can follow the animation too
+		std::unordered_map<std::string, int32_t> joints;
+		if (hasBones || assimpScene->HasAnimations())
+		{
+			animations = std::make_shared<AnimationSet>();
+			ImportSkeleton(assimpScene, animations->skeleton, joints);
+			ImportAnimations(assimpScene, joints, animations->clips);
+		}
 
 		for (unsigned int i = 0; i < assimpScene->mNumMeshes; ++i)
 		{
 			aiMesh* assimpMesh = assimpScene->mMeshes[i];
 
-			MeshBuffer* buffer = mesh->AddMeshBuffer();
-			buffer->vertices.resize(assimpMesh->mNumVertices);
-			for (unsigned int i = 0; i < assimpMesh->mNumVertices; ++i)
+			MeshData* data = new MeshData();
+			data->buffers.resize(1);
+			parts.push_back(data);
+
+			if (!ConvertMeshBuffer(assimpMesh, &data->buffers[0]))
 			{
-				buffer->vertices[i].pos = ToVec3GLM(assimpMesh->mVertices[i]);
-				buffer->vertices[i].color = glm::vec3(1.0f, 1.0f, 1.0f);
-				buffer->vertices[i].normal = ToVec3GLM(assimpMesh->mNormals[i]);
+				for (MeshData* part : parts)
+					delete part;
 
-				if (assimpMesh->GetNumUVChannels() > 0)
-				{
-					const aiVector3D uv = assimpMesh->mTextureCoords[0][i];
-					buffer->vertices[i].uv = ToVec2GLM(uv);
-				}
+				parts.clear();
+				animations.reset();
+				return false;
+			}
+
+			if (assimpMesh->HasBones())
+				ConvertMeshSkin(assimpMesh, joints, &data->buffers[0]);
+
+			ReadMaterial(assimpScene->mMaterials[assimpMesh->mMaterialIndex], folderPath, data);
+		}
+
+		// Depth first walk, the transforms are accumulated from the root
+		std::vector<std::pair<const aiNode*, glm::mat4>> stack = { { assimpScene->mRootNode, glm::mat4(1.f) } };
+
+		while (!stack.empty())
+		{
+			const aiNode* assimpNode = stack.back().first;
+			glm::mat4 transform = stack.back().second * ToMat4GLM(assimpNode->mTransformation);
+			stack.pop_back();
+
+			auto joint = joints.find(assimpNode->mName.C_Str());
+
+			for (unsigned int i = 0; i < assimpNode->mNumMeshes; ++i)
+			{
+				// Skinned vertices are moved to model space by their joints, the node transform would apply twice
+				if (assimpScene->mMeshes[assimpNode->mMeshes[i]]->HasBones())
+					nodes.push_back({ glm::mat4(1.f), assimpNode->mMeshes[i], assimpNode->mName.C_Str(), -1 });
 				else
+					nodes.push_back({ transform, assimpNode->mMeshes[i], assimpNode->mName.C_Str(), joint != joints.end() ? joint->second : -1 });
+			}
+
+			for (unsigned int i = 0; i < assimpNode->mNumChildren; ++i)
+				stack.push_back({ assimpNode->mChildren[i], transform });
+		}
+
+		return true;
+	}
+
+	// Joints in depth first order so parents come before their children
+	static void ImportSkeleton(const aiScene* assimpScene, Skeleton& skeleton, std::unordered_map<std::string, int32_t>& joints)
+	{
+		std::vector<std::pair<const aiNode*, int32_t>> stack = { { assimpScene->mRootNode, -1 } };
+		std::vector<glm::vec3> translations, scales;
+		std::vector<glm::quat> rotations;
+
+		while (!stack.empty())
+		{
+			const aiNode* assimpNode = stack.back().first;
+			int32_t parent = stack.back().second;
+			stack.pop_back();
+
+			int32_t joint = static_cast<int32_t>(skeleton.names.size());
+			joints.emplace(assimpNode->mName.C_Str(), joint);
+
+			aiVector3D scaling, position;
+			aiQuaternion rotation;
+			assimpNode->mTransformation.Decompose(scaling, rotation, position);
+
+			skeleton.names.push_back(assimpNode->mName.C_Str());
+			skeleton.parents.push_back(parent);
+			skeleton.inverseBindMatrices.push_back(glm::mat4(1.f));
+			translations.push_back(ToVec3GLM(position));
+			rotations.push_back(glm::quat(rotation.w, rotation.x, rotation.y, rotation.z));
+			scales.push_back(ToVec3GLM(scaling));
+
+			for (unsigned int i = 0; i < assimpNode->mNumChildren; ++i)
+				stack.push_back({ assimpNode->mChildren[i], joint });
+		}
+
+		skeleton.bindPose.Resize(skeleton.names.size());
+		for (size_t i = 0; i < skeleton.names.size(); ++i)
+			skeleton.bindPose.SetJoint(i, translations[i], rotations[i], scales[i]);
+
+		// Bones shared by several meshes keep the offset of the first one
+		std::vector<bool> boundJoints(skeleton.names.size(), false);
+		for (unsigned int i = 0; i < assimpScene->mNumMeshes; ++i)
+		{
+			const aiMesh* assimpMesh = assimpScene->mMeshes[i];
+			for (unsigned int j = 0; j < assimpMesh->mNumBones; ++j)
+			{
+				auto joint = joints.find(assimpMesh->mBones[j]->mName.C_Str());
+				if (joint != joints.end() && !boundJoints[joint->second])
 				{
-					buffer->vertices[i].uv = glm::vec2(0.f, 0.f);
+					skeleton.inverseBindMatrices[joint->second] = ToMat4GLM(assimpMesh->mBones[j]->mOffsetMatrix);
+					boundJoints[joint->second] = true;
 				}
 			}
+		}
+	}
 
-			buffer->indices.resize(assimpMesh->mNumFaces * 3);
-			for (unsigned int i = 0; i < assimpMesh->mNumFaces; i++)
+	static void ImportAnimations(const aiScene* assimpScene, const std::unordered_map<std::string, int32_t>& joints, std::vector<AnimationClip>& clips)
+	{
+		for (unsigned int i = 0; i < assimpScene->mNumAnimations; ++i)
+		{
+			const aiAnimation* assimpAnimation = assimpScene->mAnimations[i];
+
+			// Keys are in ticks, 25 per second when the file does not tell
+			double ticksPerSecond = assimpAnimation->mTicksPerSecond != 0.0 ? assimpAnimation->mTicksPerSecond : 25.0;
+
+			AnimationClip clip;
+			clip.name = assimpAnimation->mName.C_Str();
+			clip.duration = static_cast<float>(assimpAnimation->mDuration / ticksPerSecond);
+
+			for (unsigned int j = 0; j < assimpAnimation->mNumChannels; ++j)
 			{
-				const aiFace face = assimpMesh->mFaces[i];
+				const aiNodeAnim* channel = assimpAnimation->mChannels[j];
+
+				auto joint = joints.find(channel->mNodeName.C_Str());
+				if (joint == joints.end())
+					continue;
+
+				AnimationTrack track;
+				track.joint = joint->second;
 
-				if (face.mNumIndices != 3)
+				for (unsigned int k = 0; k < channel->mNumPositionKeys; ++k)
 				{
-					std::cout << "Error : Face != 3 indices !" << std::endl;
-					delete mesh;
-					return nullptr;
+					track.positionTimes.push_back(static_cast<float>(channel->mPositionKeys[k].mTime / ticksPerSecond));
+					track.positions.push_back(ToVec3GLM(channel->mPositionKeys[k].mValue));
 				}
 
-				buffer->indices[i * 3 + 0] = face.mIndices[0];
-				buffer->indices[i * 3 + 1] = face.mIndices[1];
-				buffer->indices[i * 3 + 2] = face.mIndices[2];
+				for (unsigned int k = 0; k < channel->mNumRotationKeys; ++k)
+				{
+					const aiQuaternion& rotation = channel->mRotationKeys[k].mValue;
+					track.rotationTimes.push_back(static_cast<float>(channel->mRotationKeys[k].mTime / ticksPerSecond));
+					track.rotations.push_back(glm::quat(rotation.w, rotation.x, rotation.y, rotation.z));
+				}
+
+				for (unsigned int k = 0; k < channel->mNumScalingKeys; ++k)
+				{
+					track.scaleTimes.push_back(static_cast<float>(channel->mScalingKeys[k].mTime / ticksPerSecond));
+					track.scales.push_back(ToVec3GLM(channel->mScalingKeys[k].mValue));
+				}
+
+				clip.tracks.push_back(track);
 			}
 
-			mesh->GetMaterial()->texture = new Texture();
-			mesh->GetMaterial()->normalMap = new Texture();
-			mesh->GetMaterial()->specularMap = new Texture();
-			mesh->GetMaterial()->metallicMap = new Texture();
-			mesh->GetMaterial()->roughnessMap = new Texture();
+			clips.push_back(clip);
+		}
+	}
+
+	// Keeps the 4 strongest influences of every vertex and renormalizes them
+	static void ConvertMeshSkin(const aiMesh* assimpMesh, const std::unordered_map<std::string, int32_t>& joints, MeshBuffer* buffer)
+	{
+		buffer->skin.assign(assimpMesh->mNumVertices, VertexSkin());
+
+		for (unsigned int i = 0; i < assimpMesh->mNumBones; ++i)
+		{
+			const aiBone* bone = assimpMesh->mBones[i];
+
+			auto joint = joints.find(bone->mName.C_Str());
+			if (joint == joints.end() || joint->second > UINT16_MAX)
+				continue;
 
-			aiMaterial* mat = assimpScene->mMaterials[assimpMesh->mMaterialIndex];
-			if (mat->GetTextureCount(aiTextureType_DIFFUSE) > 0)
+			for (unsigned int j = 0; j < bone->mNumWeights; ++j)
 			{
-				aiString path;
-				mat->GetTexture(aiTextureType_DIFFUSE, 0, &path);
-							   
-				std::cout << "Texture = " << folderPath + path.C_Str() << std::endl;
-				mesh->GetMaterial()->texture->LoadFile(folderPath + path.C_Str(), true);// tryToLoadTexture(buffer, folderPath + path.C_Str());
+				const aiVertexWeight& weight = bone->mWeights[j];
+				if (weight.mVertexId >= assimpMesh->mNumVertices)
+					continue;
+
+				VertexSkin& skin = buffer->skin[weight.mVertexId];
+
+				int weakest = 0;
+				for (int k = 1; k < 4; ++k)
+				{
+					if (skin.weights[k] < skin.weights[weakest])
+						weakest = k;
+				}
+
+				if (weight.mWeight > skin.weights[weakest])
+				{
+					skin.joints[weakest] = static_cast<uint16_t>(joint->second);
+					skin.weights[weakest] = weight.mWeight;
+				}
 			}
+		}
 
-			// normal map is of type height in ironman
-			if (mat->GetTextureCount(aiTextureType_HEIGHT) > 0)
-			{
-				aiString path;
-				mat->GetTexture(aiTextureType_HEIGHT, 0, &path);
+		for (VertexSkin& skin : buffer->skin)
+		{
+			float total = skin.weights[0] + skin.weights[1] + skin.weights[2] + skin.weights[3];
 
-				std::cout << "Normal map = " << folderPath + path.C_Str() << std::endl;
-				mesh->GetMaterial()->normalMap->LoadFile(folderPath + path.C_Str());// tryToLoadTexture(buffer, folderPath + path.C_Str());
+			// Unweighted vertices follow the root
+			if (total <= 0.f)
+			{
+				skin.joints[0] = 0;
+				skin.weights[0] = 1.f;
+				continue;
 			}
 
-			if (mat->GetTextureCount(aiTextureType_SPECULAR) > 0)
+			for (int k = 0; k < 4; ++k)
+				skin.weights[k] /= total;
+		}
+	}
+
+	static std::string GetFolderPath(const std::string& filename)
+	{
+		size_t pos = filename.find_last_of("/\\");
+		std::string folderPath = "";
+		if (pos != std::string::npos)
+			folderPath = filename.substr(0, pos);
+
+		if (folderPath.size() > 0)
+		{
+			char lastChar = folderPath[folderPath.size() - 1];
+			if (lastChar != '/' && lastChar != '\\')
+				folderPath.push_back('/');
+		}
+
+		return folderPath;
+	}
+
+	static bool ConvertMeshBuffer(const aiMesh* assimpMesh, MeshBuffer* buffer)
+	{
+		buffer->vertices.resize(assimpMesh->mNumVertices);
+		for (unsigned int i = 0; i < assimpMesh->mNumVertices; ++i)
+		{
+			buffer->vertices[i].pos = ToVec3GLM(assimpMesh->mVertices[i]);
+			buffer->vertices[i].color = glm::vec3(1.0f, 1.0f, 1.0f);
+			buffer->vertices[i].normal = ToVec3GLM(assimpMesh->mNormals[i]);
+
+			if (assimpMesh->GetNumUVChannels() > 0)
+			{
+				const aiVector3D uv = assimpMesh->mTextureCoords[0][i];
+				buffer->vertices[i].uv = ToVec2GLM(uv);
+			}
+			else
 			{
-				aiString path;
-				mat->GetTexture(aiTextureType_SPECULAR, 0, &path);
+				buffer->vertices[i].uv = glm::vec2(0.f, 0.f);
+			}
+		}
+
+		buffer->indices.resize(assimpMesh->mNumFaces * 3);
+		for (unsigned int i = 0; i < assimpMesh->mNumFaces; i++)
+		{
+			const aiFace face = assimpMesh->mFaces[i];
 
-				std::cout << "Specular map = " << folderPath + path.C_Str() << std::endl;
-				mesh->GetMaterial()->specularMap->LoadFile(folderPath + path.C_Str());// tryToLoadTexture(buffer, folderPath + path.C_Str());
+			if (face.mNumIndices != 3)
+			{
+				std::cout << "Error : Face != 3 indices !" << std::endl;
+				return false;
 			}
+
+			buffer->indices[i * 3 + 0] = face.mIndices[0];
+			buffer->indices[i * 3 + 1] = face.mIndices[1];
+			buffer->indices[i * 3 + 2] = face.mIndices[2];
 		}
 
-		return mesh;
+		MeshletBuilder::Build(buffer);
+
+		return true;
 	}
 
-	static Mesh* LoadDefaultCube()
+	static void ReadMaterial(const aiMaterial* mat, const std::string& folderPath, MeshData* data)
 	{
-		Mesh* mesh = new Mesh();
-		mesh->name = "DefaultCube";
-		mesh->CreateMaterial();
+		data->texturePath = "";
+		data->normalMapPath = "";
+		data->specularMapPath = "";
+		data->color = glm::vec4(1.f);
 
-		MeshBuffer* buffer = mesh->AddMeshBuffer();
+		if (mat->GetTextureCount(aiTextureType_DIFFUSE) > 0)
+		{
+			aiString path;
+			mat->GetTexture(aiTextureType_DIFFUSE, 0, &path);
+			data->texturePath = folderPath + path.C_Str();
+		}
+		else
+		{
+			// The shader multiplies the albedo texture by the color, only untextured materials keep it
+			aiColor4D diffuse;
+			if (aiGetMaterialColor(mat, AI_MATKEY_COLOR_DIFFUSE, &diffuse) == AI_SUCCESS)
+				data->color = glm::vec4(diffuse.r, diffuse.g, diffuse.b, 1.f);
+		}
 
-		buffer->vertices = cubeVertex;
-		buffer->indices = cubeIndices;
+		// normal map is of type height in ironman
+		if (mat->GetTextureCount(aiTextureType_HEIGHT) > 0)
+		{
+			aiString path;
+			mat->GetTexture(aiTextureType_HEIGHT, 0, &path);
+			data->normalMapPath = folderPath + path.C_Str();
+		}
 
-		mesh->GetMaterial()->texture = new Texture();
-		mesh->GetMaterial()->normalMap = new Texture();
-		mesh->GetMaterial()->specularMap = new Texture();
-		mesh->GetMaterial()->metallicMap = new Texture();
-		mesh->GetMaterial()->roughnessMap = new Texture();
+		if (mat->GetTextureCount(aiTextureType_SPECULAR) > 0)
+		{
+			aiString path;
+			mat->GetTexture(aiTextureType_SPECULAR, 0, &path);
+			data->specularMapPath = folderPath + path.C_Str();
+		}
+	}
+
+	// Engine placeholders in every slot
+	static void CreateDefaultMaterialTextures(Mesh* mesh)
+	{
+		LeMaterial* material = mesh->GetMaterial();
+		material->texture = TextureCache::GetDefault(DefaultTexture::Albedo);
+		material->normalMap = TextureCache::GetDefault(DefaultTexture::Normal);
+		material->maskMap = TextureCache::GetDefault(DefaultTexture::Mask);
+	}
+
+	static void CreateMaterialTextures(Mesh* mesh)
+	{
+		MeshData* data = mesh->GetMeshData();
+
+		LeMaterial* material = mesh->GetMaterial();
+		CreateDefaultMaterialTextures(mesh);
+
+		// Decoded in parallel, this thread runs queued jobs while waiting
+		std::vector<std::pair<Texture**, std::future<Texture*>>> loads;
+
+		if (!data->texturePath.empty())
+		{
+			std::cout << "Texture = " << data->texturePath << std::endl;
+			loads.emplace_back(&material->texture, TextureCache::LoadAsync(data->texturePath, TextureSemantic::Albedo));
+		}
+
+		if (!data->normalMapPath.empty())
+		{
+			std::cout << "Normal map = " << data->normalMapPath << std::endl;
+			loads.emplace_back(&material->normalMap, TextureCache::LoadAsync(data->normalMapPath, TextureSemantic::Normal));
+		}
+
+		// Packed in the alpha of the mask map
+		if (!data->specularMapPath.empty())
+		{
+			std::cout << "Specular map = " << data->specularMapPath << std::endl;
+			MaskSources sources;
+			sources.specular = data->specularMapPath;
+			loads.emplace_back(&material->maskMap, TextureCache::LoadMaskAsync(sources));
+		}
+
+		for (auto& load : loads)
+		{
+			ThreadPool::Get().Wait(load.second);
+			TextureCache::Assign(*load.first, load.second.get());
+		}
+	}
+
+	static Mesh* LoadDefaultCube()
+	{
+		MeshData* data = MeshCache::Load("DefaultCube", []()
+		{
+			MeshData* cube = new MeshData();
+			cube->buffers.resize(1);
+			MeshBuffer* buffer = &cube->buffers[0];
+			buffer->vertices = cubeVertex;
+			buffer->indices = cubeIndices;
+			MeshletBuilder::Build(buffer);
+			return cube;
+		});
+
+		Mesh* mesh = new Mesh(data);
+		mesh->name = "DefaultCube";
+		mesh->CreateMaterial();
+		CreateMaterialTextures(mesh);
 
 		return mesh;
 	}
 
 	static Mesh* LoadDefaultQuad()
 	{
-		Mesh* mesh = new Mesh();
+		MeshData* data = MeshCache::Load("DefaultQuad", []()
+		{
+			MeshData* quad = new MeshData();
+
+			std::vector<Vertex> vertexBuffer =
+			{
+				{ { 1.0f, 1.0f, 0.0f }, { 1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }},
+				{ { 0.0f, 1.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }},
+				{ { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }},
+				{ { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }}
+			};
+
+			std::vector<uint16_t> indexBuffer = { 0,1,2, 2,3,0 };
+
+			quad->buffers.resize(1);
+			MeshBuffer* buffer = &quad->buffers[0];
+			buffer->vertices = vertexBuffer;
+			buffer->indices = indexBuffer;
+			MeshletBuilder::Build(buffer);
+			return quad;
+		});
+
+		Mesh* mesh = new Mesh(data);
 		mesh->name = "DefaultCube";
 		mesh->CreateMaterial();
+		CreateMaterialTextures(mesh);
 
-		MeshBuffer* buffer = mesh->AddMeshBuffer();
+		return mesh;
+	}
+
+	// Chain of jointCount joints along +Y waving on a looping clip, used to benchmark skinning
+	static Model CreateSkinnedTube(uint16_t jointCount, unsigned int rings, unsigned int segments)
+	{
+		const float jointLength = 0.5f;
+		const float radius = 0.15f;
+		const float height = jointLength * (jointCount - 1);
 
-		std::vector<Vertex> vertexBuffer =
+		Model model;
+		model.animations = std::make_shared<AnimationSet>();
+
+		Skeleton& skeleton = model.animations->skeleton;
+		skeleton.bindPose.Resize(jointCount);
+
+		AnimationClip clip;
+		clip.name = "Wave";
+		clip.duration = 2.f;
+
+		for (uint16_t i = 0; i < jointCount; ++i)
 		{
-			{ { 1.0f, 1.0f, 0.0f }, { 1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }},
-			{ { 0.0f, 1.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }},
-			{ { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }},
-			{ { 1.0f, 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }}
-		};
+			skeleton.names.push_back("Joint" + std::to_string(i));
+			skeleton.parents.push_back(static_cast<int32_t>(i) - 1);
+			skeleton.inverseBindMatrices.push_back(glm::translate(glm::mat4(1.f), glm::vec3(0.f, -jointLength * i, 0.f)));
+			skeleton.bindPose.SetJoint(i, glm::vec3(0.f, i > 0 ? jointLength : 0.f, 0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f));
+
+			AnimationTrack track;
+			track.joint = i;
+			for (int key = 0; key <= 8; ++key)
+			{
+				float time = clip.duration * key / 8.f;
+				float angle = 0.3f * std::sin(glm::two_pi<float>() * time / clip.duration + 0.4f * i);
+				track.rotationTimes.push_back(time);
+				track.rotations.push_back(glm::angleAxis(angle, glm::vec3(0.f, 0.f, 1.f)));
+			}
 
-		std::vector<uint16_t> indexBuffer = { 0,1,2, 2,3,0 };
+			clip.tracks.push_back(track);
+		}
 
-		buffer->vertices = vertexBuffer;
-		buffer->indices = indexBuffer;
+		model.animations->clips.push_back(clip);
 
-		mesh->GetMaterial()->texture = new Texture();
-		mesh->GetMaterial()->normalMap = new Texture();
-		mesh->GetMaterial()->specularMap = new Texture();
-		mesh->GetMaterial()->metallicMap = new Texture();
-		mesh->GetMaterial()->roughnessMap = new Texture();
+		std::string key = "SkinnedTube" + std::to_string(jointCount) + "_" + std::to_string(rings) + "_" + std::to_string(segments);
+		MeshData* data = MeshCache::Load(key, [=]()
+		{
+			MeshData* tube = new MeshData();
+			tube->buffers.resize(1);
+			MeshBuffer* buffer = &tube->buffers[0];
 
-		return mesh;
+			for (unsigned int ring = 0; ring <= rings; ++ring)
+			{
+				float y = height * ring / rings;
+				float jointPosition = y / jointLength;
+				uint16_t joint = static_cast<uint16_t>(std::min<float>(jointPosition, jointCount - 1.f));
+				uint16_t nextJoint = std::min<uint16_t>(joint + 1, jointCount - 1);
+				float weight = jointPosition - joint;
+
+				for (unsigned int segment = 0; segment <= segments; ++segment)
+				{
+					float angle = glm::two_pi<float>() * segment / segments;
+					glm::vec3 normal(std::cos(angle), 0.f, std::sin(angle));
+
+					buffer->vertices.push_back({ glm::vec3(normal.x * radius, y, normal.z * radius), glm::vec2(float(segment) / segments, float(ring) / rings), glm::vec3(1.f), normal });
+					buffer->skin.push_back({ { joint, nextJoint, 0, 0 }, { 1.f - weight, weight, 0.f, 0.f } });
+				}
+			}
+
+			for (unsigned int ring = 0; ring < rings; ++ring)
+			{
+				for (unsigned int segment = 0; segment < segments; ++segment)
+				{
+					uint16_t current = static_cast<uint16_t>(ring * (segments + 1) + segment);
+					uint16_t next = static_cast<uint16_t>(current + segments + 1);
+					buffer->indices.insert(buffer->indices.end(), { current, next, static_cast<uint16_t>(current + 1), static_cast<uint16_t>(current + 1), next, static_cast<uint16_t>(next + 1) });
+				}
+			}
+
+			MeshletBuilder::Build(buffer);
+			return tube;
+		});
+
+		Mesh* mesh = new Mesh(data);
+		mesh->name = key;
+		mesh->CreateMaterial();
+		CreateMaterialTextures(mesh);
+
+		model.nodes.push_back({ mesh, glm::mat4(1.f), -1 });
+
+		return model;
 	}
 
 	static glm::vec2 ToVec2GLM(aiVector3D vector)
@@ -229,5 +779,11 @@ public:
 	{
 		return glm::vec3(vector.x, vector.y, vector.z);
 	}
+
+	static glm::mat4 ToMat4GLM(const aiMatrix4x4& matrix)
+	{
+		// assimp matrices are row major
+		return glm::transpose(glm::make_mat4(&matrix.a1));
+	}
 };
 
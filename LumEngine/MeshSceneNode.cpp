@@ -15,3 +15,36 @@ Mesh* MeshSceneNode::GetMesh()
 {
 	return mesh;
 }
+
+void MeshSceneNode::SetMaterialIndex(uint32_t index)
+{
+	materialIndex = index;
+
+	if (entityRegistry)
+		entityRegistry->materials.Get(entity).materialIndex = index;
+}
+
+const LeAabb& MeshSceneNode::GetWorldBounds(size_t bufferIndex, const MeshBuffer* buffer, const glm::mat4& model)
+{
+	if (worldBoundsVersion != GetTransformVersion())
+	{
+		for (WorldBounds& bounds : worldBounds)
+			bounds.valid = false;
+
+		worldBoundsVersion = GetTransformVersion();
+	}
+
+	if (bufferIndex >= worldBounds.size())
+		worldBounds.resize(bufferIndex + 1);
+
+	// Reloaded or streamed in geometry comes with other bounds
+	WorldBounds& bounds = worldBounds[bufferIndex];
+	if (!bounds.valid || bounds.local != buffer->bounds)
+	{
+		bounds.local = buffer->bounds;
+		bounds.world = buffer->bounds.Transform(model);
+		bounds.valid = true;
+	}
+
+	return bounds.world;
+}
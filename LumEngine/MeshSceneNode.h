@@ -10,18 +10,32 @@ public:
 	~MeshSceneNode();
 
 	Mesh* GetMesh();
-	BufferHandle uniformNodeMeshStagingBuffer;
-	BufferHandle uniformNodeMeshBuffer;
 
-	BufferHandle uniformNodeMaterialStagingBuffer;
-	BufferHandle uniformNodeMaterialBuffer;
-	
+	// Slot of the node material in the per frame material buffer
+	void SetMaterialIndex(uint32_t index);
+	uint32_t GetMaterialIndex() const { return materialIndex; }
+
+	// Set on nodes of animated models, skinned meshes use the palette, rigid ones follow their joint
+	std::shared_ptr<AnimationInstance> animation;
+	int32_t joint = -1;
 
-	VkCommandBuffer _copyCommandBuffer = VK_NULL_HANDLE;
 	Mesh* mesh;
 
+	// World box of the mesh buffer bufferIndex, transformed again only when the node moves or the buffer bounds change
+	const LeAabb& GetWorldBounds(size_t bufferIndex, const MeshBuffer* buffer, const glm::mat4& model);
+
 private:
+	uint32_t materialIndex = 0;
+
+	struct WorldBounds
+	{
+		bool	valid = false;
+		LeAabb	local;
+		LeAabb	world;
+	};
 
+	std::vector<WorldBounds> worldBounds;
+	uint32_t worldBoundsVersion = 0;
 
 };
 
@@ -0,0 +1,265 @@
+#include "Meshlet.h"
+#include "MeshBuffer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+void MeshletBuilder::Build(MeshBuffer* buffer)
+{
+	buffer->meshlets.clear();
+	buffer->boundsRadius = -1.f;
+	buffer->bounds = LeAabb();
+
+	const size_t vertexCount = buffer->vertices.size();
+	const size_t triangleCount = buffer->indices.size() / 3;
+
+	if (triangleCount == 0)
+		return;
+
+	// Vertex to triangles adjacency
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (uint16_t index : buffer->indices)
+		++adjacencyOffsets[index + 1];
+
+	for (size_t i = 0; i < vertexCount; ++i)
+		adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+
+	std::vector<uint32_t> adjacency(buffer->indices.size());
+	std::vector<uint32_t> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < buffer->indices.size(); ++i)
+		adjacency[fillOffsets[buffer->indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> vertexMeshlet(vertexCount, UINT32_MAX);
+	std::vector<uint16_t> meshletVertices;
+	meshletVertices.reserve(maxVertices);
+
+	std::vector<uint16_t> orderedIndices;
+	orderedIndices.reserve(buffer->indices.size());
+
+	size_t emittedCount = 0;
+	size_t nextSeed = 0;
+
+	while (emittedCount < triangleCount)
+	{
+		const uint32_t meshletId = static_cast<uint32_t>(buffer->meshlets.size());
+
+		Meshlet meshlet;
+		meshlet.firstIndex = static_cast<uint32_t>(orderedIndices.size());
+		meshletVertices.clear();
+
+		auto newVertexCount = [&](size_t triangle)
+		{
+			size_t count = 0;
+			for (size_t k = 0; k < 3; ++k)
+				count += vertexMeshlet[buffer->indices[triangle * 3 + k]] != meshletId ? 1 : 0;
+			return count;
+		};
+
+		auto addTriangle = [&](size_t triangle)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				uint16_t index = buffer->indices[triangle * 3 + k];
+				if (vertexMeshlet[index] != meshletId)
+				{
+					vertexMeshlet[index] = meshletId;
+					meshletVertices.push_back(index);
+				}
+				orderedIndices.push_back(index);
+			}
+
+			emitted[triangle] = true;
+			++emittedCount;
+		};
+
+		while (emitted[nextSeed])
+			++nextSeed;
+
+		addTriangle(nextSeed);
+		size_t meshletTriangles = 1;
+
+		// Grow the cluster with the neighbour triangle adding the fewest new vertices
+		while (meshletTriangles < maxTriangles)
+		{
+			size_t bestTriangle = SIZE_MAX;
+			size_t bestScore = 4;
+
+			for (uint16_t vertex : meshletVertices)
+			{
+				for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; ++a)
+				{
+					uint32_t triangle = adjacency[a];
+					if (emitted[triangle])
+						continue;
+
+					size_t score = newVertexCount(triangle);
+					if (score < bestScore && meshletVertices.size() + score <= maxVertices)
+					{
+						bestScore = score;
+						bestTriangle = triangle;
+					}
+				}
+
+				if (bestScore == 0)
+					break;
+			}
+
+			// No connected candidate left, continue with the next triangle in index order
+			if (bestTriangle == SIZE_MAX)
+			{
+				size_t seed = nextSeed;
+				while (seed < triangleCount && emitted[seed])
+					++seed;
+
+				if (seed == triangleCount || meshletVertices.size() + newVertexCount(seed) > maxVertices)
+					break;
+
+				bestTriangle = seed;
+			}
+
+			addTriangle(bestTriangle);
+			++meshletTriangles;
+		}
+
+		meshlet.indexCount = static_cast<uint32_t>(orderedIndices.size()) - meshlet.firstIndex;
+		meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+		buffer->meshlets.push_back(meshlet);
+	}
+
+	buffer->indices.swap(orderedIndices);
+
+	for (Meshlet& meshlet : buffer->meshlets)
+		ComputeBounds(buffer, meshlet, buffer->indices);
+
+	// Whole buffer sphere, used to cull instanced nodes before drawing
+	glm::vec3 minPos(FLT_MAX);
+	glm::vec3 maxPos(-FLT_MAX);
+	for (const Meshlet& meshlet : buffer->meshlets)
+	{
+		minPos = glm::min(minPos, meshlet.center - glm::vec3(meshlet.radius));
+		maxPos = glm::max(maxPos, meshlet.center + glm::vec3(meshlet.radius));
+	}
+
+	buffer->boundsCenter = (minPos + maxPos) * 0.5f;
+	buffer->boundsRadius = 0.f;
+	for (const Meshlet& meshlet : buffer->meshlets)
+		buffer->boundsRadius = std::max(buffer->boundsRadius, glm::length(meshlet.center - buffer->boundsCenter) + meshlet.radius);
+
+	// Tighter box, the one the draw loops cull
+	for (uint16_t index : buffer->indices)
+		buffer->bounds.Expand(buffer->vertices[index].pos);
+}
+
+void MeshletBuilder::ComputeBounds(MeshBuffer* buffer, Meshlet& meshlet, const std::vector<uint16_t>& indices)
+{
+	glm::vec3 minPos(FLT_MAX);
+	glm::vec3 maxPos(-FLT_MAX);
+
+	for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; ++i)
+	{
+		const glm::vec3& pos = buffer->vertices[indices[i]].pos;
+		minPos = glm::min(minPos, pos);
+		maxPos = glm::max(maxPos, pos);
+	}
+
+	meshlet.center = (minPos + maxPos) * 0.5f;
+
+	float radiusSq = 0.f;
+	for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; ++i)
+	{
+		glm::vec3 delta = buffer->vertices[indices[i]].pos - meshlet.center;
+		radiusSq = std::max(radiusSq, glm::dot(delta, delta));
+	}
+
+	meshlet.radius = sqrtf(radiusSq);
+
+	// Normal cone from the face normals, counter clockwise triangles are front facing
+	std::vector<glm::vec3> normals;
+	normals.reserve(meshlet.indexCount / 3);
+
+	glm::vec3 axis(0.f);
+	for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3)
+	{
+		const glm::vec3& p0 = buffer->vertices[indices[i + 0]].pos;
+		const glm::vec3& p1 = buffer->vertices[indices[i + 1]].pos;
+		const glm::vec3& p2 = buffer->vertices[indices[i + 2]].pos;
+
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+		if (length <= 1e-12f)
+			continue;
+
+		normal /= length;
+		normals.push_back(normal);
+		axis += normal;
+	}
+
+	float axisLength = glm::length(axis);
+	if (normals.empty() || axisLength <= 1e-6f)
+	{
+		meshlet.coneCutoff = 1.f;
+		return;
+	}
+
+	meshlet.coneAxis = axis / axisLength;
+
+	float minDot = 1.f;
+	for (const glm::vec3& normal : normals)
+		minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+
+	// Cones wider than ~84 degrees almost never cull anything
+	if (minDot <= 0.1f)
+		meshlet.coneCutoff = 1.f;
+	else
+		meshlet.coneCutoff = sqrtf(1.f - minDot * minDot);
+}
+
+size_t MeshletCulling::Cull(const MeshBuffer* buffer, const glm::mat4& model, const LeFrustum& frustum, const glm::vec3& cameraPosition, bool cullBackfaces, std::vector<MeshletDrawRange>& ranges)
+{
+	ranges.clear();
+
+	if (buffer->meshlets.empty())
+	{
+		if (buffer->GetIndexCount() > 0)
+			ranges.push_back({ 0, static_cast<uint32_t>(buffer->GetIndexCount()) });
+		return 0;
+	}
+
+	glm::mat3 linear(model);
+	float maxScale = std::max(glm::length(linear[0]), std::max(glm::length(linear[1]), glm::length(linear[2])));
+
+	// The cone test is done in object space, mirrored transforms flip the winding
+	bool useCone = cullBackfaces && glm::determinant(linear) > 0.f;
+	glm::vec3 localCamera = useCone ? glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.f)) : glm::vec3(0.f);
+
+	size_t culledCount = 0;
+
+	for (const Meshlet& meshlet : buffer->meshlets)
+	{
+		glm::vec3 worldCenter = glm::vec3(model * glm::vec4(meshlet.center, 1.f));
+		bool visible = frustum.IsSphereVisible(worldCenter, meshlet.radius * maxScale);
+
+		if (visible && useCone)
+		{
+			glm::vec3 view = meshlet.center - localCamera;
+			if (glm::dot(view, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(view) + meshlet.radius)
+				visible = false;
+		}
+
+		if (!visible)
+		{
+			++culledCount;
+			continue;
+		}
+
+		// Meshlets are contiguous, merge neighbours into one range
+		if (!ranges.empty() && ranges.back().firstIndex + ranges.back().indexCount == meshlet.firstIndex)
+			ranges.back().indexCount += meshlet.indexCount;
+		else
+			ranges.push_back({ meshlet.firstIndex, meshlet.indexCount });
+	}
+
+	return culledCount;
+}
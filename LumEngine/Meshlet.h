@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "LeFrustum.h"
+
+class MeshBuffer;
+
+// Cluster of triangles stored contiguously in the mesh buffer index list
+struct Meshlet
+{
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	uint32_t vertexCount = 0;
+
+	// Bounding sphere (object space)
+	glm::vec3 center = glm::vec3(0.f);
+	float radius = 0.f;
+
+	// Normal cone, coneCutoff == 1 means the cone can't be used for culling
+	glm::vec3 coneAxis = glm::vec3(0.f, 0.f, 1.f);
+	float coneCutoff = 1.f;
+};
+
+struct MeshletDrawRange
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+class MeshletBuilder
+{
+public:
+	MeshletBuilder() = delete;
+	~MeshletBuilder() = delete;
+
+	static const size_t maxVertices = 64;
+	static const size_t maxTriangles = 124;
+
+	// Reorders the buffer indices so every meshlet is a contiguous index range
+	static void Build(MeshBuffer* buffer);
+
+private:
+	static void ComputeBounds(MeshBuffer* buffer, Meshlet& meshlet, const std::vector<uint16_t>& indices);
+};
+
+class MeshletCulling
+{
+public:
+	MeshletCulling() = delete;
+	~MeshletCulling() = delete;
+
+	// Fills ranges with the merged index ranges of the visible meshlets, returns the culled meshlet count
+	static size_t Cull(const MeshBuffer* buffer, const glm::mat4& model, const LeFrustum& frustum, const glm::vec3& cameraPosition, bool cullBackfaces, std::vector<MeshletDrawRange>& ranges);
+};
@@ -0,0 +1,303 @@
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+namespace
+{
+	const float kaiserWidth = 3.f;	// In destination texels
+	const float kaiserAlpha = 4.f;
+	const float pi = 3.14159265358979f;
+
+	// Modified Bessel function of the first kind, order 0
+	float BesselI0(float x)
+	{
+		float sum = 1.f;
+		float term = 1.f;
+		for (int k = 1; k < 32; ++k)
+		{
+			term *= (x * 0.5f / k) * (x * 0.5f / k);
+			sum += term;
+			if (term < sum * 1e-8f)
+				break;
+		}
+		return sum;
+	}
+
+	float KaiserSinc(float t)
+	{
+		float radius = kaiserWidth * 0.5f;
+		if (std::fabs(t) >= radius)
+			return 0.f;
+
+		float sinc = std::fabs(t) < 1e-5f ? 1.f : std::sin(pi * t) / (pi * t);
+		float ratio = t / radius;
+		return sinc * BesselI0(kaiserAlpha * std::sqrt(1.f - ratio * ratio)) / BesselI0(kaiserAlpha);
+	}
+
+	__m128 LoadTexel(const uint8_t* texel)
+	{
+		int32_t value;
+		memcpy(&value, texel, sizeof(int32_t));
+		__m128i zero = _mm_setzero_si128();
+		__m128i bytes = _mm_cvtsi32_si128(value);
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero));
+	}
+
+	void StoreTexel(__m128 value, uint8_t* texel)
+	{
+		__m128i words = _mm_cvtps_epi32(value);
+		words = _mm_packs_epi32(words, words);
+		int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+		memcpy(texel, &packed, sizeof(int32_t));
+	}
+
+	// Interleaved rows on every thread of the pool
+	void ParallelRows(uint32_t rowCount, const std::function<void(uint32_t)>& function)
+	{
+		ThreadPool& pool = ThreadPool::Get();
+		size_t taskCount = std::min<size_t>(rowCount, pool.GetWorkerCount() + 1);
+
+		pool.ParallelFor(taskCount, [&](size_t task)
+		{
+			for (uint32_t row = static_cast<uint32_t>(task); row < rowCount; row += static_cast<uint32_t>(taskCount))
+				function(row);
+		});
+	}
+}
+
+uint32_t MipGenerator::GetLevelCount(uint32_t width, uint32_t height)
+{
+	return static_cast<uint32_t>(std::floor(std::log2(std::max(std::max(width, height), 1u)))) + 1;
+}
+
+void MipGenerator::Generate(Texture* texture, TextureSemantic semantic)
+{
+	switch (semantic)
+	{
+	case TextureSemantic::Normal:	Generate(texture, MipFilter::Box, true); break;
+	case TextureSemantic::Scalar:
+	case TextureSemantic::Mask:
+	case TextureSemantic::Height:	Generate(texture, MipFilter::Box, false); break;
+	default:						Generate(texture, MipFilter::Kaiser, false); break;
+	}
+}
+
+void MipGenerator::Generate(Texture* texture, MipFilter filter, bool normalMap)
+{
+	// sRGB bytes are filtered as they are
+	const bool sixteenBits = texture->format == VK_FORMAT_R16_UNORM;
+	if (!sixteenBits && texture->format != VK_FORMAT_R8G8B8A8_SRGB)
+		texture->Convert(VK_FORMAT_R8G8B8A8_UNORM);
+
+	const uint32_t texelSize = Texture::GetTexelSize(texture->format);
+	glm::ivec2 dimensions = texture->GetDimensions();
+	uint32_t levelCount = GetLevelCount(dimensions.x, dimensions.y);
+
+	std::vector<size_t> offsets(levelCount);
+	size_t chainSize = 0;
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		offsets[level] = chainSize;
+		chainSize += size_t(std::max(uint32_t(dimensions.x) >> level, 1u)) * std::max(uint32_t(dimensions.y) >> level, 1u) * texelSize;
+	}
+
+	std::vector<uint8_t> chain(chainSize);
+	memcpy(chain.data(), texture->GetData(), size_t(dimensions.x) * dimensions.y * texelSize);
+
+	for (uint32_t level = 1; level < levelCount; ++level)
+	{
+		uint32_t width = std::max(uint32_t(dimensions.x) >> (level - 1), 1u);
+		uint32_t height = std::max(uint32_t(dimensions.y) >> (level - 1), 1u);
+		uint8_t* destination = chain.data() + offsets[level];
+
+		if (sixteenBits)
+			DownsampleBoxR16(reinterpret_cast<const uint16_t*>(chain.data() + offsets[level - 1]), width, height, reinterpret_cast<uint16_t*>(destination));
+		else if (filter == MipFilter::Kaiser)
+			DownsampleKaiser(chain.data() + offsets[level - 1], width, height, destination);
+		else
+			DownsampleBox(chain.data() + offsets[level - 1], width, height, destination);
+
+		if (normalMap)
+			RenormalizeNormals(destination, size_t(std::max(width / 2, 1u)) * std::max(height / 2, 1u));
+	}
+
+	texture->SetLevels(texture->format, dimensions.x, dimensions.y, offsets, chain.data(), chain.size());
+}
+
+void MipGenerator::DownsampleBox(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* destination)
+{
+	const uint32_t levelWidth = std::max(width / 2, 1u);
+	const uint32_t levelHeight = std::max(height / 2, 1u);
+
+	ParallelRows(levelHeight, [=](uint32_t y)
+	{
+		const uint8_t* row0 = source + size_t(std::min(y * 2, height - 1)) * width * 4;
+		const uint8_t* row1 = source + size_t(std::min(y * 2 + 1, height - 1)) * width * 4;
+		uint8_t* output = destination + size_t(y) * levelWidth * 4;
+
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i rounding = _mm_set1_epi16(2);
+
+		// 4 source texels of 2 rows give 2 destination texels
+		uint32_t x = 0;
+		if (width >= 2)
+		{
+			for (; x + 2 <= levelWidth; x += 2)
+			{
+				__m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+				__m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+
+				__m128i low = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+				__m128i high = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+
+				low = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+				high = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+
+				__m128i sums = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(low, high), rounding), 2);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(output + x * 4), _mm_packus_epi16(sums, sums));
+			}
+		}
+
+		for (; x < levelWidth; ++x)
+		{
+			uint32_t x0 = std::min(x * 2, width - 1);
+			uint32_t x1 = std::min(x * 2 + 1, width - 1);
+
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				uint32_t sum = row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c];
+				output[x * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+			}
+		}
+	});
+}
+
+void MipGenerator::DownsampleBoxR16(const uint16_t* source, uint32_t width, uint32_t height, uint16_t* destination)
+{
+	const uint32_t levelWidth = std::max(width / 2, 1u);
+	const uint32_t levelHeight = std::max(height / 2, 1u);
+
+	ParallelRows(levelHeight, [=](uint32_t y)
+	{
+		const uint16_t* row0 = source + size_t(std::min(y * 2, height - 1)) * width;
+		const uint16_t* row1 = source + size_t(std::min(y * 2 + 1, height - 1)) * width;
+		uint16_t* output = destination + size_t(y) * levelWidth;
+
+		for (uint32_t x = 0; x < levelWidth; ++x)
+		{
+			uint32_t x0 = std::min(x * 2, width - 1);
+			uint32_t x1 = std::min(x * 2 + 1, width - 1);
+			output[x] = static_cast<uint16_t>((uint32_t(row0[x0]) + row0[x1] + row1[x0] + row1[x1] + 2) / 4);
+		}
+	});
+}
+
+void MipGenerator::BuildKaiserTaps(uint32_t sourceSize, uint32_t destinationSize, std::vector<Taps>& taps)
+{
+	const float scale = float(sourceSize) / float(destinationSize);
+	const float radius = kaiserWidth * 0.5f * scale;
+
+	taps.resize(destinationSize);
+	for (uint32_t d = 0; d < destinationSize; ++d)
+	{
+		float center = (d + 0.5f) * scale - 0.5f;
+		int first = static_cast<int>(std::ceil(center - radius));
+		int last = static_cast<int>(std::floor(center + radius));
+
+		// Texels outside of the image are clamped, their weights go to the edge texel
+		Taps& tap = taps[d];
+		tap.first = static_cast<uint32_t>(std::max(first, 0));
+		tap.weights.assign(std::min(last, int(sourceSize) - 1) - int(tap.first) + 1, 0.f);
+
+		float sum = 0.f;
+		for (int s = first; s <= last; ++s)
+		{
+			float weight = KaiserSinc((s - center) / scale);
+			int clamped = std::min(std::max(s, 0), int(sourceSize) - 1);
+			tap.weights[clamped - tap.first] += weight;
+			sum += weight;
+		}
+
+		for (float& weight : tap.weights)
+			weight /= sum;
+	}
+}
+
+void MipGenerator::DownsampleKaiser(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* destination)
+{
+	const uint32_t levelWidth = std::max(width / 2, 1u);
+	const uint32_t levelHeight = std::max(height / 2, 1u);
+
+	std::vector<Taps> horizontalTaps;
+	std::vector<Taps> verticalTaps;
+	BuildKaiserTaps(width, levelWidth, horizontalTaps);
+	BuildKaiserTaps(height, levelHeight, verticalTaps);
+
+	// Horizontal pass on every source row, RGBA floats per texel
+	std::vector<float> filteredRows(size_t(levelWidth) * height * 4);
+
+	ParallelRows(height, [&](uint32_t y)
+	{
+		const uint8_t* row = source + size_t(y) * width * 4;
+		float* output = filteredRows.data() + size_t(y) * levelWidth * 4;
+
+		for (uint32_t x = 0; x < levelWidth; ++x)
+		{
+			const Taps& tap = horizontalTaps[x];
+			__m128 sum = _mm_setzero_ps();
+			for (size_t i = 0; i < tap.weights.size(); ++i)
+				sum = _mm_add_ps(sum, _mm_mul_ps(LoadTexel(row + (tap.first + i) * 4), _mm_set1_ps(tap.weights[i])));
+
+			_mm_storeu_ps(output + x * 4, sum);
+		}
+	});
+
+	ParallelRows(levelHeight, [&](uint32_t y)
+	{
+		const Taps& tap = verticalTaps[y];
+		uint8_t* output = destination + size_t(y) * levelWidth * 4;
+		const __m128 minimum = _mm_setzero_ps();
+		const __m128 maximum = _mm_set1_ps(255.f);
+
+		for (uint32_t x = 0; x < levelWidth; ++x)
+		{
+			__m128 sum = _mm_setzero_ps();
+			for (size_t i = 0; i < tap.weights.size(); ++i)
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(filteredRows.data() + ((tap.first + i) * levelWidth + x) * 4), _mm_set1_ps(tap.weights[i])));
+
+			// Negative lobes can overshoot
+			StoreTexel(_mm_min_ps(_mm_max_ps(sum, minimum), maximum), output + x * 4);
+		}
+	});
+}
+
+void MipGenerator::RenormalizeNormals(uint8_t* pixels, size_t pixelCount)
+{
+	const __m128 toSigned = _mm_set1_ps(2.f / 255.f);
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 toUnsigned = _mm_set1_ps(127.5f);
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+
+	for (size_t i = 0; i < pixelCount; ++i)
+	{
+		uint8_t* texel = pixels + i * 4;
+		__m128 normal = _mm_and_ps(_mm_sub_ps(_mm_mul_ps(LoadTexel(texel), toSigned), one), xyzMask);
+
+		__m128 squared = _mm_mul_ps(normal, normal);
+		__m128 length = _mm_add_ps(squared, _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(2, 3, 0, 1)));
+		length = _mm_sqrt_ps(_mm_add_ps(length, _mm_shuffle_ps(length, length, _MM_SHUFFLE(1, 0, 3, 2))));
+
+		// Opposite normals averaged to nothing keep their texel, its direction is only quantization noise
+		if (_mm_cvtss_f32(length) < 0.05f)
+			continue;
+
+		uint8_t alpha = texel[3];
+		StoreTexel(_mm_mul_ps(_mm_add_ps(_mm_div_ps(normal, length), one), toUnsigned), texel);
+		texel[3] = alpha;
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Texture.h"
+
+enum class MipFilter : int
+{
+	Box = 0,	// 2x2 average
+	Kaiser		// Kaiser windowed sinc, sharper minification
+};
+
+// CPU mip chain generation of RGBA8 textures with SSE2 kernels, levels are built in parallel on the ThreadPool.
+// Each level is filtered from the previous one, odd sizes drop their last row and column as the GPU does.
+// R16 textures (heights) are box filtered in their single channel, the other formats are converted to RGBA8 first.
+class MipGenerator
+{
+public:
+	MipGenerator() = delete;
+	~MipGenerator() = delete;
+
+	static uint32_t GetLevelCount(uint32_t width, uint32_t height);
+
+	// Replaces the top level of the texture by its full chain.
+	// Colors use the Kaiser filter, normal maps a box filter renormalized per texel, scalar and mask maps a box filter.
+	static void Generate(Texture* texture, TextureSemantic semantic);
+	static void Generate(Texture* texture, MipFilter filter, bool normalMap);
+
+	// Destination is max(width / 2, 1) x max(height / 2, 1)
+	static void DownsampleBox(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* destination);
+	static void DownsampleKaiser(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* destination);
+	static void DownsampleBoxR16(const uint16_t* source, uint32_t width, uint32_t height, uint16_t* destination);
+
+	// Rescales the xyz of tangent space normals stored in [0, 255] to unit length
+	static void RenormalizeNormals(uint8_t* pixels, size_t pixelCount);
+
+private:
+	// Source texels and weights of one destination texel along an axis
+	struct Taps
+	{
+		uint32_t			first;
+		std::vector<float>	weights;
+	};
+
+	static void BuildKaiserTaps(uint32_t sourceSize, uint32_t destinationSize, std::vector<Taps>& taps);
+};
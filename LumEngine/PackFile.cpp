@@ -0,0 +1,270 @@
+#include "PackFile.h"
+#include "Lz4.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+namespace
+{
+	uint64_t AlignOffset(uint64_t offset, uint64_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+}
+
+std::string PackFile::NormalizePath(const std::string& path)
+{
+	std::vector<std::string> segments;
+
+	size_t start = 0;
+	while (start <= path.size())
+	{
+		size_t end = path.find_first_of("/\\", start);
+		if (end == std::string::npos)
+			end = path.size();
+
+		std::string segment = path.substr(start, end - start);
+		std::transform(segment.begin(), segment.end(), segment.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+		// Leading ".." stay, they lead out of the working directory
+		if (segment == "..")
+		{
+			if (!segments.empty() && segments.back() != "..")
+				segments.pop_back();
+			else
+				segments.push_back(segment);
+		}
+		else if (!segment.empty() && segment != ".")
+		{
+			segments.push_back(segment);
+		}
+
+		start = end + 1;
+	}
+
+	std::string normalized;
+	for (const std::string& segment : segments)
+		normalized += (normalized.empty() ? "" : "/") + segment;
+
+	return normalized;
+}
+
+bool PackFile::Open(const std::string& path)
+{
+	lookup.clear();
+	entries = nullptr;
+
+	if (!file.Open(path) || file.GetSize() < sizeof(Header))
+		return false;
+
+	const uint8_t* data = file.GetData();
+	const size_t fileSize = file.GetSize();
+	const Header* header = reinterpret_cast<const Header*>(data);
+
+	if (header->magic != magic || header->version != version || header->tocOffset % alignof(Entry) != 0
+		|| !IsRangeValid(header->tocOffset, sizeof(Entry) * uint64_t(header->entryCount), fileSize)
+		|| !IsRangeValid(header->namesOffset, header->namesSize, fileSize))
+	{
+		file.Close();
+		return false;
+	}
+
+	entries = reinterpret_cast<const Entry*>(data + header->tocOffset);
+	const char* names = reinterpret_cast<const char*>(data + header->namesOffset);
+
+	lookup.reserve(header->entryCount);
+	for (uint32_t i = 0; i < header->entryCount; ++i)
+	{
+		const Entry& entry = entries[i];
+		if (!IsRangeValid(entry.nameOffset, entry.nameLength, static_cast<size_t>(header->namesSize))
+			|| !IsRangeValid(entry.offset, entry.storedSize, fileSize)
+			|| (!(entry.flags & Compressed) && entry.storedSize != entry.size))
+		{
+			lookup.clear();
+			entries = nullptr;
+			file.Close();
+			return false;
+		}
+
+		lookup[std::string(names + entry.nameOffset, entry.nameLength)] = i;
+	}
+
+	return true;
+}
+
+const PackFile::Entry* PackFile::Find(const std::string& name) const
+{
+	auto entry = lookup.find(name);
+	return entry != lookup.end() ? &entries[entry->second] : nullptr;
+}
+
+#ifdef _WIN32
+
+void PackFile::ListFiles(const std::string& directory, const std::string& relativeDirectory, std::vector<std::string>& files)
+{
+	std::string pattern = (relativeDirectory.empty() ? directory : directory + "/" + relativeDirectory) + "/*";
+
+	WIN32_FIND_DATAA findData;
+	HANDLE handle = FindFirstFileA(pattern.c_str(), &findData);
+	if (handle == INVALID_HANDLE_VALUE)
+		return;
+
+	do
+	{
+		std::string name = findData.cFileName;
+		if (name == "." || name == "..")
+			continue;
+
+		std::string relativePath = relativeDirectory.empty() ? name : relativeDirectory + "/" + name;
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			ListFiles(directory, relativePath, files);
+		else
+			files.push_back(relativePath);
+	} while (FindNextFileA(handle, &findData));
+
+	FindClose(handle);
+}
+
+#else
+
+void PackFile::ListFiles(const std::string& directory, const std::string& relativeDirectory, std::vector<std::string>& files)
+{
+	DIR* handle = opendir((relativeDirectory.empty() ? directory : directory + "/" + relativeDirectory).c_str());
+	if (handle == nullptr)
+		return;
+
+	while (dirent* entry = readdir(handle))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+
+		std::string relativePath = relativeDirectory.empty() ? name : relativeDirectory + "/" + name;
+
+		struct stat entryStat;
+		if (stat((directory + "/" + relativePath).c_str(), &entryStat) != 0)
+			continue;
+
+		if (S_ISDIR(entryStat.st_mode))
+			ListFiles(directory, relativePath, files);
+		else
+			files.push_back(relativePath);
+	}
+
+	closedir(handle);
+}
+
+#endif
+
+int PackFile::Build(const std::string& directory, const std::string& path)
+{
+	std::vector<std::string> files;
+	ListFiles(directory, "", files);
+
+	// An archive built inside the directory is not packed in the next one
+	files.erase(std::remove_if(files.begin(), files.end(), [](const std::string& file)
+	{
+		return file.size() >= 5 && NormalizePath(file.substr(file.size() - 5)) == ".lpak";
+	}), files.end());
+
+	std::vector<std::string> names(files.size());
+	for (size_t i = 0; i < files.size(); ++i)
+		names[i] = NormalizePath(files[i]);
+
+	std::vector<size_t> order(files.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&names](size_t a, size_t b) { return names[a] < names[b]; });
+
+	Header header = {};
+	header.magic = magic;
+	header.version = version;
+	header.entryCount = static_cast<uint32_t>(files.size());
+	header.tocOffset = AlignOffset(sizeof(Header), entryAlignment);
+
+	std::vector<Entry> toc(files.size());
+	std::string nameBlock;
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		toc[i] = Entry();
+		toc[i].nameOffset = static_cast<uint32_t>(nameBlock.size());
+		toc[i].nameLength = static_cast<uint32_t>(names[order[i]].size());
+		nameBlock += names[order[i]];
+	}
+
+	header.namesOffset = header.tocOffset + sizeof(Entry) * toc.size();
+	header.namesSize = nameBlock.size();
+
+	std::ofstream output(path, std::ios::binary | std::ios::trunc);
+	if (!output.is_open())
+		return -1;
+
+	// The table of contents is written once the entries are placed
+	uint64_t offset = AlignOffset(header.namesOffset + header.namesSize, entryAlignment);
+	std::vector<char> padding(static_cast<size_t>(offset), 0);
+	output.write(padding.data(), padding.size());
+
+	std::vector<uint8_t> compressed;
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		std::string filePath = directory + "/" + files[order[i]];
+		Entry& entry = toc[i];
+
+		struct stat fileStat;
+		if (stat(filePath.c_str(), &fileStat) != 0)
+			return -1;
+
+		entry.offset = offset;
+		entry.time = static_cast<int64_t>(fileStat.st_mtime);
+
+		MappedFile source;
+		const uint8_t* data = nullptr;
+		if (fileStat.st_size > 0)
+		{
+			if (!source.Open(filePath))
+				return -1;
+
+			data = source.GetData();
+			entry.size = source.GetSize();
+		}
+
+		compressed.resize(Lz4::GetMaxCompressedSize(static_cast<size_t>(entry.size)));
+		size_t compressedSize = entry.size > 0 ? Lz4::Compress(data, static_cast<size_t>(entry.size), compressed.data(), compressed.size()) : 0;
+
+		if (compressedSize > 0 && compressedSize < entry.size - entry.size / 8)
+		{
+			entry.flags = Compressed;
+			entry.storedSize = compressedSize;
+			output.write(reinterpret_cast<const char*>(compressed.data()), compressedSize);
+		}
+		else
+		{
+			entry.storedSize = entry.size;
+			output.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(entry.size));
+		}
+
+		uint64_t next = AlignOffset(offset + entry.storedSize, entryAlignment);
+		output.write(padding.data(), static_cast<std::streamsize>(next - offset - entry.storedSize));
+		offset = next;
+	}
+
+	output.seekp(0);
+	output.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	output.write(padding.data(), static_cast<std::streamsize>(header.tocOffset - sizeof(Header)));
+	output.write(reinterpret_cast<const char*>(toc.data()), sizeof(Entry) * toc.size());
+	output.write(nameBlock.data(), nameBlock.size());
+
+	return output.good() ? static_cast<int>(files.size()) : -1;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "MappedFile.h"
+
+// .lpak archive of a data directory, read through one read only mapping.
+// The table of contents follows the header, then the entry names and the entries, each one aligned.
+// An entry is stored LZ4 compressed when it shrinks by at least an eighth, the others are read in place.
+class PackFile
+{
+public:
+	static const uint32_t magic = 0x4B41504C;	// "LPAK"
+	static const uint32_t version = 1;
+	static const uint64_t entryAlignment = 16;
+
+	enum EntryFlags : uint32_t
+	{
+		Compressed = 1
+	};
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t flags;
+		uint64_t tocOffset;
+		uint64_t namesOffset;
+		uint64_t namesSize;
+		uint64_t reserved;
+	};
+
+	// Sorted by name
+	struct Entry
+	{
+		uint64_t offset;
+		uint64_t size;			// Uncompressed
+		uint64_t storedSize;
+		int64_t  time;			// Modification time of the packed file, stamps the caches built from it
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		uint32_t flags;
+		uint32_t reserved;
+	};
+
+	bool Open(const std::string& path);
+
+	// name as returned by NormalizePath and relative to the packed directory, nullptr when missing
+	const Entry* Find(const std::string& name) const;
+	const uint8_t* GetStoredData(const Entry& entry) const { return file.GetData() + entry.offset; }
+
+	size_t GetEntryCount() const { return lookup.size(); }
+
+	// Packs every file under directory, returns the number of files packed or -1 when the archive can't be written
+	static int Build(const std::string& directory, const std::string& path);
+
+	// '/' separated and lower case, "." and ".." segments resolved when possible
+	static std::string NormalizePath(const std::string& path);
+
+	// Relative paths of the files under directory, '/' separated
+	static void ListFiles(const std::string& directory, const std::string& relativeDirectory, std::vector<std::string>& files);
+
+private:
+	static bool IsRangeValid(uint64_t offset, uint64_t size, size_t fileSize) { return offset <= fileSize && size <= fileSize - offset; }
+
+	MappedFile file;
+	const Entry* entries = nullptr;
+	std::unordered_map<std::string, uint32_t> lookup;
+};
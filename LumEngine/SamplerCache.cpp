@@ -0,0 +1,82 @@
+#include "SamplerCache.h"
+#include "VulkanResourceList.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+	uint32_t FloatBits(float value)
+	{
+		// -0 and 0 are the same state
+		if (value == 0.f)
+			value = 0.f;
+
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+}
+
+SamplerCache::~SamplerCache()
+{
+	Clear();
+}
+
+SamplerCache::Key SamplerCache::MakeKey(const VkSamplerCreateInfo& info)
+{
+	return Key{ {
+		static_cast<uint32_t>(info.flags),
+		static_cast<uint32_t>(info.magFilter),
+		static_cast<uint32_t>(info.minFilter),
+		static_cast<uint32_t>(info.mipmapMode),
+		static_cast<uint32_t>(info.addressModeU),
+		static_cast<uint32_t>(info.addressModeV),
+		static_cast<uint32_t>(info.addressModeW),
+		FloatBits(info.mipLodBias),
+		static_cast<uint32_t>(info.anisotropyEnable),
+		FloatBits(info.anisotropyEnable ? info.maxAnisotropy : 1.f),
+		static_cast<uint32_t>(info.compareEnable),
+		static_cast<uint32_t>(info.compareEnable ? info.compareOp : VK_COMPARE_OP_NEVER),
+		FloatBits(info.minLod),
+		FloatBits(info.maxLod),
+		static_cast<uint32_t>(info.borderColor) | static_cast<uint32_t>(info.unnormalizedCoordinates) << 31
+	} };
+}
+
+size_t SamplerCache::KeyHash::operator()(const Key& key) const
+{
+	// FNV-1a over the fields
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t field : key)
+	{
+		hash ^= field;
+		hash *= 1099511628211ull;
+	}
+
+	return static_cast<size_t>(hash);
+}
+
+VkSampler SamplerCache::Get(const VkSamplerCreateInfo& info)
+{
+	assert(info.pNext == nullptr);
+
+	Key key = MakeKey(info);
+	auto sampler = samplers.find(key);
+	if (sampler != samplers.end())
+		return sampler->second;
+
+	VkSampler created = VK_NULL_HANDLE;
+	DEBUG_CHECK_VK(vkCreateSampler(device, &info, nullptr, &created));
+
+	samplers[key] = created;
+	return created;
+}
+
+void SamplerCache::Clear()
+{
+	for (auto& sampler : samplers)
+		vkDestroySampler(device, sampler.second, nullptr);
+
+	samplers.clear();
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#define VK_NO_PROTOTYPES
+#include <volk.h>
+
+#include <array>
+#include <unordered_map>
+#include <cstdint>
+
+// Samplers shared by create-info, one VkSampler per distinct state however many textures sample it.
+// They live until Clear, so they can be immutable samplers of the descriptor set layouts. Driver thread only
+class SamplerCache
+{
+public:
+	SamplerCache() = default;
+	~SamplerCache();
+
+	SamplerCache(const SamplerCache&) = delete;
+	SamplerCache& operator=(const SamplerCache&) = delete;
+
+	void SetDevice(VkDevice logicalDevice) { device = logicalDevice; }
+
+	// Extension structures are not part of the key, info.pNext must be null
+	VkSampler Get(const VkSamplerCreateInfo& info);
+
+	size_t GetCount() const { return samplers.size(); }
+
+	// Destroys every sampler, after the layouts using them
+	void Clear();
+
+private:
+	// Every field of the create-info, floats by their bits
+	using Key = std::array<uint32_t, 15>;
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+	static Key MakeKey(const VkSamplerCreateInfo& info);
+
+	VkDevice device = VK_NULL_HANDLE;
+	std::unordered_map<Key, VkSampler, KeyHash> samplers;
+};
@@ -7,7 +7,14 @@ Scene::Scene()
 
 Scene::~Scene()
 {
+	for (MeshHandle mesh : meshAssets)
+		AssetManager::Release(mesh);
+}
 
+Mesh* Scene::AddMeshAsset(MeshHandle mesh)
+{
+	meshAssets.push_back(mesh);
+	return AssetManager::Get(mesh);
 }
 
 MeshSceneNode* Scene::AddMeshNode(Mesh* meshNode, glm::vec3 position, glm::vec3 scale, glm::vec3 rotation)
@@ -19,10 +26,165 @@ MeshSceneNode* Scene::AddMeshNode(Mesh* meshNode, glm::vec3 position, glm::vec3
 	newMeshSceneNode->SetInitialValue(position, rotation, scale, true);
 	//vk->prepareMeshSceneNode(newMeshSceneNode);
 	nodes.push_back(newMeshSceneNode);
+
+	newMeshSceneNode->SetTransformSlot(&transforms, transforms.Add());
+	hierarchy.Add(newMeshSceneNode);
+
+	Entity entity = entities.Create();
+	entities.transforms.Add(entity, { newMeshSceneNode->GetWorldTransformation(), newMeshSceneNode->GetTransformVersion() });
+	entities.renders.Add(entity, { newMeshSceneNode, meshNode });
+	entities.materials.Add(entity, { meshNode->GetMaterial(), newMeshSceneNode->GetMaterialIndex() });
+	entities.visibilities.Add(entity, { newMeshSceneNode->IsVisible(), newMeshSceneNode->IsTransparent() });
+	newMeshSceneNode->SetEntity(&entities, entity);
+
+	newMeshSceneNode->SetSpatialProxy(&spatialIndex, spatialIndex.Insert(ComputeNodeBounds(newMeshSceneNode), newMeshSceneNode));
 	return newMeshSceneNode;
 
 }
 
+std::vector<MeshSceneNode*> Scene::AddModel(const Model& model, glm::vec3 position, glm::vec3 scale, glm::vec3 rotation)
+{
+	std::vector<MeshSceneNode*> modelNodes;
+
+	// One playback state per added model, the skeleton and clips stay shared
+	std::shared_ptr<AnimationInstance> animation;
+	if (model.animations)
+	{
+		animation = std::make_shared<AnimationInstance>(model.animations);
+		animation->Play(0);
+		animations.push_back(animation);
+	}
+
+	for (const ModelNode& modelNode : model.nodes)
+	{
+		MeshSceneNode* newMeshSceneNode = AddMeshNode(modelNode.mesh, position, scale, rotation);
+		newMeshSceneNode->SetImportTransform(modelNode.transform);
+		modelNodes.push_back(newMeshSceneNode);
+
+		bool skinned = false;
+		for (size_t i = 0; i < modelNode.mesh->GetMeshBufferCount(); ++i)
+			skinned |= modelNode.mesh->GetMeshBuffer(static_cast<unsigned>(i))->IsSkinned();
+
+		if (animation && (skinned || modelNode.joint >= 0))
+		{
+			newMeshSceneNode->animation = animation;
+			newMeshSceneNode->joint = skinned ? -1 : modelNode.joint;
+			animatedNodes.push_back(newMeshSceneNode);
+		}
+	}
+
+	return modelNodes;
+}
+
+void Scene::UpdateAnimations(float deltaTime)
+{
+	for (const std::shared_ptr<AnimationInstance>& animation : animations)
+		animation->Update(deltaTime);
+
+	for (MeshSceneNode* node : animatedNodes)
+	{
+		if (node->joint >= 0)
+			node->SetImportTransform(node->animation->GetGlobalTransforms()[node->joint]);
+	}
+}
+
+LeAabb Scene::ComputeNodeBounds(MeshSceneNode* node)
+{
+	Mesh* mesh = node->GetMesh();
+	LeAabb bounds;
+
+	if (mesh->GetMeshBufferCount() == 0)
+		return bounds;
+
+	glm::mat4 model = node->GetWorldTransformation();
+	for (size_t i = 0; i < mesh->GetMeshBufferCount(); ++i)
+	{
+		// Skinned vertices leave the bind pose bounds
+		MeshBuffer* buffer = mesh->GetMeshBuffer(static_cast<unsigned>(i));
+		if (buffer->IsSkinned() || buffer->bounds.IsEmpty())
+			return LeAabb();
+
+		const LeAabb& bufferBounds = node->GetWorldBounds(i, buffer, model);
+		bounds.Expand(bufferBounds.min);
+		bounds.Expand(bufferBounds.max);
+	}
+
+	return bounds;
+}
+
+void Scene::UpdateTransforms()
+{
+	transforms.Update();
+	hierarchy.Update();
+
+	// Only reads the node matrices, nothing is left to compose after the updates above
+	EntityRegistry::ParallelForEach(entities.transforms, [this](Entity entity, TransformComponent& transform)
+	{
+		MeshSceneNode* node = entities.renders.Get(entity).node;
+		if (transform.version == node->GetTransformVersion())
+			return;
+
+		transform.world = node->GetWorldTransformation();
+		transform.version = node->GetTransformVersion();
+	});
+}
+
+void Scene::UpdateSpatialIndex()
+{
+	for (uint32_t proxy : spatialIndex.GetMovedProxies())
+		spatialIndex.SetBox(proxy, ComputeNodeBounds(static_cast<MeshSceneNode*>(spatialIndex.GetUserData(proxy))));
+
+	spatialIndex.Update();
+}
+
+void Scene::MarkGeometryChanged()
+{
+	for (SceneNode* node : nodes)
+	{
+		if (node->GetSpatialProxy() != SceneBvh::invalidIndex)
+			spatialIndex.MarkMoved(node->GetSpatialProxy());
+	}
+}
+
+void Scene::AppendNodes(const std::vector<uint32_t>& proxies, std::vector<MeshSceneNode*>& results) const
+{
+	for (uint32_t proxy : proxies)
+		results.push_back(static_cast<MeshSceneNode*>(spatialIndex.GetUserData(proxy)));
+}
+
+void Scene::QueryFrustum(const LeFrustum& frustum, std::vector<MeshSceneNode*>& results) const
+{
+	queryProxies.clear();
+	spatialIndex.QueryFrustum(frustum, queryProxies);
+	AppendNodes(queryProxies, results);
+}
+
+void Scene::QuerySphere(const glm::vec3& center, float radius, std::vector<MeshSceneNode*>& results) const
+{
+	queryProxies.clear();
+	spatialIndex.QuerySphere(center, radius, queryProxies);
+	AppendNodes(queryProxies, results);
+}
+
+void Scene::QueryBox(const LeAabb& box, std::vector<MeshSceneNode*>& results) const
+{
+	queryProxies.clear();
+	spatialIndex.QueryBox(box, queryProxies);
+	AppendNodes(queryProxies, results);
+}
+
+MeshSceneNode* Scene::RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* distance) const
+{
+	SceneBvh::RayHit hit;
+	if (!spatialIndex.RayCast(origin, direction, maxDistance, hit))
+		return nullptr;
+
+	if (distance)
+		*distance = hit.distance;
+
+	return static_cast<MeshSceneNode*>(spatialIndex.GetUserData(hit.proxy));
+}
+
 MeshSceneNode* Scene::AddSkybox(std::string texturePath, Mesh* skyboxMesh)
 {
 	MeshSceneNode* sBMesh = new MeshSceneNode(skyboxMesh);
@@ -2,7 +2,12 @@
 //#include "VulkanDriver.h"
 #include "MeshSceneNode.h"
 #include <list>
+#include <vector>
 #include "LeLight.h"
+#include "SceneBvh.h"
+#include "TransformStore.h"
+#include "SceneHierarchy.h"
+#include "AssetManager.h"
 
 class Scene
 {
@@ -11,16 +16,60 @@ public:
 	~Scene();
 
 	MeshSceneNode* AddMeshNode(Mesh* meshNode, glm::vec3 position = { 0.f, 0.f, 0.f }, glm::vec3 scale = { 1.f, 1.f, 1.f }, glm::vec3 rotation = { 0.f, 0.f, 0.f });
+	std::vector<MeshSceneNode*> AddModel(const Model& model, glm::vec3 position = { 0.f, 0.f, 0.f }, glm::vec3 scale = { 1.f, 1.f, 1.f }, glm::vec3 rotation = { 0.f, 0.f, 0.f });
 	MeshSceneNode* AddSkybox(std::string texturePath, Mesh* skyboxMesh);
 	MeshSceneNode* AddShadowDebugQuad(Mesh * quadMesh);
 
+	// The scene holds the reference of the handle and releases it when destroyed, once the driver
+	// destroyed the GPU resources of its nodes. Returns the mesh of the handle
+	Mesh* AddMeshAsset(MeshHandle mesh);
+
 	void UpdateLightsCubesTransform();
 
+	// Advances every model animation and moves the rigid nodes attached to a joint
+	void UpdateAnimations(float deltaTime);
+
+	// Composes the matrices of the mesh nodes moved since the last call, then the world matrices below them,
+	// and copies the new world matrices to the transform components on the worker threads
+	void UpdateTransforms();
+
+	// Gives the nodes moved since the last call their new box, then refits or rebuilds the spatial index
+	void UpdateSpatialIndex();
+
+	// Streamed in or reloaded geometry changes the bounds of nodes that didn't move
+	void MarkGeometryChanged();
+
+	// Mesh nodes whose box intersects the volume, nodes without bounds are always reported
+	void QueryFrustum(const LeFrustum& frustum, std::vector<MeshSceneNode*>& results) const;
+	void QuerySphere(const glm::vec3& center, float radius, std::vector<MeshSceneNode*>& results) const;
+	void QueryBox(const LeAabb& box, std::vector<MeshSceneNode*>& results) const;
+
+	// Closest mesh node box along the ray, nullptr when there is none
+	MeshSceneNode* RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* distance = nullptr) const;
+
 	//VulkanDriver* vkDriver;
 	MeshSceneNode* skyboxNode;
 	MeshSceneNode* shadowDebugNode;
 	std::list<SceneNode*> lightsCubesNodes;
     LightPropertyObject lightProperty[9];
 	std::list<SceneNode*> nodes;
+	std::vector<std::shared_ptr<AnimationInstance>> animations;
+	std::vector<MeshSceneNode*> animatedNodes;
+	SceneBvh spatialIndex;
+	TransformStore transforms;
+	SceneHierarchy hierarchy;
+
+	// Dense components of the mesh nodes for the per frame systems
+	EntityRegistry entities;
+
+private:
+	// Union of the world boxes of the buffers, empty when one of them has no bounds or is skinned
+	static LeAabb ComputeNodeBounds(MeshSceneNode* node);
+
+	void AppendNodes(const std::vector<uint32_t>& proxies, std::vector<MeshSceneNode*>& results) const;
+
+	mutable std::vector<uint32_t> queryProxies;
+
+	std::vector<MeshHandle> meshAssets;
 };
 
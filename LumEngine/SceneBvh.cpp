@@ -0,0 +1,747 @@
+#include "SceneBvh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <glm/gtc/matrix_transform.hpp>
+
+const uint32_t SceneBvh::invalidIndex;
+const uint32_t SceneBvh::maxLeafItems;
+const uint32_t SceneBvh::binCount;
+
+namespace
+{
+	enum class Overlap : int
+	{
+		Outside = 0,
+		Intersects,
+		Inside
+	};
+
+	float GetArea(const LeAabb& box)
+	{
+		if (box.IsEmpty())
+			return 0.f;
+
+		glm::vec3 size = box.max - box.min;
+		return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	LeAabb Merge(const LeAabb& a, const LeAabb& b)
+	{
+		LeAabb box;
+		box.min = glm::min(a.min, b.min);
+		box.max = glm::max(a.max, b.max);
+		return box;
+	}
+
+	bool Overlaps(const LeAabb& a, const LeAabb& b)
+	{
+		return a.min.x <= b.max.x && a.max.x >= b.min.x
+			&& a.min.y <= b.max.y && a.max.y >= b.min.y
+			&& a.min.z <= b.max.z && a.max.z >= b.min.z;
+	}
+
+	bool Contains(const LeAabb& outer, const LeAabb& inner)
+	{
+		return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::greaterThanEqual(outer.max, inner.max));
+	}
+
+	// Positive and negative vertices against every plane
+	Overlap ClassifyFrustum(const LeFrustum& frustum, const LeAabb& box)
+	{
+		Overlap overlap = Overlap::Inside;
+		for (int i = 0; i < 6; ++i)
+		{
+			const glm::vec4& plane = frustum.planes[i];
+			glm::vec3 positive(plane.x >= 0.f ? box.max.x : box.min.x, plane.y >= 0.f ? box.max.y : box.min.y, plane.z >= 0.f ? box.max.z : box.min.z);
+			glm::vec3 negative(plane.x >= 0.f ? box.min.x : box.max.x, plane.y >= 0.f ? box.min.y : box.max.y, plane.z >= 0.f ? box.min.z : box.max.z);
+
+			if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.f)
+				return Overlap::Outside;
+			if (glm::dot(glm::vec3(plane), negative) + plane.w < 0.f)
+				overlap = Overlap::Intersects;
+		}
+
+		return overlap;
+	}
+
+	Overlap ClassifySphere(const glm::vec3& center, float radius, const LeAabb& box)
+	{
+		glm::vec3 closest = glm::clamp(center, box.min, box.max) - center;
+		if (glm::dot(closest, closest) > radius * radius)
+			return Overlap::Outside;
+
+		glm::vec3 farthest = glm::max(glm::abs(box.min - center), glm::abs(box.max - center));
+		return glm::dot(farthest, farthest) <= radius * radius ? Overlap::Inside : Overlap::Intersects;
+	}
+
+	Overlap ClassifyBox(const LeAabb& query, const LeAabb& box)
+	{
+		if (!Overlaps(query, box))
+			return Overlap::Outside;
+
+		return Contains(query, box) ? Overlap::Inside : Overlap::Intersects;
+	}
+
+	// Slab test, entry distance of the ray in the box or a negative value when it misses it
+	float IntersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, const LeAabb& box)
+	{
+		glm::vec3 t0 = (box.min - origin) * inverseDirection;
+		glm::vec3 t1 = (box.max - origin) * inverseDirection;
+		glm::vec3 tMin = glm::min(t0, t1);
+		glm::vec3 tMax = glm::max(t0, t1);
+
+		float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.f));
+		float exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+
+		return enter <= exit ? enter : -1.f;
+	}
+}
+
+uint32_t SceneBvh::Insert(const LeAabb& box, void* userData)
+{
+	uint32_t proxy;
+	if (!freeProxies.empty())
+	{
+		proxy = freeProxies.back();
+		freeProxies.pop_back();
+	}
+	else
+	{
+		proxy = static_cast<uint32_t>(proxies.size());
+		proxies.emplace_back();
+	}
+
+	Proxy& newProxy = proxies[proxy];
+	newProxy = Proxy();
+	newProxy.box = box;
+	newProxy.userData = userData;
+	newProxy.alive = true;
+
+	// Tested one by one until the next build
+	outsideProxies.push_back(proxy);
+	return proxy;
+}
+
+void SceneBvh::Remove(uint32_t proxy)
+{
+	Proxy& removed = proxies[proxy];
+
+	if (removed.leaf != invalidIndex)
+		RemoveFromTree(proxy);
+	else
+		outsideProxies.erase(std::find(outsideProxies.begin(), outsideProxies.end(), proxy));
+
+	if (removed.moved)
+		movedProxies.erase(std::find(movedProxies.begin(), movedProxies.end(), proxy));
+
+	removed = Proxy();
+	freeProxies.push_back(proxy);
+}
+
+void SceneBvh::MarkMoved(uint32_t proxy)
+{
+	Proxy& moved = proxies[proxy];
+	if (moved.moved)
+		return;
+
+	moved.moved = true;
+	movedProxies.push_back(proxy);
+}
+
+void SceneBvh::SetBox(uint32_t proxy, const LeAabb& box)
+{
+	Proxy& changed = proxies[proxy];
+	changed.box = box;
+
+	if (changed.leaf == invalidIndex)
+		return;
+
+	if (box.IsEmpty())
+	{
+		RemoveFromTree(proxy);
+		outsideProxies.push_back(proxy);
+	}
+	else
+		MarkDirty(changed.leaf);
+}
+
+void SceneBvh::Update()
+{
+	for (uint32_t proxy : movedProxies)
+		proxies[proxy].moved = false;
+	movedProxies.clear();
+
+	size_t boundedOutsideCount = 0;
+	for (uint32_t proxy : outsideProxies)
+		boundedOutsideCount += proxies[proxy].box.IsEmpty() ? 0 : 1;
+
+	// Linear tests of the new proxies cost more than a build past a small fraction of the tree
+	size_t treeItemCount = items.size();
+	if (boundedOutsideCount > std::max<size_t>(64, treeItemCount / 8) || (nodes.empty() && boundedOutsideCount > 0))
+	{
+		Build();
+		return;
+	}
+
+	if (!nodes.empty() && dirtyNodes[0])
+		RefitNode(0);
+
+	if (GetCost() > builtCost * maxCostRatio)
+		Build();
+}
+
+void SceneBvh::RefitNode(uint32_t index)
+{
+	// Ancestors of a dirty node are dirty, so only the dirty paths are walked
+	Node& node = nodes[index];
+	LeAabb previousBox = node.box;
+
+	if (node.right == invalidIndex)
+	{
+		node.box = LeAabb();
+		for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; ++i)
+			node.box = Merge(node.box, proxies[items[i]].box);
+	}
+	else
+	{
+		if (dirtyNodes[index + 1])
+			RefitNode(index + 1);
+		if (dirtyNodes[node.right])
+			RefitNode(node.right);
+
+		node.box = Merge(nodes[index + 1].box, nodes[node.right].box);
+	}
+
+	UpdateNodeCost(node, previousBox, node.itemCount);
+	dirtyNodes[index] = 0;
+}
+
+void SceneBvh::Build()
+{
+	std::vector<BuildItem> buildItems;
+	buildItems.reserve(GetProxyCount());
+	outsideProxies.clear();
+
+	for (uint32_t proxy = 0; proxy < proxies.size(); ++proxy)
+	{
+		Proxy& item = proxies[proxy];
+		item.leaf = invalidIndex;
+
+		if (!item.alive)
+			continue;
+
+		if (item.box.IsEmpty())
+			outsideProxies.push_back(proxy);
+		else
+			buildItems.push_back({ item.box, (item.box.min + item.box.max) * 0.5f, proxy });
+	}
+
+	nodes.clear();
+	items.clear();
+
+	if (!buildItems.empty())
+	{
+		nodes.reserve(buildItems.size() * 2);
+		items.reserve(buildItems.size());
+		BuildNode(buildItems, 0, static_cast<uint32_t>(buildItems.size()), invalidIndex);
+	}
+
+	dirtyNodes.assign(nodes.size(), 0);
+
+	weightedArea = 0.0;
+	for (const Node& node : nodes)
+		weightedArea += double(GetArea(node.box)) * (node.right == invalidIndex ? node.itemCount : 1);
+
+	builtCost = GetCost();
+	++buildCount;
+}
+
+uint32_t SceneBvh::BuildNode(std::vector<BuildItem>& buildItems, uint32_t first, uint32_t count, uint32_t parent)
+{
+	const uint32_t index = static_cast<uint32_t>(nodes.size());
+	nodes.push_back({ LeAabb(), parent, invalidIndex, 0, 0 });
+
+	LeAabb box;
+	LeAabb centroidBox;
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		box = Merge(box, buildItems[i].box);
+		centroidBox.Expand(buildItems[i].centroid);
+	}
+
+	nodes[index].box = box;
+
+	// Binned SAH over the three axes, costs are scaled by the node area. Small nodes use one bin per item
+	const uint32_t bins = std::min(binCount, count);
+	int bestAxis = -1;
+	uint32_t bestBin = 0;
+	float bestCost = FLT_MAX;
+
+	if (count > 1)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float extent = centroidBox.max[axis] - centroidBox.min[axis];
+			if (extent <= 0.f)
+				continue;
+
+			LeAabb binBoxes[binCount];
+			uint32_t binCounts[binCount] = {};
+			float binScale = bins / extent;
+
+			for (uint32_t i = first; i < first + count; ++i)
+			{
+				uint32_t bin = std::min(bins - 1, static_cast<uint32_t>((buildItems[i].centroid[axis] - centroidBox.min[axis]) * binScale));
+				binBoxes[bin] = Merge(binBoxes[bin], buildItems[i].box);
+				++binCounts[bin];
+			}
+
+			// Right side areas swept from the last bin
+			float rightCosts[binCount];
+			LeAabb rightBox;
+			uint32_t rightCount = 0;
+			for (uint32_t bin = bins - 1; bin > 0; --bin)
+			{
+				rightBox = Merge(rightBox, binBoxes[bin]);
+				rightCount += binCounts[bin];
+				rightCosts[bin - 1] = rightCount > 0 ? GetArea(rightBox) * rightCount : 0.f;
+			}
+
+			LeAabb leftBox;
+			uint32_t leftCount = 0;
+			for (uint32_t bin = 0; bin + 1 < bins; ++bin)
+			{
+				leftBox = Merge(leftBox, binBoxes[bin]);
+				leftCount += binCounts[bin];
+
+				if (leftCount == 0 || leftCount == count)
+					continue;
+
+				float cost = GetArea(leftBox) * leftCount + rightCosts[bin];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin;
+				}
+			}
+		}
+	}
+
+	float leafCost = GetArea(box) * count;
+	float splitCost = GetArea(box) + bestCost;
+
+	if (count == 1 || (count <= maxLeafItems && (bestAxis < 0 || leafCost <= splitCost)))
+	{
+		Node& leaf = nodes[index];
+		leaf.firstItem = static_cast<uint32_t>(items.size());
+		leaf.itemCount = count;
+
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			items.push_back(buildItems[i].proxy);
+			proxies[buildItems[i].proxy].leaf = index;
+		}
+
+		return index;
+	}
+
+	uint32_t middle;
+	if (bestAxis >= 0)
+	{
+		float binScale = bins / (centroidBox.max[bestAxis] - centroidBox.min[bestAxis]);
+		float minCentroid = centroidBox.min[bestAxis];
+		auto split = std::partition(buildItems.begin() + first, buildItems.begin() + first + count, [&](const BuildItem& item)
+		{
+			return std::min(bins - 1, static_cast<uint32_t>((item.centroid[bestAxis] - minCentroid) * binScale)) <= bestBin;
+		});
+		middle = static_cast<uint32_t>(split - buildItems.begin());
+	}
+	else
+	{
+		// Same centroid everywhere, any half will do
+		middle = first + count / 2;
+	}
+
+	BuildNode(buildItems, first, middle - first, index);
+	uint32_t right = BuildNode(buildItems, middle, first + count - middle, index);
+	nodes[index].right = right;
+
+	return index;
+}
+
+void SceneBvh::RemoveFromTree(uint32_t proxy)
+{
+	uint32_t leafIndex = proxies[proxy].leaf;
+	Node& leaf = nodes[leafIndex];
+
+	uint32_t last = leaf.firstItem + leaf.itemCount - 1;
+	for (uint32_t i = leaf.firstItem; i <= last; ++i)
+	{
+		if (items[i] == proxy)
+		{
+			std::swap(items[i], items[last]);
+			break;
+		}
+	}
+
+	// The refit of the leaf accounts for its new box at its new count
+	weightedArea -= GetArea(leaf.box);
+	--leaf.itemCount;
+	proxies[proxy].leaf = invalidIndex;
+
+	MarkDirty(leafIndex);
+}
+
+void SceneBvh::MarkDirty(uint32_t node)
+{
+	// Stops at the first ancestor already queued, its own ancestors are too
+	while (node != invalidIndex && !dirtyNodes[node])
+	{
+		dirtyNodes[node] = 1;
+		node = nodes[node].parent;
+	}
+}
+
+void SceneBvh::UpdateNodeCost(const Node& node, const LeAabb& previousBox, uint32_t previousCount)
+{
+	double weight = node.right == invalidIndex ? node.itemCount : 1;
+	double previousWeight = node.right == invalidIndex ? previousCount : 1;
+	weightedArea += GetArea(node.box) * weight - GetArea(previousBox) * previousWeight;
+}
+
+float SceneBvh::GetCost() const
+{
+	if (nodes.empty())
+		return 0.f;
+
+	float rootArea = GetArea(nodes[0].box);
+	return rootArea > 0.f ? static_cast<float>(weightedArea / rootArea) : 0.f;
+}
+
+template<typename NodeTest, typename ItemTest>
+void SceneBvh::Query(NodeTest nodeTest, ItemTest itemTest, std::vector<uint32_t>& results) const
+{
+	for (uint32_t proxy : outsideProxies)
+	{
+		const LeAabb& box = proxies[proxy].box;
+		if (box.IsEmpty() || itemTest(box))
+			results.push_back(proxy);
+	}
+
+	if (nodes.empty())
+		return;
+
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while (!stack.empty())
+	{
+		uint32_t index = stack.back();
+		stack.pop_back();
+
+		const Node& node = nodes[index];
+		if (node.box.IsEmpty())
+			continue;
+
+		Overlap overlap = nodeTest(node.box);
+		if (overlap == Overlap::Outside)
+			continue;
+
+		if (overlap == Overlap::Inside)
+		{
+			AppendSubtree(index, results);
+			continue;
+		}
+
+		if (node.right != invalidIndex)
+		{
+			stack.push_back(node.right);
+			stack.push_back(index + 1);
+			continue;
+		}
+
+		for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; ++i)
+		{
+			if (itemTest(proxies[items[i]].box))
+				results.push_back(items[i]);
+		}
+	}
+}
+
+void SceneBvh::AppendSubtree(uint32_t node, std::vector<uint32_t>& results) const
+{
+	// A subtree is a contiguous node range ending at its rightmost leaf
+	uint32_t last = node;
+	while (nodes[last].right != invalidIndex)
+		last = nodes[last].right;
+
+	for (uint32_t index = node; index <= last; ++index)
+	{
+		const Node& leaf = nodes[index];
+		if (leaf.right == invalidIndex)
+			results.insert(results.end(), items.begin() + leaf.firstItem, items.begin() + leaf.firstItem + leaf.itemCount);
+	}
+}
+
+void SceneBvh::QueryFrustum(const LeFrustum& frustum, std::vector<uint32_t>& results) const
+{
+	Query([&frustum](const LeAabb& box) { return ClassifyFrustum(frustum, box); },
+		[&frustum](const LeAabb& box) { return frustum.IsBoxVisible(box); }, results);
+}
+
+void SceneBvh::QuerySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& results) const
+{
+	Query([&](const LeAabb& box) { return ClassifySphere(center, radius, box); },
+		[&](const LeAabb& box) { return ClassifySphere(center, radius, box) != Overlap::Outside; }, results);
+}
+
+void SceneBvh::QueryBox(const LeAabb& box, std::vector<uint32_t>& results) const
+{
+	Query([&box](const LeAabb& nodeBox) { return ClassifyBox(box, nodeBox); },
+		[&box](const LeAabb& itemBox) { return Overlaps(box, itemBox); }, results);
+}
+
+bool SceneBvh::RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const
+{
+	const glm::vec3 inverseDirection = 1.f / direction;
+	hit = RayHit();
+	float closest = maxDistance;
+
+	for (uint32_t proxy : outsideProxies)
+	{
+		const LeAabb& box = proxies[proxy].box;
+		float distance = box.IsEmpty() ? -1.f : IntersectRay(origin, inverseDirection, closest, box);
+		if (distance >= 0.f)
+		{
+			closest = distance;
+			hit = { proxy, distance };
+		}
+	}
+
+	if (nodes.empty())
+		return hit.proxy != invalidIndex;
+
+	// Nearest child first, subtrees entered beyond the closest hit are skipped
+	struct Entry
+	{
+		uint32_t	node;
+		float		distance;
+	};
+
+	std::vector<Entry> stack;
+	stack.reserve(64);
+
+	float rootDistance = nodes[0].box.IsEmpty() ? -1.f : IntersectRay(origin, inverseDirection, closest, nodes[0].box);
+	if (rootDistance >= 0.f)
+		stack.push_back({ 0, rootDistance });
+
+	while (!stack.empty())
+	{
+		Entry entry = stack.back();
+		stack.pop_back();
+
+		if (entry.distance > closest)
+			continue;
+
+		const Node& node = nodes[entry.node];
+		if (node.right == invalidIndex)
+		{
+			for (uint32_t i = node.firstItem; i < node.firstItem + node.itemCount; ++i)
+			{
+				float distance = IntersectRay(origin, inverseDirection, closest, proxies[items[i]].box);
+				if (distance >= 0.f && (hit.proxy == invalidIndex || distance < closest))
+				{
+					closest = distance;
+					hit = { items[i], distance };
+				}
+			}
+			continue;
+		}
+
+		uint32_t children[2] = { entry.node + 1, node.right };
+		float distances[2];
+		for (int i = 0; i < 2; ++i)
+			distances[i] = nodes[children[i]].box.IsEmpty() ? -1.f : IntersectRay(origin, inverseDirection, closest, nodes[children[i]].box);
+
+		// The nearer child is popped first
+		int nearest = distances[0] >= 0.f && (distances[1] < 0.f || distances[0] <= distances[1]) ? 0 : 1;
+		if (distances[1 - nearest] >= 0.f)
+			stack.push_back({ children[1 - nearest], distances[1 - nearest] });
+		if (distances[nearest] >= 0.f)
+			stack.push_back({ children[nearest], distances[nearest] });
+	}
+
+	return hit.proxy != invalidIndex;
+}
+
+void BvhBenchmark::Run(size_t staticCount, size_t dynamicCount, size_t frameCount)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto milliseconds = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+	// Same density whatever the count, boxes of 0.5 to 4 units
+	auto makeBox = [](std::mt19937& random, float halfSide)
+	{
+		std::uniform_real_distribution<float> position(-halfSide, halfSide - 4.f);
+		std::uniform_real_distribution<float> size(0.5f, 4.f);
+
+		LeAabb box;
+		box.min = glm::vec3(position(random), position(random), position(random));
+		box.max = box.min + glm::vec3(size(random), size(random), size(random));
+		return box;
+	};
+	auto getHalfSide = [](size_t count) { return 0.5f * 2000.f * std::cbrt(float(count) / 1e6f); };
+
+	std::mt19937 random(7);
+	const float halfSide = getHalfSide(staticCount + dynamicCount);
+
+	SceneBvh bvh;
+	for (size_t i = 0; i < staticCount; ++i)
+		bvh.Insert(makeBox(random, halfSide), nullptr);
+
+	std::vector<uint32_t> dynamicProxies;
+	std::vector<glm::vec3> velocities;
+	std::uniform_real_distribution<float> speed(-20.f, 20.f);
+	for (size_t i = 0; i < dynamicCount; ++i)
+	{
+		dynamicProxies.push_back(bvh.Insert(makeBox(random, halfSide), nullptr));
+		velocities.push_back(glm::vec3(speed(random), speed(random), speed(random)));
+	}
+
+	Clock::time_point start = Clock::now();
+	bvh.Build();
+	std::cout << "BVH benchmark : " << staticCount << " static and " << dynamicCount << " dynamic boxes, " << bvh.GetNodeCount() << " nodes, SAH cost "
+		<< bvh.GetCost() << ", build " << milliseconds(start) << " ms" << std::endl;
+
+	// The dynamic boxes move every frame, bouncing on the borders of the scene
+	const float deltaTime = 1.f / 60.f;
+	const uint32_t initialBuildCount = bvh.GetBuildCount();
+	double totalUpdate = 0.0;
+	double maxUpdate = 0.0;
+
+	for (size_t frame = 0; frame < frameCount; ++frame)
+	{
+		start = Clock::now();
+
+		for (size_t i = 0; i < dynamicProxies.size(); ++i)
+		{
+			LeAabb box = bvh.GetBox(dynamicProxies[i]);
+			glm::vec3 offset = velocities[i] * deltaTime;
+
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				if (box.min[axis] + offset[axis] < -halfSide || box.max[axis] + offset[axis] > halfSide)
+				{
+					velocities[i][axis] = -velocities[i][axis];
+					offset[axis] = -offset[axis];
+				}
+			}
+
+			box.min += offset;
+			box.max += offset;
+
+			bvh.MarkMoved(dynamicProxies[i]);
+			bvh.SetBox(dynamicProxies[i], box);
+		}
+
+		bvh.Update();
+
+		double elapsed = milliseconds(start);
+		totalUpdate += elapsed;
+		maxUpdate = std::max(maxUpdate, elapsed);
+	}
+
+	std::cout << "  Update : " << totalUpdate / frameCount << " ms/frame on average, " << maxUpdate << " ms at most, "
+		<< bvh.GetBuildCount() - initialBuildCount << " builds in " << frameCount << " frames, SAH cost " << bvh.GetCost() << std::endl;
+
+	// Queries of a fixed size, their cost grows with the depth of the tree
+	auto measureQueries = [&milliseconds](const SceneBvh& tree, float side, size_t queryCount, const std::string& prefix)
+	{
+		std::mt19937 queryRandom(11);
+		std::uniform_real_distribution<float> position(-side, side);
+		std::uniform_real_distribution<float> unit(-1.f, 1.f);
+		std::vector<uint32_t> results;
+
+		size_t sphereResults = 0;
+		Clock::time_point queryStart = Clock::now();
+		for (size_t i = 0; i < queryCount; ++i)
+		{
+			results.clear();
+			tree.QuerySphere(glm::vec3(position(queryRandom), position(queryRandom), position(queryRandom)), 10.f, results);
+			sphereResults += results.size();
+		}
+		double sphereTime = milliseconds(queryStart) * 1000.0 / queryCount;
+
+		size_t boxResults = 0;
+		queryStart = Clock::now();
+		for (size_t i = 0; i < queryCount; ++i)
+		{
+			LeAabb box;
+			box.min = glm::vec3(position(queryRandom), position(queryRandom), position(queryRandom));
+			box.max = box.min + glm::vec3(20.f);
+			results.clear();
+			tree.QueryBox(box, results);
+			boxResults += results.size();
+		}
+		double boxTime = milliseconds(queryStart) * 1000.0 / queryCount;
+
+		size_t rayHits = 0;
+		queryStart = Clock::now();
+		for (size_t i = 0; i < queryCount; ++i)
+		{
+			SceneBvh::RayHit hit;
+			glm::vec3 origin(position(queryRandom), position(queryRandom), position(queryRandom));
+			rayHits += tree.RayCast(origin, glm::vec3(unit(queryRandom), unit(queryRandom), unit(queryRandom)), 100.f, hit) ? 1 : 0;
+		}
+		double rayTime = milliseconds(queryStart) * 1000.0 / queryCount;
+
+		std::cout << prefix << "sphere " << sphereTime << " us (" << double(sphereResults) / queryCount << " results), box " << boxTime << " us ("
+			<< double(boxResults) / queryCount << " results), ray " << rayTime << " us (" << 100.0 * rayHits / queryCount << "% hits)" << std::endl;
+	};
+
+	measureQueries(bvh, halfSide, 10000, "  Queries : ");
+
+	// A camera in the middle of the scene seeing 200 units away
+	glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+	glm::mat4 proj = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 200.f);
+	proj[1][1] *= -1;
+
+	LeFrustum frustum;
+	frustum.ExtractPlanes(proj * view);
+
+	std::vector<uint32_t> results;
+	start = Clock::now();
+	bvh.QueryFrustum(frustum, results);
+	double frustumTime = milliseconds(start);
+
+	// Checked against every box
+	size_t bruteForceCount = 0;
+	start = Clock::now();
+	for (uint32_t proxy = 0; proxy < bvh.GetProxyCount(); ++proxy)
+		bruteForceCount += frustum.IsBoxVisible(bvh.GetBox(proxy)) ? 1 : 0;
+	double bruteForceTime = milliseconds(start);
+
+	std::cout << "  Frustum : " << results.size() << " boxes in " << frustumTime << " ms, " << bruteForceCount << " in " << bruteForceTime
+		<< " ms testing every box" << (results.size() == bruteForceCount ? "" : " (MISMATCH)") << std::endl;
+
+	// Static trees of growing size at the same density
+	for (size_t count = std::max<size_t>(staticCount / 100, 1); count <= staticCount; count *= 10)
+	{
+		std::mt19937 scaleRandom(13);
+		float scaleSide = getHalfSide(count);
+
+		SceneBvh scaled;
+		for (size_t i = 0; i < count; ++i)
+			scaled.Insert(makeBox(scaleRandom, scaleSide), nullptr);
+		scaled.Build();
+
+		measureQueries(scaled, scaleSide, 10000, "  " + std::to_string(count) + " boxes : ");
+	}
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "LeFrustum.h"
+
+// Bounding volume hierarchy over the boxes of proxies, built with the binned surface area heuristic.
+// Moved proxies only refit the boxes of their ancestors, the tree is built again once the refits made it
+// too expensive to traverse or too many proxies were added since the last build.
+// Proxies without bounds stay out of the tree and are reported by every overlap query, never by rays.
+class SceneBvh
+{
+public:
+	static const uint32_t invalidIndex = 0xFFFFFFFF;
+	static const uint32_t maxLeafItems = 4;
+	static const uint32_t binCount = 16;
+
+	// Refitted cost over the cost of the last build beyond which the tree is built again
+	static constexpr float maxCostRatio = 1.6f;
+
+	struct RayHit
+	{
+		uint32_t	proxy = invalidIndex;
+		float		distance = 0.f;
+	};
+
+	SceneBvh() = default;
+	~SceneBvh() = default;
+
+	uint32_t Insert(const LeAabb& box, void* userData);
+	void Remove(uint32_t proxy);
+
+	// Queues the proxy for the next Update, cheap enough for every transform setter
+	void MarkMoved(uint32_t proxy);
+	const std::vector<uint32_t>& GetMovedProxies() const { return movedProxies; }
+
+	// New box of a proxy, applied to the tree by Update
+	void SetBox(uint32_t proxy, const LeAabb& box);
+
+	// Refits the ancestors of the changed proxies, or builds the tree again when it degraded
+	void Update();
+	void Build();
+
+	void* GetUserData(uint32_t proxy) const { return proxies[proxy].userData; }
+	const LeAabb& GetBox(uint32_t proxy) const { return proxies[proxy].box; }
+	size_t GetProxyCount() const { return proxies.size() - freeProxies.size(); }
+	size_t GetNodeCount() const { return nodes.size(); }
+	uint32_t GetBuildCount() const { return buildCount; }
+
+	// Surface area heuristic cost of the tree, relative to its root box
+	float GetCost() const;
+
+	// Overlap queries append the proxies they find to results
+	void QueryFrustum(const LeFrustum& frustum, std::vector<uint32_t>& results) const;
+	void QuerySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& results) const;
+	void QueryBox(const LeAabb& box, std::vector<uint32_t>& results) const;
+
+	// Closest proxy box along the ray, direction doesn't need to be normalized, distances are in its unit
+	bool RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const;
+
+private:
+	struct Proxy
+	{
+		LeAabb	box;
+		void*	userData = nullptr;
+		uint32_t leaf = invalidIndex;		// Node holding the proxy, invalidIndex out of the tree
+		bool	moved = false;
+		bool	alive = false;
+	};
+
+	// Depth first order, the left child of an internal node follows it
+	struct Node
+	{
+		LeAabb		box;
+		uint32_t	parent;
+		uint32_t	right;			// Internal nodes
+		uint32_t	firstItem;		// Leaves, in items
+		uint32_t	itemCount;		// 0 for internal nodes
+	};
+
+	struct BuildItem
+	{
+		LeAabb		box;
+		glm::vec3	centroid;
+		uint32_t	proxy;
+	};
+
+	uint32_t BuildNode(std::vector<BuildItem>& buildItems, uint32_t first, uint32_t count, uint32_t parent);
+	void RefitNode(uint32_t index);
+	void RemoveFromTree(uint32_t proxy);
+	void MarkDirty(uint32_t node);
+	void UpdateNodeCost(const Node& node, const LeAabb& previousBox, uint32_t previousCount);
+
+	template<typename NodeTest, typename ItemTest>
+	void Query(NodeTest nodeTest, ItemTest itemTest, std::vector<uint32_t>& results) const;
+	void AppendSubtree(uint32_t node, std::vector<uint32_t>& results) const;
+
+	std::vector<Proxy>		proxies;
+	std::vector<uint32_t>	freeProxies;
+	std::vector<uint32_t>	movedProxies;
+
+	// Proxies added since the last build and proxies without bounds
+	std::vector<uint32_t>	outsideProxies;
+
+	std::vector<Node>		nodes;
+	std::vector<uint32_t>	items;
+	std::vector<uint8_t>	dirtyNodes;		// Nodes to refit and all their ancestors
+
+	// Sum of the node areas, weighted by the item count of the leaves
+	double		weightedArea = 0.0;
+	float		builtCost = 0.f;
+	uint32_t	buildCount = 0;
+};
+
+class BvhBenchmark
+{
+public:
+	BvhBenchmark() = delete;
+	~BvhBenchmark() = delete;
+
+	// Prints the build, per frame update and query times of staticCount fixed boxes and dynamicCount moving ones
+	static void Run(size_t staticCount, size_t dynamicCount, size_t frameCount);
+};
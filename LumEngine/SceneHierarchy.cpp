@@ -0,0 +1,418 @@
+#include "SceneHierarchy.h"
+#include "SceneNode.h"
+#include "TransformStore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+const uint32_t SceneHierarchy::invalidIndex;
+
+void SceneHierarchy::Add(SceneNode* node)
+{
+	uint32_t entry = AddEntry(node, invalidIndex);
+	worlds[entry] = node->GetTransformation();
+}
+
+uint32_t SceneHierarchy::AddEntry(SceneNode* node, uint32_t parent)
+{
+	uint32_t entry = static_cast<uint32_t>(nodes.size());
+
+	nodes.push_back(node);
+	parents.push_back(invalidIndex);
+	worlds.push_back(glm::mat4(1.f));
+	flags.push_back(0);
+	subtreeLasts.push_back(entry);
+	firstChildren.push_back(invalidIndex);
+	nextSiblings.push_back(invalidIndex);
+	previousSiblings.push_back(invalidIndex);
+
+	Link(entry, parent);
+	node->SetHierarchyEntry(this, entry);
+	return entry;
+}
+
+void SceneHierarchy::Link(uint32_t entry, uint32_t parent)
+{
+	parents[entry] = parent;
+	if (parent == invalidIndex)
+		return;
+
+	uint32_t next = firstChildren[parent];
+	nextSiblings[entry] = next;
+	previousSiblings[entry] = invalidIndex;
+
+	if (next != invalidIndex)
+		previousSiblings[next] = entry;
+
+	firstChildren[parent] = entry;
+
+	for (uint32_t ancestor = parent; ancestor != invalidIndex && subtreeLasts[ancestor] < subtreeLasts[entry]; ancestor = parents[ancestor])
+		subtreeLasts[ancestor] = subtreeLasts[entry];
+}
+
+void SceneHierarchy::Unlink(uint32_t entry)
+{
+	uint32_t parent = parents[entry];
+	if (parent == invalidIndex)
+		return;
+
+	uint32_t previous = previousSiblings[entry];
+	uint32_t next = nextSiblings[entry];
+
+	if (previous != invalidIndex)
+		nextSiblings[previous] = next;
+	else
+		firstChildren[parent] = next;
+
+	if (next != invalidIndex)
+		previousSiblings[next] = previous;
+
+	parents[entry] = invalidIndex;
+	nextSiblings[entry] = invalidIndex;
+	previousSiblings[entry] = invalidIndex;
+}
+
+void SceneHierarchy::SetParent(SceneNode* node, SceneNode* parent)
+{
+	if (node->GetHierarchy() != this || (parent && parent->GetHierarchy() != this))
+		throw std::runtime_error("Scene nodes can only be parented inside the hierarchy of their scene!");
+
+	uint32_t entry = node->GetHierarchyEntry();
+	uint32_t parentEntry = parent ? parent->GetHierarchyEntry() : invalidIndex;
+
+	if (parents[entry] == parentEntry)
+		return;
+
+	for (uint32_t ancestor = parentEntry; ancestor != invalidIndex; ancestor = parents[ancestor])
+	{
+		if (ancestor == entry)
+			throw std::runtime_error("A scene node can't be parented to a node of its own subtree!");
+	}
+
+	Unlink(entry);
+
+	// Parents stay before their children
+	if (parentEntry != invalidIndex && parentEntry > entry)
+		entry = MoveSubtree(entry, parentEntry);
+	else
+		Link(entry, parentEntry);
+
+	MarkDirty(entry);
+}
+
+uint32_t SceneHierarchy::MoveSubtree(uint32_t entry, uint32_t parent)
+{
+	// Pairs of an entry to move and the new entry of its parent, parents are appended before their children
+	std::vector<uint32_t> pending = { entry, parent };
+	uint32_t movedRoot = invalidIndex;
+
+	while (!pending.empty())
+	{
+		uint32_t newParent = pending.back();
+		pending.pop_back();
+		uint32_t previous = pending.back();
+		pending.pop_back();
+
+		uint32_t moved = AddEntry(nodes[previous], newParent);
+		worlds[moved] = worlds[previous];
+
+		if (flags[previous] & Dirty)
+			MarkDirty(moved);
+
+		if (movedRoot == invalidIndex)
+			movedRoot = moved;
+
+		for (uint32_t child = firstChildren[previous]; child != invalidIndex; child = nextSiblings[child])
+		{
+			pending.push_back(child);
+			pending.push_back(moved);
+		}
+
+		nodes[previous] = nullptr;
+		parents[previous] = invalidIndex;
+		flags[previous] = 0;
+		firstChildren[previous] = invalidIndex;
+		++holeCount;
+	}
+
+	return movedRoot;
+}
+
+SceneNode* SceneHierarchy::GetParent(uint32_t entry) const
+{
+	return parents[entry] != invalidIndex ? nodes[parents[entry]] : nullptr;
+}
+
+void SceneHierarchy::MarkDirty(uint32_t entry)
+{
+	if (flags[entry] & Dirty)
+		return;
+
+	flags[entry] |= Dirty;
+	dirtyEntries.push_back(entry);
+}
+
+void SceneHierarchy::Compact()
+{
+	std::vector<uint32_t> remap(nodes.size(), invalidIndex);
+	uint32_t count = 0;
+
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		if (nodes[i])
+			remap[i] = count++;
+	}
+
+	auto remapIndex = [&remap](uint32_t index) { return index != invalidIndex ? remap[index] : invalidIndex; };
+
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		uint32_t entry = remap[i];
+		if (entry == invalidIndex)
+			continue;
+
+		nodes[entry] = nodes[i];
+		parents[entry] = remapIndex(parents[i]);
+		worlds[entry] = worlds[i];
+		flags[entry] = flags[i];
+		firstChildren[entry] = remapIndex(firstChildren[i]);
+		nextSiblings[entry] = remapIndex(nextSiblings[i]);
+		previousSiblings[entry] = remapIndex(previousSiblings[i]);
+
+		nodes[entry]->SetHierarchyEntry(this, entry);
+	}
+
+	nodes.resize(count);
+	parents.resize(count);
+	worlds.resize(count);
+	flags.resize(count);
+	firstChildren.resize(count);
+	nextSiblings.resize(count);
+	previousSiblings.resize(count);
+	subtreeLasts.resize(count);
+	holeCount = 0;
+
+	// Exact again, children come after their parent
+	for (uint32_t entry = 0; entry < count; ++entry)
+		subtreeLasts[entry] = entry;
+
+	for (uint32_t entry = count; entry-- > 0;)
+	{
+		if (parents[entry] != invalidIndex)
+			subtreeLasts[parents[entry]] = std::max(subtreeLasts[parents[entry]], subtreeLasts[entry]);
+	}
+
+	std::vector<uint32_t> remainingDirty;
+	for (uint32_t entry : dirtyEntries)
+	{
+		if (remap[entry] != invalidIndex)
+			remainingDirty.push_back(remap[entry]);
+	}
+
+	dirtyEntries.swap(remainingDirty);
+}
+
+size_t SceneHierarchy::Update()
+{
+	if (holeCount > 0 && holeCount * 2 >= nodes.size())
+		Compact();
+
+	if (dirtyEntries.empty())
+		return 0;
+
+	// Every entry to compute lies between a dirty entry and the last entry of its subtree, parents are
+	// computed before their children since the scan only moves forward
+	std::sort(dirtyEntries.begin(), dirtyEntries.end());
+	scannedRanges.clear();
+
+	size_t computedCount = 0;
+	uint32_t next = 0;
+
+	for (uint32_t dirty : dirtyEntries)
+	{
+		Range range = { std::max(next, dirty), subtreeLasts[dirty] };
+		if (range.last < range.first)
+			continue;
+
+		for (uint32_t i = range.first; i <= range.last; ++i)
+		{
+			uint32_t parent = parents[i];
+			bool parentChanged = parent != invalidIndex && (flags[parent] & Changed);
+
+			if (!parentChanged && !(flags[i] & Dirty))
+				continue;
+
+			SceneNode* node = nodes[i];
+			worlds[i] = parent != invalidIndex ? worlds[parent] * node->GetTransformation() : node->GetTransformation();
+
+			// Descendants move with their parent without a transformation change of their own
+			if (!(flags[i] & Dirty))
+				node->WorldChanged();
+
+			flags[i] = Changed;
+			++computedCount;
+		}
+
+		scannedRanges.push_back(range);
+		next = range.last + 1;
+	}
+
+	for (const Range& range : scannedRanges)
+		std::fill(flags.begin() + range.first, flags.begin() + range.last + 1, uint8_t(0));
+
+	dirtyEntries.clear();
+	return computedCount;
+}
+
+void HierarchyBenchmark::Run(size_t nodeCount, size_t treeSize, float movedRootRatio, size_t frameCount)
+{
+	// Random trees, every node parented to a node of its tree added before it
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> offset(-2.f, 2.f);
+	std::uniform_real_distribution<float> angle(-180.f, 180.f);
+
+	std::vector<SceneNode> nodes(nodeCount);
+	TransformStore store;
+	SceneHierarchy hierarchy;
+
+	for (SceneNode& node : nodes)
+	{
+		node.SetTransformSlot(&store, store.Add());
+		node.SetPosition(glm::vec3(offset(random), offset(random), offset(random)));
+		node.SetRotation(glm::vec3(angle(random), angle(random), angle(random)));
+		hierarchy.Add(&node);
+	}
+
+	const size_t treeCount = nodeCount / treeSize;
+	for (size_t tree = 0; tree < treeCount; ++tree)
+	{
+		size_t root = tree * treeSize;
+		for (size_t i = 1; i < treeSize; ++i)
+			nodes[root + i].SetParent(&nodes[root + std::uniform_int_distribution<size_t>(0, i - 1)(random)]);
+	}
+
+	store.Update();
+	hierarchy.Update();
+
+	// Reference : every world matrix again, recursively through children pointers
+	std::vector<std::vector<size_t>> children(nodeCount);
+	auto findChildren = [&]()
+	{
+		for (std::vector<size_t>& nodeChildren : children)
+			nodeChildren.clear();
+
+		for (size_t i = 0; i < nodeCount; ++i)
+		{
+			SceneNode* parent = nodes[i].GetParent();
+			if (parent)
+				children[parent - nodes.data()].push_back(i);
+		}
+	};
+
+	std::vector<glm::mat4> referenceWorlds(nodeCount);
+	std::function<void(size_t, const glm::mat4&)> propagate = [&](size_t node, const glm::mat4& parentWorld)
+	{
+		referenceWorlds[node] = parentWorld * nodes[node].GetTransformation();
+		for (size_t child : children[node])
+			propagate(child, referenceWorlds[node]);
+	};
+
+	auto updateReference = [&]()
+	{
+		for (size_t i = 0; i < nodeCount; ++i)
+		{
+			if (!nodes[i].GetParent())
+				propagate(i, glm::mat4(1.f));
+		}
+	};
+
+	auto compare = [&]()
+	{
+		float maxError = 0.f;
+		for (size_t i = 0; i < nodeCount; ++i)
+		{
+			glm::mat4 world = nodes[i].GetWorldTransformation();
+			for (int column = 0; column < 4; ++column)
+			{
+				glm::vec4 error = glm::abs(world[column] - referenceWorlds[i][column]);
+				maxError = std::max(maxError, std::max(std::max(error.x, error.y), std::max(error.z, error.w)));
+			}
+		}
+		return maxError;
+	};
+
+	std::cout << "Hierarchy benchmark : " << nodeCount << " nodes in " << treeCount << " trees, " << movedRootRatio * 100.f
+		<< "% of the roots moved every frame, " << frameCount << " frames" << std::endl;
+
+	auto measure = [&](const std::string& name, const std::function<size_t()>& runFrame)
+	{
+		size_t computedCount = 0;
+		double seconds = 0.0;
+
+		for (size_t frame = 0; frame < frameCount; ++frame)
+		{
+			const size_t movedRoots = std::max<size_t>(1, static_cast<size_t>(treeCount * movedRootRatio));
+			for (size_t i = 0; i < movedRoots; ++i)
+			{
+				SceneNode& root = nodes[std::uniform_int_distribution<size_t>(0, treeCount - 1)(random) * treeSize];
+				root.SetPosition(root.GetPosition() + glm::vec3(offset(random), 0.f, offset(random)));
+			}
+
+			store.Update();
+
+			auto start = std::chrono::high_resolution_clock::now();
+			computedCount += runFrame();
+			seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+
+		std::cout << "  " << name << " : " << seconds * 1000.0 / frameCount << " ms/frame, "
+			<< computedCount / frameCount << " world matrices per frame" << std::endl;
+	};
+
+	findChildren();
+	measure("Recursive traversal of every node", [&]()
+	{
+		updateReference();
+		return nodeCount;
+	});
+
+	hierarchy.Update();
+	measure("Flat pass over the moved subtrees", [&]() { return hierarchy.Update(); });
+
+	updateReference();
+	std::cout << "  Largest difference to the recursive traversal : " << compare() << std::endl;
+
+	// Subtrees below the roots moved to other trees
+	const size_t reparentCount = 1000;
+	size_t movedNodes = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (size_t i = 0; i < reparentCount; ++i)
+	{
+		SceneNode& node = nodes[std::uniform_int_distribution<size_t>(0, nodeCount - 1)(random)];
+		SceneNode& parent = nodes[std::uniform_int_distribution<size_t>(0, treeCount - 1)(random) * treeSize];
+
+		bool cycle = false;
+		for (SceneNode* ancestor = &parent; ancestor; ancestor = ancestor->GetParent())
+			cycle |= ancestor == &node;
+
+		if (cycle)
+			continue;
+
+		size_t previousEntries = hierarchy.GetEntryCount();
+		node.SetParent(&parent);
+		movedNodes += hierarchy.GetEntryCount() - previousEntries;
+	}
+
+	double reparentSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	size_t computedCount = hierarchy.Update();
+
+	findChildren();
+	updateReference();
+	std::cout << "  Reparenting : " << reparentSeconds * 1e6 / reparentCount << " us per node, " << double(movedNodes) / reparentCount
+		<< " entries moved on average, " << computedCount << " world matrices in the next update, largest difference " << compare() << std::endl;
+}
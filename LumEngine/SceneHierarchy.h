@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+class SceneNode;
+
+// Parent links and world matrices of scene nodes, stored flat with every parent before its children.
+// Update propagates the world matrices in one forward pass that only scans from each dirty entry to the
+// last entry of its subtree, entries of other subtrees in between are skipped without touching their matrices.
+// Reparenting moves the subtree to the end of the arrays when the new parent comes after it, the holes left
+// behind are compacted once they make up half of the entries.
+class SceneHierarchy
+{
+public:
+	static const uint32_t invalidIndex = 0xFFFFFFFF;
+
+	SceneHierarchy() = default;
+	~SceneHierarchy() = default;
+
+	// The node joins as a root
+	void Add(SceneNode* node);
+
+	// Moves the node and its subtree under parent, a root when parent is nullptr. Linear in the subtree size
+	void SetParent(SceneNode* node, SceneNode* parent);
+	SceneNode* GetParent(uint32_t entry) const;
+	bool HasParent(uint32_t entry) const { return parents[entry] != invalidIndex; }
+
+	// The local transformation of the entry changed, its world matrix and the ones below it are computed again
+	void MarkDirty(uint32_t entry);
+
+	// Up to date after Update
+	const glm::mat4& GetWorld(uint32_t entry) const { return worlds[entry]; }
+
+	// Returns the number of world matrices computed
+	size_t Update();
+
+	size_t GetEntryCount() const { return nodes.size(); }
+	size_t GetNodeCount() const { return nodes.size() - holeCount; }
+
+private:
+	enum Flags : uint8_t
+	{
+		Dirty = 1,			// Local transformation changed
+		Changed = 2			// World matrix computed in the current pass
+	};
+
+	// Scanned by the current pass, cleared at its end
+	struct Range
+	{
+		uint32_t first;
+		uint32_t last;
+	};
+
+	uint32_t AddEntry(SceneNode* node, uint32_t parent);
+	void Link(uint32_t entry, uint32_t parent);
+	void Unlink(uint32_t entry);
+	uint32_t MoveSubtree(uint32_t entry, uint32_t parent);
+	void Compact();
+
+	std::vector<SceneNode*>	nodes;			// nullptr for the holes
+	std::vector<uint32_t>	parents;
+	std::vector<glm::mat4>	worlds;
+	std::vector<uint8_t>	flags;
+
+	// No descendant comes after it, only grows until the next compaction
+	std::vector<uint32_t>	subtreeLasts;
+
+	// Children lists, only walked when a subtree moves
+	std::vector<uint32_t>	firstChildren;
+	std::vector<uint32_t>	nextSiblings;
+	std::vector<uint32_t>	previousSiblings;
+
+	std::vector<uint32_t>	dirtyEntries;
+	std::vector<Range>		scannedRanges;
+	size_t					holeCount = 0;
+};
+
+class HierarchyBenchmark
+{
+public:
+	HierarchyBenchmark() = delete;
+	~HierarchyBenchmark() = delete;
+
+	// Prints the world matrix update times of a forest of nodeCount nodes in trees of treeSize nodes, moving movedRootRatio of the roots every frame
+	static void Run(size_t nodeCount, size_t treeSize, float movedRootRatio, size_t frameCount);
+};
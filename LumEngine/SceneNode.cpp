@@ -1,10 +1,25 @@
 #include "SceneNode.h"
+#include "SceneBvh.h"
+#include "TransformStore.h"
+#include "SceneHierarchy.h"
+
+#include <stdexcept>
 
 SceneNode::SceneNode()
 {
 	position = { 0.f, 0.f, 0.f };
 	rotation = { 0.f, 0.f, 0.f };
 	scale = { 1.0f, 1.0f, 1.0f };
+	importTransform = glm::mat4(1.0);
+	transformVersion = 0;
+	spatialIndex = nullptr;
+	spatialProxy = SceneBvh::invalidIndex;
+	transformStore = nullptr;
+	transformSlot = 0;
+	hierarchy = nullptr;
+	hierarchyEntry = SceneHierarchy::invalidIndex;
+	entityRegistry = nullptr;
+	entity = invalidEntity;
 	isVisible = true;
 	isTransparent = false;
 }
@@ -14,9 +29,104 @@ SceneNode::~SceneNode()
 
 }
 
+void SceneNode::SetSpatialProxy(SceneBvh* index, uint32_t proxy)
+{
+	spatialIndex = index;
+	spatialProxy = proxy;
+}
+
+void SceneNode::SetTransformSlot(TransformStore* store, uint32_t slot)
+{
+	transformStore = store;
+	transformSlot = slot;
+	TransformChanged();
+}
+
+void SceneNode::SetEntity(EntityRegistry* registry, Entity newEntity)
+{
+	entityRegistry = registry;
+	entity = newEntity;
+}
+
+void SceneNode::SetVisible(bool visible)
+{
+	isVisible = visible;
+
+	if (entityRegistry)
+		entityRegistry->visibilities.Get(entity).visible = visible;
+}
+
+void SceneNode::SetTransparent(bool transparent)
+{
+	isTransparent = transparent;
+
+	if (entityRegistry)
+		entityRegistry->visibilities.Get(entity).transparent = transparent;
+}
+
+void SceneNode::SetHierarchyEntry(SceneHierarchy* newHierarchy, uint32_t entry)
+{
+	hierarchy = newHierarchy;
+	hierarchyEntry = entry;
+}
+
+void SceneNode::SetParent(SceneNode* parent)
+{
+	if (!hierarchy)
+		throw std::runtime_error("Only the nodes of a scene can have a parent!");
+
+	hierarchy->SetParent(this, parent);
+}
+
+SceneNode* SceneNode::GetParent() const
+{
+	return hierarchy ? hierarchy->GetParent(hierarchyEntry) : nullptr;
+}
+
+glm::mat4x4 SceneNode::GetWorldTransformation()
+{
+	if (hierarchy && hierarchy->HasParent(hierarchyEntry))
+		return hierarchy->GetWorld(hierarchyEntry);
+
+	return GetTransformation();
+}
+
+void SceneNode::WorldChanged()
+{
+	++transformVersion;
+
+	if (spatialIndex)
+		spatialIndex->MarkMoved(spatialProxy);
+}
+
+void SceneNode::TransformChanged()
+{
+	++transformVersion;
+
+	if (spatialIndex)
+		spatialIndex->MarkMoved(spatialProxy);
+
+	if (hierarchy)
+		hierarchy->MarkDirty(hierarchyEntry);
+
+	if (transformStore)
+	{
+		// Same rotation order as the per node path : Y, then X, then Z
+		glm::quat quaternion = glm::angleAxis(glm::radians(rotation.y), glm::vec3(0.f, 1.f, 0.f))
+			* glm::angleAxis(glm::radians(rotation.x), glm::vec3(1.f, 0.f, 0.f))
+			* glm::angleAxis(glm::radians(rotation.z), glm::vec3(0.f, 0.f, 1.f));
+
+		transformStore->Set(transformSlot, position, quaternion, scale, importTransform);
+	}
+}
+
 void SceneNode::SetPosition(glm::vec3 newPosition)
 {
+	if (newPosition == position)
+		return;
+
 	position = newPosition;
+	TransformChanged();
 }
 
 glm::vec3 SceneNode::GetPosition()
@@ -31,7 +141,11 @@ glm::vec3 SceneNode::GetRotation()
 
 void SceneNode::SetRotation(glm::vec3 newEulerAngles)
 {
+	if (newEulerAngles == rotation)
+		return;
+
 	rotation = newEulerAngles;
+	TransformChanged();
 }
 
 glm::vec3 SceneNode::GetScale()
@@ -41,7 +155,20 @@ glm::vec3 SceneNode::GetScale()
 
 void SceneNode::SetScale(glm::vec3 newScale)
 {
+	if (newScale == scale)
+		return;
+
 	scale = newScale;
+	TransformChanged();
+}
+
+void SceneNode::SetImportTransform(const glm::mat4& transform)
+{
+	if (transform == importTransform)
+		return;
+
+	importTransform = transform;
+	TransformChanged();
 }
 
 void SceneNode::SetInitialValue(glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, bool visible)
@@ -63,6 +190,9 @@ void SceneNode::SetInitialValue(glm::vec3 position, glm::vec3 rotation, glm::vec
 #include <iostream>
 glm::mat4x4 SceneNode::GetTransformation()
 {
+	if (transformStore)
+		return transformStore->GetMatrix(transformSlot);
+
 	glm::mat4x4 transformation = glm::mat4(1.0);
 
     transformation = glm::scale(transformation, scale);
@@ -75,22 +205,22 @@ glm::mat4x4 SceneNode::GetTransformation()
     
     transformation = glm::translate(transformation, position);
 
-	return transformation;
+	return transformation * importTransform;
 }
 
 void SceneNode::ResetPosition()
 {
-	position = initialPosition;
+	SetPosition(initialPosition);
 }
 
 void SceneNode::ResetRotation()
 {
-	rotation = initialRotation;
+	SetRotation(initialRotation);
 }
 
 void SceneNode::ResetScale()
 {
-	scale = initialScale;
+	SetScale(initialScale);
 }
 
 void SceneNode::Reset()
@@ -98,5 +228,5 @@ void SceneNode::Reset()
 	ResetPosition();
 	ResetRotation(); 
 	ResetScale();
-	isVisible = initialIsVisible;
+	SetVisible(initialIsVisible);
 }
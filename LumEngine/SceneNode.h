@@ -5,6 +5,12 @@
 #include <glm/vec3.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "EntityRegistry.h"
+
+class SceneBvh;
+class TransformStore;
+class SceneHierarchy;
+
 class SceneNode
 {
 public:
@@ -17,24 +23,81 @@ public:
 	glm::vec3	GetScale();
 	void		SetRotation(glm::vec3 newEulerAngles);
 	void		SetScale(glm::vec3 newScale);
+
+	// Transform from the imported model hierarchy, applied before the node transform
+	void		SetImportTransform(const glm::mat4& transform);
 	
 	void		SetInitialValue(glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, bool visible);
 
 	glm::mat4x4 GetTransformation();
 
+	// Transformation relative to the parent composed with the world matrix of the parent, up to date after
+	// SceneHierarchy::Update. Nodes without parent return their own transformation
+	glm::mat4x4 GetWorldTransformation();
+
+	// Both nodes must belong to the hierarchy of the same scene, nullptr makes the node a root
+	void		SetParent(SceneNode* parent);
+	SceneNode*	GetParent() const;
+
+	// Changes whenever the transformation does, caches derived from it compare it
+	uint32_t	GetTransformVersion() const { return transformVersion; }
+
+	// Proxy of the node in the spatial index of its scene, told about every transformation change
+	void		SetSpatialProxy(SceneBvh* index, uint32_t proxy);
+	uint32_t	GetSpatialProxy() const { return spatialProxy; }
+
+	// Slot of the node in the transform store of its scene, which composes the transformation from then on
+	void		SetTransformSlot(TransformStore* store, uint32_t slot);
+	uint32_t	GetTransformSlot() const { return transformSlot; }
+
+	// Entry of the node in the hierarchy of its scene, kept by the hierarchy as its arrays move
+	void			SetHierarchyEntry(SceneHierarchy* hierarchy, uint32_t entry);
+	SceneHierarchy*	GetHierarchy() const { return hierarchy; }
+	uint32_t		GetHierarchyEntry() const { return hierarchyEntry; }
+
+	// The world matrix changed with the one of an ancestor
+	void		WorldChanged();
+
+	// Entity of the node in the registry of its scene, the flags below are mirrored in its components
+	void		SetEntity(EntityRegistry* registry, Entity entity);
+	Entity		GetEntity() const { return entity; }
+
+	void		SetVisible(bool visible);
+	bool		IsVisible() const { return isVisible; }
+	void		SetTransparent(bool transparent);
+	bool		IsTransparent() const { return isTransparent; }
+
 	void Reset();
 	void ResetPosition();
 	void ResetRotation();
 	void ResetScale();
 
-	bool isVisible;
-	bool isTransparent;
 	bool isScaleHomothety;
 
+protected:
+	EntityRegistry*	entityRegistry;
+	Entity			entity;
+
 private:
+	void TransformChanged();
+
+	bool isVisible;
+	bool isTransparent;
+
 	glm::vec3 position;
 	glm::vec3 rotation;
 	glm::vec3 scale;
+	glm::mat4 importTransform;
+	uint32_t  transformVersion;
+
+	SceneBvh*	spatialIndex;
+	uint32_t	spatialProxy;
+
+	TransformStore*	transformStore;
+	uint32_t		transformSlot;
+
+	SceneHierarchy*	hierarchy;
+	uint32_t		hierarchyEntry;
 
 	glm::vec3	initialPosition;
 	glm::vec3	initialRotation;
@@ -0,0 +1,190 @@
+#include "Skinning.h"
+#include "MeshLoader.h"
+#include "Animation.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <iostream>
+#include <xmmintrin.h>
+
+void CpuSkinning::SkinScalar(const SkinJob& job, size_t first, size_t count)
+{
+	for (size_t i = first; i < first + count; ++i)
+	{
+		const VertexSkin& skin = job.skin[i];
+
+		glm::mat4 matrix = job.matrices[skin.joints[0]] * skin.weights[0]
+			+ job.matrices[skin.joints[1]] * skin.weights[1]
+			+ job.matrices[skin.joints[2]] * skin.weights[2]
+			+ job.matrices[skin.joints[3]] * skin.weights[3];
+
+		job.outPositions[i] = glm::vec3(matrix * glm::vec4(job.positions[i], 1.f));
+
+		job.outAttributes[i] = job.attributes[i];
+		job.outAttributes[i].normal = glm::normalize(glm::vec3(matrix * glm::vec4(job.attributes[i].normal, 0.f)));
+	}
+}
+
+void CpuSkinning::SkinSimd(const SkinJob& job, size_t first, size_t count)
+{
+	alignas(16) float position[4];
+	alignas(16) float normal[4];
+
+	for (size_t i = first; i < first + count; ++i)
+	{
+		const VertexSkin& skin = job.skin[i];
+
+		__m128 c0 = _mm_setzero_ps(), c1 = _mm_setzero_ps(), c2 = _mm_setzero_ps(), c3 = _mm_setzero_ps();
+
+		// glm matrices are column major, each column is one load
+		for (int k = 0; k < 4; ++k)
+		{
+			const float* m = &job.matrices[skin.joints[k]][0][0];
+			__m128 w = _mm_set1_ps(skin.weights[k]);
+
+			c0 = _mm_add_ps(c0, _mm_mul_ps(_mm_loadu_ps(m + 0), w));
+			c1 = _mm_add_ps(c1, _mm_mul_ps(_mm_loadu_ps(m + 4), w));
+			c2 = _mm_add_ps(c2, _mm_mul_ps(_mm_loadu_ps(m + 8), w));
+			c3 = _mm_add_ps(c3, _mm_mul_ps(_mm_loadu_ps(m + 12), w));
+		}
+
+		const glm::vec3& p = job.positions[i];
+		__m128 skinnedPosition = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p.x)), _mm_mul_ps(c1, _mm_set1_ps(p.y))), _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(p.z)), c3));
+
+		const glm::vec3& n = job.attributes[i].normal;
+		__m128 skinnedNormal = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(n.x)), _mm_mul_ps(c1, _mm_set1_ps(n.y))), _mm_mul_ps(c2, _mm_set1_ps(n.z)));
+
+		_mm_store_ps(position, skinnedPosition);
+		_mm_store_ps(normal, skinnedNormal);
+
+		float lengthSquared = normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2];
+		float inverseLength = lengthSquared > 0.f ? 1.f / std::sqrt(lengthSquared) : 0.f;
+
+		job.outPositions[i] = glm::vec3(position[0], position[1], position[2]);
+
+		VertexAttributes& attributes = job.outAttributes[i];
+		attributes.uv = job.attributes[i].uv;
+		attributes.color = job.attributes[i].color;
+		attributes.normal = glm::vec3(normal[0], normal[1], normal[2]) * inverseLength;
+	}
+}
+
+void CpuSkinning::SkinParallel(const std::vector<SkinJob>& jobs)
+{
+	struct Range
+	{
+		size_t job;
+		size_t first;
+		size_t count;
+	};
+
+	size_t totalVertices = 0;
+	for (const SkinJob& job : jobs)
+		totalVertices += job.vertexCount;
+
+	ThreadPool& pool = ThreadPool::Get();
+	unsigned int threadCount = pool.GetWorkerCount() + 1;
+	size_t verticesPerThread = (totalVertices + threadCount - 1) / threadCount;
+
+	// Consecutive vertex ranges, a job can be split between two threads
+	std::vector<std::vector<Range>> threadRanges(threadCount);
+	size_t thread = 0;
+	size_t threadVertices = 0;
+
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		size_t first = 0;
+		while (first < jobs[i].vertexCount)
+		{
+			size_t count = std::min(jobs[i].vertexCount - first, verticesPerThread - threadVertices);
+			threadRanges[thread].push_back({ i, first, count });
+
+			first += count;
+			threadVertices += count;
+
+			if (threadVertices == verticesPerThread && thread + 1 < threadCount)
+			{
+				++thread;
+				threadVertices = 0;
+			}
+		}
+	}
+
+	pool.ParallelFor(threadRanges.size(), [&jobs, &threadRanges](size_t thread)
+	{
+		for (const Range& range : threadRanges[thread])
+			SkinSimd(jobs[range.job], range.first, range.count);
+	});
+}
+
+void SkinningBenchmark::RunCpu(size_t instanceCount, size_t frameCount)
+{
+	Model tube = MeshLoader::CreateSkinnedTube(32, 64, 32);
+	MeshBuffer* buffer = tube.nodes[0].mesh->GetMeshBuffer(0);
+	size_t vertexCount = buffer->GetVertexCount();
+
+	std::vector<glm::vec3> positions(vertexCount);
+	std::vector<VertexAttributes> attributes(vertexCount);
+	buffer->WriteVertexStreams(positions.data(), attributes.data());
+
+	std::vector<AnimationInstance> instances;
+	for (size_t i = 0; i < instanceCount; ++i)
+	{
+		instances.emplace_back(tube.animations);
+		instances.back().Play(0);
+		instances.back().Update(0.37f * i);
+	}
+
+	std::vector<glm::vec3> outPositions(vertexCount * instanceCount);
+	std::vector<VertexAttributes> outAttributes(vertexCount * instanceCount);
+
+	std::vector<SkinJob> jobs;
+	for (size_t i = 0; i < instanceCount; ++i)
+		jobs.push_back({ positions.data(), attributes.data(), buffer->GetSkinData(), instances[i].GetSkinningMatrices().data(), &outPositions[i * vertexCount], &outAttributes[i * vertexCount], vertexCount });
+
+	std::cout << "Skinning benchmark : " << instanceCount << " instances of " << vertexCount << " vertices, "
+		<< tube.animations->skeleton.GetJointCount() << " joints, " << frameCount << " frames" << std::endl;
+
+	auto measure = [&](const std::string& name, double itemsPerFrame, const char* unit, const std::function<void()>& runFrame)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		for (size_t frame = 0; frame < frameCount; ++frame)
+			runFrame();
+
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		double itemsPerSecond = itemsPerFrame * frameCount / seconds;
+
+		std::cout << "  " << name << " : " << seconds * 1000.0 / frameCount << " ms/frame, " << itemsPerSecond / 1e6 << " M " << unit << "/s" << std::endl;
+	};
+
+	const double skinnedVertices = double(vertexCount) * instanceCount;
+
+	measure("Pose sampling", double(instanceCount), "poses", [&]()
+	{
+		for (AnimationInstance& instance : instances)
+			instance.Update(1.f / 60.f);
+	});
+
+	measure("CPU scalar", skinnedVertices, "skinned vertices", [&]()
+	{
+		for (const SkinJob& job : jobs)
+			CpuSkinning::SkinScalar(job, 0, job.vertexCount);
+	});
+
+	measure("CPU SIMD", skinnedVertices, "skinned vertices", [&]()
+	{
+		for (const SkinJob& job : jobs)
+			CpuSkinning::SkinSimd(job, 0, job.vertexCount);
+	});
+
+	unsigned int threadCount = ThreadPool::Get().GetWorkerCount() + 1;
+	measure("CPU SIMD " + std::to_string(threadCount) + " threads", skinnedVertices, "skinned vertices", [&]()
+	{
+		CpuSkinning::SkinParallel(jobs);
+	});
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+
+#include "MeshBuffer.h"
+
+// Skins the bind pose streams of one mesh buffer with a matrix palette
+struct SkinJob
+{
+	const glm::vec3*		positions;
+	const VertexAttributes* attributes;
+	const VertexSkin*		skin;
+	const glm::mat4*		matrices;
+	glm::vec3*				outPositions;
+	VertexAttributes*		outAttributes;
+	size_t					vertexCount;
+};
+
+class CpuSkinning
+{
+public:
+	CpuSkinning() = delete;
+	~CpuSkinning() = delete;
+
+	// Reference path, one glm matrix blend per vertex
+	static void SkinScalar(const SkinJob& job, size_t first, size_t count);
+
+	// Blends the 4 matrices column by column with SSE, no horizontal operation
+	static void SkinSimd(const SkinJob& job, size_t first, size_t count);
+
+	// Splits the vertices of all jobs evenly between the ThreadPool workers and the calling thread
+	static void SkinParallel(const std::vector<SkinJob>& jobs);
+};
+
+class SkinningBenchmark
+{
+public:
+	SkinningBenchmark() = delete;
+	~SkinningBenchmark() = delete;
+
+	// Prints the skinned vertices per second of the CPU paths for instanceCount animated tubes
+	static void RunCpu(size_t instanceCount, size_t frameCount);
+};
@@ -1,7 +1,57 @@
 #include "Texture.h"
+#include "VirtualFileSystem.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 #include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	bool IsRgba8(VkFormat format)
+	{
+		return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+	}
+
+	// RGBA of a texel as 16 bits values
+	void ReadTexel(VkFormat format, const uint8_t* texel, uint16_t* rgba)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R8_UNORM:
+			rgba[0] = rgba[1] = rgba[2] = static_cast<uint16_t>(texel[0] * 257);
+			rgba[3] = 0xFFFF;
+			break;
+		case VK_FORMAT_R8G8_UNORM:
+			rgba[0] = static_cast<uint16_t>(texel[0] * 257);
+			rgba[1] = static_cast<uint16_t>(texel[1] * 257);
+			rgba[2] = 0;
+			rgba[3] = 0xFFFF;
+			break;
+		case VK_FORMAT_R16_UNORM:
+			memcpy(rgba, texel, sizeof(uint16_t));
+			rgba[1] = rgba[2] = rgba[0];
+			rgba[3] = 0xFFFF;
+			break;
+		default:
+			for (int c = 0; c < 4; ++c)
+				rgba[c] = static_cast<uint16_t>(texel[c] * 257);
+			break;
+		}
+	}
+
+	void WriteTexel(VkFormat format, const uint16_t* rgba, uint8_t* texel)
+	{
+		if (format == VK_FORMAT_R16_UNORM)
+		{
+			memcpy(texel, rgba, sizeof(uint16_t));
+			return;
+		}
+
+		for (uint32_t c = 0; c < Texture::GetTexelSize(format); ++c)
+			texel[c] = static_cast<uint8_t>((rgba[c] + 128) / 257);
+	}
+}
 
 Texture::Texture()
 {
@@ -23,20 +73,65 @@ void Texture::Clear()
 	{
 		delete[] data;
 		data = nullptr;
+		dataSize = 0;
+	}
+
+	if (device != VK_NULL_HANDLE)
+	{
+		vkDestroyImageView(device, textureImageView, nullptr);
+		textureImageView = VK_NULL_HANDLE;
 	}
 
 	buffer.Clear();
 }
 
 void Texture::CreateEmptyTex()
+{
+	CreateSolidColor(0, 0, 0, 0);
+}
+
+void Texture::CreateSolidColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
 {
 	Clear();
 
+	path = "";
 	width = 1;
 	height = 1;
-	data = new uint8_t[4];
-	for (int i = 0; i < 4; ++i)
-		data[i] = 0;
+	mipLevels = 1;
+	format = VK_FORMAT_R8G8B8A8_UNORM;
+	levelOffsets.clear();
+	data = new uint8_t[4]{ r, g, b, a };
+	dataSize = 4;
+}
+
+void Texture::SetPixels(int topWidth, int topHeight, const uint8_t* pixels)
+{
+	size_t size = static_cast<size_t>(topWidth) * topHeight * 4;
+
+	delete[] data;
+	data = new uint8_t[size];
+	memcpy(data, pixels, size);
+	dataSize = size;
+
+	width = topWidth;
+	height = topHeight;
+	mipLevels = 1;
+	format = VK_FORMAT_R8G8B8A8_UNORM;
+	levelOffsets.clear();
+}
+
+void Texture::SetLevels(VkFormat levelsFormat, int topWidth, int topHeight, const std::vector<size_t>& offsets, const uint8_t* levels, size_t size)
+{
+	delete[] data;
+	data = new uint8_t[size];
+	memcpy(data, levels, size);
+	dataSize = size;
+
+	width = topWidth;
+	height = topHeight;
+	format = levelsFormat;
+	levelOffsets = offsets;
+	mipLevels = static_cast<uint32_t>(offsets.size());
 }
 
 void* Texture::GetData()
@@ -44,11 +139,27 @@ void* Texture::GetData()
 	return data;
 }
 
-bool Texture::LoadFile(std::string filename, bool supportMipMap)
+bool Texture::LoadFile(std::string filename)
 {
 	int texChannels;
 
-	stbi_uc* pixels = stbi_load(filename.c_str(), &width, &height, &texChannels, STBI_rgb_alpha);
+	std::shared_ptr<const FileData> file = VirtualFileSystem::Open(filename);
+	const stbi_uc* fileData = file ? file->GetData() : nullptr;
+	const int fileSize = file ? static_cast<int>(file->GetSize()) : 0;
+
+	if (!file || !stbi_info_from_memory(fileData, fileSize, &width, &height, &texChannels))
+	{
+		throw std::runtime_error("chec du chargement d'une image!");
+		return false;
+	}
+
+	// No RGB format is sampled everywhere, gray and alpha images have no two channels equivalent
+	const bool grayscale = texChannels == STBI_grey;
+	const bool sixteenBits = grayscale && stbi_is_16_bit_from_memory(fileData, fileSize);
+	const int channels = grayscale ? STBI_grey : STBI_rgb_alpha;
+
+	void* pixels = sixteenBits ? static_cast<void*>(stbi_load_16_from_memory(fileData, fileSize, &width, &height, &texChannels, channels))
+		: static_cast<void*>(stbi_load_from_memory(fileData, fileSize, &width, &height, &texChannels, channels));
 
 	if (!pixels)
 	{
@@ -56,22 +167,90 @@ bool Texture::LoadFile(std::string filename, bool supportMipMap)
 		return false;
 	}
 
-	if (supportMipMap)
-		mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+	mipLevels = 1;
+	format = sixteenBits ? VK_FORMAT_R16_UNORM : (grayscale ? VK_FORMAT_R8_UNORM : VK_FORMAT_R8G8B8A8_UNORM);
+	levelOffsets.clear();
 
-	VkDeviceSize imageSize = GetMemorySize();
+	size_t imageSize = static_cast<size_t>(width) * height * GetTexelSize(format);
 
+	delete[] data;
 	data = new uint8_t[imageSize];
+	dataSize = imageSize;
 	memcpy(data, pixels, imageSize);
 
 	stbi_image_free(pixels);
 
+	path = filename;
+
 	return true;
 }
 
+uint32_t Texture::GetTexelSize(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R8_UNORM:			return 1;
+	case VK_FORMAT_R8G8_UNORM:
+	case VK_FORMAT_R16_UNORM:			return 2;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:		return 4;
+	default:							return 0;
+	}
+}
+
+void Texture::Convert(VkFormat target)
+{
+	if (format == target)
+		return;
+
+	if (IsRgba8(format) && IsRgba8(target))
+	{
+		format = target;
+		return;
+	}
+
+	const uint32_t sourceSize = GetTexelSize(format);
+	const uint32_t targetSize = GetTexelSize(target);
+	if (sourceSize == 0 || targetSize == 0)
+		throw std::runtime_error("Texture conversion between unsupported formats");
+
+	std::vector<size_t> sourceOffsets = HasMipChain() ? levelOffsets : std::vector<size_t>{ 0 };
+	std::vector<size_t> offsets(sourceOffsets.size());
+
+	size_t size = 0;
+	for (size_t level = 0; level < offsets.size(); ++level)
+	{
+		offsets[level] = size;
+		size += size_t(std::max(width >> level, 1)) * std::max(height >> level, 1) * targetSize;
+	}
+
+	uint8_t* converted = new uint8_t[size];
+	for (size_t level = 0; level < offsets.size(); ++level)
+	{
+		const size_t texelCount = size_t(std::max(width >> level, 1)) * std::max(height >> level, 1);
+		const uint8_t* source = data + sourceOffsets[level];
+		uint8_t* destination = converted + offsets[level];
+
+		uint16_t rgba[4];
+		for (size_t i = 0; i < texelCount; ++i)
+		{
+			ReadTexel(format, source + i * sourceSize, rgba);
+			WriteTexel(target, rgba, destination + i * targetSize);
+		}
+	}
+
+	delete[] data;
+	data = converted;
+	dataSize = size;
+	format = target;
+
+	if (HasMipChain())
+		levelOffsets = offsets;
+}
+
 int Texture::GetMemorySize()
 {
-	return width * height * 4;
+	return static_cast<int>(dataSize);
 }
 
 glm::ivec2 Texture::GetDimensions()
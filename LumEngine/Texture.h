@@ -2,8 +2,30 @@
 
 #include "BufferHandle.h"
 #include <string>
+#include <vector>
 #include <glm/vec2.hpp>
 
+// What a material slot samples, decides the GPU format of the texture
+enum class TextureSemantic : int
+{
+	Color = 0,
+	Albedo,
+	Normal,
+	Scalar,
+	Mask,		// Scalar maps packed by the TextureCache, see MaskChannel
+	Height		// 16 bits when the image has them
+};
+
+// Channel of a packed mask map, the bit (1 << channel) is set in Texture::maskChannels when a source fills it
+enum class MaskChannel : uint32_t
+{
+	Occlusion = 0,	// Red
+	Roughness,		// Green
+	Metallic,		// Blue
+	Specular,		// Alpha
+	Count
+};
+
 class Texture
 {
 public:
@@ -13,13 +35,53 @@ public:
 	~Texture();
 
 	uint32_t mipLevels = 1;
+	VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+
+	// Byte offset of every mip level in the data when the whole chain is stored, empty for a single level
+	std::vector<size_t> levelOffsets;
+
+	// Finest level on the GPU, set by the TextureStreamer. The image and its view start at this level
+	uint32_t residentLevel = 0;
+
+	// Channels of a mask map coming from an image, the others hold white
+	uint32_t maskChannels = 0;
+
 	BufferHandle buffer;
 	VkImageView textureImageView	= VK_NULL_HANDLE;
-	VkSampler	textureSampler		= VK_NULL_HANDLE;
+
+	// Source file, empty for the 1x1 placeholder
+	std::string path = "";
+
+	// Set by the TextureCache, textures are shared between materials
+	int refCount = 1;
+	uint64_t contentHash = 0;
+
+	// Set once the GPU resources exist, Clear() destroys them
+	VkDevice device = VK_NULL_HANDLE;
 
 	void* GetData();
 
-	bool LoadFile(std::string filename, bool supportMipMap = false);
+	// Top level only, the MipGenerator builds the chain.
+	// Grayscale images stay R8, or R16 with 16 bits, the others are R8G8B8A8 with an opaque alpha when they have none
+	bool LoadFile(std::string filename);
+
+	// Converts every level between the uncompressed formats (GetTexelSize), missing channels are filled from the first one
+	// and an opaque alpha. R8G8B8A8 UNORM and SRGB hold the same bytes, only the format changes
+	void Convert(VkFormat target);
+
+	// Bytes per texel of R8, R8G8, R16 and R8G8B8A8, 0 for the other formats
+	static uint32_t GetTexelSize(VkFormat format);
+
+	// Top level of RGBA8 pixels, copied
+	void SetPixels(int topWidth, int topHeight, const uint8_t* pixels);
+
+	// 1x1 image of a single color
+	void CreateSolidColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+
+	// Replaces the pixels by a full mip chain already in its GPU format
+	void SetLevels(VkFormat levelsFormat, int topWidth, int topHeight, const std::vector<size_t>& offsets, const uint8_t* levels, size_t size);
+	bool HasMipChain() const { return !levelOffsets.empty(); }
+
 	int GetMemorySize();
 
 	glm::ivec2 GetDimensions();
@@ -29,6 +91,7 @@ private:
 	int			width = 0;
 	int			height = 0;
 	uint8_t*	data = nullptr;
+	size_t		dataSize = 0;
 
 
 	void CreateEmptyTex();
@@ -0,0 +1,555 @@
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include "TextureCompressor.h"
+#include "KtxFile.h"
+#include "MipGenerator.h"
+#include "VirtualFileSystem.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+std::unordered_map<std::string, Texture*> TextureCache::entries;
+std::unordered_map<uint64_t, Texture*> TextureCache::contents;
+std::unordered_map<std::string, std::shared_future<Texture*>> TextureCache::pendingLoads;
+std::unordered_map<Texture*, TextureCache::Origin> TextureCache::origins;
+Texture* TextureCache::defaults[static_cast<int>(DefaultTexture::Count)] = {};
+std::mutex TextureCache::mutex;
+std::atomic<bool> TextureCache::blockCompression(false);
+std::atomic<bool> TextureCache::sixteenBitHeights(true);
+
+std::string TextureCache::MakePathKey(const std::string& path)
+{
+	std::string key = path;
+	std::replace(key.begin(), key.end(), '\\', '/');
+	std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return key;
+}
+
+std::string TextureCache::MakeKey(const std::string& path, TextureSemantic semantic)
+{
+	return MakePathKey(path) + "#" + std::to_string(static_cast<int>(semantic));
+}
+
+uint64_t TextureCache::HashContent(Texture* texture)
+{
+	// FNV-1a over 8 bytes words, the tail is hashed byte by byte
+	const uint64_t prime = 0x100000001B3ull;
+	uint64_t hash = 0xCBF29CE484222325ull;
+
+	glm::ivec2 dimensions = texture->GetDimensions();
+	for (uint64_t value : { uint64_t(dimensions.x), uint64_t(dimensions.y), uint64_t(texture->mipLevels), uint64_t(texture->format), uint64_t(texture->maskChannels) })
+		hash = (hash ^ value) * prime;
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(texture->GetData());
+	size_t size = static_cast<size_t>(texture->GetMemorySize());
+	size_t wordCount = size / sizeof(uint64_t);
+
+	for (size_t i = 0; i < wordCount; ++i)
+	{
+		uint64_t word;
+		memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+		hash = (hash ^ word) * prime;
+	}
+
+	for (size_t i = wordCount * sizeof(uint64_t); i < size; ++i)
+		hash = (hash ^ bytes[i]) * prime;
+
+	return hash;
+}
+
+void TextureCache::SetBlockCompression(bool enabled)
+{
+	blockCompression = enabled;
+}
+
+void TextureCache::SetSixteenBitHeights(bool enabled)
+{
+	sixteenBitHeights = enabled;
+}
+
+VkFormat TextureCache::ChooseFormat(TextureSemantic semantic, bool hasAlpha)
+{
+	if (semantic == TextureSemantic::Height)
+		return sixteenBitHeights ? VK_FORMAT_R16_UNORM : VK_FORMAT_R8_UNORM;
+
+	if (blockCompression)
+		return TextureCompressor::ChooseFormat(semantic, hasAlpha);
+
+	switch (semantic)
+	{
+	case TextureSemantic::Albedo:	return VK_FORMAT_R8G8B8A8_SRGB;
+	case TextureSemantic::Normal:	return VK_FORMAT_R8G8_UNORM;
+	case TextureSemantic::Scalar:	return VK_FORMAT_R8_UNORM;
+	default:						return VK_FORMAT_R8G8B8A8_UNORM;
+	}
+}
+
+bool TextureCache::IsChainComplete(Texture* texture, VkFormat format)
+{
+	glm::ivec2 dimensions = texture->GetDimensions();
+	return texture->format == format && texture->mipLevels == MipGenerator::GetLevelCount(dimensions.x, dimensions.y);
+}
+
+bool TextureCache::LoadChain(Texture* texture, const std::string& path, TextureSemantic semantic, bool rebuild)
+{
+	std::string cachePath = KtxFile::GetCachePath(path);
+
+	if (!rebuild && KtxFile::Read(cachePath, { path }, texture))
+	{
+		// The file must come from the same semantic, format and hold the whole chain
+		bool hasAlpha = texture->format == VK_FORMAT_BC3_UNORM_BLOCK;
+
+		if (IsChainComplete(texture, ChooseFormat(semantic, hasAlpha)))
+		{
+			texture->path = path;
+			return true;
+		}
+	}
+
+	texture->LoadFile(path);
+
+	// Only RGBA8 images can have an alpha, heights are filtered in 16 bits
+	bool hasAlpha = false;
+	const uint8_t* pixels = static_cast<const uint8_t*>(texture->GetData());
+	for (int i = 3; texture->format == VK_FORMAT_R8G8B8A8_UNORM && i < texture->GetMemorySize() && !hasAlpha; i += 4)
+		hasAlpha = pixels[i] != 255;
+
+	if (semantic == TextureSemantic::Height)
+		texture->Convert(VK_FORMAT_R16_UNORM);
+
+	MipGenerator::Generate(texture, semantic);
+
+	VkFormat format = ChooseFormat(semantic, hasAlpha);
+	if (TextureCompressor::IsBlockCompressed(format))
+		TextureCompressor::Compress(texture, format);
+	else
+		texture->Convert(format);
+
+	if (!KtxFile::Write(cachePath, { path }, texture))
+	{
+		std::cout << "Can't write texture cache " << cachePath << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool TextureCache::LoadMaskChain(Texture* texture, const MaskSources& sources, bool rebuild)
+{
+	const std::string* channelPaths[] = { &sources.occlusion, &sources.roughness, &sources.metallic, &sources.specular };
+
+	std::vector<std::string> sourcePaths;
+	uint32_t channels = 0;
+	for (uint32_t channel = 0; channel < static_cast<uint32_t>(MaskChannel::Count); ++channel)
+	{
+		if (!channelPaths[channel]->empty())
+		{
+			sourcePaths.push_back(*channelPaths[channel]);
+			channels |= 1u << channel;
+		}
+	}
+
+	if (sourcePaths.empty())
+		throw std::runtime_error("Mask map without source");
+
+	texture->maskChannels = channels;
+
+	std::string cachePath = KtxFile::GetCachePath(sourcePaths[0] + ".mask");
+	VkFormat format = ChooseFormat(TextureSemantic::Mask, true);
+
+	if (!rebuild && KtxFile::Read(cachePath, sourcePaths, texture) && IsChainComplete(texture, format))
+	{
+		texture->path = sourcePaths[0];
+		return true;
+	}
+
+	// Decoded as luminance, every source is resampled to the largest one
+	struct Source
+	{
+		stbi_uc*	pixels = nullptr;
+		int			width = 0;
+		int			height = 0;
+	};
+
+	Source images[static_cast<int>(MaskChannel::Count)];
+	int width = 0;
+	int height = 0;
+
+	for (uint32_t channel = 0; channel < static_cast<uint32_t>(MaskChannel::Count); ++channel)
+	{
+		if (channelPaths[channel]->empty())
+			continue;
+
+		int sourceChannels;
+		Source& image = images[channel];
+		std::shared_ptr<const FileData> file = VirtualFileSystem::Open(*channelPaths[channel]);
+		if (file)
+			image.pixels = stbi_load_from_memory(file->GetData(), static_cast<int>(file->GetSize()), &image.width, &image.height, &sourceChannels, STBI_grey);
+
+		if (image.pixels == nullptr)
+		{
+			for (Source& loaded : images)
+				stbi_image_free(loaded.pixels);
+			throw std::runtime_error("Can't decode " + *channelPaths[channel]);
+		}
+
+		width = std::max(width, image.width);
+		height = std::max(height, image.height);
+	}
+
+	std::vector<uint8_t> pixels(size_t(width) * height * 4, 255);
+
+	for (uint32_t channel = 0; channel < static_cast<uint32_t>(MaskChannel::Count); ++channel)
+	{
+		const Source& image = images[channel];
+		if (image.pixels == nullptr)
+			continue;
+
+		for (int y = 0; y < height; ++y)
+		{
+			const stbi_uc* row = image.pixels + size_t(y * image.height / height) * image.width;
+			uint8_t* destination = pixels.data() + size_t(y) * width * 4 + channel;
+
+			for (int x = 0; x < width; ++x)
+				destination[size_t(x) * 4] = row[x * image.width / width];
+		}
+
+		stbi_image_free(image.pixels);
+	}
+
+	texture->SetPixels(width, height, pixels.data());
+	texture->path = sourcePaths[0];
+
+	MipGenerator::Generate(texture, TextureSemantic::Mask);
+
+	if (blockCompression)
+		TextureCompressor::Compress(texture, format);
+
+	if (!KtxFile::Write(cachePath, sourcePaths, texture))
+	{
+		std::cout << "Can't write texture cache " << cachePath << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+Texture* TextureCache::Load(const std::string& path, TextureSemantic semantic)
+{
+	return LoadEntry(MakeKey(path, semantic), path, { path }, [path, semantic](Texture* texture) { LoadChain(texture, path, semantic); });
+}
+
+Texture* TextureCache::LoadMask(const MaskSources& sources)
+{
+	std::string key = "mask";
+	std::vector<std::string> sourcePaths;
+	for (const std::string* path : { &sources.occlusion, &sources.roughness, &sources.metallic, &sources.specular })
+	{
+		key += "|" + (path->empty() ? std::string() : MakeKey(*path, TextureSemantic::Mask));
+		if (!path->empty())
+			sourcePaths.push_back(*path);
+	}
+
+	return LoadEntry(key, sourcePaths.empty() ? std::string() : sourcePaths[0], sourcePaths, [sources](Texture* texture) { LoadMaskChain(texture, sources); });
+}
+
+Texture* TextureCache::LoadEntry(const std::string& key, const std::string& name, const std::vector<std::string>& sourcePaths, const std::function<void(Texture*)>& build)
+{
+	std::promise<Texture*> loadPromise;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		auto it = entries.find(key);
+		if (it != entries.end())
+		{
+			++it->second->refCount;
+			return it->second;
+		}
+
+		auto pending = pendingLoads.find(key);
+		if (pending != pendingLoads.end())
+		{
+			std::shared_future<Texture*> result = pending->second;
+			lock.unlock();
+
+			ThreadPool::Get().Wait(result);
+
+			lock.lock();
+			it = entries.find(key);
+			if (it == entries.end())
+				return nullptr;
+
+			++it->second->refCount;
+			return it->second;
+		}
+
+		pendingLoads[key] = loadPromise.get_future().share();
+	}
+
+	Texture* texture = new Texture();
+	try
+	{
+		// A duplicate load of the key must not run on this thread while it builds
+		ThreadPool::OwnerScope owner;
+		build(texture);
+	}
+	catch (const std::exception&)
+	{
+		std::cout << "Can't load texture " << name << std::endl;
+		delete texture;
+		texture = nullptr;
+	}
+
+	uint64_t hash = texture ? HashContent(texture) : 0;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (texture)
+	{
+		// Another path already holds the same image
+		auto same = contents.find(hash);
+		if (same != contents.end() && same->second->GetMemorySize() == texture->GetMemorySize()
+			&& memcmp(same->second->GetData(), texture->GetData(), texture->GetMemorySize()) == 0)
+		{
+			texture->Clear();
+			delete texture;
+			texture = same->second;
+			++texture->refCount;
+		}
+		else
+		{
+			texture->refCount = 1;
+			texture->contentHash = hash;
+			contents[hash] = texture;
+
+			Origin& origin = origins[texture];
+			origin.build = build;
+			for (const std::string& sourcePath : sourcePaths)
+				origin.paths.push_back(MakePathKey(sourcePath));
+		}
+
+		entries[key] = texture;
+	}
+
+	pendingLoads.erase(key);
+	loadPromise.set_value(texture);
+
+	return texture;
+}
+
+std::future<Texture*> TextureCache::LoadAsync(const std::string& path, TextureSemantic semantic)
+{
+	return ThreadPool::Get().Submit([path, semantic]() { return Load(path, semantic); });
+}
+
+std::future<Texture*> TextureCache::LoadMaskAsync(const MaskSources& sources)
+{
+	return ThreadPool::Get().Submit([sources]() { return LoadMask(sources); });
+}
+
+Texture* TextureCache::GetDefault(DefaultTexture semantic)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Texture*& texture = defaults[static_cast<int>(semantic)];
+	if (!texture)
+	{
+		texture = new Texture();
+
+		switch (semantic)
+		{
+		case DefaultTexture::Albedo:	texture->CreateSolidColor(255, 255, 255, 255); break;
+		case DefaultTexture::Normal:	texture->CreateSolidColor(128, 128, 255, 255); break;
+		case DefaultTexture::Mask:		texture->CreateSolidColor(255, 255, 255, 255); break;
+		default: break;
+		}
+	}
+
+	// The cache keeps its own reference
+	++texture->refCount;
+	return texture;
+}
+
+void TextureCache::AddReference(Texture* texture)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	++texture->refCount;
+}
+
+void TextureCache::Release(Texture* texture)
+{
+	if (texture == nullptr)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (--texture->refCount > 0)
+			return;
+
+		for (auto it = entries.begin(); it != entries.end();)
+			it = it->second == texture ? entries.erase(it) : std::next(it);
+
+		auto same = contents.find(texture->contentHash);
+		if (same != contents.end() && same->second == texture)
+			contents.erase(same);
+
+		origins.erase(texture);
+	}
+
+	texture->Clear();
+	delete texture;
+}
+
+void TextureCache::Assign(Texture*& slot, Texture* texture)
+{
+	if (texture == nullptr)
+		return;
+
+	Release(slot);
+	slot = texture;
+}
+
+std::vector<std::pair<Texture*, std::future<Texture*>>> TextureCache::ReloadAsync(const std::string& path)
+{
+	std::vector<std::pair<Texture*, std::future<Texture*>>> reloads;
+	std::string pathKey = MakePathKey(path);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// A texture shared by content with another path follows the file it was built from
+	for (auto& origin : origins)
+	{
+		if (std::find(origin.second.paths.begin(), origin.second.paths.end(), pathKey) == origin.second.paths.end())
+			continue;
+
+		Texture* texture = origin.first;
+		++texture->refCount;
+
+		std::function<void(Texture*)> build = origin.second.build;
+		reloads.emplace_back(texture, ThreadPool::Get().Submit([build, path]() -> Texture*
+		{
+			Texture* reloaded = new Texture();
+			try
+			{
+				build(reloaded);
+			}
+			catch (const std::exception&)
+			{
+				std::cout << "Can't reload texture " << path << std::endl;
+				delete reloaded;
+				return nullptr;
+			}
+
+			return reloaded;
+		}));
+	}
+
+	return reloads;
+}
+
+void TextureCache::Replace(Texture* texture, Texture* reloaded)
+{
+	// Cached textures always hold their whole chain
+	glm::ivec2 dimensions = reloaded->GetDimensions();
+	texture->SetLevels(reloaded->format, dimensions.x, dimensions.y, reloaded->levelOffsets, static_cast<const uint8_t*>(reloaded->GetData()), static_cast<size_t>(reloaded->GetMemorySize()));
+	texture->maskChannels = reloaded->maskChannels;
+	texture->path = reloaded->path;
+
+	reloaded->Clear();
+	delete reloaded;
+
+	uint64_t hash = HashContent(texture);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// The new content is not shared, an identical image loaded later gets its own entry
+	auto same = contents.find(texture->contentHash);
+	if (same != contents.end() && same->second == texture)
+		contents.erase(same);
+
+	texture->contentHash = hash;
+	contents.emplace(hash, texture);
+}
+
+size_t TextureCache::GetEntryCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return contents.size();
+}
+
+bool TextureCache::Cook(const std::string& path, TextureSemantic semantic)
+{
+	Texture texture;
+	bool cooked = false;
+	try
+	{
+		cooked = LoadChain(&texture, path, semantic, true);
+	}
+	catch (const std::exception&)
+	{
+		std::cout << "Can't load texture " << path << std::endl;
+	}
+
+	texture.Clear();
+	return cooked;
+}
+
+bool TextureCache::CookMask(const MaskSources& sources)
+{
+	Texture texture;
+	bool cooked = false;
+	try
+	{
+		cooked = LoadMaskChain(&texture, sources, true);
+	}
+	catch (const std::exception& exception)
+	{
+		std::cout << "Can't load mask map, " << exception.what() << std::endl;
+	}
+
+	texture.Clear();
+	return cooked;
+}
+
+std::string TextureCache::GetCubeCachePath(const std::vector<std::string>& facePaths)
+{
+	return KtxFile::GetCachePath(facePaths[0] + ".cube");
+}
+
+bool TextureCache::LoadCubeFaces(const std::vector<std::string>& facePaths, Texture faces[6], bool rebuild)
+{
+	if (facePaths.size() != 6)
+		return false;
+
+	std::string cachePath = GetCubeCachePath(facePaths);
+	if (!rebuild && KtxFile::ReadCube(cachePath, facePaths, faces) && faces[0].format == VK_FORMAT_R8G8B8A8_UNORM)
+		return true;
+
+	try
+	{
+		for (size_t i = 0; i < 6; ++i)
+		{
+			faces[i].LoadFile(facePaths[i]);
+			faces[i].Convert(VK_FORMAT_R8G8B8A8_UNORM);
+		}
+	}
+	catch (const std::exception&)
+	{
+		std::cout << "Can't load cube map " << facePaths[0] << std::endl;
+		return false;
+	}
+
+	if (!KtxFile::WriteCube(cachePath, facePaths, faces))
+	{
+		std::cout << "Can't write texture cache " << cachePath << std::endl;
+		return !rebuild;
+	}
+
+	return true;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "Texture.h"
+
+// Engine wide 1x1 textures bound to the material slots without an image
+enum class DefaultTexture : int
+{
+	Albedo = 0,		// White
+	Normal,			// Flat tangent space normal
+	Mask,			// White, no channel from an image
+	Count
+};
+
+// Grayscale images packed in the channels of one mask map, an empty path leaves its channel white
+struct MaskSources
+{
+	std::string occlusion;
+	std::string roughness;
+	std::string metallic;
+	std::string specular;
+};
+
+// Decoded textures shared by every material using them, thread safe.
+// Entries are keyed by path and by content hash, so the same image under two paths is decoded
+// twice but uploaded once. The driver creates the GPU resources of each texture once.
+// Every texture gets its full mip chain from the MipGenerator, stored in the format of its semantic
+// (block compressed when the device supports it, R8, R8G8 or sRGB otherwise, R16 for 16 bits heights)
+// and cached as .ktx2 next to the source image.
+// Scalar maps of a material are packed at import in the RGBA channels of a single mask map.
+class TextureCache
+{
+public:
+	TextureCache() = delete;
+	~TextureCache() = delete;
+
+	// Returns the texture with one more reference, or nullptr when the file can't be decoded
+	static Texture* Load(const std::string& path, TextureSemantic semantic = TextureSemantic::Color);
+
+	// Decodes on the ThreadPool
+	static std::future<Texture*> LoadAsync(const std::string& path, TextureSemantic semantic = TextureSemantic::Color);
+
+	// Packs the sources in a RGBA mask map (MaskChannel order), nullptr when none can be decoded
+	static Texture* LoadMask(const MaskSources& sources);
+	static std::future<Texture*> LoadMaskAsync(const MaskSources& sources);
+
+	// Set by the driver from the device features, before any load
+	static void SetBlockCompression(bool enabled);
+
+	// Set by the driver when R16 images can be sampled with linear filtering, heights are R8 otherwise
+	static void SetSixteenBitHeights(bool enabled);
+
+	// GPU format of the textures of semantic
+	static VkFormat ChooseFormat(TextureSemantic semantic, bool hasAlpha);
+
+	// Returns the default texture with one more reference, it is never destroyed
+	static Texture* GetDefault(DefaultTexture semantic);
+
+	// For a new holder of a texture the cache returned
+	static void AddReference(Texture* texture);
+
+	// Drops a reference, CPU data and GPU resources are destroyed with the last one
+	static void Release(Texture* texture);
+
+	// Gives the reference of texture to slot and releases the previous one, a null texture keeps the slot
+	static void Assign(Texture*& slot, Texture* texture);
+
+	static size_t GetEntryCount();
+
+	// Rebuilds on the ThreadPool every cached texture decoded from path, as an image or a mask source.
+	// Each texture is returned with one more reference next to the future of its rebuilt copy, which lives outside of the cache
+	static std::vector<std::pair<Texture*, std::future<Texture*>>> ReloadAsync(const std::string& path);
+
+	// Moves the pixels of reloaded into texture and deletes it, the GPU resources of texture are left to the driver
+	static void Replace(Texture* texture, Texture* reloaded);
+
+	// Builds the .ktx2 cache of the image or of the mask map again without keeping the texture, for the offline cooker.
+	// False when a source can't be decoded or the cache can't be written
+	static bool Cook(const std::string& path, TextureSemantic semantic);
+	static bool CookMask(const MaskSources& sources);
+
+	// Faces of a cube map in the +X -X +Y -Y +Z -Z order, R8G8B8A8 of a single level. Read from the .ktx2 cache
+	// named after the first face, the images are decoded and the cache written when it is missing, outdated or rebuilt
+	static bool LoadCubeFaces(const std::vector<std::string>& facePaths, Texture faces[6], bool rebuild = false);
+	static std::string GetCubeCachePath(const std::vector<std::string>& facePaths);
+
+private:
+	// Source files and builder of a texture, kept for the reloads
+	struct Origin
+	{
+		std::vector<std::string> paths;
+		std::function<void(Texture*)> build;
+	};
+
+	static std::string MakePathKey(const std::string& path);
+
+	static std::string MakeKey(const std::string& path, TextureSemantic semantic);
+	static uint64_t HashContent(Texture* texture);
+
+	// Shares the entry of key, or creates it with build which throws on failure
+	static Texture* LoadEntry(const std::string& key, const std::string& name, const std::vector<std::string>& sourcePaths, const std::function<void(Texture*)>& build);
+
+	// True when a .ktx2 cache holds the whole chain in format
+	static bool IsChainComplete(Texture* texture, VkFormat format);
+
+	// Reads the .ktx2 cache of the image, or decodes it and builds its chain. Throws when the image can't be decoded,
+	// false when the cache can't be written
+	static bool LoadChain(Texture* texture, const std::string& path, TextureSemantic semantic, bool rebuild = false);
+
+	// Same for the mask map of the sources, the cache is named after the first of them
+	static bool LoadMaskChain(Texture* texture, const MaskSources& sources, bool rebuild = false);
+
+	static std::unordered_map<std::string, Texture*> entries;
+	static std::unordered_map<uint64_t, Texture*> contents;
+	static std::unordered_map<std::string, std::shared_future<Texture*>> pendingLoads;
+	static std::unordered_map<Texture*, Origin> origins;
+	static Texture* defaults[static_cast<int>(DefaultTexture::Count)];
+	static std::mutex mutex;
+	static std::atomic<bool> blockCompression;
+	static std::atomic<bool> sixteenBitHeights;
+};
@@ -0,0 +1,426 @@
+#include "TextureCompressor.h"
+#include "ThreadPool.h"
+
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+namespace
+{
+	// BC7 4 bits index interpolation weights, out of 64
+	const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct Bc7Endpoints
+	{
+		int		quantized[2][4];
+		int		pbits[2];
+		uint8_t indices[16];
+		float	error;
+	};
+
+	// Pixels of a block as 4 registers of 4 pixels per channel
+	struct Bc7Pixels
+	{
+		__m128 channels[4][4];
+	};
+
+	float HorizontalSum(__m128 value)
+	{
+		__m128 shuffled = _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1));
+		__m128 sums = _mm_add_ps(value, shuffled);
+		shuffled = _mm_movehl_ps(shuffled, sums);
+		return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+	}
+
+	// Projects every pixel on the quantized segment, returns the squared error of the block
+	float FitIndices(const Bc7Pixels& pixels, const float endpoint0[4], const float endpoint1[4], uint8_t indices[16])
+	{
+		float direction[4];
+		float lengthSquared = 0.f;
+		for (int c = 0; c < 4; ++c)
+		{
+			direction[c] = endpoint1[c] - endpoint0[c];
+			lengthSquared += direction[c] * direction[c];
+		}
+
+		const __m128 scale = _mm_set1_ps(lengthSquared > 0.f ? 15.f / lengthSquared : 0.f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 maxIndex = _mm_set1_ps(15.f);
+
+		__m128 error = _mm_setzero_ps();
+
+		for (int group = 0; group < 4; ++group)
+		{
+			__m128 t = _mm_setzero_ps();
+			for (int c = 0; c < 4; ++c)
+				t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(pixels.channels[c][group], _mm_set1_ps(endpoint0[c])), _mm_set1_ps(direction[c])));
+
+			t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(t, scale), zero), maxIndex);
+
+			alignas(16) int32_t groupIndices[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(groupIndices), _mm_cvtps_epi32(t));
+
+			__m128 weights = _mm_setr_ps(float(bc7Weights[groupIndices[0]]), float(bc7Weights[groupIndices[1]]), float(bc7Weights[groupIndices[2]]), float(bc7Weights[groupIndices[3]]));
+			weights = _mm_mul_ps(weights, _mm_set1_ps(1.f / 64.f));
+
+			for (int c = 0; c < 4; ++c)
+			{
+				__m128 decoded = _mm_add_ps(_mm_set1_ps(endpoint0[c]), _mm_mul_ps(weights, _mm_set1_ps(direction[c])));
+				__m128 difference = _mm_sub_ps(pixels.channels[c][group], decoded);
+				error = _mm_add_ps(error, _mm_mul_ps(difference, difference));
+			}
+
+			for (int i = 0; i < 4; ++i)
+				indices[group * 4 + i] = static_cast<uint8_t>(groupIndices[i]);
+		}
+
+		return HorizontalSum(error);
+	}
+
+	// Tries the 4 p-bit combinations of 7 bits endpoints around the ideal ones
+	void QuantizeEndpoints(const Bc7Pixels& pixels, const float endpoint0[4], const float endpoint1[4], Bc7Endpoints& best)
+	{
+		for (int pbit0 = 0; pbit0 < 2; ++pbit0)
+		{
+			for (int pbit1 = 0; pbit1 < 2; ++pbit1)
+			{
+				Bc7Endpoints candidate;
+				float decoded[2][4];
+
+				candidate.pbits[0] = pbit0;
+				candidate.pbits[1] = pbit1;
+
+				for (int c = 0; c < 4; ++c)
+				{
+					candidate.quantized[0][c] = std::min(std::max(static_cast<int>(std::lround((endpoint0[c] - pbit0) * 0.5f)), 0), 127);
+					candidate.quantized[1][c] = std::min(std::max(static_cast<int>(std::lround((endpoint1[c] - pbit1) * 0.5f)), 0), 127);
+					decoded[0][c] = float(candidate.quantized[0][c] * 2 + pbit0);
+					decoded[1][c] = float(candidate.quantized[1][c] * 2 + pbit1);
+				}
+
+				candidate.error = FitIndices(pixels, decoded[0], decoded[1], candidate.indices);
+
+				if (candidate.error < best.error)
+					best = candidate;
+			}
+		}
+	}
+
+	struct BitWriter
+	{
+		uint8_t* bytes;
+		uint32_t position;
+
+		void Write(uint32_t value, uint32_t bitCount)
+		{
+			for (uint32_t i = 0; i < bitCount; ++i, ++position)
+			{
+				if ((value >> i) & 1)
+					bytes[position >> 3] |= static_cast<uint8_t>(1 << (position & 7));
+			}
+		}
+	};
+}
+
+VkFormat TextureCompressor::ChooseFormat(TextureSemantic semantic, bool hasAlpha)
+{
+	switch (semantic)
+	{
+	case TextureSemantic::Albedo:	return VK_FORMAT_BC7_SRGB_BLOCK;
+	case TextureSemantic::Mask:		return VK_FORMAT_BC7_UNORM_BLOCK;
+	case TextureSemantic::Normal:	return VK_FORMAT_BC5_UNORM_BLOCK;
+	case TextureSemantic::Scalar:	return VK_FORMAT_BC4_UNORM_BLOCK;
+	default:						return hasAlpha ? VK_FORMAT_BC3_UNORM_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	}
+}
+
+bool TextureCompressor::IsBlockCompressed(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return true;
+	default:
+		return false;
+	}
+}
+
+uint32_t TextureCompressor::GetBlockSize(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		return 8;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return 16;
+	default:
+		return Texture::GetTexelSize(format);
+	}
+}
+
+size_t TextureCompressor::GetLevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+	if (!IsBlockCompressed(format))
+		return size_t(width) * height * GetBlockSize(format);
+
+	return size_t((width + 3) / 4) * ((height + 3) / 4) * GetBlockSize(format);
+}
+
+void TextureCompressor::EncodeBC7(const uint8_t* rgba, uint8_t* block)
+{
+	Bc7Pixels pixels;
+	for (int group = 0; group < 4; ++group)
+	{
+		const uint8_t* p = rgba + group * 16;
+		for (int c = 0; c < 4; ++c)
+			pixels.channels[c][group] = _mm_setr_ps(float(p[c]), float(p[4 + c]), float(p[8 + c]), float(p[12 + c]));
+	}
+
+	// Principal axis of the block colors by power iteration on the covariance
+	float mean[4] = {};
+	float minimum[4] = { 255.f, 255.f, 255.f, 255.f };
+	float maximum[4] = {};
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			mean[c] += rgba[i * 4 + c] / 16.f;
+			minimum[c] = std::min(minimum[c], float(rgba[i * 4 + c]));
+			maximum[c] = std::max(maximum[c], float(rgba[i * 4 + c]));
+		}
+	}
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int a = 0; a < 4; ++a)
+			for (int b = 0; b < 4; ++b)
+				covariance[a][b] += (rgba[i * 4 + a] - mean[a]) * (rgba[i * 4 + b] - mean[b]);
+	}
+
+	float axis[4];
+	for (int c = 0; c < 4; ++c)
+		axis[c] = maximum[c] - minimum[c];
+
+	for (int iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[4] = {};
+		for (int a = 0; a < 4; ++a)
+			for (int b = 0; b < 4; ++b)
+				next[a] += covariance[a][b] * axis[b];
+
+		float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+		if (length < 1e-6f)
+			break;
+
+		for (int c = 0; c < 4; ++c)
+			axis[c] = next[c] / length;
+	}
+
+	float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3]);
+	float minT = 0.f;
+	float maxT = 0.f;
+	if (axisLength > 1e-6f)
+	{
+		for (int c = 0; c < 4; ++c)
+			axis[c] /= axisLength;
+
+		minT = FLT_MAX;
+		maxT = -FLT_MAX;
+		for (int i = 0; i < 16; ++i)
+		{
+			float t = 0.f;
+			for (int c = 0; c < 4; ++c)
+				t += (rgba[i * 4 + c] - mean[c]) * axis[c];
+
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+	}
+
+	float endpoints[2][4];
+	for (int c = 0; c < 4; ++c)
+	{
+		endpoints[0][c] = std::min(std::max(mean[c] + axis[c] * minT, 0.f), 255.f);
+		endpoints[1][c] = std::min(std::max(mean[c] + axis[c] * maxT, 0.f), 255.f);
+	}
+
+	Bc7Endpoints best;
+	best.error = FLT_MAX;
+	QuantizeEndpoints(pixels, endpoints[0], endpoints[1], best);
+
+	// One least squares refit of the endpoints to the chosen indices
+	float a00 = 0.f, a01 = 0.f, a11 = 0.f;
+	float x0[4] = {}, x1[4] = {};
+	for (int i = 0; i < 16; ++i)
+	{
+		float w = bc7Weights[best.indices[i]] / 64.f;
+		a00 += (1.f - w) * (1.f - w);
+		a01 += (1.f - w) * w;
+		a11 += w * w;
+		for (int c = 0; c < 4; ++c)
+		{
+			x0[c] += (1.f - w) * rgba[i * 4 + c];
+			x1[c] += w * rgba[i * 4 + c];
+		}
+	}
+
+	float determinant = a00 * a11 - a01 * a01;
+	if (std::fabs(determinant) > 1e-6f)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			endpoints[0][c] = std::min(std::max((a11 * x0[c] - a01 * x1[c]) / determinant, 0.f), 255.f);
+			endpoints[1][c] = std::min(std::max((a00 * x1[c] - a01 * x0[c]) / determinant, 0.f), 255.f);
+		}
+
+		QuantizeEndpoints(pixels, endpoints[0], endpoints[1], best);
+	}
+
+	// The most significant bit of the first index is implicit zero
+	if (best.indices[0] >= 8)
+	{
+		std::swap(best.quantized[0], best.quantized[1]);
+		std::swap(best.pbits[0], best.pbits[1]);
+		for (uint8_t& index : best.indices)
+			index = static_cast<uint8_t>(15 - index);
+	}
+
+	memset(block, 0, 16);
+	BitWriter writer = { block, 0 };
+	writer.Write(1 << 6, 7);
+	for (int c = 0; c < 4; ++c)
+	{
+		writer.Write(best.quantized[0][c], 7);
+		writer.Write(best.quantized[1][c], 7);
+	}
+	writer.Write(best.pbits[0], 1);
+	writer.Write(best.pbits[1], 1);
+	writer.Write(best.indices[0], 3);
+	for (int i = 1; i < 16; ++i)
+		writer.Write(best.indices[i], 4);
+}
+
+void TextureCompressor::EncodeBlock(VkFormat format, const uint8_t* rgba, uint8_t* block)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		stb_compress_dxt_block(block, rgba, 0, STB_DXT_HIGHQUAL);
+		break;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+		stb_compress_dxt_block(block, rgba, 1, STB_DXT_HIGHQUAL);
+		break;
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	{
+		uint8_t red[16];
+		for (int i = 0; i < 16; ++i)
+			red[i] = rgba[i * 4];
+		stb_compress_bc4_block(block, red);
+		break;
+	}
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	{
+		uint8_t redGreen[32];
+		for (int i = 0; i < 16; ++i)
+		{
+			redGreen[i * 2] = rgba[i * 4];
+			redGreen[i * 2 + 1] = rgba[i * 4 + 1];
+		}
+		stb_compress_bc5_block(block, redGreen);
+		break;
+	}
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		EncodeBC7(rgba, block);
+		break;
+	default:
+		break;
+	}
+}
+
+void TextureCompressor::Compress(Texture* texture, VkFormat format)
+{
+	// stb_dxt builds its tables on the first block, which must not race
+	static std::once_flag stbInitialized;
+	std::call_once(stbInitialized, []()
+	{
+		uint8_t pixels[64] = {};
+		uint8_t block[16];
+		stb_compress_dxt_block(block, pixels, 1, STB_DXT_NORMAL);
+	});
+
+	if (Texture::GetTexelSize(texture->format) != 4)
+		texture->Convert(VK_FORMAT_R8G8B8A8_UNORM);
+
+	glm::ivec2 dimensions = texture->GetDimensions();
+	const uint8_t* source = static_cast<const uint8_t*>(texture->GetData());
+
+	// RGBA8 levels from the MipGenerator, or the top level only
+	std::vector<size_t> sourceOffsets = texture->HasMipChain() ? texture->levelOffsets : std::vector<size_t>{ 0 };
+	uint32_t levelCount = static_cast<uint32_t>(sourceOffsets.size());
+
+	std::vector<size_t> offsets(levelCount);
+	size_t chainSize = 0;
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		offsets[level] = chainSize;
+		chainSize += GetLevelSize(format, std::max(uint32_t(dimensions.x) >> level, 1u), std::max(uint32_t(dimensions.y) >> level, 1u));
+	}
+
+	std::vector<uint8_t> chain(chainSize);
+	ThreadPool& pool = ThreadPool::Get();
+	const uint32_t blockSize = GetBlockSize(format);
+
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		uint32_t width = std::max(uint32_t(dimensions.x) >> level, 1u);
+		uint32_t height = std::max(uint32_t(dimensions.y) >> level, 1u);
+		uint32_t blocksX = (width + 3) / 4;
+		uint32_t blocksY = (height + 3) / 4;
+		size_t taskCount = std::min<size_t>(blocksY, pool.GetWorkerCount() + 1);
+
+		// Interleaved block rows, edge blocks repeat the last row and column
+		pool.ParallelFor(taskCount, [&, level, width, height, blocksX, blocksY, taskCount](size_t task)
+		{
+			const uint8_t* levelPixels = source + sourceOffsets[level];
+			uint8_t pixels[64];
+
+			for (uint32_t blockY = static_cast<uint32_t>(task); blockY < blocksY; blockY += static_cast<uint32_t>(taskCount))
+			{
+				for (uint32_t blockX = 0; blockX < blocksX; ++blockX)
+				{
+					for (uint32_t y = 0; y < 4; ++y)
+					{
+						uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+						for (uint32_t x = 0; x < 4; ++x)
+						{
+							uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+							memcpy(pixels + (y * 4 + x) * 4, levelPixels + (size_t(sourceY) * width + sourceX) * 4, 4);
+						}
+					}
+
+					EncodeBlock(format, pixels, chain.data() + offsets[level] + (size_t(blockY) * blocksX + blockX) * blockSize);
+				}
+			}
+		});
+	}
+
+	texture->SetLevels(format, dimensions.x, dimensions.y, offsets, chain.data(), chain.size());
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Texture.h"
+
+// CPU encoder of the BC formats sampled by materials.
+// BC1/BC3/BC4/BC5 blocks come from stb_dxt, BC7 uses mode 6 only (one RGBA subset, 4 bits indices)
+// fitted with SSE. Blocks are encoded in parallel on the ThreadPool.
+class TextureCompressor
+{
+public:
+	TextureCompressor() = delete;
+	~TextureCompressor() = delete;
+
+	// Albedo BC7 sRGB, mask maps BC7, normal maps BC5 (x and y only), scalar maps BC4, other colors BC1 or BC3 with alpha.
+	// Heights are not compressed
+	static VkFormat ChooseFormat(TextureSemantic semantic, bool hasAlpha);
+
+	static bool IsBlockCompressed(VkFormat format);
+
+	// Bytes per 4x4 block, or per texel for the uncompressed formats
+	static uint32_t GetBlockSize(VkFormat format);
+
+	static size_t GetLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+	// Encodes every level of the texture (its MipGenerator chain or its top level) in format, converted to RGBA8 first
+	static void Compress(Texture* texture, VkFormat format);
+
+	// rgba holds the 4x4 block row by row
+	static void EncodeBlock(VkFormat format, const uint8_t* rgba, uint8_t* block);
+	static void EncodeBC7(const uint8_t* rgba, uint8_t* block);
+};
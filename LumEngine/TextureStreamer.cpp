@@ -0,0 +1,143 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+
+uint32_t TextureStreamer::GetTailLevel(Texture* texture)
+{
+	glm::ivec2 dimensions = texture->GetDimensions();
+	uint32_t level = 0;
+
+	while (level + 1 < texture->mipLevels && std::max(uint32_t(dimensions.x) >> level, uint32_t(dimensions.y) >> level) > tailSize)
+		++level;
+
+	return level;
+}
+
+size_t TextureStreamer::GetResidentSize(Texture* texture, uint32_t firstLevel)
+{
+	if (!texture->HasMipChain())
+		return static_cast<size_t>(texture->GetMemorySize());
+
+	return static_cast<size_t>(texture->GetMemorySize()) - texture->levelOffsets[firstLevel];
+}
+
+void TextureStreamer::Register(Texture* texture)
+{
+	if (!texture->HasMipChain() || textures.count(texture) > 0)
+		return;
+
+	Entry& entry = textures[texture];
+	entry.tailLevel = GetTailLevel(texture);
+	entry.lastUsedFrame = frame;
+
+	texture->residentLevel = entry.tailLevel;
+	residentBytes += GetResidentSize(texture, entry.tailLevel);
+}
+
+void TextureStreamer::Unregister(Texture* texture)
+{
+	auto it = textures.find(texture);
+	if (it == textures.end())
+		return;
+
+	residentBytes -= GetResidentSize(texture, texture->residentLevel);
+	textures.erase(it);
+}
+
+void TextureStreamer::Request(Texture* texture, float uvPerPixel)
+{
+	auto it = textures.find(texture);
+	if (it == textures.end())
+		return;
+
+	// One texel per pixel at the requested level
+	glm::ivec2 dimensions = texture->GetDimensions();
+	float texelsPerPixel = uvPerPixel * static_cast<float>(std::max(dimensions.x, dimensions.y));
+	uint32_t level = texelsPerPixel > 1.f ? static_cast<uint32_t>(std::floor(std::log2(texelsPerPixel))) : 0;
+
+	Entry& entry = it->second;
+	entry.requestedLevel = std::min(std::min(level, entry.tailLevel), entry.requestedLevel);
+	entry.lastUsedFrame = frame;
+}
+
+bool TextureStreamer::Evict(size_t size, Texture* keep, std::vector<Change>& changes)
+{
+	std::vector<std::pair<uint64_t, Texture*>> candidates;
+	for (auto& texture : textures)
+	{
+		if (texture.first != keep && texture.second.lastUsedFrame < frame && texture.first->residentLevel < texture.second.tailLevel)
+			candidates.emplace_back(texture.second.lastUsedFrame, texture.first);
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const std::pair<uint64_t, Texture*>& a, const std::pair<uint64_t, Texture*>& b) { return a.first < b.first; });
+
+	size_t freed = 0;
+	for (auto& candidate : candidates)
+	{
+		if (freed >= size)
+			break;
+
+		Texture* texture = candidate.second;
+		uint32_t tailLevel = textures[texture].tailLevel;
+
+		freed += GetResidentSize(texture, texture->residentLevel) - GetResidentSize(texture, tailLevel);
+		residentBytes -= GetResidentSize(texture, texture->residentLevel) - GetResidentSize(texture, tailLevel);
+		texture->residentLevel = tailLevel;
+		changes.push_back({ texture, tailLevel });
+	}
+
+	return freed >= size;
+}
+
+void TextureStreamer::Update(std::vector<Change>& changes)
+{
+	changes.clear();
+
+	// Finest requests first, they are the most visible
+	std::vector<std::pair<Texture*, Entry*>> requests;
+	for (auto& texture : textures)
+	{
+		if (texture.second.lastUsedFrame == frame && texture.second.requestedLevel != UINT32_MAX)
+			requests.emplace_back(texture.first, &texture.second);
+	}
+
+	std::sort(requests.begin(), requests.end(), [](const std::pair<Texture*, Entry*>& a, const std::pair<Texture*, Entry*>& b)
+	{
+		return a.second->requestedLevel < b.second->requestedLevel;
+	});
+
+	size_t uploaded = 0;
+	for (auto& request : requests)
+	{
+		Texture* texture = request.first;
+		Entry& entry = *request.second;
+		uint32_t level = entry.requestedLevel;
+		entry.requestedLevel = UINT32_MAX;
+
+		if (level >= texture->residentLevel)
+			continue;
+
+		// Coarser levels until the texture fits in what the budget and the frame allow
+		for (; level < texture->residentLevel; ++level)
+		{
+			size_t growth = GetResidentSize(texture, level) - GetResidentSize(texture, texture->residentLevel);
+			if (uploaded + GetResidentSize(texture, level) > maxUploadPerFrame && uploaded > 0)
+				continue;
+
+			if (residentBytes + growth > budget && !Evict(residentBytes + growth - budget, texture, changes))
+				continue;
+
+			residentBytes += growth;
+			uploaded += GetResidentSize(texture, level);
+			texture->residentLevel = level;
+			changes.push_back({ texture, level });
+			break;
+		}
+	}
+
+	for (auto& texture : textures)
+		texture.second.requestedLevel = UINT32_MAX;
+
+	++frame;
+}
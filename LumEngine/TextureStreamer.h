@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "Texture.h"
+
+// Residency policy of the texture mip levels on the GPU, the driver applies its decisions.
+// Textures start with their mip tail only, the draw loop requests finer levels from the screen
+// space texel density of their materials. Requested levels are made resident within a memory
+// budget, the textures unused for the longest time fall back to their tail to make room.
+class TextureStreamer
+{
+public:
+	// One texture whose resident range moves to firstLevel
+	struct Change
+	{
+		Texture*	texture;
+		uint32_t	firstLevel;
+	};
+
+	TextureStreamer() = default;
+	~TextureStreamer() = default;
+
+	// Levels of at most tailSize texels stay resident
+	static const uint32_t tailSize = 64;
+
+	size_t budget = 256ull * 1024 * 1024;
+	size_t maxUploadPerFrame = 32ull * 1024 * 1024;
+
+	static uint32_t GetTailLevel(Texture* texture);
+
+	// Bytes of the levels [firstLevel, mipLevels)
+	static size_t GetResidentSize(Texture* texture, uint32_t firstLevel);
+
+	// Textures without a mip chain are always fully resident and never change
+	void Register(Texture* texture);
+	void Unregister(Texture* texture);
+
+	// uvPerPixel is the UV distance covered by one screen pixel where the texture is sampled
+	void Request(Texture* texture, float uvPerPixel);
+
+	// Ends the frame, fills changes with the uploads and evictions to apply before drawing
+	void Update(std::vector<Change>& changes);
+
+	size_t GetResidentBytes() const { return residentBytes; }
+	size_t GetTextureCount() const { return textures.size(); }
+
+private:
+	struct Entry
+	{
+		uint32_t tailLevel = 0;
+		uint32_t requestedLevel = UINT32_MAX;
+		uint64_t lastUsedFrame = 0;
+	};
+
+	std::unordered_map<Texture*, Entry> textures;
+	size_t		residentBytes = 0;
+	uint64_t	frame = 1;
+
+	// Frees at least size bytes from the least recently used textures not used this frame
+	bool Evict(size_t size, Texture* keep, std::vector<Change>& changes);
+};
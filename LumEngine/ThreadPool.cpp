@@ -0,0 +1,133 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Results in progress on this thread that queued jobs may wait on
+	thread_local unsigned int ownedResultCount = 0;
+}
+
+ThreadPool::OwnerScope::OwnerScope()
+{
+	++ownedResultCount;
+}
+
+ThreadPool::OwnerScope::~OwnerScope()
+{
+	--ownedResultCount;
+}
+
+ThreadPool::ThreadPool(unsigned int workerCount)
+{
+	for (unsigned int i = 0; i < workerCount; ++i)
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	condition.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+ThreadPool& ThreadPool::Get()
+{
+	static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+	return pool;
+}
+
+void ThreadPool::Enqueue(std::function<void()> job, bool parallelTask)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		(parallelTask ? parallelTasks : jobs).push_back(std::move(job));
+	}
+
+	condition.notify_one();
+}
+
+bool ThreadPool::PopJob(bool parallelTasksOnly, std::function<void()>& job)
+{
+	// Someone is blocked on the ParallelFor tasks, they go before the other jobs
+	if (!parallelTasks.empty())
+	{
+		job = std::move(parallelTasks.front());
+		parallelTasks.pop_front();
+		return true;
+	}
+
+	if (parallelTasksOnly || jobs.empty())
+		return false;
+
+	job = std::move(jobs.front());
+	jobs.pop_front();
+	return true;
+}
+
+bool ThreadPool::RunPendingJob()
+{
+	std::function<void()> job;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!PopJob(ownedResultCount > 0, job))
+			return false;
+	}
+
+	job();
+	return true;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return stopping || !jobs.empty() || !parallelTasks.empty(); });
+
+			// Queued jobs are still run so no future is left without a result
+			if (!PopJob(false, job))
+				return;
+		}
+
+		job();
+	}
+}
+
+void ThreadPool::ParallelFor(size_t taskCount, const std::function<void(size_t)>& function)
+{
+	// The caller waits on every task, so each one runs as the owner of a result
+	std::vector<std::future<void>> results;
+	for (size_t task = 1; task < taskCount; ++task)
+	{
+		auto job = std::make_shared<std::packaged_task<void()>>([&function, task]()
+		{
+			OwnerScope scope;
+			function(task);
+		});
+
+		results.push_back(job->get_future());
+		Enqueue([job]() { (*job)(); }, true);
+	}
+
+	// The caller also only picks up ParallelFor tasks until its own are done,
+	// a queued job started here could stall the caller for as long as it runs
+	OwnerScope scope;
+
+	if (taskCount > 0)
+		function(0);
+
+	for (std::future<void>& result : results)
+	{
+		Wait(result);
+		result.get();
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running queued jobs in submission order, ParallelFor tasks first.
+// Threads waiting on a job result should go through Wait so they run queued jobs meanwhile,
+// jobs can then wait on other jobs without starving the pool.
+// A thread producing a result other jobs may wait on, running a ParallelFor task or waiting in ParallelFor
+// only runs ParallelFor tasks while it waits: a job started on top of it could wait on that result and never
+// see it complete, or hold the ParallelFor caller for as long as it runs.
+// ParallelFor tasks never wait on other jobs, so every wait still makes progress.
+class ThreadPool
+{
+public:
+	// Held by a thread while it produces a result other jobs may wait on, such as a pending cache entry
+	class OwnerScope
+	{
+	public:
+		OwnerScope();
+		~OwnerScope();
+
+		OwnerScope(const OwnerScope&) = delete;
+		OwnerScope& operator=(const OwnerScope&) = delete;
+	};
+
+	explicit ThreadPool(unsigned int workerCount);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Shared pool, one worker per core besides the calling thread
+	static ThreadPool& Get();
+
+	template<typename Function>
+	auto Submit(Function&& function) -> std::future<decltype(function())>
+	{
+		using Result = decltype(function());
+
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+		std::future<Result> result = task->get_future();
+
+		Enqueue([task]() { (*task)(); });
+
+		return result;
+	}
+
+	// Runs queued jobs until the future is ready
+	template<typename Future>
+	void Wait(const Future& future)
+	{
+		while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			if (!RunPendingJob())
+				future.wait_for(std::chrono::microseconds(100));
+		}
+	}
+
+	// Calls function(task) for every task in [0, taskCount), the calling thread takes task 0
+	// and only helps with ParallelFor tasks until the others are done
+	void ParallelFor(size_t taskCount, const std::function<void(size_t)>& function);
+
+	// Runs the oldest queued job the calling thread may run, false when there is none
+	bool RunPendingJob();
+
+	unsigned int GetWorkerCount() const { return static_cast<unsigned int>(workers.size()); }
+
+private:
+	void Enqueue(std::function<void()> job, bool parallelTask = false);
+	bool PopJob(bool parallelTasksOnly, std::function<void()>& job);
+	void WorkerLoop();
+
+	std::vector<std::thread>			workers;
+	std::deque<std::function<void()>>	jobs;
+	std::deque<std::function<void()>>	parallelTasks;
+	std::mutex							mutex;
+	std::condition_variable				condition;
+	bool								stopping = false;
+};
@@ -0,0 +1,254 @@
+#include "TransformStore.h"
+#include "TransformStoreKernel.h"
+#include "CpuFeatures.h"
+#include "SceneNode.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace
+{
+	// Four slots per iteration, the lanes of the default build
+	struct SseLanes
+	{
+		typedef __m128 Type;
+		static const size_t laneCount = 4;
+
+		static Type Load(const float* values) { return _mm_load_ps(values); }
+		static Type Broadcast(float value) { return _mm_set1_ps(value); }
+		static Type Add(Type a, Type b) { return _mm_add_ps(a, b); }
+		static Type Sub(Type a, Type b) { return _mm_sub_ps(a, b); }
+		static Type Mul(Type a, Type b) { return _mm_mul_ps(a, b); }
+		static Type MulAdd(Type a, Type b, Type c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		static __m128 GetQuarter(Type lanes, size_t) { return lanes; }
+	};
+
+	size_t CountBits(uint8_t bits)
+	{
+		size_t count = 0;
+		for (; bits != 0; bits &= bits - 1)
+			++count;
+		return count;
+	}
+}
+
+uint32_t TransformStore::Add()
+{
+	uint32_t slot;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		slot = static_cast<uint32_t>(count++);
+
+		// A new group of identity slots
+		if (slot % groupSize == 0)
+		{
+			for (auto& component : components)
+				component.resize(slot + groupSize, 0.f);
+
+			matrices.resize(slot + groupSize, glm::mat4(1.f));
+			dirtyLanes.push_back(0);
+
+			for (uint32_t i = slot; i < slot + groupSize; ++i)
+				SetIdentity(i);
+		}
+	}
+
+	SetIdentity(slot);
+	matrices[slot] = glm::mat4(1.f);
+	dirtyLanes[slot / groupSize] &= static_cast<uint8_t>(~(1u << (slot % groupSize)));
+	return slot;
+}
+
+void TransformStore::Remove(uint32_t slot)
+{
+	SetIdentity(slot);
+	dirtyLanes[slot / groupSize] &= static_cast<uint8_t>(~(1u << (slot % groupSize)));
+	freeSlots.push_back(slot);
+}
+
+void TransformStore::SetIdentity(uint32_t slot)
+{
+	for (int component : { RotationX, RotationY, RotationZ, TranslationX, TranslationY, TranslationZ,
+		Import01, Import02, Import03, Import10, Import12, Import13, Import20, Import21, Import23 })
+		components[component][slot] = 0.f;
+
+	for (int component : { RotationW, ScaleX, ScaleY, ScaleZ, Import00, Import11, Import22 })
+		components[component][slot] = 1.f;
+}
+
+void TransformStore::Set(uint32_t slot, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale, const glm::mat4& importTransform)
+{
+	components[TranslationX][slot] = translation.x;
+	components[TranslationY][slot] = translation.y;
+	components[TranslationZ][slot] = translation.z;
+	components[RotationX][slot] = rotation.x;
+	components[RotationY][slot] = rotation.y;
+	components[RotationZ][slot] = rotation.z;
+	components[RotationW][slot] = rotation.w;
+	components[ScaleX][slot] = scale.x;
+	components[ScaleY][slot] = scale.y;
+	components[ScaleZ][slot] = scale.z;
+
+	for (int row = 0; row < 3; ++row)
+	{
+		for (int column = 0; column < 4; ++column)
+			components[Import00 + row * 4 + column][slot] = importTransform[column][row];
+	}
+
+	dirtyLanes[slot / groupSize] |= static_cast<uint8_t>(1u << (slot % groupSize));
+}
+
+const glm::mat4& TransformStore::GetMatrix(uint32_t slot)
+{
+	uint8_t& dirty = dirtyLanes[slot / groupSize];
+	uint8_t lane = static_cast<uint8_t>(1u << (slot % groupSize));
+
+	if (dirty & lane)
+	{
+		matrices[slot] = ComposeScalar(slot);
+		dirty &= static_cast<uint8_t>(~lane);
+	}
+
+	return matrices[slot];
+}
+
+glm::mat4 TransformStore::ComposeScalar(uint32_t slot) const
+{
+	glm::vec3 translation(components[TranslationX][slot], components[TranslationY][slot], components[TranslationZ][slot]);
+	glm::quat rotation(components[RotationW][slot], components[RotationX][slot], components[RotationY][slot], components[RotationZ][slot]);
+	glm::vec3 scale(components[ScaleX][slot], components[ScaleY][slot], components[ScaleZ][slot]);
+
+	glm::mat4 importTransform(1.f);
+	for (int row = 0; row < 3; ++row)
+	{
+		for (int column = 0; column < 4; ++column)
+			importTransform[column][row] = components[Import00 + row * 4 + column][slot];
+	}
+
+	glm::mat4 transformation = glm::scale(glm::mat4(1.f), scale) * glm::mat4_cast(rotation);
+	return glm::translate(transformation, translation) * importTransform;
+}
+
+void TransformStore::MarkAllDirty()
+{
+	std::fill(dirtyLanes.begin(), dirtyLanes.end(), uint8_t(0xFF));
+}
+
+size_t TransformStore::Update()
+{
+	size_t composedCount = 0;
+	for (size_t group = 0; group < dirtyLanes.size(); ++group)
+	{
+		if (dirtyLanes[group] == 0)
+			continue;
+
+		composedCount += CountBits(dirtyLanes[group]);
+		ComposeGroup(group);
+		dirtyLanes[group] = 0;
+	}
+
+	return composedCount;
+}
+
+void TransformStore::ComposeGroup(size_t group)
+{
+	const size_t first = group * groupSize;
+
+	const float* groupComponents[ComponentCount];
+	for (int component = 0; component < ComponentCount; ++component)
+		groupComponents[component] = components[component].data() + first;
+
+	if (CpuFeatures::HasAvx2())
+		ComposeGroupAvx2(groupComponents, &matrices[first][0][0]);
+	else
+		ComposeLanes<SseLanes>(groupComponents, &matrices[first][0][0]);
+}
+
+void TransformBenchmark::Run(size_t nodeCount, size_t iterationCount)
+{
+	// Nodes of random transforms, a quarter of them with an import transform like the model nodes
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> position(-500.f, 500.f);
+	std::uniform_real_distribution<float> angle(-180.f, 180.f);
+	std::uniform_real_distribution<float> size(0.5f, 2.f);
+
+	std::vector<SceneNode> nodes(nodeCount);
+	TransformStore store;
+
+	for (size_t i = 0; i < nodeCount; ++i)
+	{
+		SceneNode& node = nodes[i];
+		node.SetPosition(glm::vec3(position(random), position(random), position(random)));
+		node.SetRotation(glm::vec3(angle(random), angle(random), angle(random)));
+		node.SetScale(glm::vec3(size(random), size(random), size(random)));
+
+		if (i % 4 == 0)
+		{
+			glm::mat4 importTransform = glm::translate(glm::mat4(1.f), glm::vec3(position(random), position(random), position(random)));
+			node.SetImportTransform(glm::rotate(importTransform, glm::radians(angle(random)), glm::vec3(0.f, 1.f, 0.f)));
+		}
+	}
+
+	const char* simdName = CpuFeatures::HasAvx2() ? "AVX2 + FMA" : "SSE";
+
+	std::cout << "Transform benchmark : " << nodeCount << " nodes, " << iterationCount << " iterations" << std::endl;
+
+	auto measure = [&](const std::string& name, const std::function<void()>& compose)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		for (size_t iteration = 0; iteration < iterationCount; ++iteration)
+			compose();
+
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		double matricesPerSecond = double(nodeCount) * iterationCount / seconds;
+
+		std::cout << "  " << name << " : " << seconds * 1000.0 / iterationCount << " ms/frame, " << matricesPerSecond / 1e6 << " M matrices/s" << std::endl;
+	};
+
+	// The per node path first, the nodes use the store from then on
+	std::vector<glm::mat4> nodeMatrices(nodeCount);
+	measure("SceneNode::GetTransformation, 5 matrix products", [&]()
+	{
+		for (size_t i = 0; i < nodeCount; ++i)
+			nodeMatrices[i] = nodes[i].GetTransformation();
+	});
+
+	for (SceneNode& node : nodes)
+		node.SetTransformSlot(&store, store.Add());
+
+	std::vector<glm::mat4> storeMatrices(nodeCount);
+	measure("Store scalar quaternion path", [&]()
+	{
+		for (size_t i = 0; i < nodeCount; ++i)
+			storeMatrices[i] = store.ComposeScalar(nodes[i].GetTransformSlot());
+	});
+
+	measure(std::string(simdName) + " 8 nodes per iteration", [&]()
+	{
+		store.MarkAllDirty();
+		store.Update();
+	});
+
+	float maxError = 0.f;
+	for (size_t i = 0; i < nodeCount; ++i)
+	{
+		const glm::mat4& matrix = store.GetMatrix(nodes[i].GetTransformSlot());
+		for (int column = 0; column < 4; ++column)
+		{
+			glm::vec4 error = glm::abs(matrix[column] - nodeMatrices[i][column]);
+			maxError = glm::max(maxError, glm::max(glm::max(error.x, error.y), glm::max(error.z, error.w)));
+		}
+	}
+
+	std::cout << "  Largest difference of the " << simdName << " matrices to SceneNode::GetTransformation : " << maxError << std::endl;
+}
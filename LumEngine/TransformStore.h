@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <xmmintrin.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Allocates on a SIMD register boundary so the kernels can use aligned loads
+template<typename T, size_t Alignment>
+struct AlignedAllocator
+{
+	typedef T value_type;
+
+	template<typename U>
+	struct rebind
+	{
+		typedef AlignedAllocator<U, Alignment> other;
+	};
+
+	AlignedAllocator() = default;
+
+	template<typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(size_t count)
+	{
+		void* memory = _mm_malloc(count * sizeof(T), Alignment);
+		if (!memory)
+			throw std::bad_alloc();
+
+		return static_cast<T*>(memory);
+	}
+
+	void deallocate(T* memory, size_t) { _mm_free(memory); }
+
+	template<typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+
+	template<typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+// Translations, rotations and scales of the scene nodes as parallel arrays, one float per slot and component.
+// The matrices of the changed slots are composed 8 slots per iteration, with AVX2 and FMA when the CPU has them
+// and two SSE halves otherwise, into the matrix array the instance batchers copy from.
+class TransformStore
+{
+public:
+	static const size_t groupSize = 8;
+
+	TransformStore() = default;
+	~TransformStore() = default;
+
+	// New slot with the identity transform
+	uint32_t Add();
+	void Remove(uint32_t slot);
+
+	// The import transform is affine, its last row is ignored
+	void Set(uint32_t slot, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale, const glm::mat4& importTransform);
+
+	// Matrix of the slot, composed alone when it changed since the last Update
+	const glm::mat4& GetMatrix(uint32_t slot);
+
+	// Composes the matrices of every changed slot, returns how many slots changed
+	size_t Update();
+
+	// Every slot is composed again by the next Update
+	void MarkAllDirty();
+
+	// Slots in use and free ones
+	size_t GetCount() const { return count; }
+
+	// Reference of the kernel : scale * rotation * translation * import, like SceneNode::GetTransformation
+	glm::mat4 ComposeScalar(uint32_t slot) const;
+
+private:
+	enum Component
+	{
+		TranslationX, TranslationY, TranslationZ,
+		RotationX, RotationY, RotationZ, RotationW,
+		ScaleX, ScaleY, ScaleZ,
+		Import00, Import01, Import02, Import03,		// Row, column
+		Import10, Import11, Import12, Import13,
+		Import20, Import21, Import22, Import23,
+		ComponentCount
+	};
+
+	void ComposeGroup(size_t group);
+
+	// Composes the 8 slots of a group to their column major matrices, defined in TransformStoreKernel.h
+	template<typename Lanes>
+	static void ComposeLanes(const float* const components[ComponentCount], float* matrices);
+
+	// TransformStoreAvx2.cpp, built with /arch:AVX2 and only called when CpuFeatures::HasAvx2
+	static void ComposeGroupAvx2(const float* const components[ComponentCount], float* matrices);
+	void SetIdentity(uint32_t slot);
+
+	// Padded to a whole group, the padding slots keep the identity
+	std::vector<float, AlignedAllocator<float, 32>> components[ComponentCount];
+	std::vector<glm::mat4>	matrices;
+	std::vector<uint8_t>	dirtyLanes;		// One byte per group, bit i for slot 8 * group + i
+	std::vector<uint32_t>	freeSlots;
+	size_t count = 0;
+};
+
+class TransformBenchmark
+{
+public:
+	TransformBenchmark() = delete;
+	~TransformBenchmark() = delete;
+
+	// Prints the matrices composed per second by SceneNode::GetTransformation, the scalar store path and the SIMD kernel
+	static void Run(size_t nodeCount, size_t iterationCount);
+};
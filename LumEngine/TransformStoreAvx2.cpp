@@ -0,0 +1,29 @@
+#include "TransformStoreKernel.h"
+
+#include <immintrin.h>
+
+// Built with /arch:AVX2. As in FrustumCullingAvx2.cpp the kernel only sees the raw component and matrix arrays,
+// no glm or std inline function gets a VEX encoded copy here.
+
+namespace
+{
+	// Eight slots per iteration, multiply adds fused
+	struct Avx2Lanes
+	{
+		typedef __m256 Type;
+		static const size_t laneCount = 8;
+
+		static Type Load(const float* values) { return _mm256_load_ps(values); }
+		static Type Broadcast(float value) { return _mm256_set1_ps(value); }
+		static Type Add(Type a, Type b) { return _mm256_add_ps(a, b); }
+		static Type Sub(Type a, Type b) { return _mm256_sub_ps(a, b); }
+		static Type Mul(Type a, Type b) { return _mm256_mul_ps(a, b); }
+		static Type MulAdd(Type a, Type b, Type c) { return _mm256_fmadd_ps(a, b, c); }
+		static __m128 GetQuarter(Type lanes, size_t quarter) { return quarter == 0 ? _mm256_castps256_ps128(lanes) : _mm256_extractf128_ps(lanes, 1); }
+	};
+}
+
+void TransformStore::ComposeGroupAvx2(const float* const components[ComponentCount], float* matrices)
+{
+	ComposeLanes<Avx2Lanes>(components, matrices);
+}
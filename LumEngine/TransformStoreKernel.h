@@ -0,0 +1,86 @@
+#pragma once
+
+#include "TransformStore.h"
+
+#include <xmmintrin.h>
+
+// Body of the composition kernel, included by TransformStore.cpp for the SSE lanes and TransformStoreAvx2.cpp for the AVX2 ones.
+// Lanes holds the type and operations of laneCount slots, declared in an unnamed namespace so every instance stays in its file.
+template<typename Lanes>
+void TransformStore::ComposeLanes(const float* const components[ComponentCount], float* matrices)
+{
+	typedef typename Lanes::Type Type;
+
+	// Unchanged slots of the group are composed too, to the same matrix
+	for (size_t first = 0; first < groupSize; first += Lanes::laneCount)
+	{
+		Type qx = Lanes::Load(components[RotationX] + first);
+		Type qy = Lanes::Load(components[RotationY] + first);
+		Type qz = Lanes::Load(components[RotationZ] + first);
+		Type qw = Lanes::Load(components[RotationW] + first);
+
+		Type x2 = Lanes::Add(qx, qx), y2 = Lanes::Add(qy, qy), z2 = Lanes::Add(qz, qz);
+		Type xx = Lanes::Mul(qx, x2), yy = Lanes::Mul(qy, y2), zz = Lanes::Mul(qz, z2);
+		Type xy = Lanes::Mul(qx, y2), xz = Lanes::Mul(qx, z2), yz = Lanes::Mul(qy, z2);
+		Type wx = Lanes::Mul(qw, x2), wy = Lanes::Mul(qw, y2), wz = Lanes::Mul(qw, z2);
+		Type one = Lanes::Broadcast(1.f);
+
+		// Rotation rows scaled by the scale of their axis
+		Type scaleX = Lanes::Load(components[ScaleX] + first);
+		Type scaleY = Lanes::Load(components[ScaleY] + first);
+		Type scaleZ = Lanes::Load(components[ScaleZ] + first);
+
+		Type linear[3][3] =
+		{
+			{ Lanes::Mul(scaleX, Lanes::Sub(one, Lanes::Add(yy, zz))), Lanes::Mul(scaleX, Lanes::Sub(xy, wz)), Lanes::Mul(scaleX, Lanes::Add(xz, wy)) },
+			{ Lanes::Mul(scaleY, Lanes::Add(xy, wz)), Lanes::Mul(scaleY, Lanes::Sub(one, Lanes::Add(xx, zz))), Lanes::Mul(scaleY, Lanes::Sub(yz, wx)) },
+			{ Lanes::Mul(scaleZ, Lanes::Sub(xz, wy)), Lanes::Mul(scaleZ, Lanes::Add(yz, wx)), Lanes::Mul(scaleZ, Lanes::Sub(one, Lanes::Add(xx, yy))) }
+		};
+
+		// The node translation is applied before the rotation, after the import transform
+		Type importRows[3][4];
+		for (int row = 0; row < 3; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+				importRows[row][column] = Lanes::Load(components[Import00 + row * 4 + column] + first);
+		}
+
+		importRows[0][3] = Lanes::Add(importRows[0][3], Lanes::Load(components[TranslationX] + first));
+		importRows[1][3] = Lanes::Add(importRows[1][3], Lanes::Load(components[TranslationY] + first));
+		importRows[2][3] = Lanes::Add(importRows[2][3], Lanes::Load(components[TranslationZ] + first));
+
+		Type rows[3][4];
+		for (int row = 0; row < 3; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				Type value = Lanes::Mul(linear[row][0], importRows[0][column]);
+				value = Lanes::MulAdd(linear[row][1], importRows[1][column], value);
+				rows[row][column] = Lanes::MulAdd(linear[row][2], importRows[2][column], value);
+			}
+		}
+
+		// Rows of 4 slots to their 4 column major matrices, one 4x4 transpose per column
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 identityW = _mm_set1_ps(1.f);
+
+		for (size_t quarter = 0; quarter < Lanes::laneCount / 4; ++quarter)
+		{
+			float* quarterMatrices = matrices + (first + quarter * 4) * 16;
+
+			for (int column = 0; column < 4; ++column)
+			{
+				__m128 x = Lanes::GetQuarter(rows[0][column], quarter);
+				__m128 y = Lanes::GetQuarter(rows[1][column], quarter);
+				__m128 z = Lanes::GetQuarter(rows[2][column], quarter);
+				__m128 w = column == 3 ? identityW : zero;
+				_MM_TRANSPOSE4_PS(x, y, z, w);
+
+				_mm_storeu_ps(quarterMatrices + column * 4, x);
+				_mm_storeu_ps(quarterMatrices + 16 + column * 4, y);
+				_mm_storeu_ps(quarterMatrices + 32 + column * 4, z);
+				_mm_storeu_ps(quarterMatrices + 48 + column * 4, w);
+			}
+		}
+	}
+}
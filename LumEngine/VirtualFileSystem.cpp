@@ -0,0 +1,109 @@
+#include "VirtualFileSystem.h"
+#include "Lz4.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+std::vector<VirtualFileSystem::MountedArchive> VirtualFileSystem::mounts;
+
+bool VirtualFileSystem::Mount(const std::string& archivePath, const std::string& mountPoint)
+{
+	std::shared_ptr<PackFile> archive = std::make_shared<PackFile>();
+	if (!archive->Open(archivePath))
+		return false;
+
+	// The last archive mounted wins, a patch archive overrides the entries of the base one
+	std::string prefix = PackFile::NormalizePath(mountPoint);
+	mounts.insert(mounts.begin(), { prefix.empty() ? prefix : prefix + "/", archive });
+	return true;
+}
+
+void VirtualFileSystem::UnmountAll()
+{
+	mounts.clear();
+}
+
+const PackFile::Entry* VirtualFileSystem::FindEntry(const std::string& path, std::shared_ptr<PackFile>& archive)
+{
+	if (mounts.empty())
+		return nullptr;
+
+	std::string normalized = PackFile::NormalizePath(path);
+	for (const MountedArchive& mount : mounts)
+	{
+		if (normalized.compare(0, mount.prefix.size(), mount.prefix) != 0)
+			continue;
+
+		if (const PackFile::Entry* entry = mount.archive->Find(normalized.substr(mount.prefix.size())))
+		{
+			archive = mount.archive;
+			return entry;
+		}
+	}
+
+	return nullptr;
+}
+
+std::shared_ptr<const FileData> VirtualFileSystem::Open(const std::string& path)
+{
+	std::shared_ptr<FileData> file = std::make_shared<FileData>();
+
+	std::shared_ptr<PackFile> archive;
+	if (const PackFile::Entry* entry = FindEntry(path, archive))
+	{
+		const uint8_t* stored = archive->GetStoredData(*entry);
+		file->size = static_cast<size_t>(entry->size);
+
+		if (entry->flags & PackFile::Compressed)
+		{
+			file->decompressed.resize(file->size);
+			if (!Lz4::Decompress(stored, static_cast<size_t>(entry->storedSize), file->decompressed.data(), file->size))
+				return nullptr;
+
+			file->data = file->decompressed.data();
+		}
+		else
+		{
+			// Read in place, the mapping lives as long as the file
+			file->data = stored;
+			file->owner = archive;
+		}
+
+		return file;
+	}
+
+	std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+	if (!mapping->Open(path))
+		return nullptr;
+
+	file->data = mapping->GetData();
+	file->size = mapping->GetSize();
+	file->owner = mapping;
+	return file;
+}
+
+bool VirtualFileSystem::Exists(const std::string& path)
+{
+	uint64_t size;
+	int64_t time;
+	return GetStamp(path, size, time);
+}
+
+bool VirtualFileSystem::GetStamp(const std::string& path, uint64_t& size, int64_t& time)
+{
+	std::shared_ptr<PackFile> archive;
+	if (const PackFile::Entry* entry = FindEntry(path, archive))
+	{
+		size = entry->size;
+		time = entry->time;
+		return true;
+	}
+
+	struct stat fileStat;
+	if (stat(path.c_str(), &fileStat) != 0 || (fileStat.st_mode & S_IFMT) == S_IFDIR)
+		return false;
+
+	size = static_cast<uint64_t>(fileStat.st_size);
+	time = static_cast<int64_t>(fileStat.st_mtime);
+	return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "PackFile.h"
+
+// Bytes of a file, mapped from the disk or an archive, or decompressed.
+// The data stays valid as long as the FileData is referenced
+class FileData
+{
+public:
+	const uint8_t* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+
+private:
+	friend class VirtualFileSystem;
+
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	std::shared_ptr<const void> owner;		// The archive or the mapping of a loose file
+	std::vector<uint8_t> decompressed;
+};
+
+// Resolves the paths of the engine loaders in the mounted archives first, then on the disk.
+// Archives are mounted before any load, lookups are lock free afterwards
+class VirtualFileSystem
+{
+public:
+	VirtualFileSystem() = delete;
+	~VirtualFileSystem() = delete;
+
+	// The archive holds the files under mountPoint, "../Data" for an archive of the Data directory
+	static bool Mount(const std::string& archivePath, const std::string& mountPoint);
+	static void UnmountAll();
+
+	// nullptr when the file doesn't exist or its entry is corrupted
+	static std::shared_ptr<const FileData> Open(const std::string& path);
+
+	static bool Exists(const std::string& path);
+
+	// Size and modification time of the source of a cache, from the archive when it was packed
+	static bool GetStamp(const std::string& path, uint64_t& size, int64_t& time);
+
+private:
+	struct MountedArchive
+	{
+		std::string prefix;		// Normalized mount point ending with '/'
+		std::shared_ptr<PackFile> archive;
+	};
+
+	// The entry of path in a mounted archive, or nullptr
+	static const PackFile::Entry* FindEntry(const std::string& path, std::shared_ptr<PackFile>& archive);
+
+	static std::vector<MountedArchive> mounts;
+};
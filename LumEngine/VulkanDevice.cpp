@@ -74,6 +74,7 @@ void VulkanDevice::CreateLogicalDevice(VkQueueFlags requestedQueueTypes)
 
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	deviceFeatures.textureCompressionBC = features.textureCompressionBC;
 
 	const char* device_extensions[] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 	VkDeviceCreateInfo deviceInfo = {};
@@ -6,10 +6,12 @@
 #include <fstream>
 #include <cassert>
 #include <array>
+#include <algorithm>
 #include "LeMaterial.h"
 #include <glm/common.hpp>
 #include <glm/common.hpp>
 #include "MeshLoader.h"
+#include "TextureCache.h"
 
 #define VULKAN_ENABLE_VALIDATION
 
@@ -60,7 +62,7 @@ VulkanDriver::VulkanDriver(unsigned int width, unsigned int height)
 	// Prepare frame render objects and logic
 	CreateCommandPool();
 	CreateCommandBuffer(setupCommandBuffer, true);
-	CreateTextureSampler();
+	CreateSamplers();
 	swapChain.Create(&windowWidth, &windowHeight);
 	CreateDescriptorPool();
 	InitilizeRessourcesManager();
@@ -83,7 +85,6 @@ VulkanDriver::VulkanDriver(unsigned int width, unsigned int height)
 	// Prepare skybox render objects
 	CreateSkyboxDescriptorSetLayout();
 	CreateSkyboxPipeline();
-	CreateSkyboxSampler();
 	LoadCubeMap();
 
 	// Prepare Light Cube render objects
@@ -103,6 +104,10 @@ VulkanDriver::VulkanDriver(unsigned int width, unsigned int height)
 	CreateShadowPipeline();
 	   
 	InitializeImGui();
+
+	// Assets saved while running are imported again and swapped in between two frames
+	if (!assetReloader.Start("../Data"))
+		std::cout << "Can't watch ../Data, assets won't be reloaded" << std::endl;
 }
 
 VulkanDriver::~VulkanDriver()
@@ -237,6 +242,8 @@ void VulkanDriver::CreateImGuiInterface()
 		aLightHeightSize = 150.f;
 	else if (ambientUniformBufferObject.mode == 2)
 		aLightHeightSize = 210.f;
+	else
+		aLightHeightSize = 80.f;
 
 	ImGui::BeginChild("Child6", ImVec2(0.f, aLightHeightSize), true);
 	ImGui::Text("Ambient Light parameters");
@@ -279,15 +286,19 @@ void VulkanDriver::CreateImGuiInterface()
 		ImGui::ColorEdit3(colorString5.c_str(), glm::value_ptr(ambientUniformBufferObject.ambientCube[5]));
 	}
 
-	std::string kaString = "Ka";
-	ImGui::SliderFloat(kaString.c_str(), &ambientUniformBufferObject.ka, 0.f, 1.f);
+	// The skybox lights the scene as it is
+	if (ambientUniformBufferObject.mode != AmbientMode::ImageBased)
+	{
+		std::string kaString = "Ka";
+		ImGui::SliderFloat(kaString.c_str(), &ambientUniformBufferObject.ka, 0.f, 1.f);
+	}
 
 	std::string modeString = "Mode";
-	ImGui::Combo(modeString.c_str(), &ambientUniformBufferObject.mode, "Flat\0Trilight\0CubeMap\0");
+	ImGui::Combo(modeString.c_str(), &ambientUniformBufferObject.mode, "Flat\0Trilight\0CubeMap\0ImageBased\0");
 
 	ImGui::EndChild();
 
-	ImGui::BeginChild("Child7", ImVec2(0, 130), true/*, ImGuiWindowFlags_MenuBar*/);
+	ImGui::BeginChild("Child7", ImVec2(0, 200), true/*, ImGuiWindowFlags_MenuBar*/);
 	ImGui::Text("Global lights parameters");
 	ImGui::Spacing();
 
@@ -303,6 +314,24 @@ void VulkanDriver::CreateImGuiInterface()
 	std::string showShadowMap = "Show debug shadow map ? ";
 	ImGui::Checkbox(showShadowMap.c_str(), &showShadowMapDebug);
 
+	std::string meshletCullingString = "Use meshlet culling ? ";
+	ImGui::Checkbox(meshletCullingString.c_str(), &useMeshletCulling);
+
+	std::string instancingString = "Use instancing ? ";
+	ImGui::Checkbox(instancingString.c_str(), &useInstancing);
+
+	ImGui::Text("Draw calls : %u", drawCallCount);
+	ImGui::Text("Visible mesh buffers : %u / %zu", visibleBufferCount, cullCandidates.size());
+	ImGui::Text("Loading assets : %zu", AssetManager::GetPendingCount());
+	ImGui::Text("Streamed textures : %zu, %.1f / %.1f MB resident", textureStreamer.GetTextureCount(), textureStreamer.GetResidentBytes() / (1024.f * 1024.f), textureStreamer.budget / (1024.f * 1024.f));
+
+	if (skinningStats.vertexCount > 0)
+	{
+		std::string gpuSkinningString = "Use GPU skinning ? ";
+		ImGui::Checkbox(gpuSkinningString.c_str(), &useGpuSkinning);
+		ImGui::Text("Skinned vertices : %u, CPU %.3f ms, GPU %.3f ms", skinningStats.vertexCount, skinningStats.cpuTimeMs, skinningStats.gpuTimeMs);
+	}
+
 	ImGui::EndChild();
 
 	ImGui::End();
@@ -413,10 +442,14 @@ void VulkanDriver::CreateImGuiInterface()
 		ImGui::Text(meshName.c_str());
 		ImGui::SameLine();
 		std::string visibleString = "Is Visible##" + std::to_string(nodeIndex);
-		ImGui::Checkbox(visibleString.c_str(), &node->isVisible);
+		bool isVisible = node->IsVisible();
+		if (ImGui::Checkbox(visibleString.c_str(), &isVisible))
+			node->SetVisible(isVisible);
 		ImGui::SameLine();
 		std::string transparentString = "Is Transparent##" + std::to_string(nodeIndex);
-		ImGui::Checkbox(transparentString.c_str(), &node->isTransparent);
+		bool isTransparent = node->IsTransparent();
+		if (ImGui::Checkbox(transparentString.c_str(), &isTransparent))
+			node->SetTransparent(isTransparent);
 		ImGui::SameLine();
 		std::string resAllString = "Reset##" + std::to_string(nodeIndex);
 		if (ImGui::Button(resAllString.c_str()))
@@ -560,7 +593,7 @@ void VulkanDriver::SetupSampleValues()
 	ambientUniformBufferObject.ambientCube[5] = glm::vec4(0.f, 0.f, 1.f, 1.f); //+z
 
 	ambientUniformBufferObject.ka = 0.02f;
-	ambientUniformBufferObject.mode = AmbientMode::Flat;
+	ambientUniformBufferObject.mode = AmbientMode::ImageBased;
 
 	lightParamsUniformBufferObject.brdf = BRDF::GGX_KARIS;
 	lightParamsUniformBufferObject.gamma = 2.2f;
@@ -569,6 +602,8 @@ void VulkanDriver::SetupSampleValues()
 
 void VulkanDriver::CleanUp()
 {
+	assetReloader.Stop();
+
 	delete ressourcesList.pipelineLayouts;
 	delete ressourcesList.pipelines;
 	delete ressourcesList.descriptorSetLayouts;
@@ -585,11 +620,8 @@ void VulkanDriver::CleanUp()
 	for (size_t i = 0; i < swapChain.imageCount; i++)
 		vkFreeCommandBuffers(logicalDevice, commandPool, 1, &drawCommandBuffer[i]);
 
-	vkDestroySampler(logicalDevice, depthSampler, nullptr);
-	vkDestroySampler(logicalDevice, normalMapSampler, nullptr);
-	vkDestroySampler(logicalDevice, specularMapSampler, nullptr);
-	vkDestroySampler(logicalDevice, metallicMapSampler, nullptr);
-	vkDestroySampler(logicalDevice, roughnessMapSampler, nullptr);
+	// The layouts using them as immutable samplers are destroyed
+	samplerCache.Clear();
 
 	msaaRenderTarget.buffer.Clear();
 	vkDestroyImageView(logicalDevice, msaaRenderTarget.view, nullptr);
@@ -623,25 +655,18 @@ void VulkanDriver::CleanUp()
 	skyboxUniformData->buffers.Clear();
 	delete skyboxUniformData;
 
-	vkDestroySampler(logicalDevice, skyboxMapSampler, nullptr);
-	skyboxCubeMap->buffer.Clear();
-	skyboxCubeMap->Clear();
-	vkDestroyImageView(logicalDevice, skyboxCubeMap->textureImageView, nullptr);
-	
-	currentScene->skyboxNode->uniformNodeMeshStagingBuffer.Clear();
-	currentScene->skyboxNode->uniformNodeMeshBuffer.Clear();
-	currentScene->skyboxNode->uniformNodeMaterialStagingBuffer.Clear();
-	currentScene->skyboxNode->uniformNodeMaterialBuffer.Clear();
+	for (Texture* texture : { skyboxCubeMap, specularCubeMap, brdfLut })
+	{
+		texture->buffer.Clear();
+		texture->Clear();
+		vkDestroyImageView(logicalDevice, texture->textureImageView, nullptr);
+		delete texture;
+	}
 	
 	MeshBuffer* skyboxNodeMeshBuffer = currentScene->skyboxNode->GetMesh()->GetMeshBuffer(0);
 	skyboxNodeMeshBuffer->vertexBuffer.Clear();
 	skyboxNodeMeshBuffer->indexBuffer.Clear();
 
-	currentScene->shadowDebugNode->uniformNodeMeshStagingBuffer.Clear();
-	currentScene->shadowDebugNode->uniformNodeMeshBuffer.Clear();
-	currentScene->shadowDebugNode->uniformNodeMaterialStagingBuffer.Clear();
-	currentScene->shadowDebugNode->uniformNodeMaterialBuffer.Clear();
-
 	MeshBuffer* shadowDebugNodeMeshBuffer = currentScene->shadowDebugNode->GetMesh()->GetMeshBuffer(0);		
 	shadowDebugNodeMeshBuffer->vertexBuffer.Clear();
 	shadowDebugNodeMeshBuffer->indexBuffer.Clear();
@@ -652,42 +677,69 @@ void VulkanDriver::CleanUp()
 				
 		if (meshNode)
 		{
-			meshNode->uniformNodeMeshStagingBuffer.Clear();
-			meshNode->uniformNodeMeshBuffer.Clear();
-			meshNode->uniformNodeMaterialStagingBuffer.Clear();
-			meshNode->uniformNodeMaterialBuffer.Clear();
-
+			// Geometry can be shared between meshes, Clear() is a no-op once released
 			int meshCount = meshNode->GetMesh()->GetMeshBufferCount();
 			for (size_t i = 0; i < meshCount; i++)
 			{
 				MeshBuffer* meshBuffer = meshNode->GetMesh()->GetMeshBuffer(i);
-				vkFreeDescriptorSets(logicalDevice, descriptorPool, 1, &meshBuffer->descriptorSet);
 				meshBuffer->vertexBuffer.Clear();
 				meshBuffer->indexBuffer.Clear();
+			}
+
+			// Textures are shared between materials, Clear() destroys their GPU resources once
+			LeMaterial* material = meshNode->GetMesh()->GetMaterial();
+			for (Texture* texture : { material->texture, material->normalMap, material->maskMap })
+				texture->Clear();
+			
+		}
+	}
 
-				vkDestroySampler(logicalDevice, meshNode->GetMesh()->GetMaterial()->texture->textureSampler, nullptr);
-				meshNode->GetMesh()->GetMaterial()->texture->Clear();
-				vkDestroyImageView(logicalDevice, meshNode->GetMesh()->GetMaterial()->texture->textureImageView, nullptr);
+	for (RetiredTextureImage& retired : retiredTextureImages)
+	{
+		vkDestroyImageView(logicalDevice, retired.view, nullptr);
+		retired.image.Clear();
+		retired.staging.Clear();
+	}
+	retiredTextureImages.clear();
+	materialTextureSets.clear();
 
-				vkDestroySampler(logicalDevice, meshNode->GetMesh()->GetMaterial()->normalMap->textureSampler, nullptr);
-				meshNode->GetMesh()->GetMaterial()->normalMap->Clear();
-				vkDestroyImageView(logicalDevice, meshNode->GetMesh()->GetMaterial()->normalMap->textureImageView, nullptr);
+	for (Texture* texture : assetTextures)
+	{
+		texture->Clear();
+		TextureCache::Release(texture);
+	}
+	assetTextures.clear();
 
-				vkDestroySampler(logicalDevice, meshNode->GetMesh()->GetMaterial()->specularMap->textureSampler, nullptr);
-				meshNode->GetMesh()->GetMaterial()->specularMap->Clear();
-				vkDestroyImageView(logicalDevice, meshNode->GetMesh()->GetMaterial()->specularMap->textureImageView, nullptr);
+	// Descriptor sets are shared between meshes with the same textures
+	for (auto& materialDescriptorSet : materialDescriptorSets)
+		vkFreeDescriptorSets(logicalDevice, descriptorPool, 1, &materialDescriptorSet.second);
+	materialDescriptorSets.clear();
 
-				vkDestroySampler(logicalDevice, meshNode->GetMesh()->GetMaterial()->metallicMap->textureSampler, nullptr);
-				meshNode->GetMesh()->GetMaterial()->metallicMap->Clear();
-				vkDestroyImageView(logicalDevice, meshNode->GetMesh()->GetMaterial()->metallicMap->textureImageView, nullptr);
+	instanceBuffer.UnmapMemory();
+	instanceBuffer.Clear();
+	materialBuffer.UnmapMemory();
+	materialBuffer.Clear();
 
-				vkDestroySampler(logicalDevice, meshNode->GetMesh()->GetMaterial()->roughnessMap->textureSampler, nullptr);
-				meshNode->GetMesh()->GetMaterial()->roughnessMap->Clear();
-				vkDestroyImageView(logicalDevice, meshNode->GetMesh()->GetMaterial()->roughnessMap->textureImageView, nullptr);
-			}
-			
-		}
+	// Skinned copies only borrow their buffers
+	for (SkinnedBuffer& skinnedBuffer : skinnedBuffers)
+	{
+		skinnedBuffer.source->skinBuffer.Clear();
+		delete skinnedBuffer.skinned;
 	}
+	skinnedBuffers.clear();
+	skinnedNodeBuffers.clear();
+
+	skinnedVertexBuffer.Clear();
+	cpuSkinnedVertexBuffer.UnmapMemory();
+	cpuSkinnedVertexBuffer.Clear();
+	paletteBuffer.UnmapMemory();
+	paletteBuffer.Clear();
+
+	if (skinningDescriptorPool != VK_NULL_HANDLE)
+		vkDestroyDescriptorPool(logicalDevice, skinningDescriptorPool, nullptr);
+
+	if (timestampQueryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(logicalDevice, timestampQueryPool, nullptr);
 
 	for (SceneNode* node : currentScene->lightsCubesNodes)
 	{
@@ -695,40 +747,20 @@ void VulkanDriver::CleanUp()
 
 		if (meshNode)
 		{
-			meshNode->uniformNodeMeshStagingBuffer.Clear();
-			meshNode->uniformNodeMeshBuffer.Clear();
-			meshNode->uniformNodeMaterialStagingBuffer.Clear();
-			meshNode->uniformNodeMaterialBuffer.Clear();
-
+			// Geometry can be shared between meshes, Clear() is a no-op once released
 			int meshCount = meshNode->GetMesh()->GetMeshBufferCount();
 			for (size_t i = 0; i < meshCount; i++)
 			{
 				MeshBuffer* meshBuffer = meshNode->GetMesh()->GetMeshBuffer(i);
-				vkFreeDescriptorSets(logicalDevice, descriptorPool, 1, &meshBuffer->descriptorSet);
 				meshBuffer->vertexBuffer.Clear();
 				meshBuffer->indexBuffer.Clear();
-
-				vkDestroySampler(logicalDevice, meshNode->GetMesh()->GetMaterial()->texture->textureSampler, nullptr);
-				meshNode->GetMesh()->GetMaterial()->texture->Clear();
-				vkDestroyImageView(logicalDevice, meshNode->GetMesh()->GetMaterial()->texture->textureImageView, nullptr);
-
-				vkDestroySampler(logicalDevice, meshNode->GetMesh()->GetMaterial()->normalMap->textureSampler, nullptr);
-				meshNode->GetMesh()->GetMaterial()->normalMap->Clear();
-				vkDestroyImageView(logicalDevice, meshNode->GetMesh()->GetMaterial()->normalMap->textureImageView, nullptr);
-
-				vkDestroySampler(logicalDevice, meshNode->GetMesh()->GetMaterial()->specularMap->textureSampler, nullptr);
-				meshNode->GetMesh()->GetMaterial()->specularMap->Clear();
-				vkDestroyImageView(logicalDevice, meshNode->GetMesh()->GetMaterial()->specularMap->textureImageView, nullptr);
-
-				vkDestroySampler(logicalDevice, meshNode->GetMesh()->GetMaterial()->metallicMap->textureSampler, nullptr);
-				meshNode->GetMesh()->GetMaterial()->metallicMap->Clear();
-				vkDestroyImageView(logicalDevice, meshNode->GetMesh()->GetMaterial()->metallicMap->textureImageView, nullptr);
-
-				vkDestroySampler(logicalDevice, meshNode->GetMesh()->GetMaterial()->roughnessMap->textureSampler, nullptr);
-				meshNode->GetMesh()->GetMaterial()->roughnessMap->Clear();
-				vkDestroyImageView(logicalDevice, meshNode->GetMesh()->GetMaterial()->roughnessMap->textureImageView, nullptr);
 			}
 
+			// Textures are shared between materials, Clear() destroys their GPU resources once
+			LeMaterial* material = meshNode->GetMesh()->GetMaterial();
+			for (Texture* texture : { material->texture, material->normalMap, material->maskMap })
+				texture->Clear();
+
 		}
 	}
 
@@ -826,6 +858,14 @@ void VulkanDriver::CreatePhysicalDevice()
 	vulkanDevice->CreateLogicalDevice();
 	this->logicalDevice = vulkanDevice->logicalDevice;
 
+	// Material textures are block compressed when the device samples BC formats
+	TextureCache::SetBlockCompression(vulkanDevice->features.textureCompressionBC == VK_TRUE);
+
+	// 16 bits heights need a filterable R16, unlike R8, R8G8 and sRGB it is optional
+	VkFormatProperties r16Properties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R16_UNORM, &r16Properties);
+	TextureCache::SetSixteenBitHeights((r16Properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0);
+
 	this->vulkanDevice->msaaSamples = LeUTILS::GetMaxUsableSampleCount(physicalDevice);
 }
 
@@ -1148,7 +1188,8 @@ void VulkanDriver::CreateFrameBuffer()
 
 void VulkanDriver::CreateDescriptorPool()
 {
-	std::vector<VkDescriptorPoolSize> poolSizes = { LeUTILS::GetDescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 150), LeUTILS::GetDescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 150) };
+	std::vector<VkDescriptorPoolSize> poolSizes = { LeUTILS::GetDescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 150), LeUTILS::GetDescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 210),
+		LeUTILS::GetDescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 90) };
 
 	VkDescriptorPoolCreateInfo descriptorPoolInfo = LeUTILS::DescriptorPoolCreateInfoUtils(poolSizes.size(), poolSizes.data(), 90);
 	DEBUG_CHECK_VK(vkCreateDescriptorPool(logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -1165,23 +1206,55 @@ void VulkanDriver::InitilizeRessourcesManager()
 
 void VulkanDriver::SetupVertexDescriptions()
 {
-	verticesDescription.bindingDescriptions = {	LeUTILS::VertexInputBindingDescriptionUtils(0, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX) };
+	// Binding 0 is the position stream, binding 2 the other attributes (binding 1 is the instance stream)
+	verticesDescription.bindingDescriptions = 
+	{
+		LeUTILS::VertexInputBindingDescriptionUtils(0, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX),
+		LeUTILS::VertexInputBindingDescriptionUtils(2, sizeof(VertexAttributes), VK_VERTEX_INPUT_RATE_VERTEX)
+	};
 
 	verticesDescription.attributeDescriptions = 
 	{
-		LeUTILS::VertexInputAttributeDescriptionUtils(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos)),
-		LeUTILS::VertexInputAttributeDescriptionUtils(0, 1, VK_FORMAT_R32G32_SFLOAT,    offsetof(Vertex, uv)),
-		LeUTILS::VertexInputAttributeDescriptionUtils(0, 2, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)),
-		LeUTILS::VertexInputAttributeDescriptionUtils(0, 3, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)),
+		LeUTILS::VertexInputAttributeDescriptionUtils(0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0),
+		LeUTILS::VertexInputAttributeDescriptionUtils(2, 1, VK_FORMAT_R32G32_SFLOAT,    offsetof(VertexAttributes, uv)),
+		LeUTILS::VertexInputAttributeDescriptionUtils(2, 2, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexAttributes, color)),
+		LeUTILS::VertexInputAttributeDescriptionUtils(2, 3, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexAttributes, normal)),
 	};
 
-	verticesDescription.inputState = LeUTILS::PipelineVertexInputStateCreateInfoUtils();
-	verticesDescription.inputState.vertexBindingDescriptionCount = verticesDescription.bindingDescriptions.size();
-	verticesDescription.inputState.pVertexBindingDescriptions = verticesDescription.bindingDescriptions.data();
-	verticesDescription.inputState.vertexAttributeDescriptionCount = verticesDescription.attributeDescriptions.size();
-	verticesDescription.inputState.pVertexAttributeDescriptions = verticesDescription.attributeDescriptions.data();
+	SetupInputState(verticesDescription);
+
+	// Per instance model matrix (one column per location) and material index
+	std::vector<VkVertexInputAttributeDescription> instanceAttributes;
+
+	for (uint32_t column = 0; column < 4; ++column)
+		instanceAttributes.push_back(LeUTILS::VertexInputAttributeDescriptionUtils(1, 4 + column, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+
+	instanceAttributes.push_back(LeUTILS::VertexInputAttributeDescriptionUtils(1, 8, VK_FORMAT_R32_UINT, offsetof(InstanceData, materialIndex)));
+
+	VkVertexInputBindingDescription instanceBinding = LeUTILS::VertexInputBindingDescriptionUtils(1, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE);
+
+	instancedVerticesDescription.bindingDescriptions = verticesDescription.bindingDescriptions;
+	instancedVerticesDescription.bindingDescriptions.push_back(instanceBinding);
+	instancedVerticesDescription.attributeDescriptions = verticesDescription.attributeDescriptions;
+	instancedVerticesDescription.attributeDescriptions.insert(instancedVerticesDescription.attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
 
+	SetupInputState(instancedVerticesDescription);
 
+	// Depth only passes only fetch the position stream
+	depthVerticesDescription.bindingDescriptions = { verticesDescription.bindingDescriptions[0], instanceBinding };
+	depthVerticesDescription.attributeDescriptions = { verticesDescription.attributeDescriptions[0] };
+	depthVerticesDescription.attributeDescriptions.insert(depthVerticesDescription.attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+
+	SetupInputState(depthVerticesDescription);
+}
+
+void VulkanDriver::SetupInputState(VerticesDescription& description)
+{
+	description.inputState = LeUTILS::PipelineVertexInputStateCreateInfoUtils();
+	description.inputState.vertexBindingDescriptionCount = description.bindingDescriptions.size();
+	description.inputState.pVertexBindingDescriptions = description.bindingDescriptions.data();
+	description.inputState.vertexAttributeDescriptionCount = description.attributeDescriptions.size();
+	description.inputState.pVertexAttributeDescriptions = description.attributeDescriptions.data();
 }
 
 //void VulkanDriver::CreateAttachment(VkFormat format, VkImageUsageFlagBits usage, FrameBufferAttachment *attachment, VkCommandBuffer layoutCmd, uint32_t width, uint32_t height)
@@ -1289,20 +1362,7 @@ void VulkanDriver::PrepareOffscreenRendering()
 	depthStencilView.subresourceRange.layerCount = 1;
 	depthStencilView.image = offscreenFramebuffer.depth.image;
 	DEBUG_CHECK_VK(vkCreateImageView(logicalDevice, &depthStencilView, nullptr, &offscreenFramebuffer.depth.view));
-	   
-	VkSamplerCreateInfo dSampler = LeUTILS::SamplerCreateInfoUtils();
-	dSampler.magFilter = VK_FILTER_LINEAR;
-	dSampler.minFilter = VK_FILTER_LINEAR;
-	dSampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	dSampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-	dSampler.addressModeV = dSampler.addressModeU;
-	dSampler.addressModeW = dSampler.addressModeU;
-	dSampler.mipLodBias = 0.0f;
-	dSampler.maxAnisotropy = 1.0f;
-	dSampler.minLod = 0.0f;
-	dSampler.maxLod = 1.0f;
-	dSampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-	DEBUG_CHECK_VK(vkCreateSampler(logicalDevice, &dSampler, nullptr, &depthSampler));
+
 
 	VkAttachmentDescription attachmentDescription{};
 	attachmentDescription.format = VK_FORMAT_D16_UNORM;
@@ -1430,21 +1490,30 @@ void VulkanDriver::PrepareSceneUniformBuffer()
 void VulkanDriver::CreateSceneDescriptorSetLayout()
 {
 	VkDescriptorSetLayoutBinding sceneUniformLayoutBinding		 = LeUTILS::DescriptorSetLayoutBindingUtils(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
-	VkDescriptorSetLayoutBinding meshNodeUniformLayoutBinding	 = LeUTILS::DescriptorSetLayoutBindingUtils(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
-	VkDescriptorSetLayoutBinding materialUniformLayoutBinding	 = LeUTILS::DescriptorSetLayoutBindingUtils(2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT);
+	VkDescriptorSetLayoutBinding materialStorageLayoutBinding	 = LeUTILS::DescriptorSetLayoutBindingUtils(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT);
 	VkDescriptorSetLayoutBinding lightUniformLayoutBinding		 = LeUTILS::DescriptorSetLayoutBindingUtils(3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT);
 	VkDescriptorSetLayoutBinding ambientUniformLayoutBinding	 = LeUTILS::DescriptorSetLayoutBindingUtils(4, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT);
 	VkDescriptorSetLayoutBinding lightParamsUniformLayoutBinding = LeUTILS::DescriptorSetLayoutBindingUtils(5, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
 	VkDescriptorSetLayoutBinding samplerLayoutBinding			 = LeUTILS::DescriptorSetLayoutBindingUtils(6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
 	VkDescriptorSetLayoutBinding normalMapLayoutBinding			 = LeUTILS::DescriptorSetLayoutBindingUtils(7, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
-	VkDescriptorSetLayoutBinding specularMapLayoutBinding		 = LeUTILS::DescriptorSetLayoutBindingUtils(8, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
-	VkDescriptorSetLayoutBinding metallicMapLayoutBinding		 = LeUTILS::DescriptorSetLayoutBindingUtils(9, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
-	VkDescriptorSetLayoutBinding roughnessMapLayoutBinding		 = LeUTILS::DescriptorSetLayoutBindingUtils(10, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
-	VkDescriptorSetLayoutBinding shadowMapSamplerLayoutBinding	 = LeUTILS::DescriptorSetLayoutBindingUtils(11, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
-	VkDescriptorSetLayoutBinding skyboxSamplerLayoutBinding		 = LeUTILS::DescriptorSetLayoutBindingUtils(12, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
+	VkDescriptorSetLayoutBinding maskMapLayoutBinding			 = LeUTILS::DescriptorSetLayoutBindingUtils(8, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
+	VkDescriptorSetLayoutBinding shadowMapSamplerLayoutBinding	 = LeUTILS::DescriptorSetLayoutBindingUtils(9, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
+	VkDescriptorSetLayoutBinding skyboxSamplerLayoutBinding		 = LeUTILS::DescriptorSetLayoutBindingUtils(10, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
+	VkDescriptorSetLayoutBinding specularMapLayoutBinding		 = LeUTILS::DescriptorSetLayoutBindingUtils(11, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
+	VkDescriptorSetLayoutBinding brdfLutLayoutBinding			 = LeUTILS::DescriptorSetLayoutBindingUtils(12, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
+
+	// Descriptor writes only change the image views
+	samplerLayoutBinding.pImmutableSamplers = &materialSampler;
+	normalMapLayoutBinding.pImmutableSamplers = &materialSampler;
+	maskMapLayoutBinding.pImmutableSamplers = &materialSampler;
+	shadowMapSamplerLayoutBinding.pImmutableSamplers = &depthSampler;
+	skyboxSamplerLayoutBinding.pImmutableSamplers = &skyboxMapSampler;
+	specularMapLayoutBinding.pImmutableSamplers = &skyboxMapSampler;
+	brdfLutLayoutBinding.pImmutableSamplers = &skyboxMapSampler;
 		
-	std::array<VkDescriptorSetLayoutBinding, 13> bindings = { sceneUniformLayoutBinding, meshNodeUniformLayoutBinding, materialUniformLayoutBinding, lightUniformLayoutBinding, ambientUniformLayoutBinding,
-		lightParamsUniformLayoutBinding, samplerLayoutBinding, normalMapLayoutBinding, specularMapLayoutBinding, metallicMapLayoutBinding, roughnessMapLayoutBinding, shadowMapSamplerLayoutBinding, skyboxSamplerLayoutBinding };
+	std::array<VkDescriptorSetLayoutBinding, 12> bindings = { sceneUniformLayoutBinding, materialStorageLayoutBinding, lightUniformLayoutBinding, ambientUniformLayoutBinding,
+		lightParamsUniformLayoutBinding, samplerLayoutBinding, normalMapLayoutBinding, maskMapLayoutBinding, shadowMapSamplerLayoutBinding, skyboxSamplerLayoutBinding,
+		specularMapLayoutBinding, brdfLutLayoutBinding };
 		
 	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1481,10 +1550,10 @@ void VulkanDriver::CreateLightCubePipeline()
 	/*FIXED PIPELINE FUNCTION*/
 
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo = LeUTILS::InputAssemblyStateUtils(
-	1, 
-	static_cast<uint32_t>(verticesDescription.attributeDescriptions.size()),
-	verticesDescription.bindingDescriptions.data(),
-	verticesDescription.attributeDescriptions.data() );
+	static_cast<uint32_t>(instancedVerticesDescription.bindingDescriptions.size()), 
+	static_cast<uint32_t>(instancedVerticesDescription.attributeDescriptions.size()),
+	instancedVerticesDescription.bindingDescriptions.data(),
+	instancedVerticesDescription.attributeDescriptions.data() );
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly = LeUTILS::PipelineInputAssemblyStateUtils(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_FALSE);
 
@@ -1542,11 +1611,10 @@ void VulkanDriver::CreateLightCubePipeline()
 void VulkanDriver::CreateLightCubeDescriptorSetLayout()
 {
 	VkDescriptorSetLayoutBinding sceneUniformLayoutBinding = LeUTILS::DescriptorSetLayoutBindingUtils(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
-	VkDescriptorSetLayoutBinding meshNodeUniformLayoutBinding = LeUTILS::DescriptorSetLayoutBindingUtils(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
 	VkDescriptorSetLayoutBinding lightParamsUniformLayoutBinding = LeUTILS::DescriptorSetLayoutBindingUtils(2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
-	VkDescriptorSetLayoutBinding materialUniformLayoutBinding = LeUTILS::DescriptorSetLayoutBindingUtils(3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT);
+	VkDescriptorSetLayoutBinding materialStorageLayoutBinding = LeUTILS::DescriptorSetLayoutBindingUtils(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT);
 		   
-	std::array<VkDescriptorSetLayoutBinding, 4> bindings = { sceneUniformLayoutBinding, meshNodeUniformLayoutBinding, lightParamsUniformLayoutBinding, materialUniformLayoutBinding };
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings = { sceneUniformLayoutBinding, lightParamsUniformLayoutBinding, materialStorageLayoutBinding };
 
 	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1556,18 +1624,19 @@ void VulkanDriver::CreateLightCubeDescriptorSetLayout()
 	ressourcesList.descriptorSetLayouts->add("lightCube", layoutInfo);
 }
 
-void VulkanDriver::CreateLightCubeBufferDescriptorSet(MeshSceneNode* node, MeshBuffer* buffer, int lightIndex)
+void VulkanDriver::UpdateLightCubeDescriptorSet()
 {
-	if (buffer->descriptorSet == VK_NULL_HANDLE)
+	// Light cubes only use scene wide buffers, one set is shared by all of them
+	VkDescriptorSet lcDescriptorSet = ressourcesList.descriptorSets->get("lightCube");
+	if (lcDescriptorSet == VK_NULL_HANDLE)
 	{
-		VkDescriptorSetLayout layouts[] = { ressourcesList.descriptorSetLayouts->get("lightCube") };
 		VkDescriptorSetAllocateInfo allocInfo = {};
 		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.pSetLayouts = ressourcesList.descriptorSetLayouts->getPtr("lightCube");
 		allocInfo.descriptorSetCount = 1;
-		allocInfo.pSetLayouts = layouts;
 
-		DEBUG_CHECK_VK(vkAllocateDescriptorSets(logicalDevice, &allocInfo, &buffer->descriptorSet));
+		lcDescriptorSet = ressourcesList.descriptorSets->add("lightCube", allocInfo);
 	}
 
 	// Scene buffers
@@ -1576,37 +1645,30 @@ void VulkanDriver::CreateLightCubeBufferDescriptorSet(MeshSceneNode* node, MeshB
 	bufferSceneVertexInfo.offset = 0;
 	bufferSceneVertexInfo.range = sizeof(SceneUniformBufferObject);
 
-	// Node buffers
-	VkDescriptorBufferInfo bufferNodeVertexInfo = {};
-	bufferNodeVertexInfo.buffer = node->uniformNodeMeshBuffer.buffer;
-	bufferNodeVertexInfo.offset = 0;
-	bufferNodeVertexInfo.range = sizeof(UniformNodeVertexBuffer);
-	
 	// Light Params buffer
 	VkDescriptorBufferInfo lightParamsInfo = {};
 	lightParamsInfo.buffer = lightParametersUniformBuffer->buffers.buffer;
 	lightParamsInfo.offset = 0;
 	lightParamsInfo.range = sizeof(LightParamsUniformBufferObject);
 	
-	// Material buffers
+	// Material buffer, the frame slice is selected with a dynamic offset
 	VkDescriptorBufferInfo bufferMaterialInfo = {};
-	bufferMaterialInfo.buffer = node->uniformNodeMaterialBuffer.buffer;
+	bufferMaterialInfo.buffer = materialBuffer.buffer;
 	bufferMaterialInfo.offset = 0;
-	bufferMaterialInfo.range = sizeof(UniformMaterialBuffer);
+	bufferMaterialInfo.range = sizeof(UniformMaterialBuffer) * materialCount;
 	
-	std::array<VkWriteDescriptorSet, 4> descriptorWrites = {};
+	std::array<VkWriteDescriptorSet, 3> descriptorWrites = {};
 	
-	descriptorWrites[0] = LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &bufferSceneVertexInfo);
+	descriptorWrites[0] = LeUTILS::WriteDescriptorSetUtils(lcDescriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &bufferSceneVertexInfo);
 
-	descriptorWrites[1] = LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &bufferNodeVertexInfo);
+	descriptorWrites[1] = LeUTILS::WriteDescriptorSetUtils(lcDescriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &lightParamsInfo);
 
-	descriptorWrites[2] = LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &lightParamsInfo);
-
-	descriptorWrites[3] = LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &bufferMaterialInfo);
-
-	//descriptorWrites[3] = LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &lightsInfo);
+	descriptorWrites[2] = LeUTILS::WriteDescriptorSetUtils(lcDescriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 3, &bufferMaterialInfo);
 
 	vkUpdateDescriptorSets(logicalDevice, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+
+	for (SceneNode* node : currentScene->lightsCubesNodes)
+		static_cast<MeshSceneNode*>(node)->GetMesh()->descriptorSet = lcDescriptorSet;
 }
 
 void VulkanDriver::CreateMsaaRessources()
@@ -1665,10 +1727,10 @@ void VulkanDriver::CreateGraphicPipeline()
 	/*FIXED PIPELINE FUNCTION*/
 
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo = LeUTILS::InputAssemblyStateUtils(
-		1, 
-		static_cast<uint32_t>(verticesDescription.attributeDescriptions.size()),
-		verticesDescription.bindingDescriptions.data(),
-		verticesDescription.attributeDescriptions.data());
+		static_cast<uint32_t>(instancedVerticesDescription.bindingDescriptions.size()), 
+		static_cast<uint32_t>(instancedVerticesDescription.attributeDescriptions.size()),
+		instancedVerticesDescription.bindingDescriptions.data(),
+		instancedVerticesDescription.attributeDescriptions.data());
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly = LeUTILS::PipelineInputAssemblyStateUtils(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_FALSE);
 
@@ -1762,10 +1824,10 @@ void VulkanDriver::CreateShadowPipeline()
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo};
 	
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo = LeUTILS::InputAssemblyStateUtils(
-		1, 
-		static_cast<uint32_t>(verticesDescription.attributeDescriptions.size()),
-		verticesDescription.bindingDescriptions.data(),
-		verticesDescription.attributeDescriptions.data());
+		static_cast<uint32_t>(depthVerticesDescription.bindingDescriptions.size()), 
+		static_cast<uint32_t>(depthVerticesDescription.attributeDescriptions.size()),
+		depthVerticesDescription.bindingDescriptions.data(),
+		depthVerticesDescription.attributeDescriptions.data());
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly = LeUTILS::PipelineInputAssemblyStateUtils(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_FALSE);
 
@@ -1787,9 +1849,8 @@ void VulkanDriver::CreateShadowPipeline()
 
 	VkPipelineColorBlendStateCreateInfo colorBlending = LeUTILS::PipelineColorBlendStateUtils(&colorBlendAttachment, VK_FALSE);
 
-	VkDescriptorSetLayout descriptorSetLayouts[] = { ressourcesList.descriptorSetLayouts->get("shadow"), ressourcesList.descriptorSetLayouts->get("main") };
-
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo = LeUTILS::PipelineLayoutInfo(descriptorSetLayouts, 2);
+	// Model matrices come from the instance buffer, no per mesh set needed
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = LeUTILS::PipelineLayoutInfo(ressourcesList.descriptorSetLayouts->getPtr("shadow"));
 
 	VkPipelineLayout shadowPipelineLayout = ressourcesList.pipelineLayouts->add("shadow", pipelineLayoutInfo);
 
@@ -1823,30 +1884,6 @@ void VulkanDriver::CreateShadowPipeline()
 	vkDestroyShaderModule(logicalDevice, vertShaderModule, nullptr);
 }
 
-void VulkanDriver::CreateMeshSceneNodeUniformBuffer(MeshSceneNode* node)
-{
-	VkDeviceSize bufferSize = sizeof(UniformNodeVertexBuffer);
-
-	vulkanDevice->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, node->uniformNodeMeshStagingBuffer);
-	vulkanDevice->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, node->uniformNodeMeshBuffer);
-	
-	VkCommandBuffer nodeCopyCommandBuffer = VK_NULL_HANDLE;
-	CreateCommandBuffer(nodeCopyCommandBuffer, true);
-	node->_copyCommandBuffer = nodeCopyCommandBuffer;
-	VkBufferCopy copyRegion = {};
-	copyRegion.size = sizeof(UniformNodeVertexBuffer);
-	vkCmdCopyBuffer(node->_copyCommandBuffer, node->uniformNodeMeshStagingBuffer.buffer, node->uniformNodeMeshBuffer.buffer, 1, &copyRegion);
-
-	bufferSize = sizeof(UniformMaterialBuffer);
-
-	vulkanDevice->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, node->uniformNodeMaterialStagingBuffer);
-	vulkanDevice->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, node->uniformNodeMaterialBuffer);
-
-	copyRegion.size = sizeof(UniformMaterialBuffer);
-	vkCmdCopyBuffer(node->_copyCommandBuffer, node->uniformNodeMaterialStagingBuffer.buffer, node->uniformNodeMaterialBuffer.buffer, 1, &copyRegion);
-	vkEndCommandBuffer(node->_copyCommandBuffer);
-}
-
 void VulkanDriver::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
 {
 	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
@@ -1862,7 +1899,7 @@ void VulkanDriver::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSi
 	FlushCommanderBuffer(commandBuffer, graphicQueue, true, true);
 }
 
-void VulkanDriver::UpdateShadowDescriptorSet(MeshSceneNode* node)
+void VulkanDriver::UpdateShadowDescriptorSet()
 {
 	VkDescriptorSet sDescriptorSet = ressourcesList.descriptorSets->get("shadow");
 	if (sDescriptorSet == VK_NULL_HANDLE)
@@ -1911,7 +1948,8 @@ void VulkanDriver::CreateQuadDebugShadowPipeline()
 
 	/*FIXED PIPELINE FUNCTION*/
 
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo = LeUTILS::InputAssemblyStateUtils(1, 
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = LeUTILS::InputAssemblyStateUtils(
+		static_cast<uint32_t>(verticesDescription.bindingDescriptions.size()), 
 		static_cast<uint32_t>(verticesDescription.attributeDescriptions.size()), 
 		verticesDescription.bindingDescriptions.data(),
 		verticesDescription.attributeDescriptions.data());
@@ -1977,6 +2015,7 @@ void VulkanDriver::CreateQuadDebugShadowDescriptorSetLayout()
 	fragLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	fragLayoutBinding.descriptorCount = 1;
 	fragLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	fragLayoutBinding.pImmutableSamplers = &depthSampler;
 
 	std::array<VkDescriptorSetLayoutBinding, 1> bindings = { fragLayoutBinding };
 
@@ -2018,11 +2057,10 @@ void VulkanDriver::UpdateQuadDebugShadowDescriptorSet()
 	vkUpdateDescriptorSets(logicalDevice, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
 }
 
-void VulkanDriver::CreateNodeMeshBufferDescriptorSet(MeshSceneNode* node, MeshBuffer* buffer)
+void VulkanDriver::CreateMeshDescriptorSet(Mesh* mesh)
 {
 	//TODO : https://developer.nvidia.com/vulkan-shader-resource-binding
-
-	if (buffer->descriptorSet == VK_NULL_HANDLE)
+	if (mesh->descriptorSet == VK_NULL_HANDLE)
 	{
 		VkDescriptorSetLayout layouts[] = { ressourcesList.descriptorSetLayouts->get("main") };
 		VkDescriptorSetAllocateInfo allocInfo = {};
@@ -2031,17 +2069,14 @@ void VulkanDriver::CreateNodeMeshBufferDescriptorSet(MeshSceneNode* node, MeshBu
 		allocInfo.descriptorSetCount = 1;
 		allocInfo.pSetLayouts = layouts;
 
-		DEBUG_CHECK_VK(vkAllocateDescriptorSets(logicalDevice, &allocInfo, &buffer->descriptorSet));
+		DEBUG_CHECK_VK(vkAllocateDescriptorSets(logicalDevice, &allocInfo, &mesh->descriptorSet));
 	}
 
 	// Scene buffers
 	VkDescriptorBufferInfo bufferSceneVertexInfo = LeUTILS::DescriptorBufferInfoUtils(sceneUniformBuffer->buffers.buffer, sizeof(SceneUniformBufferObject));
 
-	// Node buffers
-	VkDescriptorBufferInfo bufferNodeVertexInfo = LeUTILS::DescriptorBufferInfoUtils(node->uniformNodeMeshBuffer.buffer, sizeof(UniformNodeVertexBuffer));
-
-	// Material buffers
-	VkDescriptorBufferInfo bufferMaterialInfo = LeUTILS::DescriptorBufferInfoUtils(node->uniformNodeMaterialBuffer.buffer, sizeof(UniformMaterialBuffer));
+	// Material buffer, the frame slice is selected with a dynamic offset
+	VkDescriptorBufferInfo bufferMaterialInfo = LeUTILS::DescriptorBufferInfoUtils(materialBuffer.buffer, sizeof(UniformMaterialBuffer) * materialCount);
 
 	// Light buffer
 	VkDescriptorBufferInfo lightsInfo = LeUTILS::DescriptorBufferInfoUtils(lightUniformBuffer->buffers.buffer, sizeof(LightUniformBufferObject));
@@ -2053,19 +2088,13 @@ void VulkanDriver::CreateNodeMeshBufferDescriptorSet(MeshSceneNode* node, MeshBu
 	VkDescriptorBufferInfo lightParamsInfo = LeUTILS::DescriptorBufferInfoUtils(lightParametersUniformBuffer->buffers.buffer, sizeof(LightParamsUniformBufferObject));
 	
 	// Tex buffer
-	VkDescriptorImageInfo imageInfo = LeUTILS::DescriptorImageInfoUtils(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, node->GetMesh()->GetMaterial()->texture->textureImageView, node->GetMesh()->GetMaterial()->texture->textureSampler);
+	VkDescriptorImageInfo imageInfo = LeUTILS::DescriptorImageInfoUtils(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mesh->GetMaterial()->texture->textureImageView, materialSampler);
 
 	// Normal map buffer
-	VkDescriptorImageInfo normalMapImageInfo = LeUTILS::DescriptorImageInfoUtils(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, node->GetMesh()->GetMaterial()->normalMap->textureImageView, normalMapSampler);
+	VkDescriptorImageInfo normalMapImageInfo = LeUTILS::DescriptorImageInfoUtils(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mesh->GetMaterial()->normalMap->textureImageView, materialSampler);
 
-	// Specular map buffer
-	VkDescriptorImageInfo specularMapImageInfo = LeUTILS::DescriptorImageInfoUtils(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, node->GetMesh()->GetMaterial()->specularMap->textureImageView, specularMapSampler);
-	
-	// Metallic map buffer
-	VkDescriptorImageInfo metallicMapImageInfo = LeUTILS::DescriptorImageInfoUtils(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, node->GetMesh()->GetMaterial()->metallicMap->textureImageView, metallicMapSampler);
-	
-	// Roughness map buffer
-	VkDescriptorImageInfo roughnessMapImageInfo = LeUTILS::DescriptorImageInfoUtils(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, node->GetMesh()->GetMaterial()->roughnessMap->textureImageView, roughnessMapSampler);
+	// Mask map buffer
+	VkDescriptorImageInfo maskMapImageInfo = LeUTILS::DescriptorImageInfoUtils(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mesh->GetMaterial()->maskMap->textureImageView, materialSampler);
 
 	// ShadowMap
 	VkDescriptorImageInfo shadowMapDescInfo = LeUTILS::DescriptorImageInfoUtils(VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, offscreenFramebuffer.depth.view, depthSampler);
@@ -2073,25 +2102,62 @@ void VulkanDriver::CreateNodeMeshBufferDescriptorSet(MeshSceneNode* node, MeshBu
 	// Skybox
 	VkDescriptorImageInfo skyboxDescInfo = LeUTILS::DescriptorImageInfoUtils(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, skyboxCubeMap->textureImageView, skyboxMapSampler);
 
-	std::array<VkWriteDescriptorSet, 13> descriptorWrites = {};	
+	// Image based lighting
+	VkDescriptorImageInfo specularMapDescInfo = LeUTILS::DescriptorImageInfoUtils(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, specularCubeMap->textureImageView, skyboxMapSampler);
+	VkDescriptorImageInfo brdfLutDescInfo = LeUTILS::DescriptorImageInfoUtils(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, brdfLut->textureImageView, skyboxMapSampler);
+
+	std::array<VkWriteDescriptorSet, 12> descriptorWrites = {};	
 	
-	descriptorWrites[0] =  LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &bufferSceneVertexInfo);
-	descriptorWrites[1] =  LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, &bufferNodeVertexInfo);
-	descriptorWrites[2] =  LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &bufferMaterialInfo);
-	descriptorWrites[3] =  LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &lightsInfo);
-	descriptorWrites[4] =  LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &ambientInfo);
-	descriptorWrites[5] =  LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &lightParamsInfo);
-	descriptorWrites[6] =  LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6, &imageInfo);
-	descriptorWrites[7] =  LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7, &normalMapImageInfo);
-	descriptorWrites[8] =  LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8, &specularMapImageInfo);
-	descriptorWrites[9] =  LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9, &metallicMapImageInfo);
-	descriptorWrites[10] = LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10, &roughnessMapImageInfo);
-	descriptorWrites[11] = LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 11, &shadowMapDescInfo);
-	descriptorWrites[12] = LeUTILS::WriteDescriptorSetUtils(buffer->descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 12, &skyboxDescInfo);
+	descriptorWrites[0] =  LeUTILS::WriteDescriptorSetUtils(mesh->descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &bufferSceneVertexInfo);
+	descriptorWrites[1] =  LeUTILS::WriteDescriptorSetUtils(mesh->descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2, &bufferMaterialInfo);
+	descriptorWrites[2] =  LeUTILS::WriteDescriptorSetUtils(mesh->descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &lightsInfo);
+	descriptorWrites[3] =  LeUTILS::WriteDescriptorSetUtils(mesh->descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &ambientInfo);
+	descriptorWrites[4] =  LeUTILS::WriteDescriptorSetUtils(mesh->descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &lightParamsInfo);
+	descriptorWrites[5] =  LeUTILS::WriteDescriptorSetUtils(mesh->descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6, &imageInfo);
+	descriptorWrites[6] =  LeUTILS::WriteDescriptorSetUtils(mesh->descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 7, &normalMapImageInfo);
+	descriptorWrites[7] =  LeUTILS::WriteDescriptorSetUtils(mesh->descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8, &maskMapImageInfo);
+	descriptorWrites[8] =  LeUTILS::WriteDescriptorSetUtils(mesh->descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9, &shadowMapDescInfo);
+	descriptorWrites[9] =  LeUTILS::WriteDescriptorSetUtils(mesh->descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10, &skyboxDescInfo);
+	descriptorWrites[10] = LeUTILS::WriteDescriptorSetUtils(mesh->descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 11, &specularMapDescInfo);
+	descriptorWrites[11] = LeUTILS::WriteDescriptorSetUtils(mesh->descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 12, &brdfLutDescInfo);
 
 	vkUpdateDescriptorSets(logicalDevice, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
 }
 
+std::string VulkanDriver::GetMaterialTexturesKey(LeMaterial* material)
+{
+	// Textures are unique per image in the TextureCache, their addresses identify the combination
+	std::string key = "";
+	for (Texture* texture : { material->texture, material->normalMap, material->maskMap })
+		key += std::to_string(reinterpret_cast<uintptr_t>(texture)) + "|";
+
+	return key;
+}
+
+void VulkanDriver::BindMaterialDescriptorSet(Mesh* mesh)
+{
+	// Meshes with the same textures share their descriptor set so their nodes can be drawn in one instanced call
+	std::string materialKey = GetMaterialTexturesKey(mesh->GetMaterial());
+	auto sharedDescriptorSet = materialDescriptorSets.find(materialKey);
+	if (sharedDescriptorSet != materialDescriptorSets.end())
+	{
+		mesh->descriptorSet = sharedDescriptorSet->second;
+		return;
+	}
+
+	LeMaterial* material = mesh->GetMaterial();
+	CreateTextureBuffer(material->texture);
+	CreateTextureBuffer(material->normalMap);
+	CreateTextureBuffer(material->maskMap);
+
+	// The previous set of the mesh may still be shared by other meshes
+	mesh->descriptorSet = VK_NULL_HANDLE;
+	CreateMeshDescriptorSet(mesh);
+
+	materialDescriptorSets[materialKey] = mesh->descriptorSet;
+	materialTextureSets.push_back({ { material->texture, material->normalMap, material->maskMap }, mesh->descriptorSet });
+}
+
 void VulkanDriver::CopyBufferToImage(BufferHandle& srcBuffer, BufferHandle& dstImage, int layerCount, uint32_t width, uint32_t height)
 {
 	dstImage.SetDevice(logicalDevice);
@@ -2116,262 +2182,872 @@ void VulkanDriver::CopyBufferToImage(BufferHandle& srcBuffer, BufferHandle& dstI
 	FlushCommanderBuffer(commandBuffer, graphicQueue, true, true);
 }
 
-void VulkanDriver::CreateTextureBuffer(Texture* texture)
+void VulkanDriver::RecordTextureUpload(Texture* texture, BufferHandle& staging, VkCommandBuffer commandBuffer)
 {
-	BufferHandle stagingImage;
-	//CreateImage(texture->GetDimensions().x, texture->GetDimensions().y, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_LINEAR, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingImage);
-	vulkanDevice->CreateBuffer(texture->GetMemorySize(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingImage);
-	
-	void* data;
-	DEBUG_CHECK_VK(vkMapMemory(logicalDevice, stagingImage.memory, 0, texture->GetMemorySize(), 0, &data));
-	memcpy(data, texture->GetData(), (size_t)texture->GetMemorySize());
-	vkUnmapMemory(logicalDevice, stagingImage.memory);
-	
-	vulkanDevice->CreateImage(texture->GetDimensions().x, texture->GetDimensions().y, texture->mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture->buffer, 1, 0);
-	
-	TransitionImageLayout(texture->buffer, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, texture->mipLevels);
-	CopyBufferToImage(stagingImage, texture->buffer, 1, texture->GetDimensions().x, texture->GetDimensions().y);
-	//TransitionImageLayout(texture->buffer, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, texture->mipLevels);
-
-	GenerateMipMaps(texture->buffer, VK_FORMAT_R8G8B8A8_UNORM, texture->GetDimensions().x, texture->GetDimensions().y, texture->mipLevels);
-
-	vulkanDevice->CreateImageView(texture->buffer.image, VK_FORMAT_R8G8B8A8_UNORM, texture->textureImageView, texture->mipLevels);
-
-	stagingImage.Clear();
-}
+	// The image holds the resident levels only, its level 0 is texture->residentLevel
+	const uint32_t firstLevel = texture->HasMipChain() ? texture->residentLevel : 0;
+	const uint32_t levelCount = texture->mipLevels - firstLevel;
+	const uint32_t width = std::max(uint32_t(texture->GetDimensions().x) >> firstLevel, 1u);
+	const uint32_t height = std::max(uint32_t(texture->GetDimensions().y) >> firstLevel, 1u);
+	const size_t firstOffset = texture->HasMipChain() ? texture->levelOffsets[firstLevel] : 0;
+	const size_t size = static_cast<size_t>(texture->GetMemorySize()) - firstOffset;
 
-void VulkanDriver::GenerateMipMaps(BufferHandle& srcBuffer, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
-{
-	VkFormatProperties formatProperties;
-	vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
+	vulkanDevice->CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging);
 
-	if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) 
-		throw std::runtime_error("texture image format does not support linear blitting!");
+	void* data;
+	DEBUG_CHECK_VK(vkMapMemory(logicalDevice, staging.memory, 0, size, 0, &data));
+	memcpy(data, static_cast<uint8_t*>(texture->GetData()) + firstOffset, size);
+	vkUnmapMemory(logicalDevice, staging.memory);
 
-	VkCommandBuffer tmpCommandBuffer = VK_NULL_HANDLE;
-	CreateCommandBuffer(tmpCommandBuffer, true);
+	vulkanDevice->CreateImage(width, height, levelCount, VK_SAMPLE_COUNT_1_BIT, texture->format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture->buffer, 1, 0);
 
 	VkImageMemoryBarrier barrier = {};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.image = srcBuffer.image;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-	barrier.subresourceRange.levelCount = 1;
+	barrier.image = texture->buffer.image;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 
-	int32_t mipWidth = texWidth;
-	int32_t mipHeight = texHeight;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-	for (uint32_t i = 1; i < mipLevels; i++) 
+	// One region per level, every level comes from the same staging buffer
+	std::vector<VkBufferImageCopy> regions(levelCount);
+	for (uint32_t level = 0; level < levelCount; ++level)
 	{
-		barrier.subresourceRange.baseMipLevel = i - 1;
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-		vkCmdPipelineBarrier(tmpCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-		VkImageBlit blit = {};
-		blit.srcOffsets[0] = { 0, 0, 0 };
-		blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
-		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		blit.srcSubresource.mipLevel = i - 1;
-		blit.srcSubresource.baseArrayLayer = 0;
-		blit.srcSubresource.layerCount = 1;
-		blit.dstOffsets[0] = { 0, 0, 0 };
-		blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
-		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		blit.dstSubresource.mipLevel = i;
-		blit.dstSubresource.baseArrayLayer = 0;
-		blit.dstSubresource.layerCount = 1;
-
-		vkCmdBlitImage(tmpCommandBuffer, srcBuffer.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, srcBuffer.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
-
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		vkCmdPipelineBarrier(tmpCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-		if (mipWidth > 1) mipWidth /= 2;
-		if (mipHeight > 1) mipHeight /= 2;
+		VkBufferImageCopy& region = regions[level];
+		region.bufferOffset = texture->HasMipChain() ? texture->levelOffsets[firstLevel + level] - firstOffset : 0;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { std::max(width >> level, 1u), std::max(height >> level, 1u), 1 };
 	}
 
-	barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+	vkCmdCopyBufferToImage(commandBuffer, staging.buffer, texture->buffer.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount, regions.data());
+
 	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
 	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-	vkCmdPipelineBarrier(tmpCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-	FlushCommanderBuffer(tmpCommandBuffer, graphicQueue, true, true);
+	vulkanDevice->CreateImageView(texture->buffer.image, texture->format, texture->textureImageView, levelCount);
 }
 
-void VulkanDriver::CreateCubeMapTextureBuffer(Texture* texture, Texture cubeMapTextureArray[6], size_t singleLayerSize)
+void VulkanDriver::CreateTextureBuffer(Texture* texture)
 {
-	BufferHandle stagingImage;
-	uint32_t cubeMapImageSize = cubeMapTextureArray[0].GetDimensions().x;
+	// Textures are shared through the TextureCache, the first material using one uploads it
+	if (texture->textureImageView != VK_NULL_HANDLE)
+		return;
 
-	size_t imageSize = singleLayerSize * 6;
+	// Only the mip tail is uploaded, the TextureStreamer brings the finer levels when they are seen
+	textureStreamer.Register(texture);
 
-	vulkanDevice->CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingImage);
+	BufferHandle stagingImage;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	CreateCommandBuffer(commandBuffer, true);
+	RecordTextureUpload(texture, stagingImage, commandBuffer);
+	FlushCommanderBuffer(commandBuffer, graphicQueue, true, true);
 
-	void* data;
-	//uint8_t* data;
-	DEBUG_CHECK_VK(vkMapMemory(logicalDevice, stagingImage.memory, 0, imageSize, 0, &data));
+	texture->device = logicalDevice;
 
-	for (size_t i = 0; i < 6; ++i)
-		memcpy((static_cast<uint8_t*>(data)) + (singleLayerSize * i), cubeMapTextureArray[i].GetData(), singleLayerSize);
+	stagingImage.Clear();
+	++uploadedTextureCount;
+}
 
-	vkUnmapMemory(logicalDevice, stagingImage.memory);
+void VulkanDriver::UpdateMaterialTextureDescriptors(const MaterialTextureSet& materialSet)
+{
+	const std::array<Texture*, 3>& textures = materialSet.textures;
+	std::array<VkDescriptorImageInfo, 3> imageInfos = {
+		LeUTILS::DescriptorImageInfoUtils(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, textures[0]->textureImageView, materialSampler),
+		LeUTILS::DescriptorImageInfoUtils(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, textures[1]->textureImageView, materialSampler),
+		LeUTILS::DescriptorImageInfoUtils(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, textures[2]->textureImageView, materialSampler)
+	};
 
-	vulkanDevice->CreateImage(cubeMapImageSize, cubeMapImageSize, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture->buffer, 6, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
+	std::array<VkWriteDescriptorSet, 3> descriptorWrites = {};
+	for (uint32_t i = 0; i < descriptorWrites.size(); ++i)
+		descriptorWrites[i] = LeUTILS::WriteDescriptorSetUtils(materialSet.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6 + i, &imageInfos[i]);
 
-	TransitionImageLayout(texture->buffer, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 6, 1);
-	CopyBufferToImage(stagingImage, texture->buffer, 6, cubeMapImageSize, cubeMapImageSize);
-	TransitionImageLayout(texture->buffer, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 6, 1);
+	vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
 
-	//vulkanDevice->CreateImageView(texture->buffer.image, VK_FORMAT_R8G8B8A8_UNORM, texture->textureImageView, VK_IMAGE_VIEW_TYPE_CUBE);
+void VulkanDriver::RequestTextureDensity(Mesh* mesh, const MeshBuffer* buffer, const glm::mat4& model)
+{
+	if (buffer->uvDensity <= 0.f || buffer->boundsRadius < 0.f)
+		return;
 
-	VkImageViewCreateInfo viewCreateInfo = {};
-	viewCreateInfo.image = texture->buffer.image;
-	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
-	viewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-	viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
-	viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	viewCreateInfo.subresourceRange.baseMipLevel = 0;
-	viewCreateInfo.subresourceRange.levelCount = 1;
-	viewCreateInfo.subresourceRange.baseArrayLayer = 0;
-	viewCreateInfo.subresourceRange.layerCount = 6;
-	DEBUG_CHECK_VK(vkCreateImageView(logicalDevice, &viewCreateInfo, nullptr, &texture->textureImageView));
+	// UV distance of one pixel at the closest point of the bounding sphere
+	float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	glm::vec3 center = glm::vec3(model * glm::vec4(buffer->boundsCenter, 1.f));
+	float distance = std::max(glm::length(center - cameraPosition) - buffer->boundsRadius * scale, 0.1f);
+	float uvPerPixel = buffer->uvDensity / scale * distance / cameraPixelScale;
 
-	stagingImage.Clear();
+	auto material = materialUvPerPixel.find(mesh->GetMaterial());
+	if (material == materialUvPerPixel.end())
+		materialUvPerPixel[mesh->GetMaterial()] = uvPerPixel;
+	else
+		material->second = std::min(material->second, uvPerPixel);
 }
 
-void VulkanDriver::CreateMeshBuffers(MeshBuffer* meshBuffer)
+void VulkanDriver::UpdateTextureStreaming(VkCommandBuffer commandBuffer)
 {
-	VkDeviceSize bufferSize = sizeof(Vertex) * meshBuffer->vertices.size();
-	BufferHandle stagingBuffer;
-	vulkanDevice->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer);
+	++frameCount;
 
-	void* data;
-	DEBUG_CHECK_VK(vkMapMemory(logicalDevice, stagingBuffer.memory, 0, bufferSize, 0, &data));
-	memcpy(data, meshBuffer->vertices.data(), (size_t)bufferSize);
-	vkUnmapMemory(logicalDevice, stagingBuffer.memory);
+	// Every frame recorded before the last imageCount ones has completed
+	for (size_t i = 0; i < retiredTextureImages.size();)
+	{
+		RetiredTextureImage& retired = retiredTextureImages[i];
+		if (retired.frame + swapChain.imageCount > frameCount)
+		{
+			++i;
+			continue;
+		}
 
-	vulkanDevice->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshBuffer->vertexBuffer);
-	CopyBuffer(stagingBuffer.buffer, meshBuffer->vertexBuffer.buffer, bufferSize);
-	stagingBuffer.Clear();
+		vkDestroyImageView(logicalDevice, retired.view, nullptr);
+		retired.image.Clear();
+		retired.staging.Clear();
+		retiredTextureImages[i] = retiredTextureImages.back();
+		retiredTextureImages.pop_back();
+	}
 
-	// Indices buffer
-	bufferSize = 2 * meshBuffer->indices.size();
-	vulkanDevice->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer);
+	for (auto& material : materialUvPerPixel)
+	{
+		for (Texture* texture : { material.first->texture, material.first->normalMap, material.first->maskMap })
+			textureStreamer.Request(texture, material.second);
+	}
+	materialUvPerPixel.clear();
 
-	DEBUG_CHECK_VK(vkMapMemory(logicalDevice, stagingBuffer.memory, 0, bufferSize, 0, &data));
-	memcpy(data, meshBuffer->indices.data(), (size_t)bufferSize);
-	vkUnmapMemory(logicalDevice, stagingBuffer.memory);
+	std::vector<TextureStreamer::Change> changes;
+	textureStreamer.Update(changes);
 
-	vulkanDevice->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshBuffer->indexBuffer);
-	CopyBuffer(stagingBuffer.buffer, meshBuffer->indexBuffer.buffer, bufferSize);
-	stagingBuffer.Clear();
-}
+	if (changes.empty())
+		return;
 
-void VulkanDriver::CreateSceneObjectsBuffers()
-{
-	for (SceneNode* node : currentScene->nodes)
+	// The new images are filled before the render passes of this frame sample them
+	for (const TextureStreamer::Change& change : changes)
 	{
-		MeshSceneNode* meshSceneNode = static_cast<MeshSceneNode*>(node);
-		CreateMeshSceneNodeUniformBuffer(meshSceneNode);
-
-		Mesh* mesh = meshSceneNode->GetMesh();
+		RetiredTextureImage retired;
+		retired.image = change.texture->buffer;
+		retired.view = change.texture->textureImageView;
+		retired.frame = frameCount;
+
+		change.texture->buffer = BufferHandle();
+		RecordTextureUpload(change.texture, retired.staging, commandBuffer);
+		retiredTextureImages.push_back(retired);
+	}
 
-		for (size_t i = 0; i < mesh->GetMeshBufferCount(); i++)
+	// Descriptor sets of the previous frames are no longer in use, this frame has not bound them yet
+	for (const MaterialTextureSet& materialSet : materialTextureSets)
+	{
+		bool changed = std::any_of(changes.begin(), changes.end(), [&materialSet](const TextureStreamer::Change& change)
 		{
-			CreateMeshBuffers(mesh->GetMeshBuffer(i));
-			CreateTextureBuffer(mesh->GetMaterial()->texture);
-					   
-			VkSamplerCreateInfo samplerInfo = LeUTILS::VkSamplerCreateInfoUtils();
-			samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-			samplerInfo.minLod = 0;
-			samplerInfo.maxLod = static_cast<float>(mesh->GetMaterial()->texture->mipLevels);
-			samplerInfo.mipLodBias = 0;
-			DEBUG_CHECK_VK(vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &mesh->GetMaterial()->texture->textureSampler));
-
-			CreateTextureBuffer(mesh->GetMaterial()->normalMap);
-			CreateTextureBuffer(mesh->GetMaterial()->specularMap);
-			CreateTextureBuffer(mesh->GetMaterial()->metallicMap);
-			CreateTextureBuffer(mesh->GetMaterial()->roughnessMap);
-			CreateNodeMeshBufferDescriptorSet(meshSceneNode, mesh->GetMeshBuffer(i));
-			UpdateShadowDescriptorSet(meshSceneNode);
-		}
+			return std::find(materialSet.textures.begin(), materialSet.textures.end(), change.texture) != materialSet.textures.end();
+		});
+
+		if (changed)
+			UpdateMaterialTextureDescriptors(materialSet);
 	}
+}
 
-	int lightIndex = 0;
-	for (SceneNode* node : currentScene->lightsCubesNodes)
-	{
-		MeshSceneNode* meshSceneNode = static_cast<MeshSceneNode*>(node);
-		CreateMeshSceneNodeUniformBuffer(meshSceneNode);
+void VulkanDriver::UpdateAssetReloads()
+{
+	std::vector<AssetReloader::TextureReload> textureReloads;
+	std::vector<AssetReloader::MeshReload> meshReloads;
+	assetReloader.Update(textureReloads, meshReloads);
 
-		Mesh* mesh = meshSceneNode->GetMesh();
+	if (!meshReloads.empty())
+	{
+		// The old buffers are destroyed right away, nothing may still read them
+		DEBUG_CHECK_VK(vkQueueWaitIdle(graphicQueue));
 
-		for (size_t i = 0; i < mesh->GetMeshBufferCount(); i++)
+		for (const AssetReloader::MeshReload& reload : meshReloads)
 		{
-			CreateMeshBuffers(mesh->GetMeshBuffer(i));
+			MeshData* data = reload.data;
+
+			// Skinning buffers and draw batches point to the MeshBuffers, they must keep their count and layout
+			bool compatible = data->buffers.size() == reload.reloaded->buffers.size();
+			for (size_t i = 0; compatible && i < data->buffers.size(); ++i)
+				compatible = !data->buffers[i].IsSkinned() && !reload.reloaded->buffers[i].IsSkinned();
+
+			if (!compatible)
+			{
+				std::cout << "Can't reload " << data->key << " while running, its buffers or skin changed" << std::endl;
+				delete reload.reloaded;
+				MeshCache::Release(data);
+				continue;
+			}
 
-			CreateLightCubeBufferDescriptorSet(meshSceneNode, mesh->GetMeshBuffer(i), lightIndex);
+			bool uploaded = !data->buffers.empty() && data->buffers[0].vertexBuffer.buffer != VK_NULL_HANDLE;
+			MeshCache::Replace(data, reload.reloaded);
+
+			for (MeshBuffer& buffer : data->buffers)
+			{
+				buffer.uvDensity = buffer.ComputeUvDensity();
+				if (uploaded)
+					CreateMeshBuffers(&buffer);
+			}
+
+			MeshCache::Release(data);
 		}
 
-		++lightIndex;
+		currentScene->MarkGeometryChanged();
 	}
 
-	CreateMeshBuffers(currentScene->skyboxNode->mesh->GetMeshBuffer(0));
-	CreateMeshBuffers(currentScene->shadowDebugNode->mesh->GetMeshBuffer(0));
-}
+	if (textureReloads.empty())
+		return;
 
-void VulkanDriver::CreateSyncObjects()
-{
-	const int imageCount = swapChain.imageCount;
+	// New images replace the old ones like streamed levels, the old ones are retired after the frames in flight
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	CreateCommandBuffer(commandBuffer, true);
 
-	imageAvailableSemaphores.resize(imageCount);
-	renderFinishedSemaphores.resize(imageCount);
-	inFlightFences.resize(imageCount);
+	for (const AssetReloader::TextureReload& reload : textureReloads)
+	{
+		Texture* texture = reload.texture;
+		bool uploaded = texture->textureImageView != VK_NULL_HANDLE;
 
-	VkSemaphoreCreateInfo semaphoreInfo = {};
-	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		textureStreamer.Unregister(texture);
+		TextureCache::Replace(texture, reload.reloaded);
 
-	VkFenceCreateInfo fenceInfo = {};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+		if (!uploaded)
+			continue;
 
+		RetiredTextureImage retired;
+		retired.image = texture->buffer;
+		retired.view = texture->textureImageView;
+		retired.frame = frameCount;
 
-	for (size_t i = 0; i < imageCount; i++)
+		texture->buffer = BufferHandle();
+		textureStreamer.Register(texture);
+		RecordTextureUpload(texture, retired.staging, commandBuffer);
+		retiredTextureImages.push_back(retired);
+	}
+
+	FlushCommanderBuffer(commandBuffer, graphicQueue, true, true);
+
+	// Only the sets sampling a reloaded texture are written again
+	for (const MaterialTextureSet& materialSet : materialTextureSets)
 	{
-		DEBUG_CHECK_VK(vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]));
-		DEBUG_CHECK_VK(vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]));
-		DEBUG_CHECK_VK(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &inFlightFences[i]));
+		bool changed = std::any_of(textureReloads.begin(), textureReloads.end(), [&materialSet](const AssetReloader::TextureReload& reload)
+		{
+			return std::find(materialSet.textures.begin(), materialSet.textures.end(), reload.texture) != materialSet.textures.end();
+		});
+
+		if (changed)
+			UpdateMaterialTextureDescriptors(materialSet);
 	}
+
+	for (const AssetReloader::TextureReload& reload : textureReloads)
+		TextureCache::Release(reload.texture);
 }
 
-void VulkanDriver::CreateSkyboxPipeline()
+void VulkanDriver::UpdateAssetUploads()
 {
-	std::vector<char> vertShaderCode = LeUTILS::ReadFile("../Data/Shaders/skybox.vert.spv");
-	std::vector<char> fragShaderCode = LeUTILS::ReadFile("../Data/Shaders/skybox.frag.spv");
+	// Up to the budget, but at least one asset so a large one can't stall the queue
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	size_t uploadedBytes = 0;
+	bool meshesAdded = false;
 
-	VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
-	VkShaderModule fragShaderModule = CreateShaderModule(fragShaderCode);
+	AssetManager::Upload upload;
+	for (size_t count = 0; count == 0 || (uploadedBytes < uploadBudgetBytes &&
+		std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < uploadBudgetMs); ++count)
+	{
+		if (!AssetManager::PopUpload(upload))
+			break;
 
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vertShaderModule;
-	vertShaderStageInfo.pName = "main";
-	vertShaderStageInfo.pSpecializationInfo = nullptr;
+		if (upload.texture)
+		{
+			bool uploaded = upload.texture->textureImageView != VK_NULL_HANDLE;
+			CreateTextureBuffer(upload.texture);
+
+			if (!uploaded)
+			{
+				TextureCache::AddReference(upload.texture);
+				assetTextures.push_back(upload.texture);
+				uploadedBytes += TextureStreamer::GetResidentSize(upload.texture, upload.texture->residentLevel);
+			}
+		}
+		else
+		{
+			// Geometry shared with a mesh loaded before is already on the GPU
+			for (MeshBuffer& buffer : upload.data->buffers)
+			{
+				if (buffer.vertexBuffer.buffer != VK_NULL_HANDLE)
+					continue;
+
+				CreateMeshBuffers(&buffer);
+				buffer.uvDensity = buffer.ComputeUvDensity();
+				uploadedBytes += buffer.GetVertexCount() * (sizeof(glm::vec3) + sizeof(VertexAttributes)) + buffer.GetIndexCount() * sizeof(uint16_t);
+			}
+
+			meshesAdded = true;
+		}
+
+		AssetManager::FinishUpload(upload);
+	}
+
+	// The nodes of the new meshes draw from this frame on
+	if (meshesAdded)
+	{
+		GrowInstanceBuffer();
+		currentScene->MarkGeometryChanged();
+	}
+
+	std::vector<Mesh*> changedMeshes;
+	AssetManager::ApplyTextureBindings(changedMeshes);
+
+	for (Mesh* mesh : changedMeshes)
+		BindMaterialDescriptorSet(mesh);
+}
+
+void VulkanDriver::CreateCubeMapTextureBuffer(Texture* texture, Texture cubeMapTextureArray[6])
+{
+	// Faces of the same size, format and levels, each face with its whole chain in the staging buffer
+	Texture& firstFace = cubeMapTextureArray[0];
+	const uint32_t cubeMapImageSize = firstFace.GetDimensions().x;
+	const uint32_t levelCount = firstFace.HasMipChain() ? static_cast<uint32_t>(firstFace.levelOffsets.size()) : 1;
+	const size_t faceSize = static_cast<size_t>(firstFace.GetMemorySize());
+
+	texture->format = firstFace.format;
+	texture->mipLevels = levelCount;
+
+	BufferHandle stagingImage;
+	vulkanDevice->CreateBuffer(faceSize * 6, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingImage);
+
+	void* data;
+	DEBUG_CHECK_VK(vkMapMemory(logicalDevice, stagingImage.memory, 0, faceSize * 6, 0, &data));
+
+	for (size_t i = 0; i < 6; ++i)
+		memcpy((static_cast<uint8_t*>(data)) + (faceSize * i), cubeMapTextureArray[i].GetData(), faceSize);
+
+	vkUnmapMemory(logicalDevice, stagingImage.memory);
+
+	vulkanDevice->CreateImage(cubeMapImageSize, cubeMapImageSize, levelCount, VK_SAMPLE_COUNT_1_BIT, texture->format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture->buffer, 6, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
+
+	TransitionImageLayout(texture->buffer, texture->format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 6, levelCount);
+
+	// One region per face and level
+	std::vector<VkBufferImageCopy> regions;
+	for (uint32_t face = 0; face < 6; ++face)
+	{
+		for (uint32_t level = 0; level < levelCount; ++level)
+		{
+			VkBufferImageCopy region = {};
+			region.bufferOffset = faceSize * face + (firstFace.HasMipChain() ? firstFace.levelOffsets[level] : 0);
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = level;
+			region.imageSubresource.baseArrayLayer = face;
+			region.imageSubresource.layerCount = 1;
+			region.imageExtent = { std::max(cubeMapImageSize >> level, 1u), std::max(cubeMapImageSize >> level, 1u), 1 };
+			regions.push_back(region);
+		}
+	}
+
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	CreateCommandBuffer(commandBuffer, true);
+	vkCmdCopyBufferToImage(commandBuffer, stagingImage.buffer, texture->buffer.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+	FlushCommanderBuffer(commandBuffer, graphicQueue, true, true);
+
+	TransitionImageLayout(texture->buffer, texture->format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 6, levelCount);
+
+	VkImageViewCreateInfo viewCreateInfo = {};
+	viewCreateInfo.image = texture->buffer.image;
+	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
+	viewCreateInfo.format = texture->format;
+	viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+	viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewCreateInfo.subresourceRange.baseMipLevel = 0;
+	viewCreateInfo.subresourceRange.levelCount = levelCount;
+	viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+	viewCreateInfo.subresourceRange.layerCount = 6;
+	DEBUG_CHECK_VK(vkCreateImageView(logicalDevice, &viewCreateInfo, nullptr, &texture->textureImageView));
+
+	stagingImage.Clear();
+}
+
+void VulkanDriver::CreateMeshBuffers(MeshBuffer* meshBuffer)
+{
+	// Shared geometry is only uploaded once
+	if (meshBuffer->vertexBuffer.buffer != VK_NULL_HANDLE)
+		return;
+
+	// Packed positions then the other attributes, depth only passes bind the first stream alone
+	meshBuffer->attributesOffset = sizeof(glm::vec3) * meshBuffer->GetVertexCount();
+	VkDeviceSize bufferSize = meshBuffer->attributesOffset + sizeof(VertexAttributes) * meshBuffer->GetVertexCount();
+	BufferHandle stagingBuffer;
+	vulkanDevice->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer);
+
+	void* data;
+	DEBUG_CHECK_VK(vkMapMemory(logicalDevice, stagingBuffer.memory, 0, bufferSize, 0, &data));
+	meshBuffer->WriteVertexStreams(static_cast<glm::vec3*>(data), reinterpret_cast<VertexAttributes*>(static_cast<uint8_t*>(data) + meshBuffer->attributesOffset));
+	vkUnmapMemory(logicalDevice, stagingBuffer.memory);
+
+	// The skinning compute shader reads the bind pose streams of skinned buffers
+	VkBufferUsageFlags vertexUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	if (meshBuffer->IsSkinned())
+		vertexUsage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+	vulkanDevice->CreateBuffer(bufferSize, vertexUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshBuffer->vertexBuffer);
+	CopyBuffer(stagingBuffer.buffer, meshBuffer->vertexBuffer.buffer, bufferSize);
+	stagingBuffer.Clear();
+
+	if (meshBuffer->IsSkinned())
+	{
+		bufferSize = sizeof(VertexSkin) * meshBuffer->GetVertexCount();
+		vulkanDevice->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer);
+
+		DEBUG_CHECK_VK(vkMapMemory(logicalDevice, stagingBuffer.memory, 0, bufferSize, 0, &data));
+		memcpy(data, meshBuffer->GetSkinData(), (size_t)bufferSize);
+		vkUnmapMemory(logicalDevice, stagingBuffer.memory);
+
+		vulkanDevice->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshBuffer->skinBuffer);
+		CopyBuffer(stagingBuffer.buffer, meshBuffer->skinBuffer.buffer, bufferSize);
+		stagingBuffer.Clear();
+	}
+
+	// Indices buffer
+	bufferSize = sizeof(uint16_t) * meshBuffer->GetIndexCount();
+	vulkanDevice->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer);
+
+	DEBUG_CHECK_VK(vkMapMemory(logicalDevice, stagingBuffer.memory, 0, bufferSize, 0, &data));
+	memcpy(data, meshBuffer->GetIndexData(), (size_t)bufferSize);
+	vkUnmapMemory(logicalDevice, stagingBuffer.memory);
+
+	vulkanDevice->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshBuffer->indexBuffer);
+	CopyBuffer(stagingBuffer.buffer, meshBuffer->indexBuffer.buffer, bufferSize);
+	stagingBuffer.Clear();
+}
+
+void VulkanDriver::DrawMeshBufferMeshlets(MeshBuffer* buffer, const glm::mat4& model, const LeFrustum& frustum, bool cullBackfaces, uint32_t firstInstance)
+{
+	if (!useMeshletCulling)
+	{
+		vkCmdDrawIndexed(drawCommandBuffer[currentBuffer], buffer->GetIndexCount(), 1, 0, 0, firstInstance);
+		++drawCallCount;
+		return;
+	}
+
+	MeshletCulling::Cull(buffer, model, frustum, cameraPosition, cullBackfaces, meshletDrawRanges);
+
+	for (const MeshletDrawRange& range : meshletDrawRanges)
+		vkCmdDrawIndexed(drawCommandBuffer[currentBuffer], range.indexCount, 1, range.firstIndex, 0, firstInstance);
+
+	drawCallCount += static_cast<uint32_t>(meshletDrawRanges.size());
+}
+
+void VulkanDriver::DrawInstanceBatches(const InstanceBatcher& batcher, VkPipelineLayout pipelineLayout, const LeFrustum* frustum, bool cullBackfaces, bool positionsOnly)
+{
+	VkDeviceSize instanceOffset = instanceFrameSize * currentBuffer;
+	vkCmdBindVertexBuffers(drawCommandBuffer[currentBuffer], 1, 1, &instanceBuffer.buffer, &instanceOffset);
+
+	uint32_t materialOffset = static_cast<uint32_t>(materialFrameSize * currentBuffer);
+
+	MeshBuffer* boundBuffer = nullptr;
+	VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+
+	for (const InstanceBatch& batch : batcher.GetBatches())
+	{
+		if (batch.buffer != boundBuffer)
+		{
+			// Skinned copies use the slice of the current frame
+			VkDeviceSize positionsOffset = batch.buffer->vertexOffset + batch.buffer->vertexFrameStride * currentBuffer;
+			VkDeviceSize attributesOffset = positionsOffset + batch.buffer->attributesOffset;
+			vkCmdBindVertexBuffers(drawCommandBuffer[currentBuffer], 0, 1, &batch.buffer->vertexBuffer.buffer, &positionsOffset);
+
+			if (!positionsOnly)
+				vkCmdBindVertexBuffers(drawCommandBuffer[currentBuffer], 2, 1, &batch.buffer->vertexBuffer.buffer, &attributesOffset);
+			vkCmdBindIndexBuffer(drawCommandBuffer[currentBuffer], batch.buffer->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+			boundBuffer = batch.buffer;
+		}
+
+		if (pipelineLayout != VK_NULL_HANDLE && batch.descriptorSet != boundDescriptorSet)
+		{
+			vkCmdBindDescriptorSets(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &batch.descriptorSet, 1, &materialOffset);
+			boundDescriptorSet = batch.descriptorSet;
+		}
+
+		// Instanced groups were culled per node, a lone node still gets meshlet culling
+		if (batch.instanceCount == 1 && frustum != nullptr)
+		{
+			DrawMeshBufferMeshlets(batch.buffer, batch.model, *frustum, cullBackfaces, batch.firstInstance);
+			continue;
+		}
+
+		vkCmdDrawIndexed(drawCommandBuffer[currentBuffer], batch.buffer->GetIndexCount(), batch.instanceCount, 0, 0, batch.firstInstance);
+		++drawCallCount;
+	}
+}
+
+void VulkanDriver::CreateSkinningPipeline()
+{
+	std::vector<VkDescriptorSetLayoutBinding> bindings;
+	for (int binding = 0; binding < 4; ++binding)
+		bindings.push_back(LeUTILS::DescriptorSetLayoutBindingUtils(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT));
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	ressourcesList.descriptorSetLayouts->add("skinning", layoutInfo);
+
+	// Vertex count, source attributes, palette, output and output attributes bases
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(uint32_t) * 5;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = LeUTILS::PipelineLayoutInfo(ressourcesList.descriptorSetLayouts->getPtr("skinning"));
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	VkPipelineLayout skinningPipelineLayout = ressourcesList.pipelineLayouts->add("skinning", pipelineLayoutInfo);
+
+	std::vector<char> computeShaderCode = LeUTILS::ReadFile("../Data/Shaders/skinning.comp.spv");
+	VkShaderModule computeShaderModule = CreateShaderModule(computeShaderCode);
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = computeShaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = skinningPipelineLayout;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	ressourcesList.pipelines->addComputePipeline("skinning", pipelineInfo, pipelineCache);
+
+	vkDestroyShaderModule(logicalDevice, computeShaderModule, nullptr);
+	isSkinningPipelineCreated = true;
+
+	// Two timestamps around the dispatches, only when the graphic queue supports them
+	if (vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits > 0)
+	{
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2;
+		DEBUG_CHECK_VK(vkCreateQueryPool(logicalDevice, &queryPoolInfo, nullptr, &timestampQueryPool));
+	}
+}
+
+void VulkanDriver::CreateSkinningBuffers()
+{
+	const VkDeviceSize streamAlignment = 16;
+	auto align = [streamAlignment](VkDeviceSize size) { return (size + streamAlignment - 1) / streamAlignment * streamAlignment; };
+
+	uint32_t paletteSize = 0;
+	std::unordered_map<MeshBuffer*, VkDescriptorSet> sourceDescriptorSets;
+
+	for (SceneNode* node : currentScene->nodes)
+	{
+		MeshSceneNode* meshNode = static_cast<MeshSceneNode*>(node);
+		Mesh* mesh = meshNode->GetMesh();
+
+		if (!meshNode->animation)
+			continue;
+
+		const AnimationInstance* animation = meshNode->animation.get();
+
+		for (size_t i = 0; i < mesh->GetMeshBufferCount(); ++i)
+		{
+			MeshBuffer* source = mesh->GetMeshBuffer(i);
+			if (!source->IsSkinned())
+				continue;
+
+			// One palette per animation instance, shared by all its skinned buffers
+			if (paletteBases.find(animation) == paletteBases.end())
+			{
+				paletteBases[animation] = paletteSize;
+				paletteSize += static_cast<uint32_t>(animation->GetSkeleton().GetJointCount());
+			}
+
+			size_t vertexCount = source->GetVertexCount();
+
+			// Draw copy, it keeps the source indices but has no meshlets or bounds since the vertices move
+			MeshBuffer* skinned = new MeshBuffer();
+			skinned->indexBuffer = source->indexBuffer;
+			skinned->mappedIndices = source->GetIndexData();
+			skinned->mappedIndexCount = static_cast<uint32_t>(source->GetIndexCount());
+			skinned->attributesOffset = align(sizeof(glm::vec3) * vertexCount);
+			skinned->vertexOffset = skinnedFrameSize;
+			skinnedFrameSize += align(skinned->attributesOffset + sizeof(VertexAttributes) * vertexCount);
+
+			std::vector<MeshBuffer*>& nodeBuffers = skinnedNodeBuffers[node];
+			nodeBuffers.resize(mesh->GetMeshBufferCount(), nullptr);
+			nodeBuffers[i] = skinned;
+
+			SkinnedBuffer skinnedBuffer = { source, skinned, animation, paletteBases[animation], VK_NULL_HANDLE };
+			skinnedBuffer.positions.resize(vertexCount);
+			skinnedBuffer.attributes.resize(vertexCount);
+			source->WriteVertexStreams(skinnedBuffer.positions.data(), skinnedBuffer.attributes.data());
+			skinnedBuffers.push_back(std::move(skinnedBuffer));
+
+			sourceDescriptorSets[source] = VK_NULL_HANDLE;
+			skinningStats.vertexCount += static_cast<uint32_t>(vertexCount);
+		}
+	}
+
+	lastFrameTime = std::chrono::high_resolution_clock::now();
+
+	if (skinnedBuffers.empty())
+		return;
+
+	// Created with the first skinned buffer, scenes without one never load the compute shader
+	if (!isSkinningPipelineCreated)
+		CreateSkinningPipeline();
+
+	// Compute output, read as vertex streams by every pass
+	vulkanDevice->CreateBuffer(skinnedFrameSize * swapChain.imageCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, skinnedVertexBuffer);
+
+	vulkanDevice->CreateBuffer(skinnedFrameSize * swapChain.imageCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, cpuSkinnedVertexBuffer);
+	DEBUG_CHECK_VK(cpuSkinnedVertexBuffer.MapMemory());
+
+	paletteFrameSize = sizeof(glm::mat4) * paletteSize;
+	vulkanDevice->CreateBuffer(paletteFrameSize * swapChain.imageCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, paletteBuffer);
+	DEBUG_CHECK_VK(paletteBuffer.MapMemory());
+
+	for (SkinnedBuffer& skinnedBuffer : skinnedBuffers)
+		skinnedBuffer.skinned->vertexFrameStride = skinnedFrameSize;
+
+	// Palette and output are bound whole, the frame slices are selected by push constants
+	std::vector<VkDescriptorPoolSize> poolSizes = { LeUTILS::GetDescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(sourceDescriptorSets.size() * 4)) };
+	VkDescriptorPoolCreateInfo descriptorPoolInfo = LeUTILS::DescriptorPoolCreateInfoUtils(poolSizes.size(), poolSizes.data(), static_cast<uint32_t>(sourceDescriptorSets.size()));
+	DEBUG_CHECK_VK(vkCreateDescriptorPool(logicalDevice, &descriptorPoolInfo, nullptr, &skinningDescriptorPool));
+
+	for (auto& sourceDescriptorSet : sourceDescriptorSets)
+	{
+		MeshBuffer* source = sourceDescriptorSet.first;
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = skinningDescriptorPool;
+		allocInfo.pSetLayouts = ressourcesList.descriptorSetLayouts->getPtr("skinning");
+		allocInfo.descriptorSetCount = 1;
+		DEBUG_CHECK_VK(vkAllocateDescriptorSets(logicalDevice, &allocInfo, &sourceDescriptorSet.second));
+
+		VkDescriptorBufferInfo sourceInfo = LeUTILS::DescriptorBufferInfoUtils(source->vertexBuffer.buffer, VK_WHOLE_SIZE);
+		VkDescriptorBufferInfo skinInfo = LeUTILS::DescriptorBufferInfoUtils(source->skinBuffer.buffer, VK_WHOLE_SIZE);
+		VkDescriptorBufferInfo paletteInfo = LeUTILS::DescriptorBufferInfoUtils(paletteBuffer.buffer, VK_WHOLE_SIZE);
+		VkDescriptorBufferInfo outputInfo = LeUTILS::DescriptorBufferInfoUtils(skinnedVertexBuffer.buffer, VK_WHOLE_SIZE);
+
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets =
+		{
+			LeUTILS::WriteDescriptorSetUtils(sourceDescriptorSet.second, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &sourceInfo),
+			LeUTILS::WriteDescriptorSetUtils(sourceDescriptorSet.second, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &skinInfo),
+			LeUTILS::WriteDescriptorSetUtils(sourceDescriptorSet.second, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &paletteInfo),
+			LeUTILS::WriteDescriptorSetUtils(sourceDescriptorSet.second, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &outputInfo)
+		};
+		vkUpdateDescriptorSets(logicalDevice, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
+	}
+
+	for (SkinnedBuffer& skinnedBuffer : skinnedBuffers)
+		skinnedBuffer.descriptorSet = sourceDescriptorSets[skinnedBuffer.source];
+}
+
+void VulkanDriver::UpdateSkinning()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	float deltaTime = std::chrono::duration<float>(start - lastFrameTime).count();
+	lastFrameTime = start;
+
+	currentScene->UpdateAnimations(deltaTime);
+
+	if (skinnedBuffers.empty())
+		return;
+
+	// The previous frame was waited for in SubmitDrawing, its timestamps are available
+	if (timestampsWritten)
+	{
+		uint64_t timestamps[2] = {};
+		if (vkGetQueryPoolResults(logicalDevice, timestampQueryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+			skinningStats.gpuTimeMs = (timestamps[1] - timestamps[0]) * deviceProperties.limits.timestampPeriod / 1e6;
+
+		timestampsWritten = false;
+	}
+
+	if (useGpuSkinning)
+	{
+		glm::mat4* palettes = reinterpret_cast<glm::mat4*>(static_cast<uint8_t*>(paletteBuffer.mapped) + paletteFrameSize * currentBuffer);
+
+		for (auto& paletteBase : paletteBases)
+		{
+			const std::vector<glm::mat4>& matrices = paletteBase.first->GetSkinningMatrices();
+			memcpy(palettes + paletteBase.second, matrices.data(), sizeof(glm::mat4) * matrices.size());
+		}
+	}
+	else
+	{
+		uint8_t* frameVertices = static_cast<uint8_t*>(cpuSkinnedVertexBuffer.mapped) + skinnedFrameSize * currentBuffer;
+
+		std::vector<SkinJob> jobs;
+		for (SkinnedBuffer& skinnedBuffer : skinnedBuffers)
+		{
+			uint8_t* vertices = frameVertices + skinnedBuffer.skinned->vertexOffset;
+
+			jobs.push_back({ skinnedBuffer.positions.data(), skinnedBuffer.attributes.data(), skinnedBuffer.source->GetSkinData(), skinnedBuffer.animation->GetSkinningMatrices().data(),
+				reinterpret_cast<glm::vec3*>(vertices), reinterpret_cast<VertexAttributes*>(vertices + skinnedBuffer.skinned->attributesOffset), skinnedBuffer.positions.size() });
+		}
+
+		CpuSkinning::SkinParallel(jobs);
+		skinningStats.gpuTimeMs = 0.0;
+	}
+
+	for (SkinnedBuffer& skinnedBuffer : skinnedBuffers)
+		skinnedBuffer.skinned->vertexBuffer.buffer = useGpuSkinning ? skinnedVertexBuffer.buffer : cpuSkinnedVertexBuffer.buffer;
+
+	skinningStats.cpuTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void VulkanDriver::RecordSkinningDispatch()
+{
+	if (skinnedBuffers.empty() || !useGpuSkinning)
+		return;
+
+	VkCommandBuffer commandBuffer = drawCommandBuffer[currentBuffer];
+
+	if (timestampQueryPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, timestampQueryPool, 0, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, 0);
+	}
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ressourcesList.pipelines->get("skinning"));
+
+	VkPipelineLayout skinningPipelineLayout = ressourcesList.pipelineLayouts->get("skinning");
+	VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+
+	for (const SkinnedBuffer& skinnedBuffer : skinnedBuffers)
+	{
+		if (skinnedBuffer.descriptorSet != boundDescriptorSet)
+		{
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, skinningPipelineLayout, 0, 1, &skinnedBuffer.descriptorSet, 0, nullptr);
+			boundDescriptorSet = skinnedBuffer.descriptorSet;
+		}
+
+		const MeshBuffer* skinned = skinnedBuffer.skinned;
+		VkDeviceSize outputOffset = skinned->vertexOffset + skinnedFrameSize * currentBuffer;
+
+		uint32_t pushConstants[5] =
+		{
+			static_cast<uint32_t>(skinnedBuffer.positions.size()),
+			static_cast<uint32_t>(skinnedBuffer.source->attributesOffset / sizeof(float)),
+			static_cast<uint32_t>(paletteFrameSize / sizeof(glm::mat4) * currentBuffer + skinnedBuffer.paletteBase),
+			static_cast<uint32_t>(outputOffset / sizeof(float)),
+			static_cast<uint32_t>((outputOffset + skinned->attributesOffset) / sizeof(float))
+		};
+
+		vkCmdPushConstants(commandBuffer, skinningPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), pushConstants);
+		vkCmdDispatch(commandBuffer, (pushConstants[0] + 63) / 64, 1, 1);
+	}
+
+	// Skinned vertices are fetched by the shadow and main passes
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = skinnedVertexBuffer.buffer;
+	barrier.offset = skinnedFrameSize * currentBuffer;
+	barrier.size = skinnedFrameSize;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	if (timestampQueryPool != VK_NULL_HANDLE)
+	{
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, timestampQueryPool, 1);
+		timestampsWritten = true;
+	}
+}
+void VulkanDriver::CreateSceneObjectsBuffers()
+{
+	CreateInstanceBuffers();
+
+	for (SceneNode* node : currentScene->nodes)
+	{
+		MeshSceneNode* meshSceneNode = static_cast<MeshSceneNode*>(node);
+
+		Mesh* mesh = meshSceneNode->GetMesh();
+
+		for (size_t i = 0; i < mesh->GetMeshBufferCount(); i++)
+		{
+			CreateMeshBuffers(mesh->GetMeshBuffer(i));
+			mesh->GetMeshBuffer(i)->uvDensity = mesh->GetMeshBuffer(i)->ComputeUvDensity();
+		}
+
+		BindMaterialDescriptorSet(mesh);
+	}
+
+	std::cout << "Material textures : " << uploadedTextureCount << " images for " << materialDescriptorSets.size() << " materials, " << samplerCache.GetCount() << " samplers, " << textureStreamer.GetResidentBytes() / (1024 * 1024) << " MB resident" << std::endl;
+
+	CreateSkinningBuffers();
+
+	UpdateShadowDescriptorSet();
+
+	for (SceneNode* node : currentScene->lightsCubesNodes)
+	{
+		Mesh* mesh = static_cast<MeshSceneNode*>(node)->GetMesh();
+
+		for (size_t i = 0; i < mesh->GetMeshBufferCount(); i++)
+			CreateMeshBuffers(mesh->GetMeshBuffer(i));
+	}
+
+	UpdateLightCubeDescriptorSet();
+
+	CreateMeshBuffers(currentScene->skyboxNode->mesh->GetMeshBuffer(0));
+	CreateMeshBuffers(currentScene->shadowDebugNode->mesh->GetMeshBuffer(0));
+}
+
+void VulkanDriver::CreateSyncObjects()
+{
+	const int imageCount = swapChain.imageCount;
+
+	imageAvailableSemaphores.resize(imageCount);
+	renderFinishedSemaphores.resize(imageCount);
+	inFlightFences.resize(imageCount);
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+
+	for (size_t i = 0; i < imageCount; i++)
+	{
+		DEBUG_CHECK_VK(vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]));
+		DEBUG_CHECK_VK(vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]));
+		DEBUG_CHECK_VK(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &inFlightFences[i]));
+	}
+}
+
+void VulkanDriver::CreateSkyboxPipeline()
+{
+	std::vector<char> vertShaderCode = LeUTILS::ReadFile("../Data/Shaders/skybox.vert.spv");
+	std::vector<char> fragShaderCode = LeUTILS::ReadFile("../Data/Shaders/skybox.frag.spv");
+
+	VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
+	VkShaderModule fragShaderModule = CreateShaderModule(fragShaderCode);
+
+	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
+	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertShaderStageInfo.module = vertShaderModule;
+	vertShaderStageInfo.pName = "main";
+	vertShaderStageInfo.pSpecializationInfo = nullptr;
 
 	VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
 	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -2382,7 +3058,8 @@ void VulkanDriver::CreateSkyboxPipeline()
 
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo = LeUTILS::InputAssemblyStateUtils(1,
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = LeUTILS::InputAssemblyStateUtils(
+		static_cast<uint32_t>(verticesDescription.bindingDescriptions.size()),
 		static_cast<uint32_t>(verticesDescription.attributeDescriptions.size()),
 			verticesDescription.bindingDescriptions.data(),
 			verticesDescription.attributeDescriptions.data());
@@ -2441,39 +3118,54 @@ void VulkanDriver::CreateSkyboxPipeline()
 void VulkanDriver::LoadCubeMap()
 {
 	std::vector<std::string> textPath = { "posx.jpg",  "negx.jpg", "posy.jpg", "negy.jpg", "posz.jpg", "negz.jpg" };
+	for (std::string& path : textPath)
+		path = "../Data/Textures/Maskonaive2/" + path;
+
+	// The faces are decoded once, then read from their .ktx2 cache
 	Texture textArray[6];
+	TextureCache::LoadCubeFaces(textPath, textArray);
 
-	void* texData[6];
-	for (size_t i = 0; i < 6; ++i)
+	skyboxCubeMap = new Texture();
+
+	CreateCubeMapTextureBuffer(skyboxCubeMap, textArray);
+
+	// Baked on the first launch, then read from the caches of the faces
+	ImageBasedLight light;
+	if (IblBaker::Load(textPath, textArray, light))
+	{
+		memcpy(ambientUniformBufferObject.irradiance, light.irradiance, sizeof(ambientUniformBufferObject.irradiance));
+	}
+	else
 	{
-		textArray[i].LoadFile("../Data/Textures/Maskonaive2/" + textPath[i]);
-		texData[i] = textArray[i].GetData();
+		// Black light, a flat ambient takes over
+		std::cout << "Can't bake the image based lighting of " << textPath[0] << std::endl;
+		memset(ambientUniformBufferObject.irradiance, 0, sizeof(ambientUniformBufferObject.irradiance));
+		for (Texture& face : light.specular)
+			face.CreateSolidColor(0, 0, 0, 255);
+		light.brdfLut.CreateSolidColor(0, 0, 0, 0);
+
+		if (ambientUniformBufferObject.mode == AmbientMode::ImageBased)
+			ambientUniformBufferObject.mode = AmbientMode::Flat;
 	}
 
-	const VkDeviceSize imageSize = textArray[0].GetDimensions().x * textArray[0].GetDimensions().y * 4 * 6;
-	const VkDeviceSize layerSize = imageSize / 6;
+	specularCubeMap = new Texture();
+	CreateCubeMapTextureBuffer(specularCubeMap, light.specular);
 
-	skyboxCubeMap = new Texture();
+	// The LUT keeps the pixels of the light
+	brdfLut = new Texture(light.brdfLut);
 
-	CreateCubeMapTextureBuffer(skyboxCubeMap, textArray, layerSize);
-}
+	BufferHandle stagingImage;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	CreateCommandBuffer(commandBuffer, true);
+	RecordTextureUpload(brdfLut, stagingImage, commandBuffer);
+	FlushCommanderBuffer(commandBuffer, graphicQueue, true, true);
+	stagingImage.Clear();
 
-void VulkanDriver::CreateSkyboxSampler()
-{
-	VkSamplerCreateInfo sampler = {};
-	sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	sampler.magFilter = VK_FILTER_LINEAR;
-	sampler.minFilter = VK_FILTER_LINEAR;
-	sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-	sampler.addressModeV = sampler.addressModeU;
-	sampler.addressModeW = sampler.addressModeU;
-	sampler.mipLodBias = 0.0f;
-	sampler.compareOp = VK_COMPARE_OP_NEVER;
-	sampler.minLod = 0.0f;
-	sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-	sampler.maxAnisotropy = 1.0f;
-	DEBUG_CHECK_VK(vkCreateSampler(logicalDevice, &sampler, nullptr, &skyboxMapSampler));
+	for (Texture& face : textArray)
+		face.Clear();
+
+	for (Texture& face : light.specular)
+		face.Clear();
 }
 
 void VulkanDriver::UpdateSkyboxDescriptorSet()
@@ -2513,7 +3205,7 @@ void VulkanDriver::UpdateSkyboxDescriptorSet()
 
 	vkUpdateDescriptorSets(logicalDevice, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 
-	currentScene->skyboxNode->GetMesh()->GetMeshBuffer(0)->descriptorSet = sDescriptorSet;
+	currentScene->skyboxNode->GetMesh()->descriptorSet = sDescriptorSet;
 
 }
 
@@ -2521,6 +3213,7 @@ void VulkanDriver::CreateSkyboxDescriptorSetLayout()
 {
 	VkDescriptorSetLayoutBinding skyboxVertexUniformLayoutBinding = LeUTILS::DescriptorSetLayoutBindingUtils(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
 	VkDescriptorSetLayoutBinding skyboxFragmentUniformLayoutBinding = LeUTILS::DescriptorSetLayoutBindingUtils(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
+	skyboxFragmentUniformLayoutBinding.pImmutableSamplers = &skyboxMapSampler;
 
 	std::array<VkDescriptorSetLayoutBinding, 2> skyboxBindings = { skyboxVertexUniformLayoutBinding, skyboxFragmentUniformLayoutBinding };
 	VkDescriptorSetLayoutCreateInfo skyboxLayoutInfo = {};
@@ -2531,13 +3224,43 @@ void VulkanDriver::CreateSkyboxDescriptorSetLayout()
 	ressourcesList.descriptorSetLayouts->add("skybox", skyboxLayoutInfo);
 }
 
-void VulkanDriver::CreateTextureSampler()
+void VulkanDriver::CreateSamplers()
 {
+	samplerCache.SetDevice(logicalDevice);
+
+	// Every material texture, of any size, the level count is clamped by the image views
 	VkSamplerCreateInfo samplerInfo = LeUTILS::VkSamplerCreateInfoUtils();
-	DEBUG_CHECK_VK(vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &normalMapSampler));
-	DEBUG_CHECK_VK(vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &specularMapSampler));
-	DEBUG_CHECK_VK(vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &metallicMapSampler));
-	DEBUG_CHECK_VK(vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &roughnessMapSampler));
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+	materialSampler = samplerCache.Get(samplerInfo);
+
+	VkSamplerCreateInfo dSampler = LeUTILS::SamplerCreateInfoUtils();
+	dSampler.magFilter = VK_FILTER_LINEAR;
+	dSampler.minFilter = VK_FILTER_LINEAR;
+	dSampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	dSampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+	dSampler.addressModeV = dSampler.addressModeU;
+	dSampler.addressModeW = dSampler.addressModeU;
+	dSampler.mipLodBias = 0.0f;
+	dSampler.maxAnisotropy = 1.0f;
+	dSampler.minLod = 0.0f;
+	dSampler.maxLod = 1.0f;
+	dSampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	depthSampler = samplerCache.Get(dSampler);
+
+	VkSamplerCreateInfo sampler = LeUTILS::SamplerCreateInfoUtils();
+	sampler.magFilter = VK_FILTER_LINEAR;
+	sampler.minFilter = VK_FILTER_LINEAR;
+	sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler.addressModeV = sampler.addressModeU;
+	sampler.addressModeW = sampler.addressModeU;
+	sampler.mipLodBias = 0.0f;
+	sampler.compareOp = VK_COMPARE_OP_NEVER;
+	sampler.minLod = 0.0f;
+	sampler.maxLod = VK_LOD_CLAMP_NONE;
+	sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	sampler.maxAnisotropy = 1.0f;
+	skyboxMapSampler = samplerCache.Get(sampler);
 }
 
 void VulkanDriver::UpdateSceneUniformBuffer()
@@ -2552,6 +3275,10 @@ void VulkanDriver::UpdateSceneUniformBuffer()
 
 	ubo.depthVP = shadowMatrixUniformBufferObject.depthVP;
 
+	cameraFrustum.ExtractPlanes(ubo.proj * ubo.view);
+	cameraPosition = glm::vec3(glm::inverse(ubo.view)[3]);
+	cameraPixelScale = std::abs(ubo.proj[1][1]) * swapChain.swapchainExtent.height * 0.5f;
+
 	memcpy(sceneUniformBuffer->data, &ubo, sizeof(SceneUniformBufferObject));
 	memcpy(lightUniformBuffer->data, &lightUniformBufferObject, sizeof(LightUniformBufferObject));
 	memcpy(ambientUniformBuffer->data, &ambientUniformBufferObject, sizeof(AmbientUniformBufferObject));
@@ -2598,35 +3325,192 @@ void VulkanDriver::UpdateShadowUniformBuffer(LeLight light, int lightType)
 	shadowMatrixUniformBufferObject.depthVP = depthProjectionMatrix * depthViewMatrix;
 	shadowMatrixUniformBufferObject.lightType = lightType;
 
+	// Point lights don't render a shadow map with a usable frustum
+	shadowFrustum.ExtractPlanes(shadowMatrixUniformBufferObject.depthVP);
+	isShadowFrustumValid = light.isVisible && (lightType == 1 || lightType == 2);
+
 	memcpy(shadowMatrixUniformBuffer->data, &shadowMatrixUniformBufferObject, sizeof(ShadowMatrixUniformBufferObject));
 }
 
-void VulkanDriver::UpdateMeshUniformBuffer(MeshSceneNode* node)
+void VulkanDriver::CreateInstanceBuffers()
 {
-	UniformNodeVertexBuffer nodeVertexData;
-	nodeVertexData.model = node->GetTransformation();
+	materialCount = 0;
 
-	void* data;
-	DEBUG_CHECK_VK(vkMapMemory(logicalDevice, node->uniformNodeMeshStagingBuffer.memory, 0, sizeof(UniformNodeVertexBuffer), 0, &data));
-	memcpy(data, &nodeVertexData, sizeof(UniformNodeVertexBuffer));
-	vkUnmapMemory(logicalDevice, node->uniformNodeMeshStagingBuffer.memory);
+	for (SceneNode* node : currentScene->nodes)
+		static_cast<MeshSceneNode*>(node)->SetMaterialIndex(materialCount++);
+
+	for (SceneNode* node : currentScene->lightsCubesNodes)
+		static_cast<MeshSceneNode*>(node)->SetMaterialIndex(materialCount++);
+
+	instanceCapacity = GetInstanceCapacity();
+
+	VkDeviceSize alignment = std::max<VkDeviceSize>(deviceProperties.limits.minStorageBufferOffsetAlignment, 1);
+	materialFrameSize = sizeof(UniformMaterialBuffer) * std::max(materialCount, 1u);
+	materialFrameSize = (materialFrameSize + alignment - 1) / alignment * alignment;
+
+	vulkanDevice->CreateBuffer(materialFrameSize * swapChain.imageCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, materialBuffer);
+	DEBUG_CHECK_VK(materialBuffer.MapMemory());
 
-	//FlushCommanderBuffer(node->_copyCommandBuffer, graphicQueue, false);
+	instanceFrameSize = sizeof(InstanceData) * std::max(instanceCapacity, 1u);
+
+	vulkanDevice->CreateBuffer(instanceFrameSize * swapChain.imageCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instanceBuffer);
+	DEBUG_CHECK_VK(instanceBuffer.MapMemory());
 }
 
-void VulkanDriver::UpdateMaterialUniformBuffer(MeshSceneNode* node)
+uint32_t VulkanDriver::GetInstanceCapacity()
 {
-	//UniformMaterialBuffer materialData;
-	//nodeVertexData.model = node->GetTransformation();
+	uint32_t meshBufferCount = 0;
+	for (SceneNode* node : currentScene->nodes)
+		meshBufferCount += static_cast<uint32_t>(static_cast<MeshSceneNode*>(node)->GetMesh()->GetMeshBufferCount());
 
-	void* data;
-	DEBUG_CHECK_VK(vkMapMemory(logicalDevice, node->uniformNodeMaterialStagingBuffer.memory, 0, sizeof(UniformMaterialBuffer), 0, &data));
-	memcpy(data, node->GetMesh()->GetMaterial(), sizeof(UniformMaterialBuffer));
-	vkUnmapMemory(logicalDevice, node->uniformNodeMaterialStagingBuffer.memory);
+	// Scene nodes are drawn at most twice per frame (shadow and main pass), light cubes once
+	uint32_t capacity = meshBufferCount * 2;
+
+	for (SceneNode* node : currentScene->lightsCubesNodes)
+		capacity += static_cast<uint32_t>(static_cast<MeshSceneNode*>(node)->GetMesh()->GetMeshBufferCount());
+
+	return capacity;
+}
+
+void VulkanDriver::GrowInstanceBuffer()
+{
+	uint32_t capacity = GetInstanceCapacity();
+	if (capacity <= instanceCapacity)
+		return;
+
+	// Frames in flight still read the instances of the old buffer
+	DEBUG_CHECK_VK(vkQueueWaitIdle(graphicQueue));
 
-	FlushCommanderBuffer(node->_copyCommandBuffer, graphicQueue, false);
+	instanceBuffer.UnmapMemory();
+	instanceBuffer.Clear();
+
+	instanceCapacity = capacity;
+	instanceFrameSize = sizeof(InstanceData) * instanceCapacity;
+
+	vulkanDevice->CreateBuffer(instanceFrameSize * swapChain.imageCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instanceBuffer);
+	DEBUG_CHECK_VK(instanceBuffer.MapMemory());
 }
 
+void VulkanDriver::UpdateInstanceBuffers()
+{
+	UniformMaterialBuffer* materials = reinterpret_cast<UniformMaterialBuffer*>(static_cast<uint8_t*>(materialBuffer.mapped) + materialFrameSize * currentBuffer);
+
+	// Every entity writes its own slot of the buffer
+	EntityRegistry::ParallelForEach(currentScene->entities.materials, [materials](Entity, MaterialComponent& component)
+	{
+		materials[component.materialIndex] = component.material->params;
+		materials[component.materialIndex].maskChannels = component.material->maskMap->maskChannels;
+	});
+
+	for (SceneNode* node : currentScene->lightsCubesNodes)
+	{
+		MeshSceneNode* meshNode = static_cast<MeshSceneNode*>(node);
+		LeMaterial* material = meshNode->GetMesh()->GetMaterial();
+		materials[meshNode->GetMaterialIndex()] = material->params;
+		materials[meshNode->GetMaterialIndex()].maskChannels = material->maskMap->maskChannels;
+	}
+
+	for (InstanceBatcher* batcher : { &shadowBatcher, &opaqueBatcher, &transparentBatcher, &lightCubeBatcher })
+	{
+		batcher->mergeInstances = useInstancing;
+		batcher->Clear();
+	}
+
+	// The spatial index keeps the nodes out of both frustums away from the per buffer tests. Without a shadow
+	// frustum every node casts shadows. Proxies are sorted to keep the order the nodes were added in
+	spatialProxies.clear();
+	if (isShadowFrustumValid)
+	{
+		currentScene->spatialIndex.QueryFrustum(cameraFrustum, spatialProxies);
+		currentScene->spatialIndex.QueryFrustum(shadowFrustum, spatialProxies);
+		std::sort(spatialProxies.begin(), spatialProxies.end());
+		spatialProxies.erase(std::unique(spatialProxies.begin(), spatialProxies.end()), spatialProxies.end());
+	}
+	else
+	{
+		for (SceneNode* node : currentScene->nodes)
+			spatialProxies.push_back(node->GetSpatialProxy());
+	}
+
+	// World boxes of the visible nodes, transformed again only for the nodes that moved
+	sceneBoxCuller.Clear();
+	cullCandidates.clear();
+
+	for (uint32_t proxy : spatialProxies)
+	{
+		MeshSceneNode* meshNode = static_cast<MeshSceneNode*>(currentScene->spatialIndex.GetUserData(proxy));
+		Entity entity = meshNode->GetEntity();
+		if (!currentScene->entities.visibilities.Get(entity).visible)
+			continue;
+
+		Mesh* mesh = currentScene->entities.renders.Get(entity).mesh;
+		const glm::mat4& model = currentScene->entities.transforms.Get(entity).world;
+
+		auto skinnedNode = skinnedNodeBuffers.find(meshNode);
+
+		for (size_t i = 0; i < mesh->GetMeshBufferCount(); ++i)
+		{
+			MeshBuffer* buffer = mesh->GetMeshBuffer(i);
+
+			if (skinnedNode != skinnedNodeBuffers.end() && skinnedNode->second[i] != nullptr)
+				buffer = skinnedNode->second[i];
+
+			sceneBoxCuller.Add(meshNode->GetWorldBounds(i, buffer, model));
+			cullCandidates.push_back({ meshNode, buffer, static_cast<uint32_t>(i), model });
+		}
+	}
+
+	visibleBufferCount = static_cast<uint32_t>(sceneBoxCuller.Cull(cameraFrustum, cameraVisibility));
+	if (isShadowFrustumValid)
+		sceneBoxCuller.Cull(shadowFrustum, shadowVisibility);
+
+	// Only the survivors are batched
+	for (uint32_t i = 0; i < cullCandidates.size(); ++i)
+	{
+		const CullCandidate& candidate = cullCandidates[i];
+		Entity entity = candidate.node->GetEntity();
+		Mesh* mesh = currentScene->entities.renders.Get(entity).mesh;
+		uint32_t materialIndex = currentScene->entities.materials.Get(entity).materialIndex;
+
+		// The shadow pass has no descriptor set per mesh, nodes are only grouped by geometry
+		if (!isShadowFrustumValid || BoxCuller::IsVisible(shadowVisibility, i))
+			shadowBatcher.Add(candidate.buffer, VK_NULL_HANDLE, candidate.model, materialIndex);
+
+		if (!BoxCuller::IsVisible(cameraVisibility, i))
+			continue;
+
+		RequestTextureDensity(mesh, mesh->GetMeshBuffer(candidate.bufferIndex), candidate.model);
+
+		if (currentScene->entities.visibilities.Get(entity).transparent)
+			transparentBatcher.Add(candidate.buffer, mesh->descriptorSet, candidate.model, materialIndex);
+		else
+			opaqueBatcher.Add(candidate.buffer, mesh->descriptorSet, candidate.model, materialIndex);
+	}
+
+	int lightIndex = 0;
+	for (SceneNode* node : currentScene->lightsCubesNodes)
+	{
+		LeLight* lightData = currentScene->lightProperty[lightIndex].lightData;
+		++lightIndex;
+
+		if (lightData->position.w == 0.0f || !lightData->isVisible)
+			continue;
+
+		MeshSceneNode* meshNode = static_cast<MeshSceneNode*>(node);
+		Mesh* mesh = meshNode->GetMesh();
+		glm::mat4 model = node->GetTransformation();
+
+		for (size_t i = 0; i < mesh->GetMeshBufferCount(); ++i)
+			lightCubeBatcher.Add(mesh->GetMeshBuffer(i), mesh->descriptorSet, model, meshNode->GetMaterialIndex());
+	}
+
+	InstanceData* instances = reinterpret_cast<InstanceData*>(static_cast<uint8_t*>(instanceBuffer.mapped) + instanceFrameSize * currentBuffer);
+
+	uint32_t instanceCount = shadowBatcher.Write(instances, 0, instanceCapacity);
+	instanceCount = opaqueBatcher.Write(instances, instanceCount, instanceCapacity);
+	instanceCount = transparentBatcher.Write(instances, instanceCount, instanceCapacity);
+	lightCubeBatcher.Write(instances, instanceCount, instanceCapacity);
+}
 void VulkanDriver::PrepareSceneDrawing()
 {
 	if (!objectBuffersCreated)
@@ -2658,29 +3542,32 @@ void VulkanDriver::PrepareSceneDrawing()
 
 void VulkanDriver::PrepareDrawing()
 {
-	for (auto node : currentScene->nodes)
-	{
-		MeshSceneNode* meshNode = static_cast<MeshSceneNode*>(node);
-		UpdateMeshUniformBuffer(meshNode);
-		UpdateMaterialUniformBuffer(meshNode);
-	}
+	// Before anything of this frame reads the geometry or the textures
+	UpdateAssetReloads();
+	UpdateAssetUploads();
 
 	currentScene->UpdateLightsCubesTransform();
-
-	for (auto node : currentScene->lightsCubesNodes)
-	{
-		MeshSceneNode* meshNode = static_cast<MeshSceneNode*>(node);
-		UpdateMeshUniformBuffer(meshNode);
-		UpdateMaterialUniformBuffer(meshNode);
-	}
+	UpdateSkinning();
 	
 	UpdateShadowUniformBuffer(lightUniformBufferObject.light[0], currentScene->lightProperty[0].lightType);
 	UpdateSceneUniformBuffer();
 
+	// Needs the frustums of this frame and the nodes moved by the animations
+	drawCallCount = 0;
+	currentScene->UpdateTransforms();
+	currentScene->UpdateSpatialIndex();
+	UpdateInstanceBuffers();
+
 	VkCommandBuffer drawCmdBuf = VK_NULL_HANDLE;
 	CreateCommandBuffer(drawCmdBuf, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 	drawCommandBuffer[currentBuffer] = drawCmdBuf;
 
+	// Texel densities of this frame are known, new mip levels are copied before any pass samples them
+	UpdateTextureStreaming(drawCmdBuf);
+
+	// Outside of any render pass
+	RecordSkinningDispatch();
+
 	// Shadow Pass
 	VkExtent2D shadowExtent = {};
 	shadowExtent.height = offscreenFramebuffer.height;
@@ -2715,30 +3602,7 @@ void VulkanDriver::PrepareDrawing()
 	vkCmdBindPipeline(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelines->get("shadow"));
 	vkCmdBindDescriptorSets(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelineLayouts->get("shadow"), 0, 1, ressourcesList.descriptorSets->getPtr("shadow"), 0, NULL);
 	   
-	for (auto node : currentScene->nodes)
-	{
-		if (!node->isVisible)
-			continue;
-
-		MeshSceneNode* meshNode = static_cast<MeshSceneNode*>(node);
-		Mesh* mesh = meshNode->GetMesh();
-				
-		for (size_t i = 0; i < mesh->GetMeshBufferCount(); ++i)
-		{
-			MeshBuffer* buffer = mesh->GetMeshBuffer(i);
-
-			VkBuffer vertexBuffers[] = { buffer->vertexBuffer.buffer };
-			VkDeviceSize offsets[] = { 0 };
-			
-			vkCmdBindVertexBuffers(drawCommandBuffer[currentBuffer], 0, 1, vertexBuffers, offsets);
-
-			vkCmdBindIndexBuffer(drawCommandBuffer[currentBuffer], buffer->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
-
-			vkCmdBindDescriptorSets(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelineLayouts->get("shadow"), 1, 1, &buffer->descriptorSet, 0, nullptr);
-
-			vkCmdDrawIndexed(drawCommandBuffer[currentBuffer], buffer->indices.size(), 1, 0, 0, 0);
-		}
-	}
+	DrawInstanceBatches(shadowBatcher, VK_NULL_HANDLE, isShadowFrustumValid ? &shadowFrustum : nullptr, false, true);
 
 	vkCmdEndRenderPass(drawCommandBuffer[currentBuffer]);
 	// !!Shadow Pass
@@ -2774,64 +3638,11 @@ void VulkanDriver::PrepareMeshDrawing()
 	// Bind the graphic pipeline
 	vkCmdBindPipeline(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelines->get("main"));
 
-	for (auto node : currentScene->nodes)
-	{
-		if (!node->isVisible || node->isTransparent)
-			continue;
-
-		MeshSceneNode* meshNode = static_cast<MeshSceneNode*>(node);
-		
-		Mesh* mesh = meshNode->GetMesh();
-
-		for (size_t i = 0; i < mesh->GetMeshBufferCount(); ++i)
-		{
-			MeshBuffer* buffer = mesh->GetMeshBuffer(i);
-
-			VkBuffer vertexBuffers[] = { buffer->vertexBuffer.buffer };
-			VkDeviceSize offsets[] = { 0 };
-
-			vkCmdBindVertexBuffers(drawCommandBuffer[currentBuffer], 0, 1, vertexBuffers, offsets);
-
-			vkCmdBindIndexBuffer(drawCommandBuffer[currentBuffer], buffer->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
-
-			vkCmdBindDescriptorSets(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelineLayouts->get("main"), 0, 1, &buffer->descriptorSet, 0, nullptr);
-
-			vkCmdDrawIndexed(drawCommandBuffer[currentBuffer], buffer->indices.size(), 1, 0, 0, 0);
-		}
-	}
+	DrawInstanceBatches(opaqueBatcher, ressourcesList.pipelineLayouts->get("main"), &cameraFrustum, true);
 
 	vkCmdBindPipeline(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelines->get("lightCube"));
 
-	int lightIndex = 0;
-	for (auto node : currentScene->lightsCubesNodes)
-	{
-		LeLight* lightData = currentScene->lightProperty[lightIndex].lightData;
-		++lightIndex;
-
-		if (lightData->position.w == 0.0f || !lightData->isVisible)
-			continue;
-
-		MeshSceneNode* meshNode = static_cast<MeshSceneNode*>(node);
-
-		Mesh* mesh = meshNode->GetMesh();
-
-		for (size_t i = 0; i < mesh->GetMeshBufferCount(); ++i)
-		{
-			MeshBuffer* buffer = mesh->GetMeshBuffer(i);
-
-			VkBuffer vertexBuffers[] = { buffer->vertexBuffer.buffer };
-			VkDeviceSize offsets[] = { 0 };
-
-			vkCmdBindVertexBuffers(drawCommandBuffer[currentBuffer], 0, 1, vertexBuffers, offsets);
-
-			vkCmdBindIndexBuffer(drawCommandBuffer[currentBuffer], buffer->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
-
-			vkCmdBindDescriptorSets(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelineLayouts->get("lightCube"), 0, 1, &buffer->descriptorSet, 0, nullptr);
-
-			vkCmdDrawIndexed(drawCommandBuffer[currentBuffer], buffer->indices.size(), 1, 0, 0, 0);
-		}
-
-	}
+	DrawInstanceBatches(lightCubeBatcher, ressourcesList.pipelineLayouts->get("lightCube"), nullptr, false);
 
 	VkDeviceSize offsets[] = { 0 };
 
@@ -2842,8 +3653,9 @@ void VulkanDriver::PrepareMeshDrawing()
 		vkCmdBindDescriptorSets(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelineLayouts->get("quadDebug"), 0, 1, ressourcesList.descriptorSets->getPtr("quadDebug"), 0, NULL);
 		vkCmdBindPipeline(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelines->get("quadDebug"));
 		vkCmdBindVertexBuffers(drawCommandBuffer[currentBuffer], 0, 1, quadVertexBuffers, offsets);
+		vkCmdBindVertexBuffers(drawCommandBuffer[currentBuffer], 2, 1, quadVertexBuffers, &quadBuffer->attributesOffset);
 		vkCmdBindIndexBuffer(drawCommandBuffer[currentBuffer], quadBuffer->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
-		vkCmdDrawIndexed(drawCommandBuffer[currentBuffer], quadBuffer->indices.size(), 1, 0, 0, 0);
+		vkCmdDrawIndexed(drawCommandBuffer[currentBuffer], quadBuffer->GetIndexCount(), 1, 0, 0, 0);
 	}
 
 	vkCmdBindPipeline(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelines->get("skybox"));
@@ -2853,68 +3665,22 @@ void VulkanDriver::PrepareMeshDrawing()
 	VkBuffer vertexBuffers[] = { sbBuffer->vertexBuffer.buffer };
 
 	vkCmdBindVertexBuffers(drawCommandBuffer[currentBuffer], 0, 1, vertexBuffers, offsets);
+	vkCmdBindVertexBuffers(drawCommandBuffer[currentBuffer], 2, 1, vertexBuffers, &sbBuffer->attributesOffset);
 
 	vkCmdBindIndexBuffer(drawCommandBuffer[currentBuffer], sbBuffer->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
 
-	vkCmdBindDescriptorSets(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelineLayouts->get("skybox"), 0, 1, &sbBuffer->descriptorSet, 0, nullptr);
+	vkCmdBindDescriptorSets(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelineLayouts->get("skybox"), 0, 1, &currentScene->skyboxNode->GetMesh()->descriptorSet, 0, nullptr);
 
-	vkCmdDrawIndexed(drawCommandBuffer[currentBuffer], sbBuffer->indices.size(), 1, 0, 0, 0);
+	vkCmdDrawIndexed(drawCommandBuffer[currentBuffer], sbBuffer->GetIndexCount(), 1, 0, 0, 0);
 
 	// We draw first the back faces
 	vkCmdBindPipeline(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelines->get("transparent_front"));
 
-	for (auto node : currentScene->nodes)
-	{
-		if (!node->isVisible || !node->isTransparent)
-			continue;
-
-		MeshSceneNode* meshNode = static_cast<MeshSceneNode*>(node);
-		
-		Mesh* mesh = meshNode->GetMesh();
-
-		for (size_t i = 0; i < mesh->GetMeshBufferCount(); ++i)
-		{
-			MeshBuffer* buffer = mesh->GetMeshBuffer(i);
-
-			VkBuffer vertexBuffers[] = { buffer->vertexBuffer.buffer };
-			VkDeviceSize offsets[] = { 0 };
-
-			vkCmdBindVertexBuffers(drawCommandBuffer[currentBuffer], 0, 1, vertexBuffers, offsets);
-
-			vkCmdBindIndexBuffer(drawCommandBuffer[currentBuffer], buffer->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
-
-			vkCmdBindDescriptorSets(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelineLayouts->get("main"), 0, 1, &buffer->descriptorSet, 0, nullptr);
-
-			vkCmdDrawIndexed(drawCommandBuffer[currentBuffer], buffer->indices.size(), 1, 0, 0, 0);
-		}
-	}
+	DrawInstanceBatches(transparentBatcher, ressourcesList.pipelineLayouts->get("main"), &cameraFrustum, false);
 
 	vkCmdBindPipeline(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelines->get("transparent_back"));
 
-	for (auto node : currentScene->nodes)
-	{
-		if (!node->isVisible || !node->isTransparent)
-			continue;
-
-		MeshSceneNode* meshNode = static_cast<MeshSceneNode*>(node);
-		Mesh* mesh = meshNode->GetMesh();
-
-		for (size_t i = 0; i < mesh->GetMeshBufferCount(); ++i)
-		{
-			MeshBuffer* buffer = mesh->GetMeshBuffer(i);
-
-			VkBuffer vertexBuffers[] = { buffer->vertexBuffer.buffer };
-			VkDeviceSize offsets[] = { 0 };
-
-			vkCmdBindVertexBuffers(drawCommandBuffer[currentBuffer], 0, 1, vertexBuffers, offsets);
-
-			vkCmdBindIndexBuffer(drawCommandBuffer[currentBuffer], buffer->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
-
-			vkCmdBindDescriptorSets(drawCommandBuffer[currentBuffer], VK_PIPELINE_BIND_POINT_GRAPHICS, ressourcesList.pipelineLayouts->get("main"), 0, 1, &buffer->descriptorSet, 0, nullptr);
-
-			vkCmdDrawIndexed(drawCommandBuffer[currentBuffer], buffer->indices.size(), 1, 0, 0, 0);
-		}
-	}
+	DrawInstanceBatches(transparentBatcher, ressourcesList.pipelineLayouts->get("main"), &cameraFrustum, false);
 }
 
 void VulkanDriver::SubmitDrawing()
@@ -12,6 +12,17 @@
 #include "LeCamera.h"
 #include "InputManager.h"
 #include "UniformBufferHandle.h"
+#include "InstanceBatch.h"
+#include "Skinning.h"
+#include "TextureStreamer.h"
+#include "AssetReloader.h"
+#include "AssetManager.h"
+#include "SamplerCache.h"
+#include "IblBaker.h"
+#include "FrustumCulling.h"
+
+#include <chrono>
+#include <array>
 
 struct Resources
 {
@@ -57,6 +68,16 @@ public:
 
 	GLFWwindow*	window = nullptr;
 
+	// Skinned meshes are skinned by a compute shader, or on the CPU with SIMD on every core
+	bool		useGpuSkinning = true;
+
+	struct SkinningStats
+	{
+		uint32_t	vertexCount = 0;
+		double		cpuTimeMs = 0.0;	// Animation update and CPU skinning
+		double		gpuTimeMs = 0.0;	// Compute dispatch, read back from timestamp queries
+	} skinningStats;
+
 private:
 	unsigned int	windowWidth = 0;
 	unsigned int	windowHeight = 0;
@@ -103,6 +124,8 @@ private:
 	VkDescriptorPool				descriptorPool		= VK_NULL_HANDLE;
 
 	VerticesDescription				verticesDescription;
+	VerticesDescription				instancedVerticesDescription;
+	VerticesDescription				depthVerticesDescription;
 
 	LeCamera camera;
 	
@@ -118,16 +141,16 @@ private:
 	bool		openLightSetting = false;
 	bool		openMeshSetting = false;
 	bool		showShadowMapDebug = false;
+	bool		useMeshletCulling = true;
+	bool		useInstancing = true;
 	int			cameraButtonValue = 1;
 	uint32_t	currentBuffer = 0;
 
-	// Image Sampler
-	VkSampler normalMapSampler		= VK_NULL_HANDLE;
-	VkSampler specularMapSampler	= VK_NULL_HANDLE;
-	VkSampler metallicMapSampler	= VK_NULL_HANDLE;
-	VkSampler roughnessMapSampler	= VK_NULL_HANDLE;
+	// Image Sampler, from the cache and immutable in the descriptor set layouts
+	SamplerCache samplerCache;
+	VkSampler materialSampler		= VK_NULL_HANDLE;	// Albedo, normal and mask maps
 	VkSampler depthSampler			= VK_NULL_HANDLE;
-	VkSampler skyboxMapSampler		= VK_NULL_HANDLE;
+	VkSampler skyboxMapSampler		= VK_NULL_HANDLE;	// Skybox, prefiltered specular map and BRDF LUT, every level
 
 	// OFFSCREEN RENDERING
 	OffscreenFrameBuffer offscreenFramebuffer;
@@ -147,6 +170,104 @@ private:
 
 	Texture*		skyboxCubeMap;
 
+	// Image based lighting baked from the skybox, its irradiance is in the ambient uniform buffer
+	Texture*		specularCubeMap;
+	Texture*		brdfLut;
+
+	// Meshlet culling
+	LeFrustum						cameraFrustum;
+	LeFrustum						shadowFrustum;
+	glm::vec3						cameraPosition = glm::vec3(0.f);
+	bool							isShadowFrustumValid = false;
+	std::vector<MeshletDrawRange>	meshletDrawRanges;
+
+	// Frustum culling of the scene node buffers, candidate i is box i of the culler
+	struct CullCandidate
+	{
+		MeshSceneNode*	node;
+		MeshBuffer*		buffer;		// Skinned copy of the node when it has one
+		uint32_t		bufferIndex;
+		glm::mat4		model;
+	};
+
+	BoxCuller						sceneBoxCuller;
+	std::vector<CullCandidate>		cullCandidates;
+	std::vector<uint32_t>			spatialProxies;		// Nodes the scene spatial index found in a frustum
+	std::vector<uint8_t>			cameraVisibility;
+	std::vector<uint8_t>			shadowVisibility;
+	uint32_t						visibleBufferCount = 0;
+
+	// Instancing, one slice of the instance and material buffers per swap chain image
+	BufferHandle					instanceBuffer;
+	BufferHandle					materialBuffer;
+	VkDeviceSize					instanceFrameSize = 0;
+	VkDeviceSize					materialFrameSize = 0;
+	uint32_t						instanceCapacity = 0;
+	uint32_t						materialCount = 0;
+	uint32_t						drawCallCount = 0;
+	InstanceBatcher					shadowBatcher;
+	InstanceBatcher					opaqueBatcher;
+	InstanceBatcher					transparentBatcher;
+	InstanceBatcher					lightCubeBatcher;
+	std::unordered_map<std::string, VkDescriptorSet> materialDescriptorSets;
+	uint32_t						uploadedTextureCount = 0;
+
+	// Texture streaming, replaced images are destroyed once the frames in flight are done with them
+	struct RetiredTextureImage
+	{
+		BufferHandle	image;
+		VkImageView		view;
+		BufferHandle	staging;
+		uint64_t		frame;
+	};
+	TextureStreamer					textureStreamer;
+	std::vector<RetiredTextureImage> retiredTextureImages;
+	// The textures a shared material descriptor set was written with, a rebound material moves to another set
+	struct MaterialTextureSet
+	{
+		std::array<Texture*, 3>	textures;	// Albedo, normal map and mask map
+		VkDescriptorSet			descriptorSet;
+	};
+	std::vector<MaterialTextureSet>	materialTextureSets;
+	std::unordered_map<LeMaterial*, float> materialUvPerPixel;
+	uint64_t						frameCount = 0;
+	float							cameraPixelScale = 1.f;	// Pixels per world unit at a distance of one
+
+	// Hot reload of the files saved in Data/ while running
+	AssetReloader					assetReloader;
+
+	// Assets of the AssetManager uploaded between frames, at least one per frame
+	size_t							uploadBudgetBytes = 16ull * 1024 * 1024;
+	double							uploadBudgetMs = 4.0;
+	std::vector<Texture*>			assetTextures;	// Uploaded textures stay registered to the streamer, the driver keeps them alive
+
+	// Skinning, every skinned buffer of a node is drawn from a copy pointing into the per frame skinned vertex buffer
+	struct SkinnedBuffer
+	{
+		MeshBuffer*					source;
+		MeshBuffer*					skinned;
+		const AnimationInstance*	animation;
+		uint32_t					paletteBase;
+		VkDescriptorSet				descriptorSet;
+
+		// Bind pose streams for the CPU path
+		std::vector<glm::vec3>			positions;
+		std::vector<VertexAttributes>	attributes;
+	};
+	std::vector<SkinnedBuffer>		skinnedBuffers;
+	std::unordered_map<const SceneNode*, std::vector<MeshBuffer*>> skinnedNodeBuffers;
+	std::unordered_map<const AnimationInstance*, uint32_t> paletteBases;
+	BufferHandle					skinnedVertexBuffer;
+	BufferHandle					cpuSkinnedVertexBuffer;
+	BufferHandle					paletteBuffer;
+	VkDeviceSize					skinnedFrameSize = 0;
+	VkDeviceSize					paletteFrameSize = 0;
+	VkDescriptorPool				skinningDescriptorPool = VK_NULL_HANDLE;
+	bool							isSkinningPipelineCreated = false;
+	VkQueryPool						timestampQueryPool = VK_NULL_HANDLE;
+	bool							timestampsWritten = false;
+	std::chrono::high_resolution_clock::time_point lastFrameTime;
+
 	// Initialize
 	void drvCreateWindow();
 	void CreateInstance();
@@ -159,7 +280,7 @@ private:
 	void CreateCommandPool();
 	void CreateDescriptorPool();
 	void SetupSampleValues();
-	void CreateTextureSampler();
+	void CreateSamplers();
 	void CreatePipelineCache();
 	void InitializeImGui();
 	void CreateSyncObjects(); 
@@ -169,38 +290,43 @@ private:
 	void CreateFrameBuffer();
 
 	void SetupVertexDescriptions();
+	void SetupInputState(VerticesDescription& description);
 
 	// Create and manage UBOs
 	void PrepareSceneUniformBuffer();
-	void CreateMeshSceneNodeUniformBuffer(MeshSceneNode* node);
 	void UpdateSceneUniformBuffer();
 	void UpdateShadowUniformBuffer(LeLight light, int lightType);
-	void UpdateMeshUniformBuffer(MeshSceneNode* node);
-	void UpdateMaterialUniformBuffer(MeshSceneNode* node);
+
+	// Instance and material buffers
+	void CreateInstanceBuffers();
+	uint32_t GetInstanceCapacity();
+	void GrowInstanceBuffer();
+	void UpdateInstanceBuffers();
 
 	// Create Scene Rendering Objects
 	void CreateMsaaRessources();
 	void CreateRenderPass();
 	void CreateGraphicPipeline();
 	void CreateSceneDescriptorSetLayout();
-	void CreateNodeMeshBufferDescriptorSet(MeshSceneNode* node, MeshBuffer* buffer);
+	void CreateMeshDescriptorSet(Mesh* mesh);
+	void BindMaterialDescriptorSet(Mesh* mesh);
+	std::string GetMaterialTexturesKey(LeMaterial* material);
 	
 	// Create Skybox Rendering Objects
 	void CreateSkyboxPipeline();
-	void CreateSkyboxSampler();
 	void UpdateSkyboxDescriptorSet();
 	void CreateSkyboxDescriptorSetLayout();
 
 	// Create Light Cube Objects
 	void CreateLightCubePipeline();
 	void CreateLightCubeDescriptorSetLayout();
-	void CreateLightCubeBufferDescriptorSet(MeshSceneNode* node, MeshBuffer* buffer, int lightIndex);
+	void UpdateLightCubeDescriptorSet();
 
 	// Create Shadow Rendering Objects
 	void PrepareOffscreenRendering();
 	void CreateShadowPipeline();
 	void CreateShadowDescriptorSetLayout();
-	void UpdateShadowDescriptorSet(MeshSceneNode* node);
+	void UpdateShadowDescriptorSet();
 
 	// Create quad for light shadow map debug
 	void CreateQuadDebugShadowPipeline();
@@ -210,12 +336,25 @@ private:
 	// Drawing Preparation
 	void CreateSceneObjectsBuffers();
 	void CreateMeshBuffers(MeshBuffer* meshBuffer);
+	void DrawMeshBufferMeshlets(MeshBuffer* buffer, const glm::mat4& model, const LeFrustum& frustum, bool cullBackfaces, uint32_t firstInstance);
+	void DrawInstanceBatches(const InstanceBatcher& batcher, VkPipelineLayout pipelineLayout, const LeFrustum* frustum, bool cullBackfaces, bool positionsOnly = false);
+
+	// Skinning
+	void CreateSkinningPipeline();
+	void CreateSkinningBuffers();
+	void UpdateSkinning();
+	void RecordSkinningDispatch();
 
 	// Buffer Management
 	void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 	void CreateTextureBuffer(Texture* texture);
-	void GenerateMipMaps(BufferHandle& srcBuffer, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
-	void CreateCubeMapTextureBuffer(Texture* texture, Texture* cubeMapTextureArray, size_t singleLayerSize);
+	void RecordTextureUpload(Texture* texture, BufferHandle& staging, VkCommandBuffer commandBuffer);
+	void UpdateTextureStreaming(VkCommandBuffer commandBuffer);
+	void RequestTextureDensity(Mesh* mesh, const MeshBuffer* buffer, const glm::mat4& model);
+	void UpdateMaterialTextureDescriptors(const MaterialTextureSet& materialSet);
+	void UpdateAssetReloads();
+	void UpdateAssetUploads();
+	void CreateCubeMapTextureBuffer(Texture* texture, Texture* cubeMapTextureArray);
 	void CopyBufferToImage(BufferHandle& srcBuffer, BufferHandle& dstImage, int layerCount, uint32_t width, uint32_t height);
 	
 	// Command Buffer Management
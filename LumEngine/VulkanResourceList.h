@@ -76,6 +76,14 @@ public:
 		resources[name] = pipeline;
 		return pipeline;
 	}
+
+	VkPipeline addComputePipeline(std::string name, VkComputePipelineCreateInfo &pipelineCreateInfo, VkPipelineCache &pipelineCache)
+	{
+		VkPipeline pipeline;
+		DEBUG_CHECK_VK(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+		resources[name] = pipeline;
+		return pipeline;
+	}
 };
 
 class DescriptorSetLayoutList : public VulkanResourceList<VkDescriptorSetLayout>
@@ -1,16 +1,99 @@
 #define VULKAN_ENABLE_VALIDATION
 #include "VulkanDriver.h"
 #include "MeshLoader.h"
+#include "Skinning.h"
+#include "ThreadPool.h"
+#include "TextureCache.h"
+#include "AssetManager.h"
+#include "VirtualFileSystem.h"
+#include "FrustumCulling.h"
+#include "SceneBvh.h"
+#include "TransformStore.h"
+#include "SceneHierarchy.h"
 
-int main() 
+#include <string>
+#include <chrono>
+
+// --bench-skinning : CPU skinning paths alone, then the same frames skinned by the compute shader and on the CPU
+const int skinningBenchmarkInstances = 256;
+const size_t skinningBenchmarkFrames = 300;
+const size_t skinningBenchmarkWarmUp = 10;
+
+// --bench-culling : world box frustum culling, scalar then SIMD, without opening a window
+const size_t cullingBenchmarkBoxes = 100000;
+const size_t cullingBenchmarkIterations = 200;
+
+// --bench-spatial : scene spatial index build, per frame update of the moving boxes and queries
+const size_t spatialBenchmarkStaticBoxes = 1000000;
+const size_t spatialBenchmarkDynamicBoxes = 10000;
+const size_t spatialBenchmarkFrames = 100;
+
+// --bench-transforms : model matrices composed per node, then by the transform store kernel
+const size_t transformBenchmarkNodes = 100000;
+const size_t transformBenchmarkIterations = 100;
+
+// --bench-hierarchy : world matrices of a forest of trees when a few roots move, then reparenting
+const size_t hierarchyBenchmarkNodes = 100000;
+const size_t hierarchyBenchmarkTreeSize = 100;
+const float hierarchyBenchmarkMovedRoots = 0.01f;
+const size_t hierarchyBenchmarkFrames = 100;
+
+// --pack-data : packs Data/ in one archive, read instead of the loose files when it exists
+const char* const dataDirectory = "../Data";
+const char* const dataArchive = "../Data.lpak";
+
+int main(int argc, char** argv)
 {
+	bool benchmarkSkinning = argc > 1 && std::string(argv[1]) == "--bench-skinning";
+
+	if (argc > 1 && std::string(argv[1]) == "--bench-culling")
+	{
+		CullingBenchmark::Run(cullingBenchmarkBoxes, cullingBenchmarkIterations);
+		return 0;
+	}
+
+	if (argc > 1 && std::string(argv[1]) == "--bench-spatial")
+	{
+		BvhBenchmark::Run(spatialBenchmarkStaticBoxes, spatialBenchmarkDynamicBoxes, spatialBenchmarkFrames);
+		return 0;
+	}
+
+	if (argc > 1 && std::string(argv[1]) == "--bench-transforms")
+	{
+		TransformBenchmark::Run(transformBenchmarkNodes, transformBenchmarkIterations);
+		return 0;
+	}
+
+	if (argc > 1 && std::string(argv[1]) == "--bench-hierarchy")
+	{
+		HierarchyBenchmark::Run(hierarchyBenchmarkNodes, hierarchyBenchmarkTreeSize, hierarchyBenchmarkMovedRoots, hierarchyBenchmarkFrames);
+		return 0;
+	}
+
+	if (argc > 1 && std::string(argv[1]) == "--pack-data")
+	{
+		int fileCount = PackFile::Build(dataDirectory, dataArchive);
+		std::cout << (fileCount < 0 ? "Can't write " : "Packed " + std::to_string(fileCount) + " files in ") << dataArchive << std::endl;
+		return fileCount < 0 ? 1 : 0;
+	}
+
+	// Shaders are loaded by the driver, the archive is mounted first
+	if (VirtualFileSystem::Mount(dataArchive, dataDirectory))
+		std::cout << "Data read from " << dataArchive << std::endl;
+
+	if (benchmarkSkinning)
+		SkinningBenchmark::RunCpu(skinningBenchmarkInstances, 100);
+
 	VulkanDriver vkDriver = VulkanDriver(1820, 980);
 	Scene* scene = vkDriver.CreateEmptyInitialScene();
 
 	scene->AddSkybox("", MeshLoader::LoadDefaultCube());
 	scene->AddShadowDebugQuad(MeshLoader::LoadDefaultQuad());
 
-	Mesh* ironManMesh = MeshLoader::LoadMesh("../Data/Models/Sphere.FBX");
+	// Meshes and textures load through the AssetManager, their nodes are drawn from the first frame with
+	// placeholder textures and no geometry, and fill in as the driver uploads them within its frame budget.
+	// The scene keeps the mesh handles and releases them at shutdown.
+	auto importStart = std::chrono::high_resolution_clock::now();
 
 	float xOffset = 0.f;
 	for (int x = 0; x < 7; ++x)
@@ -18,7 +101,7 @@ int main()
 		float yOffset = 0.f;
 		for (int y = 0; y < 7; ++y)
 		{
-			Mesh* sphere = MeshLoader::LoadMesh("../Data/Models/Sphere.FBX");
+			Mesh* sphere = scene->AddMeshAsset(AssetManager::LoadMesh("../Data/Models/Sphere.FBX"));
 			sphere->GetMaterial()->params.color = glm::vec4(1.f, 0.f, 0.f, 1.f);
 			sphere->GetMaterial()->params.roughness = x / 6.f;
 			sphere->GetMaterial()->params.metallic = y / 6.f;
@@ -28,43 +111,84 @@ int main()
 		xOffset += 130.f;
 	}
 
-	Mesh* ironRusty = MeshLoader::LoadMesh("../Data/Models/Sphere.FBX");
-	ironRusty->GetMaterial()->texture->LoadFile("../Data/Models/RustyIron/albedo.png");
-	ironRusty->GetMaterial()->normalMap->LoadFile("../Data/Models/RustyIron/normal.png");
-	ironRusty->GetMaterial()->metallicMap->LoadFile("../Data/Models/RustyIron/metallic.png");
-	ironRusty->GetMaterial()->roughnessMap->LoadFile("../Data/Models/RustyIron/roughness.png");
+	Mesh* ironRusty = scene->AddMeshAsset(AssetManager::LoadMesh("../Data/Models/Sphere.FBX"));
+	AssetManager::BindTexture(ironRusty, &LeMaterial::texture, AssetManager::LoadTexture("../Data/Models/RustyIron/albedo.png", TextureSemantic::Albedo));
+	AssetManager::BindTexture(ironRusty, &LeMaterial::normalMap, AssetManager::LoadTexture("../Data/Models/RustyIron/normal.png", TextureSemantic::Normal));
+	MaskSources ironRustyMask;
+	ironRustyMask.roughness = "../Data/Models/RustyIron/roughness.png";
+	ironRustyMask.metallic = "../Data/Models/RustyIron/metallic.png";
+	AssetManager::BindTexture(ironRusty, &LeMaterial::maskMap, AssetManager::LoadMask(ironRustyMask));
 	scene->AddMeshNode(ironRusty, glm::vec3(0.f, 600.f, 0.f), glm::vec3(0.02f, 0.02f, 0.02f), glm::vec3(0.f, 0.f, 0.f));
 
 	// Shadow display
-	Mesh* shadowGroundMesh = MeshLoader::LoadMesh("../Data/Models/cube.obj");
+	Mesh* shadowGroundMesh = scene->AddMeshAsset(AssetManager::LoadMesh("../Data/Models/cube.obj"));
 	scene->AddMeshNode(shadowGroundMesh, glm::vec3(0.f, 200.f, 0.f), glm::vec3(18.060f, 0.040f, 16.640f), glm::vec3(0.f, 0.f, 0.f));
-	Mesh* shadowWallMesh = MeshLoader::LoadMesh("../Data/Models/cube.obj");
+	Mesh* shadowWallMesh = scene->AddMeshAsset(AssetManager::LoadMesh("../Data/Models/cube.obj"));
 	scene->AddMeshNode(shadowWallMesh, glm::vec3(0.0f, 1.27f, -208.5f), glm::vec3(18.060f, 10.4f, 0.04f), glm::vec3(0.f, 0.f, 0.f));
-	Mesh* ironManMesh4 = MeshLoader::LoadMesh("../Data/Models/ironman/ironman.fbx");
-	scene->AddMeshNode(ironManMesh4, glm::vec3(-4.7f, 8.25f, 0.f), glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.f, 0.f, 0.f));
-	Mesh* shadowSphere = MeshLoader::LoadMesh("../Data/Models/Sphere.FBX");
+	Mesh* shadowSphere = scene->AddMeshAsset(AssetManager::LoadMesh("../Data/Models/Sphere.FBX"));
 	scene->AddMeshNode(shadowSphere, glm::vec3(-80.f, 450.f, 0.f), glm::vec3(0.02f, 0.02f, 0.02f), glm::vec3(0.f, 0.f, 0.f));
 
-	Mesh* brickCube = MeshLoader::LoadMesh("../Data/Models/cube.obj");
-	brickCube->GetMaterial()->texture->LoadFile("../Data/Models/brickwall.jpg");
-	brickCube->GetMaterial()->normalMap->LoadFile("../Data/Models/normal_mapping_normal_map.png");
+	Mesh* ironMan = scene->AddMeshAsset(AssetManager::LoadMesh("../Data/Models/ironman/ironman.fbx"));
+	scene->AddMeshNode(ironMan, glm::vec3(-4.7f, 8.25f, 0.f), glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.f, 0.f, 0.f));
+
+	Mesh* brickCube = scene->AddMeshAsset(AssetManager::LoadMesh("../Data/Models/cube.obj"));
+	AssetManager::BindTexture(brickCube, &LeMaterial::texture, AssetManager::LoadTexture("../Data/Models/brickwall.jpg", TextureSemantic::Albedo));
+	AssetManager::BindTexture(brickCube, &LeMaterial::normalMap, AssetManager::LoadTexture("../Data/Models/normal_mapping_normal_map.png", TextureSemantic::Normal));
 	scene->AddMeshNode(brickCube, glm::vec3(5.0f, 8.85f, 0.f));
-	Mesh* texCube = MeshLoader::LoadMesh("../Data/Models/cube.obj");
-	texCube->GetMaterial()->texture->LoadFile("../Data/Models/brickwall.jpg");
+	Mesh* texCube = scene->AddMeshAsset(AssetManager::LoadMesh("../Data/Models/cube.obj"));
+	AssetManager::BindTexture(texCube, &LeMaterial::texture, AssetManager::LoadTexture("../Data/Models/brickwall.jpg", TextureSemantic::Albedo));
 	scene->AddMeshNode(texCube, glm::vec3(1.8f, 8.850f, 0.f));
 
-	Mesh* window = MeshLoader::LoadMesh("../Data/Models/plane_z.obj");
-	window->GetMaterial()->texture->LoadFile("../Data/Models/blending_transparent_window.png");
-	scene->AddMeshNode(window, glm::vec3(0.f, 26.f, 18.25f), glm::vec3(0.5f, 0.5f, 0.5f), glm::vec3(0.f, 90.f, 0.f))->isTransparent = true;
+	Mesh* window = scene->AddMeshAsset(AssetManager::LoadMesh("../Data/Models/plane_z.obj"));
+	AssetManager::BindTexture(window, &LeMaterial::texture, AssetManager::LoadTexture("../Data/Models/blending_transparent_window.png", TextureSemantic::Albedo));
+	scene->AddMeshNode(window, glm::vec3(0.f, 26.f, 18.25f), glm::vec3(0.5f, 0.5f, 0.5f), glm::vec3(0.f, 90.f, 0.f))->SetTransparent(true);
+
+	std::cout << "Scene setup : " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - importStart).count()
+		<< " ms on " << ThreadPool::Get().GetWorkerCount() + 1 << " threads" << std::endl;
+
+	if (benchmarkSkinning)
+	{
+		for (int i = 0; i < skinningBenchmarkInstances; ++i)
+			scene->AddModel(MeshLoader::CreateSkinnedTube(32, 64, 32), glm::vec3(-16.f + (i % 16) * 2.f, 30.f + (i / 16) * 5.f, -10.f));
+	}
+
+	size_t frame = 0;
+	double skinningTimes[2] = { 0.0, 0.0 };
 
 	while (!glfwWindowShouldClose(vkDriver.window))
 	{
 		glfwPollEvents();
 
+		// GPU frames first, then CPU frames
+		size_t benchmarkPass = frame / skinningBenchmarkFrames;
+		if (benchmarkSkinning)
+			vkDriver.useGpuSkinning = benchmarkPass == 0;
+
 		vkDriver.PrepareSceneDrawing();
 		vkDriver.PrepareDrawing();
 		vkDriver.PrepareMeshDrawing();
 		vkDriver.SubmitDrawing();
+
+		if (!benchmarkSkinning)
+			continue;
+
+		// GPU times are read back one frame late
+		if (frame % skinningBenchmarkFrames >= skinningBenchmarkWarmUp)
+			skinningTimes[benchmarkPass] += benchmarkPass == 0 ? vkDriver.skinningStats.gpuTimeMs : vkDriver.skinningStats.cpuTimeMs;
+
+		if (++frame == skinningBenchmarkFrames * 2)
+		{
+			const char* names[2] = { "GPU compute", "CPU SIMD multithreaded (with animation update)" };
+			const double measuredFrames = double(skinningBenchmarkFrames - skinningBenchmarkWarmUp);
+
+			std::cout << "Renderer skinning : " << vkDriver.skinningStats.vertexCount << " skinned vertices per frame" << std::endl;
+			for (int pass = 0; pass < 2; ++pass)
+			{
+				double milliseconds = skinningTimes[pass] / measuredFrames;
+				std::cout << "  " << names[pass] << " : " << milliseconds << " ms/frame, " << vkDriver.skinningStats.vertexCount / milliseconds / 1e3 << " M skinned vertices/s" << std::endl;
+			}
+			break;
+		}
 	}
 
 	return 0;